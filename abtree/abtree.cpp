@@ -43,6 +43,10 @@
 #include "console_arguments.hpp"
 #include "database.hpp"
 #include "miscellaneous.hpp" // to_string_with_unit_suffix
+#include "pma/bulk_loading.hpp" // sort_elements
+#include "pma/generic/node_search.hpp"
+#include "slab_allocator.hpp"
+#include "thread_pool.hpp"
 #include "timer.hpp" // Time the single PANN operations
 #include "distribution/random_permutation.hpp"
 
@@ -77,12 +81,7 @@ ABTree::ABTree(size_t iA, size_t iB, size_t lA, size_t lB) :
     intnode_a(iA), intnode_b(iB), leaf_a(lA), leaf_b(lB), min_sizeof_inode(init_memsize_internal_node()), min_sizeof_leaf(init_memsize_leaf()), root(create_leaf()), cardinality(0), num_nodes_allocated(0), num_leaves_allocated(1) {
     validate_bounds();
 
-    // Use the same memory space for nodes & leaves ?
-    bool abtree_random_permutation = false;
-    try { // driver::initialize() should have been already called
-        ARGREF(bool, "abtree_random_permutation").get(abtree_random_permutation);
-    } catch ( configuration::ConsoleArgumentError& e ) { } // ignore
-    if(abtree_random_permutation) set_common_memsize_nodes(true);
+    init_memory_from_configuration();
 }
 
 ABTree::ABTree(size_t B, std::pair<int64_t,int64_t>* elements, std::size_t elements_sz) : ABTree(B/2, B, elements, elements_sz) { }
@@ -94,15 +93,31 @@ ABTree::ABTree(size_t iA, size_t iB, size_t lA, size_t lB, std::pair<int64_t,int
         intnode_a(iA), intnode_b(iB), leaf_a(lA), leaf_b(lB), min_sizeof_inode(init_memsize_internal_node()), min_sizeof_leaf(init_memsize_leaf()), root(nullptr), cardinality(0), num_nodes_allocated(0), num_leaves_allocated(0){
     validate_bounds();
 
+    init_memory_from_configuration();
+
+    // Load the elements
+    initialize_from_array(elements, elements_sz);
+}
+
+void ABTree::init_memory_from_configuration(){
     // Use the same memory space for nodes & leaves ?
     bool abtree_random_permutation = false;
     try { // driver::initialize() should have been already called
         ARGREF(bool, "abtree_random_permutation").get(abtree_random_permutation);
     } catch ( configuration::ConsoleArgumentError& e ) { } // ignore
-    if(abtree_random_permutation) set_common_memsize_nodes(true);
 
-    // Load the elements
-    initialize_from_array(elements, elements_sz);
+    // Allocate the nodes from large chunks of memory?
+    bool abtree_slab_allocator = false;
+    try {
+        ARGREF(bool, "abtree_slab_allocator").get(abtree_slab_allocator);
+    } catch ( configuration::ConsoleArgumentError& e ) { } // ignore
+
+    if(abtree_random_permutation && abtree_slab_allocator){
+        if(root != nullptr){ delete_node(root, 0); root = nullptr; } // the dtor is not invoked
+        throw std::invalid_argument("The options --abtree_random_permutation and --abtree_slab_allocator cannot be combined");
+    }
+    if(abtree_random_permutation) set_common_memsize_nodes(true);
+    if(abtree_slab_allocator) set_slab_allocator(true);
 }
 
 ABTree::~ABTree(){
@@ -116,14 +131,10 @@ ABTree::~ABTree(){
 
 void ABTree::initialize_from_array(std::pair<int64_t, int64_t>* elements, size_t size, bool do_sort){
     using namespace std;
+    constexpr size_t min_elements_per_worker = 1ull << 16;
 
     // sort the elements in the input array
-    if(do_sort){
-        auto comparator = [](const pair<int64_t, int64_t>& e1, const pair<int64_t, int64_t>& e2){
-            return e1.first < e2.first;
-        };
-        std::sort(elements, elements + size, comparator);
-    }
+    if(do_sort){ pma::sort_elements(elements, size, load_threads); }
 
     assert(root == nullptr);
     // single root?
@@ -139,97 +150,83 @@ void ABTree::initialize_from_array(std::pair<int64_t, int64_t>* elements, size_t
         return;
     }
 
-    // general case
+    // The tree is built bottom up, a level at the time. The nodes of each level are allocated first, by the
+    // caller, as the allocators are not thread safe, then the workers fill disjoint ranges of nodes. The
+    // elements (children) are spread evenly among the nodes of each level, the first `mod' nodes take one more.
+    auto num_workers = [this](size_t num_elements){
+        return std::max<size_t>(1, std::min<size_t>(load_threads, num_elements / min_elements_per_worker));
+    };
+
     // leaves
     const size_t num_leaves = ceil(static_cast<double>(size) / leaf_b);
     const size_t leaf_ff = size / num_leaves;
     const size_t leaf_ff_mod = size % num_leaves;
-    size_t leaf_index = 0; // in [0, leaf_ff), or leaf_ff+1) for the first leaves
-    size_t leaf_bbpoint = leaf_ff_mod * (leaf_ff + 1);
-    Leaf* leaf_current = create_leaf();
-
-    // inner nodes
-    int64_t num_levels = ceil(log(num_leaves) / log(intnode_b));
-    struct NodeState{
-        InternalNode* node = nullptr;
-        int64_t first_key = 0; /* it doesn't matter: we don't store the leftmost min anywhere */
-        size_t fill_factor = 0;
-        size_t index = 0;
-        size_t bbpoint = 0;
-    };
-    vector<NodeState> levels(num_levels);
-    height = num_levels + 1;
-
-    // compute the fill factor & bbpoint
-    size_t num_children = num_leaves;
-    for(int l = num_levels -1; l > 0; l--){
-        size_t num_nodes = ceil(((double) num_children) / intnode_b);
-        size_t ff = num_children / num_nodes;
-        size_t mod = num_children % num_nodes;
-        levels[l].fill_factor = ff;
-        levels[l].bbpoint = mod;
-
-        num_children = num_nodes;
-    }
-    levels[0].fill_factor = intnode_b;
-    levels[0].bbpoint = 1;
-
-    std::function<void(int,Node*,int64_t,bool)> propagate;
-    propagate = [&propagate, this, &levels](int level, Node* child, int64_t key, bool last){
-        assert(level >= 0);
-
-        NodeState& current = levels[level];
-        if(!current.node ||
-                (current.index < current.bbpoint && current.node->N == current.fill_factor +1) ||
-                (current.index >= current.bbpoint && current.node->N == current.fill_factor)){
-            assert(((current.node == nullptr && level == 0) || last == false) &&
-                    "It implies creating a new node with no key at the last iteration");
-            assert((current.node == nullptr || level > 0) && "Are we splitting the root?!");
-            if(current.node != nullptr){
-                propagate(level -1, current.node, current.first_key, last);
-                current.index++;
+    vector<Node*> nodes(num_leaves);
+    vector<int64_t> pivots(num_leaves); // the first key of each node in the current level
+    for(size_t i = 0; i < num_leaves; i++){
+        nodes[i] = create_leaf(/* hint */ i > 0 ? reinterpret_cast<Leaf*>(nodes[i -1]) : nullptr);
+    }
+    const size_t leaf_workers = num_workers(size);
+    run_workers(leaf_workers, [&](size_t worker_id){
+        size_t leaf_start = num_leaves * worker_id / leaf_workers;
+        size_t leaf_end = num_leaves * (worker_id +1) / leaf_workers;
+        for(size_t i = leaf_start; i < leaf_end; i++){
+            Leaf* leaf = reinterpret_cast<Leaf*>(nodes[i]);
+            size_t offset = i * leaf_ff + std::min(i, leaf_ff_mod);
+            leaf->N = leaf_ff + (i < leaf_ff_mod);
+            int64_t* __restrict keys = KEYS(leaf);
+            int64_t* __restrict values = VALUES(leaf);
+            for(size_t j = 0; j < leaf->N; j++){
+                keys[j] = elements[offset + j].first;
+                values[j] = elements[offset + j].second;
             }
-            current.node = create_internal_node();
-            CHILDREN(current.node)[0] = child;
-            current.node->N = 1; // node->N refers to the # pointers contained!
-            current.first_key = key;
-
-        } else {
-            assert(current.node->N > 0 && current.node->N < intnode_b);
-            CHILDREN(current.node)[current.node->N] = child;
-            KEYS(current.node)[current.node->N -1] = key;
-            current.node->N++;
-            if(last && level > 0)
-                propagate(level -1, current.node, current.first_key, last);
+            leaf->previous = (i > 0) ? reinterpret_cast<Leaf*>(nodes[i -1]) : nullptr;
+            leaf->next = (i +1 < num_leaves) ? reinterpret_cast<Leaf*>(nodes[i +1]) : nullptr;
+            pivots[i] = keys[0];
         }
-    };
-
-    for(size_t i = 0; i < size; i++){
-        // next leaf?
-        if((i < leaf_bbpoint && leaf_index > leaf_ff) || (i >= leaf_bbpoint && leaf_index >= leaf_ff)){
-            leaf_current->N = leaf_ff;
-            if(i <= leaf_bbpoint) leaf_current->N++; // leaf_current refers to the previous leaf here!
-
-            propagate(num_levels -1, leaf_current, KEYS(leaf_current)[0], false);
+    });
+    height = 1;
 
-            Leaf* leaf_next = create_leaf();
-            leaf_next->previous = leaf_current;
-            leaf_current->next = leaf_next;
-            leaf_current = leaf_next;
-            leaf_index = 0;
-        }
-
-        KEYS(leaf_current)[leaf_index] = elements[i].first;
-        VALUES(leaf_current)[leaf_index] = elements[i].second;
+    // inner nodes
+    while(nodes.size() > 1){
+        const size_t num_children = nodes.size();
+        const size_t num_inodes = ceil(static_cast<double>(num_children) / intnode_b);
+        const size_t inode_ff = num_children / num_inodes;
+        const size_t inode_ff_mod = num_children % num_inodes;
+        vector<Node*> parents(num_inodes);
+        vector<int64_t> parent_pivots(num_inodes);
+        for(size_t i = 0; i < num_inodes; i++){ parents[i] = create_internal_node(/* hint */ i > 0 ? parents[i -1] : nullptr); }
+
+        const size_t inode_workers = num_workers(num_children);
+        run_workers(inode_workers, [&](size_t worker_id){
+            size_t inode_start = num_inodes * worker_id / inode_workers;
+            size_t inode_end = num_inodes * (worker_id +1) / inode_workers;
+            for(size_t i = inode_start; i < inode_end; i++){
+                InternalNode* inode = reinterpret_cast<InternalNode*>(parents[i]);
+                size_t offset = i * inode_ff + std::min(i, inode_ff_mod);
+                inode->N = inode_ff + (i < inode_ff_mod); // node->N refers to the # pointers contained!
+                assert(inode->N <= intnode_b);
+                for(size_t j = 0; j < inode->N; j++){
+                    CHILDREN(inode)[j] = nodes[offset + j];
+                    if(j > 0) KEYS(inode)[j -1] = pivots[offset + j];
+                }
+                parent_pivots[i] = pivots[offset];
+            }
+        });
 
-        leaf_index++;
+        nodes = std::move(parents);
+        pivots = std::move(parent_pivots);
+        height++;
     }
-    leaf_current->N = leaf_ff; // update the size for the last leaf
-    propagate(num_levels -1, leaf_current, KEYS(leaf_current)[0], true); // attach the last leaf
-    root = levels[0].node;
+
+    root = nodes[0];
     cardinality = size;
 }
 
+void ABTree::set_load_threads(size_t num_threads){
+    if(num_threads == 0) throw std::invalid_argument("The number of threads must be > 0");
+    load_threads = num_threads;
+}
 
 void ABTree::load(const std::pair<int64_t, int64_t>* elements, size_t elements_sz){
     assert(cardinality == 0 && "Expected empty");
@@ -285,6 +282,44 @@ int64_t* ABTree::VALUES(const Leaf* leaf) const {
     return KEYS(leaf) + leaf_b;
 }
 
+/*****************************************************************************
+ *                                                                           *
+ *   Node search                                                             *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+// Dispatch to the kernels unrolled over the capacity of the node, for the most common node sizes
+template<bool upper_bound>
+size_t search_node(const int64_t* keys, size_t num_keys, int64_t key, size_t capacity) noexcept {
+    using namespace pma;
+    switch(capacity){
+    case 16: return upper_bound ? node_upper_bound<16>(keys, num_keys, key) : node_lower_bound<16>(keys, num_keys, key);
+    case 32: return upper_bound ? node_upper_bound<32>(keys, num_keys, key) : node_lower_bound<32>(keys, num_keys, key);
+    case 64: return upper_bound ? node_upper_bound<64>(keys, num_keys, key) : node_lower_bound<64>(keys, num_keys, key);
+    default: return upper_bound ? node_upper_bound(keys, num_keys, key) : node_lower_bound(keys, num_keys, key);
+    }
+}
+} // anonymous namespace
+
+size_t ABTree::lower_bound(const InternalNode* inode, int64_t key) const noexcept {
+    assert(inode->N > 0);
+    return search_node</* upper bound ? */ false>(KEYS(inode), inode->N -1, key, intnode_b);
+}
+
+size_t ABTree::upper_bound(const InternalNode* inode, int64_t key) const noexcept {
+    assert(inode->N > 0);
+    return search_node</* upper bound ? */ true>(KEYS(inode), inode->N -1, key, intnode_b);
+}
+
+size_t ABTree::lower_bound(const Leaf* leaf, int64_t key) const noexcept {
+    return search_node</* upper bound ? */ false>(KEYS(leaf), leaf->N, key, leaf_b);
+}
+
+void ABTree::prefetch(const Node* node, int depth) const noexcept {
+    bool is_leaf = (depth == height -1);
+    pma::node_prefetch(node, is_leaf ? sizeof(Leaf) + sizeof(int64_t) * leaf_b : sizeof(InternalNode) + sizeof(int64_t) * intnode_b);
+}
+
 
 /*****************************************************************************
  *                                                                           *
@@ -301,14 +336,18 @@ bool ABTree::is_leaf(int depth) const {
     return (depth == height -1);
 }
 
-ABTree::InternalNode* ABTree::create_internal_node() const {
+ABTree::InternalNode* ABTree::create_internal_node(const Node* hint) const {
     static_assert(!std::is_polymorphic<InternalNode>::value, "Expected a non polymorphic type (no vtable)");
     static_assert(sizeof(InternalNode) == 8, "Expected only 8 bytes for the cardinality");
 
     // (cardinality) 1 + (keys=) intnode_b + (pointers) intnode_b +1 == 2 * intnode_b +2;
     InternalNode* ptr (nullptr);
-    int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_internal_node());
-    if(rc != 0) throw std::runtime_error("ABTree::create_internal_node, cannot obtain a chunk of aligned memory");
+    if(slab_inodes){
+        ptr = reinterpret_cast<InternalNode*>(slab_inodes->allocate(hint));
+    } else {
+        int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_internal_node());
+        if(rc != 0) throw std::runtime_error("ABTree::create_internal_node, cannot obtain a chunk of aligned memory");
+    }
     ptr->N = 0;
 
     num_nodes_allocated++;
@@ -327,14 +366,18 @@ size_t ABTree::memsize_internal_node() const {
     }
 }
 
-ABTree::Leaf* ABTree::create_leaf() const {
+ABTree::Leaf* ABTree::create_leaf(const Leaf* hint) const {
     static_assert(!std::is_polymorphic<Leaf>::value, "Expected a non polymorphic type (no vtable)");
     static_assert(sizeof(Leaf) == 24, "Expected 24 bytes for the cardinality + ptr previous + ptr next");
 
     // (cardinality) 1 + (ptr left/right) 2 + (keys=) leaf_b + (values) leaf_b == 2 * leaf_b + 1;
     Leaf* ptr (nullptr);
-    int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_leaf());
-    if(rc != 0) throw std::runtime_error("ABTree::create_leaf, cannot obtain a chunk of aligned memory");
+    if(slab_leaves){
+        ptr = reinterpret_cast<Leaf*>(slab_leaves->allocate(hint));
+    } else {
+        int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_leaf());
+        if(rc != 0) throw std::runtime_error("ABTree::create_leaf, cannot obtain a chunk of aligned memory");
+    }
     ptr->N = 0;
     ptr->next = ptr->previous = nullptr;
 
@@ -371,7 +414,12 @@ void ABTree::delete_node(Node* node, int depth) const {
         num_leaves_allocated--;
     }
 
-    free(node);
+    SlabAllocator* allocator = is_leaf ? slab_leaves.get() : slab_inodes.get();
+    if(allocator != nullptr){
+        allocator->deallocate(node);
+    } else {
+        free(node);
+    }
 }
 
 #define _STR(x) #x
@@ -483,7 +531,7 @@ void ABTree::split(InternalNode* inode, size_t child_index, int child_depth){
     if(child_is_leaf){
         // split a leaf in half
         Leaf* l1 = reinterpret_cast<Leaf*>(CHILDREN(inode)[child_index]);
-        Leaf* l2 = create_leaf();
+        Leaf* l2 = create_leaf(/* hint */ l1);
 
         assert(l1->N <= leaf_b);
 
@@ -511,7 +559,7 @@ void ABTree::split(InternalNode* inode, size_t child_index, int child_depth){
     // split an internal node
     else {
         InternalNode* n1 = reinterpret_cast<InternalNode*>(CHILDREN(inode)[child_index]);
-        InternalNode* n2 = create_internal_node();
+        InternalNode* n2 = create_internal_node(/* hint */ n1);
 
         size_t thres = n1->N /2;
         n2->N = n1->N - (thres +1);
@@ -552,11 +600,9 @@ void ABTree::insert(Node* node, int64_t key, int64_t value, int depth){
     while(depth < (height -1)){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
 
-        assert(inode->N > 0);
-        size_t i = 0, last_key = inode->N -1;
-        int64_t* __restrict keys = KEYS(inode);
-        while(i < last_key && key > keys[i]) i++;
+        size_t i = lower_bound(inode, key);
         node = CHILDREN(inode)[i];
+        prefetch(node, depth +1);
         COUT_DEBUG("inode: " << inode << ", depth: " << depth << "/" << height << ", child index: " << i);
 
         // before moving to its child, check whether it is full. If this is the case
@@ -1111,9 +1157,8 @@ int64_t ABTree::remove(Node* node, int64_t key, int depth, int64_t* omin){
 
     while(depth < height -1){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = node->N;
-        assert(N > 0);
-        while(i < N -1 && KEYS(inode)[i] < key) i++;
+        size_t N = node->N;
+        size_t i = lower_bound(inode, key);
         if(omin == nullptr && i < N -1 && KEYS(inode)[i] == key){
             // in case omin != nullptr, then i = 0 and we are already following the min
             // from another internal node. This tree has many duplicates.
@@ -1152,8 +1197,7 @@ int64_t ABTree::remove(Node* node, int64_t key, int depth, int64_t* omin){
                 value = values[N-1];
                 leaf->N -= 1;
             } else if(keys[N-1] > key){
-                size_t i = 0;
-                while(i < N && keys[i] < key) i++;
+                size_t i = lower_bound(leaf, key);
                 if(i < N && keys[i] == key){
                     value = values[i];
                     for(size_t j = i; j < leaf->N -1; j++){
@@ -1214,21 +1258,51 @@ int64_t ABTree::find(int64_t key) const noexcept {
     // use tail recursion on the internal nodes
     for(int depth = 0, l = height -1; depth < l; depth++){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = inode->N -1;
-        assert(N > 0 && N <= intnode_b);
-        int64_t* __restrict keys = KEYS(inode);
-        while(i < N && keys[i] <= key) i++;
-        node = CHILDREN(inode)[i];
+        assert(inode->N > 1 && inode->N -1 <= intnode_b);
+        node = CHILDREN(inode)[upper_bound(inode, key)];
+        prefetch(node, depth +1);
     }
 
     // base case, this is a leaf
     Leaf* leaf = reinterpret_cast<Leaf*>(node);
-    size_t i = 0, N = leaf->N;
+    size_t N = leaf->N;
     int64_t* __restrict keys = KEYS(leaf);
-    while(i < N && keys[i] < key) i++;
+    size_t i = lower_bound(leaf, key);
     return (i < N && keys[i] == key) ? VALUES(leaf)[i] : -1;
 }
 
+void ABTree::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    constexpr size_t group_sz = 16;
+    Node* nodes[group_sz];
+    assert(root != nullptr);
+
+    for(size_t i = 0; i < num_keys; i += group_sz){
+        size_t sz = std::min(group_sz, num_keys - i);
+        for(size_t j = 0; j < sz; j++){ nodes[j] = root; }
+
+        // all leaves are at the same depth, descend the tree one level at the time for all keys in the group
+        for(int depth = 0, l = height -1; depth < l; depth++){
+            for(size_t j = 0; j < sz; j++){
+                InternalNode* inode = reinterpret_cast<InternalNode*>(nodes[j]);
+                assert(inode->N > 1 && inode->N -1 <= intnode_b);
+                Node* child = CHILDREN(inode)[upper_bound(inode, keys[i + j])];
+                prefetch(child, depth +1);
+                nodes[j] = child;
+            }
+        }
+
+        // base case, search the leaves
+        for(size_t j = 0; j < sz; j++){
+            Leaf* leaf = reinterpret_cast<Leaf*>(nodes[j]);
+            size_t N = leaf->N;
+            int64_t* __restrict leaf_keys = KEYS(leaf);
+            int64_t key = keys[i + j];
+            size_t k = lower_bound(leaf, key);
+            out_values[i + j] = (k < N && leaf_keys[k] == key) ? VALUES(leaf)[k] : -1;
+        }
+    }
+}
+
 /******************************************************************************
  *                                                                            *
  *   Iterator                                                                 *
@@ -1259,6 +1333,28 @@ std::pair<int64_t, int64_t>  ABTree::Iterator::next() {
     return v;
 }
 
+size_t ABTree::Iterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    if(!block) return 0;
+
+    // the qualifying elements of the current leaf
+    const int64_t* __restrict keys = tree->KEYS(block);
+    size_t start = pos, end = pos, N = block->N;
+    while(end < N && keys[end] <= max) end++;
+    *out_keys = keys + start;
+    *out_values = tree->VALUES(block) + start;
+
+    // move to the next leaf
+    if(end < N){
+        block = nullptr;
+    } else {
+        block = block->next;
+        pos = 0;
+        if(block && tree->KEYS(block)[0] > max){ block = nullptr; }
+    }
+
+    return end - start;
+}
+
 std::unique_ptr<ABTree::Iterator> ABTree::create_iterator(int64_t max, Leaf* leaf, int64_t pos) const {
     if(leaf == nullptr || KEYS(leaf)[pos] > max){
         return std::unique_ptr<ABTree::Iterator>(new ABTree::Iterator(this, max, nullptr, 0));
@@ -1289,9 +1385,7 @@ std::unique_ptr<ABTree::Iterator> ABTree::leaf_scan(Leaf* leaf, int64_t min, int
 
     // standard case, find the first key that satisfies the interval
     } else {
-        size_t i = 0;
-        while(i < leaf->N && KEYS(leaf)[i] < min) i++;
-        return create_iterator(max, leaf, i);
+        return create_iterator(max, leaf, lower_bound(leaf, min));
     }
 }
 
@@ -1302,11 +1396,8 @@ std::unique_ptr<pma::Iterator> ABTree::find(int64_t min, int64_t max) const {
 
     for(int depth = 0, l = height -1; depth < l; depth++){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = inode->N;
-        assert(N > 0);
-        int64_t* __restrict keys = KEYS(inode);
-        while(i < N -1 && keys[i] < min) i++;
-        node = CHILDREN(inode)[i];
+        node = CHILDREN(inode)[lower_bound(inode, min)];
+        prefetch(node, depth +1);
     }
 
     return leaf_scan(reinterpret_cast<Leaf*>(node), min, max);
@@ -1325,11 +1416,8 @@ pma::Interface::SumResult ABTree::sum(int64_t min, int64_t max) const {
     Node* node = root;
     for(int depth = 0, l = height -1; depth < l; depth++){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = inode->N;
-        assert(N > 0);
-        int64_t* __restrict keys = KEYS(inode);
-        while(i < N -1 && keys[i] < min) i++;
-        node = CHILDREN(inode)[i];
+        node = CHILDREN(inode)[lower_bound(inode, min)];
+        prefetch(node, depth +1);
     }
 
     // First the first entry in the current leaf such that key >= min
@@ -1351,8 +1439,7 @@ pma::Interface::SumResult ABTree::sum(int64_t min, int64_t max) const {
     // standard case, find the first key that satisfies the interval
     int64_t* __restrict keys = KEYS(leaf);
     int64_t* __restrict values = VALUES(leaf);
-    int64_t i = 0;
-    while(/*i < leaf->N && */ keys[i] < min) i++;
+    int64_t i = lower_bound(leaf, min);
 
     int64_t N = leaf->N;
     SumResult result;
@@ -1396,6 +1483,55 @@ pma::Interface::SumResult ABTree::sum(int64_t min, int64_t max) const {
 
     return result;
 }
+
+void ABTree::scan(int64_t min, int64_t max, pma::Interface::ScanVisitor& visitor) const {
+    if(min > max || size() == 0){ return; }
+
+    // Find the first leaf for the key `min'
+    Node* node = root;
+    for(int depth = 0, l = height -1; depth < l; depth++){
+        InternalNode* inode = reinterpret_cast<InternalNode*>(node);
+        node = CHILDREN(inode)[lower_bound(inode, min)];
+        prefetch(node, depth +1);
+    }
+
+    // edge case, the interval starts at the sibling leaf
+    Leaf* leaf = reinterpret_cast<Leaf*>(node);
+    assert(leaf->N > 0 && "Empty leaf");
+    if(KEYS(leaf)[leaf->N -1] < min){
+        leaf = leaf->next;
+        assert((leaf == nullptr || leaf->N > 0) && "Empty leaf");
+        if(leaf == nullptr){ return; }
+    }
+
+    // first entry in the leaf such that key >= min
+    size_t i = lower_bound(leaf, min);
+
+    // pass the qualifying entries to the visitor, a leaf at the time
+    bool proceed = true;
+    while(proceed && leaf != nullptr){
+        const int64_t* __restrict keys = KEYS(leaf);
+        const int64_t* __restrict values = VALUES(leaf);
+        const size_t N = leaf->N;
+        size_t j = i;
+        while(j < N && keys[j] <= max /* inclusive */) j++;
+        if(j > i){ proceed = visitor.visit(keys + i, values + i, j - i); }
+
+        if(j < N){ // the next key is > max
+            leaf = nullptr;
+        } else {
+            leaf = leaf->next;
+            i = 0;
+            if(leaf != nullptr && leaf->next != nullptr){
+                // prefetch the next next leaf
+                PREFETCH(leaf->next);
+                PREFETCH(KEYS(leaf->next));
+                PREFETCH(VALUES(leaf->next));
+            }
+        }
+    }
+}
+
 /******************************************************************************
  *                                                                            *
  *   Memory distance among the leaves                                         *
@@ -1728,12 +1864,94 @@ void ABTree::set_common_memsize_nodes(bool value){
         throw std::logic_error("Cannot invoke the method #set_common_memsize_nodes when the data structure is not empty");
     }
 
+    if(value && slab_leaves){
+        // the random permutation would move the leaves into the chunks of the internal nodes and vice versa
+        throw std::logic_error("Cannot use the same memory size for all nodes together with the slab allocators");
+    }
+
     if(common_memsize != value){
         common_memsize = value;
-        delete_node(root, 0);
-        root = create_leaf();
+        bool has_root = root != nullptr; // it is still null when invoked by the ctor for the bulk loading
+        if(has_root){ delete_node(root, 0); root = nullptr; }
+        if(has_root){ root = create_leaf(); }
     }
 }
+
+void ABTree::set_slab_allocator(bool value){
+    if(size() != 0){
+        throw std::logic_error("Cannot invoke the method #set_slab_allocator when the data structure is not empty");
+    }
+
+    if(value && common_memsize){
+        throw std::logic_error("Cannot use the slab allocators together with the same memory size for all nodes");
+    }
+
+    if(static_cast<bool>(slab_leaves) != value){
+        bool has_root = root != nullptr; // it is still null when invoked by the ctor for the bulk loading
+        if(has_root){ delete_node(root, 0); root = nullptr; }
+        if(value){
+            init_slab_allocators();
+        } else {
+            slab_inodes.reset();
+            slab_leaves.reset();
+        }
+        if(has_root){ root = create_leaf(); }
+    }
+}
+
+void ABTree::init_slab_allocators(){
+    slab_inodes.reset(new SlabAllocator(memsize_internal_node()));
+    slab_leaves.reset(new SlabAllocator(memsize_leaf()));
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Defragmentation                                                         *
+ *                                                                           *
+ *****************************************************************************/
+
+void ABTree::defragment(){
+    if(!slab_leaves) return; // the leaves are allocated from the heap
+    COUT_DEBUG("leaves: " << num_leaves_allocated << ", chunks: " << slab_leaves->num_chunks());
+
+    // the new allocator hands out the slots of its chunks sequentially
+    std::unique_ptr<SlabAllocator> allocator { new SlabAllocator(memsize_leaf()) };
+    Leaf* previous = nullptr;
+    defragment_rec(root, 0, allocator.get(), &previous);
+    if(previous != nullptr){ previous->next = nullptr; }
+
+    slab_leaves = std::move(allocator); // release the old chunks altogether
+}
+
+void ABTree::defragment_rec(Node* node, int depth, SlabAllocator* allocator, Leaf** previous){
+    if(is_leaf(depth)){ // only the root
+        assert(node == root);
+        Leaf* copy = reinterpret_cast<Leaf*>(allocator->allocate());
+        memcpy(copy, node, memsize_leaf());
+        copy->previous = nullptr;
+        *previous = copy;
+        root = copy;
+    } else if (is_leaf(depth +1)){ // parent of leaves
+        InternalNode* inode = reinterpret_cast<InternalNode*>(node);
+        Node** children = CHILDREN(inode);
+        for(size_t i = 0; i < inode->N; i++){
+            Leaf* copy = reinterpret_cast<Leaf*>(allocator->allocate());
+            memcpy(copy, children[i], memsize_leaf());
+            copy->previous = *previous;
+            if(*previous != nullptr){ (*previous)->next = copy; }
+            children[i] = copy;
+            *previous = copy;
+        }
+    } else {
+        InternalNode* inode = reinterpret_cast<InternalNode*>(node);
+        Node** children = CHILDREN(inode);
+        for(size_t i = 0; i < inode->N; i++){
+            defragment_rec(children[i], depth +1, allocator, previous);
+        }
+    }
+}
+
+
 void ABTree::build(){
     bool abtree_random_permutation = false;
     try { // driver::initialize() should have been already called
@@ -1742,6 +1960,15 @@ void ABTree::build(){
     if(abtree_random_permutation){
         permute(ARGREF(uint64_t, "seed_random_permutation") + size());
     }
+
+    bool abtree_defragment = false;
+    try {
+        ARGREF(bool, "abtree_defragment").get(abtree_defragment);
+    } catch ( configuration::ConsoleArgumentError& e ) { } // ignore
+    if(abtree_defragment){
+        LOG_VERBOSE("[ABTree::build] Defragmenting the leaves...");
+        defragment();
+    }
 }
 
 void ABTree::permute(uint64_t random_seed){
@@ -22,10 +22,13 @@
 #include "pma/iterator.hpp"
 
 #include <cinttypes>
+#include <memory>
 #include <ostream>
 #include <unordered_map>
 #include <utility>
 
+class SlabAllocator; // forward decl.
+
 namespace abtree {
 
 /**
@@ -87,6 +90,7 @@ class ABTree : public pma::InterfaceRQ {
   public:
     virtual bool hasNext() const override;
     virtual std::pair<int64_t, int64_t> next() override;
+    virtual size_t next_block(const int64_t** out_keys, const int64_t** out_values) override; // the elements of the current leaf
   };
 
   const size_t intnode_a; // lower bound for internal nodes
@@ -96,12 +100,15 @@ class ABTree : public pma::InterfaceRQ {
   bool common_memsize = false; // whether all nodes must be allocated with the same size
   const size_t min_sizeof_inode; // the minimum size, in bytes, of an allocated InternalNode
   const size_t min_sizeof_leaf; // the minimum size, in bytes, of an allocated Leaf
+  std::unique_ptr<SlabAllocator> slab_inodes; // when set, the allocator for the internal nodes, otherwise they are allocated from the heap
+  std::unique_ptr<SlabAllocator> slab_leaves; // when set, the allocator for the leaves, otherwise they are allocated from the heap
   Node* root; // current root
   int64_t cardinality; // number of elements inside the B-Tree
   int height =1; // number of levels, or height of the tree
   mutable size_t num_nodes_allocated; // internal profiling
   mutable size_t num_leaves_allocated; // internal profiling
   bool record_leaf_statistics = false; // whether to record the leaf distances when deleting the tree
+  size_t load_threads = 1; // max number of threads to sort the elements & build the tree in #load
 
   void initialize_from_array(std::pair<int64_t, int64_t>* elements, size_t size, bool do_sort = true);
 
@@ -117,9 +124,26 @@ class ABTree : public pma::InterfaceRQ {
   size_t get_lowerbound(int depth) const;
   size_t get_upperbound(int depth) const;
 
-  // Create a new node / leaf
-  InternalNode* create_internal_node() const;
-  Leaf* create_leaf() const;
+  // Number of keys in the internal node (resp. leaf) strictly less than (lower bound) or less or equal than (upper bound) `key'
+  size_t lower_bound(const InternalNode* inode, int64_t key) const noexcept;
+  size_t upper_bound(const InternalNode* inode, int64_t key) const noexcept;
+  size_t lower_bound(const Leaf* leaf, int64_t key) const noexcept;
+
+  // Prefetch the header & the keys of the node at depth `depth', before searching it
+  void prefetch(const Node* node, int depth) const noexcept;
+
+  // Create a new node / leaf. With the slab allocators, the new node is placed close to the `hint', if possible.
+  InternalNode* create_internal_node(const Node* hint = nullptr) const;
+  Leaf* create_leaf(const Leaf* hint = nullptr) const;
+
+  // Create the slab allocators according to the current size of the nodes
+  void init_slab_allocators();
+
+  // Set the memory allocation of the nodes according to the parameters --abtree_random_permutation and --abtree_slab_allocator
+  void init_memory_from_configuration();
+
+  // Relocate the leaves of the subtree rooted at `node' into the given allocator, in key order
+  void defragment_rec(Node* node, int depth, SlabAllocator* allocator, Leaf** previous);
 
   // Determine the memory size of an internal node / leaf
   size_t init_memsize_internal_node() const;
@@ -263,6 +287,12 @@ public:
    */
   virtual int64_t find(int64_t key) const noexcept override;
 
+  /**
+   * Lookup the given sequence of keys. The tree is traversed in groups of keys, prefetching
+   * the next node of each key while the nodes of the other keys in the group are searched.
+   */
+  virtual void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
   /**
    * Returns an iterator for all keys in the interval [min, max]
    */
@@ -273,6 +303,11 @@ public:
    */
   virtual pma::Interface::SumResult sum(int64_t min, int64_t max) const override;
 
+  /**
+   * Visit all elements in the interval [min, max], a leaf at the time
+   */
+  virtual void scan(int64_t min, int64_t max, pma::Interface::ScanVisitor& visitor) const override;
+
   /**
    * Remove the element having the given key and returns its value. In case
    * of duplicates, it removes only one of the elements in an unspecified manner.
@@ -316,6 +351,11 @@ public:
    */
   virtual void load(const std::pair<int64_t, int64_t>* elements, size_t elements_sz);
 
+  /**
+   * Set the max number of threads, including the caller, to sort the elements and build the tree in #load
+   */
+  void set_load_threads(size_t num_threads);
+
   /**
    * Verify that all nodes in the tree respect the proper bounds. If the validation fails,
    * a std::range_error exception is raised
@@ -329,10 +369,30 @@ public:
    * If this setting is false (default), a permutation will only swap internal nodes with
    * internal nodes, and leaves with leaves, without swapping inodes with leaves.
    *
+   * As the permutation then moves leaves into the memory of internal nodes and vice versa,
+   * this setting cannot be combined with the slab allocators (#set_slab_allocator).
+   *
    * This setting can be changed only when the tree is empty.
    */
   void set_common_memsize_nodes(bool value);
 
+  /**
+   * Set whether the nodes are allocated from slab allocators, i.e. large chunks of memory, possibly backed by
+   * huge pages, rather than individually from the heap. A new node is placed in the same chunk of its sibling, if
+   * possible. By default, it is given by the parameter --abtree_slab_allocator. It cannot be combined with
+   * #set_common_memsize_nodes(true).
+   *
+   * This setting can be changed only when the tree is empty.
+   */
+  void set_slab_allocator(bool value);
+
+  /**
+   * Relocate all leaves, in key order, into a new set of chunks, so that logically consecutive leaves are also
+   * adjacent in memory. It restores the locality of range scans after a long series of updates. It requires the
+   * slab allocator, otherwise it does nothing.
+   */
+  void defragment();
+
   /**
    * Whether to record the average distance among the leaves in the tree. If set, when
    * the tree is deleted, a final pass among all the leaves of the tree is performed. Some
@@ -343,7 +403,8 @@ public:
 
   /**
    * Intercept a batch of inserts has been executed, and randomly permute the node in memory
-   * if the parameter --abtree_random_permutation has been set.
+   * if the parameter --abtree_random_permutation has been set, or defragment the leaves
+   * if the parameter --abtree_defragment has been set.
    */
   void build() override;
 
@@ -20,13 +20,16 @@
 
 #include "art.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib> // free, posix_memalign
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 #include "miscellaneous.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 
@@ -193,6 +196,50 @@ void ART::insert(int64_t key, int64_t value) {
 #endif
 }
 
+void ART::load(pair<int64_t, int64_t>* array, size_t array_sz){
+    COUT_DEBUG("array_sz: " << array_sz);
+    if(array_sz == 0) return;
+    if(!empty()){
+        for(size_t i = 0; i < array_sz; i++){ insert(array[i].first, array[i].second); }
+        return;
+    }
+
+    pma::sort_elements(array, array_sz, get_load_threads());
+
+    // allocate the leaves, the elements are spread evenly, the first `leaf_ff_mod' leaves take one more
+    const size_t num_leaves = (array_sz + m_leaf_block_size -1) / m_leaf_block_size;
+    const size_t leaf_ff = array_sz / num_leaves;
+    const size_t leaf_ff_mod = array_sz % num_leaves;
+    vector<Leaf*> leaves(num_leaves);
+    leaves[0] = m_first;
+    for(size_t i = 1; i < num_leaves; i++){ leaves[i] = create_leaf(); }
+
+    // copy the elements into the leaves
+    constexpr size_t min_elements_per_worker = 1ull << 16;
+    const size_t num_workers = std::max<size_t>(1, std::min<size_t>(get_load_threads(), array_sz / min_elements_per_worker));
+    run_workers(num_workers, [&](size_t worker_id){
+        size_t leaf_start = num_leaves * worker_id / num_workers;
+        size_t leaf_end = num_leaves * (worker_id +1) / num_workers;
+        for(size_t i = leaf_start; i < leaf_end; i++){
+            Leaf* leaf = leaves[i];
+            size_t offset = i * leaf_ff + std::min(i, leaf_ff_mod);
+            leaf->N = leaf_ff + (i < leaf_ff_mod);
+            int64_t* __restrict keys = KEYS(leaf);
+            int64_t* __restrict values = VALUES(leaf);
+            for(size_t j = 0; j < leaf->N; j++){
+                keys[j] = array[offset + j].first;
+                values[j] = array[offset + j].second;
+            }
+            leaf->previous = (i > 0) ? leaves[i -1] : nullptr;
+            leaf->next = (i +1 < num_leaves) ? leaves[i +1] : nullptr;
+        }
+    });
+    m_cardinality = array_sz;
+
+    // the radix tree is not thread safe
+    for(auto leaf : leaves){ index_insert(KEYS(leaf)[0], leaf); }
+}
+
 int64_t ART::leaf_insert(Leaf* leaf, int64_t key, int64_t value){
     COUT_DEBUG("leaf: " << leaf << ", key: " << key << ", value: " << value);
     assert(leaf->N < m_leaf_block_size);
@@ -504,6 +551,28 @@ int64_t ART::find(int64_t key) const {
     return VALUES(leaf)[index];
 }
 
+void ART::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    constexpr size_t group_sz = 16;
+    Leaf* leaves[group_sz];
+
+    for(size_t i = 0; i < num_keys; i += group_sz){
+        size_t sz = min(group_sz, num_keys - i);
+
+        // first pass, traverse the radix tree and request the leaves
+        for(size_t j = 0; j < sz; j++){
+            leaves[j] = index_find_leq(keys[i + j]);
+            if(leaves[j] != nullptr){ PREFETCH(KEYS(leaves[j])); }
+        }
+
+        // second pass, search the leaves
+        for(size_t j = 0; j < sz; j++){
+            Leaf* leaf = leaves[j];
+            int64_t index = (leaf != nullptr) ? leaf_find(leaf, keys[i + j]) : -1;
+            out_values[i + j] = (index >= 0) ? VALUES(leaf)[index] : -1;
+        }
+    }
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Iterator                                                                *
@@ -538,6 +607,28 @@ std::pair<int64_t, int64_t> ART::Iterator::next() {
     return v;
 }
 
+size_t ART::Iterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    if(!block) return 0;
+
+    // the qualifying elements of the current leaf
+    const int64_t* __restrict keys = tree->KEYS(block);
+    size_t start = pos, end = pos, N = block->N;
+    while(end < N && keys[end] <= max) end++;
+    *out_keys = keys + start;
+    *out_values = tree->VALUES(block) + start;
+
+    // move to the next leaf
+    if(end < N){
+        block = nullptr;
+    } else {
+        block = block->next;
+        pos = 0;
+        if(block && tree->KEYS(block)[0] > max){ block = nullptr; }
+    }
+
+    return end - start;
+}
+
 unique_ptr<ART::Iterator> ART::create_iterator(int64_t max, Leaf* leaf, int64_t pos) const {
     if(leaf == nullptr || KEYS(leaf)[pos] > max){
         return unique_ptr<Iterator>(new ART::Iterator(this, max, nullptr, 0));
@@ -670,6 +761,49 @@ pma::Interface::SumResult ART::sum(int64_t min, int64_t max) const {
     return leaf_sum(leaf, i, max);
 }
 
+void ART::scan(int64_t min, int64_t max, pma::Interface::ScanVisitor& visitor) const {
+    if(min > max) return;
+    if(min < 0) min = 0; // this is because ART uses the most significant bit internally as a marker
+
+    Leaf* leaf = index_find_leq(min);
+    if(leaf == nullptr) leaf = m_first;
+    if(leaf->N == 0){ return; } // empty tree
+
+    // edge case, the interval starts at the sibling leaf
+    if(KEYS(leaf)[leaf->N -1] < min){
+        leaf = leaf->next;
+        if(leaf == nullptr) return;
+    }
+
+    // first entry in the leaf such that key >= min
+    size_t i = 0;
+    while(i < leaf->N && KEYS(leaf)[i] < min) i++;
+
+    // pass the qualifying entries to the visitor, a leaf at the time
+    bool proceed = true;
+    while(proceed && leaf != nullptr){
+        const int64_t* __restrict keys = KEYS(leaf);
+        const int64_t* __restrict values = VALUES(leaf);
+        const size_t N = leaf->N;
+        size_t j = i;
+        while(j < N && keys[j] <= max /* inclusive */) j++;
+        if(j > i){ proceed = visitor.visit(keys + i, values + i, j - i); }
+
+        if(j < N){ // the next key is > max
+            leaf = nullptr;
+        } else {
+            leaf = leaf->next;
+            i = 0;
+            if(leaf != nullptr && leaf->next != nullptr){
+                // prefetch the next next leaf
+                PREFETCH(leaf->next);
+                PREFETCH(KEYS(leaf->next));
+                PREFETCH(VALUES(leaf->next));
+            }
+        }
+    }
+}
+
 /******************************************************************************
  *                                                                            *
  *   Dump                                                                     *
@@ -22,13 +22,14 @@
 #ifndef ABTREE_ART_HPP_
 #define ABTREE_ART_HPP_
 
+#include "pma/bulk_loading.hpp"
 #include "pma/interface.hpp"
 #include "pma/iterator.hpp"
 #include "third-party/art/Tree.h"
 
 namespace abtree {
 
-class ART : public pma::InterfaceRQ {
+class ART : public pma::InterfaceRQ, public pma::BulkLoading {
     // Elements are ultimately stored in a linked list of blocks, named leaves
     struct Leaf {
         // remove the ctors
@@ -56,6 +57,7 @@ class ART : public pma::InterfaceRQ {
     public:
       virtual bool hasNext() const override;
       virtual std::pair<int64_t, int64_t> next() override;
+      virtual size_t next_block(const int64_t** out_keys, const int64_t** out_values) override; // the elements of the current leaf
     };
 
     // Translate a key from humans into a key for the ART tree
@@ -134,16 +136,27 @@ public:
 
     void insert(int64_t key, int64_t value) override;
 
+    /**
+     * Load a batch of elements. If the tree is empty, the elements are sorted, with up to #get_load_threads() threads,
+     * and copied into new leaves by the same threads; the pivots of the leaves are then inserted into the radix tree,
+     * sequentially. Otherwise the elements are inserted one by one.
+     */
+    void load(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
+
     int64_t remove(int64_t key) override;
 
     int64_t find(int64_t key) const override;
 
+    void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
     std::unique_ptr<pma::Iterator> find(int64_t min, int64_t max) const override;
 
     std::unique_ptr<pma::Iterator> iterator() const override;
 
     SumResult sum(int64_t min, int64_t max) const override;
 
+    void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+
     size_t size() const override;
 
     bool empty() const noexcept;
@@ -17,18 +17,22 @@
 
 #include "dense_array.hpp"
 
-#include <algorithm> // std::sort
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstring> // strerror
 #include <linux/memfd.h> // MFD_HUGETLB
 #include <iostream>
+#include <limits>
+#include <new> // std::bad_alloc
+#include <stdexcept>
 #include <sys/mman.h> // mmap
 #include <unistd.h> // close
 
 #include "configuration.hpp"
 #include "errorhandling.hpp"
 #include "miscellaneous.hpp"
+#include "thread_pool.hpp"
 
 using namespace pma;
 using namespace std;
@@ -57,7 +61,8 @@ namespace abtree {
  *                                                                           *
  *****************************************************************************/
 
-DenseArray::DenseArray(size_t node_size) : m_index(node_size), m_keys(nullptr), m_values(nullptr), m_cardinality(0) { }
+DenseArray::DenseArray(size_t node_size) : m_index(node_size), m_keys(nullptr), m_values(nullptr), m_cardinality(0),
+        m_delta(/* segment capacity */ 64, CachedDensityBounds{ /* rho_0 */ 0.08, /* rho_h */ 0.3, /* theta_h */ 0.75, /* theta_0 */ 1.0 }) { }
 
 DenseArray::~DenseArray() {
     release_memory(m_handle_physical_memory_keys, m_handle_physical_memory_values, m_keys, m_values, m_cardinality);
@@ -71,15 +76,24 @@ DenseArray::~DenseArray() {
  *****************************************************************************/
 
 void DenseArray::insert(int64_t k, int64_t v){
-    m_delta.emplace_back(k, v);
+    m_delta.insert(k, v);
 }
 
 size_t DenseArray::size() const {
-    return m_cardinality;
+    return m_cardinality + m_delta.size();
 }
 
 bool DenseArray::empty() const {
-    return m_cardinality == 0;
+    return m_cardinality == 0 && m_delta.empty();
+}
+
+size_t DenseArray::delta_size() const {
+    return m_delta.size();
+}
+
+void DenseArray::set_build_threads(size_t num_threads){
+    if(num_threads == 0) throw std::invalid_argument("The number of threads must be > 0");
+    m_build_threads = num_threads;
 }
 
 /******************************************************************************
@@ -87,56 +101,149 @@ bool DenseArray::empty() const {
  *   Build                                                                    *
  *                                                                            *
  *****************************************************************************/
-void DenseArray::build() {
-    if(m_delta.empty()) return; // nop
+namespace {
+
+// The elements of the delta as a sequence of contiguous runs, one for each non empty segment of the PMA
+struct DeltaRuns {
+    vector<const int64_t*> m_keys; // the keys of each run
+    vector<const int64_t*> m_values; // the values of each run
+    vector<uint64_t> m_offsets; // the position of the first element of each run in the delta, plus the total cardinality as last entry
+
+    template<typename PMA>
+    DeltaRuns(const PMA& delta) {
+        uint64_t offset = 0;
+        for(size_t segment_id = 0, end = delta.get_number_segments(); segment_id < end; segment_id++){
+            const int64_t* keys; const int64_t* values;
+            size_t size = delta.get_segment(segment_id, &keys, &values);
+            if(size == 0) continue;
+            m_keys.push_back(keys);
+            m_values.push_back(values);
+            m_offsets.push_back(offset);
+            offset += size;
+        }
+        m_offsets.push_back(offset);
+    }
+
+    uint64_t size() const { return m_offsets.back(); }
+
+    // The run containing the element at the given position of the delta
+    size_t run(uint64_t position) const {
+        return std::upper_bound(m_offsets.begin(), m_offsets.end(), position) - m_offsets.begin() -1;
+    }
+
+    int64_t key(uint64_t position) const {
+        size_t r = run(position);
+        return m_keys[r][position - m_offsets[r]];
+    }
+};
+
+} // anonymous namespace
+
+// Merge path: the number of elements from the sequence `a' among the first `diagonal' elements of the merge of a and b,
+// where the ties are resolved in favour of a
+static uint64_t merge_path(const int64_t* a, uint64_t a_length, const DeltaRuns& b, uint64_t diagonal){
+    const uint64_t b_length = b.size();
+    uint64_t lo = diagonal > b_length ? diagonal - b_length : 0;
+    uint64_t hi = std::min(diagonal, a_length);
+    while(lo < hi){
+        uint64_t mid = (lo + hi) / 2;
+        if(a[mid] <= b.key(diagonal - mid -1)){
+            lo = mid +1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void DenseArray::merge(int64_t* __restrict keys_new, int64_t* __restrict values_new) const {
+    const int64_t *__restrict keys_old(m_keys), *__restrict values_old(m_values);
+    const DeltaRuns delta { m_delta };
+    const uint64_t cardinality_old = m_cardinality;
+    const uint64_t cardinality_delta = delta.size();
+    const uint64_t cardinality_new = cardinality_old + cardinality_delta;
+    constexpr uint64_t min_elements_per_worker = 1ull << 16; // do not bother to spawn a thread for less elements
+    const size_t num_workers = std::max<uint64_t>(1, std::min<uint64_t>(m_build_threads, cardinality_new / min_elements_per_worker));
+    COUT_DEBUG("cardinality old: " << cardinality_old << ", delta: " << cardinality_delta << " in " << delta.m_keys.size() << " runs, workers: " << num_workers);
+
+    // each worker merges an equal portion of the output, starting from the split points given by the merge path
+    run_workers(num_workers, [&](size_t worker_id){
+        uint64_t k = cardinality_new * worker_id / num_workers;
+        uint64_t k_end = cardinality_new * (worker_id +1) / num_workers;
+        uint64_t i = merge_path(keys_old, cardinality_old, delta, k);
+        uint64_t j = k - i;
+        uint64_t i_end = merge_path(keys_old, cardinality_old, delta, k_end);
+        uint64_t j_end = k_end - i_end;
+        if(j == j_end){ // only elements from the dense arrays
+            memcpy(keys_new + k, keys_old + i, (i_end - i) * sizeof(int64_t));
+            memcpy(values_new + k, values_old + i, (i_end - i) * sizeof(int64_t));
+            return;
+        }
 
-    // sort the delta
-    std::sort(begin(m_delta), end(m_delta), [](const auto& e1, const auto& e2){
-       return e1.first < e2.first;
+        // the current run of the delta
+        size_t r = delta.run(j);
+        const int64_t* __restrict delta_keys = delta.m_keys[r];
+        const int64_t* __restrict delta_values = delta.m_values[r];
+        uint64_t run_start = delta.m_offsets[r]; // position in the delta of the first element of the run
+        uint64_t run_end = std::min(delta.m_offsets[r +1], j_end);
+
+        while(true){
+            while(i < i_end && j < run_end){
+                assert(k < cardinality_new && "Invalid index, over the actual capacity of the new arrays");
+                if(keys_old[i] <= delta_keys[j - run_start]){
+                    keys_new[k] = keys_old[i];
+                    values_new[k] = values_old[i];
+                    i++;
+                } else {
+                    keys_new[k] = delta_keys[j - run_start];
+                    values_new[k] = delta_values[j - run_start];
+                    j++;
+                }
+                k++;
+            }
+
+            if(j < run_end){ // the dense arrays are exhausted, copy the rest of the run
+                memcpy(keys_new + k, delta_keys + (j - run_start), (run_end - j) * sizeof(int64_t));
+                memcpy(values_new + k, delta_values + (j - run_start), (run_end - j) * sizeof(int64_t));
+                k += run_end - j;
+                j = run_end;
+            }
+            if(j == j_end) break;
+
+            // move to the next run
+            r++;
+            delta_keys = delta.m_keys[r];
+            delta_values = delta.m_values[r];
+            run_start = delta.m_offsets[r];
+            run_end = std::min(delta.m_offsets[r +1], j_end);
+        }
+
+        memcpy(keys_new + k, keys_old + i, (i_end - i) * sizeof(int64_t));
+        memcpy(values_new + k, values_old + i, (i_end - i) * sizeof(int64_t));
+        assert(k + (i_end - i) == k_end);
     });
+}
+
+void DenseArray::build() {
+    if(m_delta.empty()) return; // nop
+    const uint64_t cardinality_delta = m_delta.size();
 
     // acquire some physical memory
-    uint64_t cardinality_new = m_cardinality + m_delta.size();
+    uint64_t cardinality_new = m_cardinality + cardinality_delta;
     int handle_keys_new (-1), handle_values_new (-1);
     int64_t *keys_new(nullptr), *values_new(nullptr);
     acquire_memory(&handle_keys_new, &handle_values_new, &keys_new, &values_new, cardinality_new);
     auto dealloc = [&, this](int64_t*){ release_memory(handle_keys_new, handle_values_new, keys_new, values_new, cardinality_new); };
     unique_ptr<int64_t, decltype(dealloc)> protect_from_memory_leak{ (int64_t*) 0x1, dealloc };
 
-    // merge
-    int64_t *__restrict keys_old(m_keys), *__restrict values_old(m_values);
-    uint64_t cardinality_old = m_cardinality;
-    uint64_t cardinality_delta = m_delta.size();
-    uint64_t i(0), j(0), k(0);
-    while(i < cardinality_old && j < cardinality_delta){
-        assert(k < cardinality_new && "Invalid index, over the actual capacity of the new arrays");
-        if(keys_old[i] < m_delta[j].first){
-            keys_new[k] = keys_old[i];
-            values_new[k] = values_old[i];
-            i++;
-        } else {
-            keys_new[k] = m_delta[j].first;
-            values_new[k] = m_delta[j].second;
-            j++;
-        }
-        k++;
-    }
-    while(i < cardinality_old){
-        keys_new[k] = keys_old[i];
-        values_new[k] = values_old[i];
-        i++; k++;
-    }
-    while(j < cardinality_delta){
-        keys_new[k] = m_delta[j].first;
-        values_new[k] = m_delta[j].second;
-        j++; k++;
-    }
+    // merge the segments of the delta directly into the new arrays
+    merge(keys_new, values_new);
 
     // rebuild the index
     const uint64_t node_size = m_index.node_size();
     const uint64_t cardinality_index = cardinality_new / node_size + ((cardinality_new % node_size) > 0);
     m_index.rebuild(cardinality_index);
-    for(uint64_t i = 0; i < cardinality_index; i++){ // `i' shadows the previous var for the merge
+    for(uint64_t i = 0; i < cardinality_index; i++){
         m_index.set_separator_key(i, keys_new[i * node_size]);
     }
 
@@ -209,6 +316,14 @@ void DenseArray::acquire_memory(int* out_handle_keys, int* out_handle_values, in
     *out_array_keys = reinterpret_cast<int64_t*>(mmap_keys);
     *out_array_values = reinterpret_cast<int64_t*>(mmap_values);
 
+    // request transparent huge pages for the shmem backed mappings
+    if(configuration::use_transparent_huge_pages()){
+        rc = madvise(mmap_keys, memory_required_bytes, MADV_HUGEPAGE);
+        if(rc != 0){ RAISE("Cannot request transparent huge pages (keys). madvise error: " << strerror(errno) << "(" << errno << ")"); }
+        rc = madvise(mmap_values, memory_required_bytes, MADV_HUGEPAGE);
+        if(rc != 0){ RAISE("Cannot request transparent huge pages (values). madvise error: " << strerror(errno) << "(" << errno << ")"); }
+    }
+
     protect_from_memory_leak.release(); // we're done
 }
 
@@ -260,47 +375,126 @@ uint64_t DenseArray::get_amount_memory_needed(uint64_t cardinality){
  *   Find                                                                     *
  *                                                                            *
  *****************************************************************************/
-int64_t DenseArray::find(int64_t key) const {
-    if(empty()) return -1;
-
-    size_t i = m_index.find_first(key) * m_index.node_size();
-    int64_t* __restrict keys = m_keys;
-    while(i < m_cardinality && keys[i] < key) i++;
-    return (i < m_cardinality && keys[i] == key) ? m_values[i] : -1;
-}
-
-unique_ptr<pma::Iterator> DenseArray::find(int64_t min, int64_t max) const {
-    if(min > max || empty()) return make_unique<InternalIterator>(this, 0, 0); // empty iterator
+void DenseArray::find_interval(int64_t min, int64_t max, int64_t* out_begin, int64_t* out_end) const {
+    if(min > max || m_cardinality == 0){ *out_begin = *out_end = 0; return; }
+    const int64_t* __restrict keys = m_keys;
     int64_t node_size = m_index.node_size();
-    int64_t index_first = m_index.find_first(min) * node_size;
     int64_t end = m_cardinality;
-    int64_t* __restrict keys = m_keys;
+    int64_t index_first = m_index.find_first(min) * node_size;
     while(index_first < end && keys[index_first] < min) index_first++;
     int64_t index_last = m_index.find_last(max) * node_size;
     while(index_last < end && keys[index_last] <= max) index_last++;
+    *out_begin = index_first;
+    *out_end = std::max(index_first, index_last);
+}
+
+int64_t DenseArray::find(int64_t key) const {
+    int64_t value = -1;
+    if(m_cardinality > 0){
+        size_t i = m_index.find_first(key) * m_index.node_size();
+        int64_t* __restrict keys = m_keys;
+        while(i < m_cardinality && keys[i] < key) i++;
+        if(i < m_cardinality && keys[i] == key) return m_values[i];
+    }
+    m_delta.find(key, &value);
+    return value;
+}
+
+void DenseArray::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    if(m_cardinality == 0){
+        for(size_t i = 0; i < num_keys; i++){ out_values[i] = -1; m_delta.find(keys[i], out_values + i); }
+        return;
+    }
+
+    constexpr size_t group_sz = 16;
+    uint64_t nodes[group_sz];
+    const uint64_t node_size = m_index.node_size();
+    for(size_t i = 0; i < num_keys; i += group_sz){
+        size_t sz = min(group_sz, num_keys - i);
+        m_index.find_batch(keys + i, nodes, sz);
+        for(size_t j = 0; j < sz; j++){ PREFETCH(m_keys + nodes[j] * node_size); }
+
+        for(size_t j = 0; j < sz; j++){
+            int64_t key = keys[i + j];
+            size_t k = nodes[j] * node_size;
+            while(k < m_cardinality && m_keys[k] < key) k++;
+            if(k < m_cardinality && m_keys[k] == key){
+                out_values[i + j] = m_values[k];
+            } else { // search in the delta
+                out_values[i + j] = -1;
+                m_delta.find(key, out_values + i + j);
+            }
+        }
+    }
+}
+
+unique_ptr<pma::Iterator> DenseArray::find(int64_t min, int64_t max) const {
+    int64_t index_first, index_last;
+    find_interval(min, max, &index_first, &index_last);
 
     COUT_DEBUG("[" << min << ", " << max << "] index_first: " << index_first << ", index_last: " << index_last);
 
-    return make_unique<InternalIterator>(this, index_first, index_last);
+    return make_unique<InternalIterator>(this, index_first, index_last, min, max);
 }
 
 unique_ptr<pma::Iterator> DenseArray::iterator() const {
-    return make_unique<InternalIterator>(this, 0, m_cardinality);
+    return make_unique<InternalIterator>(this, 0, m_cardinality, numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max());
 }
 
-DenseArray::InternalIterator::InternalIterator(const DenseArray* instance, size_t begin, size_t end) :
-        m_keys(instance->m_keys), m_values(instance->m_values), m_offset(begin), m_end(end) { }
+DenseArray::InternalIterator::InternalIterator(const DenseArray* instance, size_t begin, size_t end, int64_t min, int64_t max) :
+        m_keys(instance->m_keys), m_values(instance->m_values), m_offset(begin), m_end(end) {
+    instance->m_delta.scan(min, max, [this](const int64_t* keys, const int64_t* values, size_t length){
+        m_delta_keys.insert(m_delta_keys.end(), keys, keys + length);
+        m_delta_values.insert(m_delta_values.end(), values, values + length);
+        return true;
+    });
+}
 
-bool DenseArray::InternalIterator::hasNext() const { return m_offset < m_end; }
+bool DenseArray::InternalIterator::hasNext() const { return m_offset < m_end || m_delta_offset < m_delta_keys.size(); }
 
 pair<int64_t, int64_t> DenseArray::InternalIterator::next() {
     pair<int64_t, int64_t> result;
-    result.first = m_keys[m_offset];
-    result.second = m_values[m_offset];
-    m_offset++;
+    if(m_delta_offset == m_delta_keys.size() || (m_offset < m_end && m_keys[m_offset] <= m_delta_keys[m_delta_offset])){
+        result.first = m_keys[m_offset];
+        result.second = m_values[m_offset];
+        m_offset++;
+    } else {
+        result.first = m_delta_keys[m_delta_offset];
+        result.second = m_delta_values[m_delta_offset];
+        m_delta_offset++;
+    }
     return result;
 }
 
+size_t DenseArray::InternalIterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    const uint64_t delta_size = m_delta_keys.size();
+    size_t length = 0;
+    if(m_delta_offset == delta_size){ // all remaining elements of the dense array
+        *out_keys = m_keys + m_offset;
+        *out_values = m_values + m_offset;
+        length = m_end - m_offset;
+        m_offset = m_end;
+    } else if (m_offset == m_end){ // all remaining elements of the delta
+        *out_keys = m_delta_keys.data() + m_delta_offset;
+        *out_values = m_delta_values.data() + m_delta_offset;
+        length = delta_size - m_delta_offset;
+        m_delta_offset = delta_size;
+    } else if (m_keys[m_offset] <= m_delta_keys[m_delta_offset]){ // the run of the dense array up to the next key of the delta
+        uint64_t stop = upper_bound(m_keys + m_offset, m_keys + m_end, m_delta_keys[m_delta_offset]) - m_keys;
+        *out_keys = m_keys + m_offset;
+        *out_values = m_values + m_offset;
+        length = stop - m_offset;
+        m_offset = stop;
+    } else { // the run of the delta up to the next key of the dense array
+        uint64_t stop = lower_bound(m_delta_keys.begin() + m_delta_offset, m_delta_keys.end(), m_keys[m_offset]) - m_delta_keys.begin();
+        *out_keys = m_delta_keys.data() + m_delta_offset;
+        *out_values = m_delta_values.data() + m_delta_offset;
+        length = stop - m_delta_offset;
+        m_delta_offset = stop;
+    }
+    return length;
+}
+
 /******************************************************************************
  *                                                                            *
  *   Sum                                                                      *
@@ -312,34 +506,76 @@ pma::Interface::SumResult DenseArray::sum(int64_t min, int64_t max) const {
 
     int64_t* __restrict keys = m_keys;
     int64_t* __restrict values = m_values;
+    int64_t offset, end;
+    find_interval(min, max, &offset, &end);
+
+    if(offset < end){
+        result.m_first_key = keys[offset];
+        result.m_last_key = keys[end -1];
+        result.m_num_elements = end - offset;
+        do {
+            result.m_sum_keys += keys[offset];
+            result.m_sum_values += values[offset];
+            offset++;
+        } while(offset < end);
+    }
 
-    int64_t node_size = m_index.node_size();
-    int64_t offset = m_index.find_first(min) * node_size;
-    while(offset < m_cardinality && keys[offset] < min) offset++;
-    int64_t end = m_index.find_last(max) * node_size;
-    while(end < m_cardinality && keys[end] <= max) end++;
-
-    if(offset >= end) return result;
-
-    result.m_first_key = keys[offset];
-    result.m_last_key = keys[end -1];
-    result.m_num_elements = end - offset;
-    do {
-        result.m_sum_keys += keys[offset];
-        result.m_sum_values += values[offset];
-        offset++;
-    } while(offset < end);
+    // elements in the delta
+    m_delta.scan(min, max, [&result](const int64_t* keys, const int64_t* values, size_t length){
+        if(result.m_num_elements == 0 || keys[0] < result.m_first_key) result.m_first_key = keys[0];
+        if(result.m_num_elements == 0 || keys[length -1] > result.m_last_key) result.m_last_key = keys[length -1];
+        result.m_num_elements += length;
+        for(size_t i = 0; i < length; i++){
+            result.m_sum_keys += keys[i];
+            result.m_sum_values += values[i];
+        }
+        return true;
+    });
 
     return result;
 }
 
+void DenseArray::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    if(min > max || empty()) return;
+
+    const int64_t* __restrict keys = m_keys;
+    int64_t offset, end;
+    find_interval(min, max, &offset, &end);
+
+    // interleave the runs of the dense array with the runs of the delta
+    bool keep_going = true;
+    m_delta.scan(min, max, [&](const int64_t* delta_keys, const int64_t* delta_values, size_t delta_length){
+        size_t i = 0;
+        while(i < delta_length){
+            if(offset < end && keys[offset] <= delta_keys[i]){
+                int64_t stop = upper_bound(keys + offset, keys + end, delta_keys[i]) - keys;
+                keep_going = visitor.visit(keys + offset, m_values + offset, stop - offset);
+                offset = stop;
+            } else {
+                size_t stop = (offset < end) ? lower_bound(delta_keys + i, delta_keys + delta_length, keys[offset]) - delta_keys : delta_length;
+                keep_going = visitor.visit(delta_keys + i, delta_values + i, stop - i);
+                i = stop;
+            }
+            if(!keep_going) return false;
+        }
+        return true;
+    });
+
+    // the remaining elements are already contiguous
+    if(keep_going && offset < end){ visitor.visit(keys + offset, m_values + offset, end - offset); }
+}
+
 /******************************************************************************
  *                                                                            *
  *   Dump                                                                     *
  *                                                                            *
  *****************************************************************************/
+void DenseArray::set_index_layout(pma::StaticIndex::Layout layout) {
+    m_index.set_layout(layout);
+}
+
 size_t DenseArray::memory_footprint() const {
-    return get_amount_memory_needed(m_cardinality) *2 /* x2 = keys and values */ + m_index.memory_footprint();
+    return get_amount_memory_needed(m_cardinality) *2 /* x2 = keys and values */ + m_index.memory_footprint() + m_delta.memory_footprint();
 }
 
 void DenseArray::dump() const {
@@ -353,10 +589,8 @@ void DenseArray::dump() const {
         cout << "\n\n";
     }
 
-    cout << "[Delta] cardinality: " << m_delta.size() << endl;
-    for(uint64_t i = 0; i < m_delta.size(); i++){
-        cout << "[" << i << "] key: " << m_delta[i].first << ", value: " << m_delta[i].second << "\n";
-    }
+    cout << "[Delta] ";
+    m_delta.dump(cout);
 }
 
 } /* namespace abtree */
@@ -24,6 +24,7 @@
 
 #include "pma/interface.hpp"
 #include "pma/iterator.hpp"
+#include "pma/btree/10/packed_memory_array.hpp"
 #include "pma/generic/static_index.hpp"
 
 namespace abtree {
@@ -34,14 +35,13 @@ private:
     int64_t* m_keys; // a dense static array containing the ordered sequence of keys
     int64_t* m_values; // a dense static array containing the ordered sequence of values
     uint64_t m_cardinality; // the current number of elements stored in the dense arrays (it doesn't take into account the delta)
-    using delta_t = std::vector<std::pair<int64_t, int64_t>>;
-    delta_t m_delta; // delta (temporary) storage, elements inserted but not yet merged in the static dense array.
+    pma::v10::PackedMemoryArray<int64_t, int64_t> m_delta; // delta storage, elements inserted but not yet merged in the static dense array.
     int m_handle_physical_memory_keys = -1; // the handle to the physical memory for the allocated storage that backs the array `m_keys'
     int m_handle_physical_memory_values = -1; // as above, for the array `m_values'
+    size_t m_build_threads = 1; // max number of threads to merge the delta in the dense arrays
 
-    // NB: the delta is merged only when explicitly invoking the method ::build(). In this implementation elements in the
-    // delta are NOT sorted, they do not participate in scans and are not searched in. A delta here only represents a
-    // temporary buffer for elements to be stored in the static dense arrays m_keys and m_values.
+    // NB: the delta is merged only when explicitly invoking the method ::build(). The delta is a sorted PMA, its elements
+    // are searched in and participate in the scans together with the elements of the dense arrays.
 
     void acquire_memory(int* out_handle_keys, int* out_handle_values, int64_t** out_array_keys, int64_t** out_array_values, uint64_t total_cardinality);
 
@@ -51,18 +51,27 @@ private:
     // to a page boundary.
     static uint64_t get_amount_memory_needed(uint64_t cardinality);
 
-    // Implementation of the iterator class
+    // Retrieve the positions [*out_begin, *out_end) of the elements in the dense arrays in the interval [min, max]
+    void find_interval(int64_t min, int64_t max, int64_t* out_begin, int64_t* out_end) const;
+
+    // Merge the dense arrays with the segments of the delta, writing the result into the given arrays
+    void merge(int64_t* out_keys, int64_t* out_values) const;
+
+    // Implementation of the iterator class. It merges the elements of the dense arrays with a copy of the elements of the delta in the same interval.
     class InternalIterator : public pma::Iterator {
         int64_t* m_keys; // a dense static array containing the ordered sequence of keys
         int64_t* m_values; // a dense static array containing the ordered sequence of values
         uint64_t m_offset; // current position
         uint64_t m_end; // final position
+        std::vector<int64_t> m_delta_keys; // the keys of the delta in the interval scanned
+        std::vector<int64_t> m_delta_values; // the values of the delta in the interval scanned
+        uint64_t m_delta_offset = 0; // current position in the delta
 
     public:
         /**
-         * Perform a scan in [begin_incl, end_excl)
+         * Perform a scan in [begin_incl, end_excl) of the dense arrays and [min, max] of the delta
          */
-        InternalIterator(const DenseArray* instance, size_t begin_incl, size_t end_excl);
+        InternalIterator(const DenseArray* instance, size_t begin_incl, size_t end_excl, int64_t min, int64_t max);
 
         /**
          * Check whether a next element exists
@@ -73,6 +82,11 @@ private:
          * Return the next element
          */
         std::pair<int64_t, int64_t> next() override;
+
+        /**
+         * Return all remaining elements in a single block, without copies
+         */
+        size_t next_block(const int64_t** out_keys, const int64_t** out_values) override;
     };
 
 public:
@@ -88,17 +102,17 @@ public:
     virtual ~DenseArray();
 
     /**
-     * Append the given <key, value> in the delta
+     * Insert the given <key, value> in the delta
      */
     void insert(int64_t key, int64_t value) override;
 
     /**
-     * Return the number of elements in the static tree, without taking into account the delta
+     * Return the number of elements stored, both in the dense arrays and in the delta
      */
     std::size_t size() const override;
 
     /**
-     * Check whether the data structure is empty, withouth taking into account the delta
+     * Check whether the data structure is empty, both the dense arrays and the delta
      */
     bool empty() const;
 
@@ -107,12 +121,27 @@ public:
      */
     void build() override;
 
+    /**
+     * Set the max number of threads to merge the delta into the dense arrays, in #build
+     */
+    void set_build_threads(size_t num_threads);
+
+    /**
+     * Retrieve the number of elements in the delta, not merged yet in the dense arrays
+     */
+    size_t delta_size() const;
+
     /**
      * Return the value associated to the element with the given `key', or -1 if not present.
      * In case of duplicates, it returns the value of one of the qualifying elements.
      */
     int64_t find(int64_t key) const override;
 
+    /**
+     * Lookup the given sequence of keys, overlapping the accesses to the index and to the dense array for groups of keys
+     */
+    void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
     /**
      * Find all elements in the interval [min, max]
      */
@@ -129,7 +158,17 @@ public:
     SumResult sum(int64_t min, int64_t max) const override;
 
     /**
-     * Report the memory footprint, in bytes, of the dense arrays and the above index. The delta is not taken into account.
+     * Visit all elements in the range [min, max], in a single run
+     */
+    void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+
+    /**
+     * Set the layout of the separator keys in the static index
+     */
+    void set_index_layout(pma::StaticIndex::Layout layout);
+
+    /**
+     * Report the memory footprint, in bytes, of the dense arrays, the above index and the delta
      */
     size_t memory_footprint() const override;
 
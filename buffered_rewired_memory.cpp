@@ -19,8 +19,11 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <functional>
 #include <iostream>
 
+#include "configuration.hpp"
 #include "errorhandling.hpp"
 
 using namespace std;
@@ -49,8 +52,10 @@ using namespace std;
 BufferedRewiredMemory::BufferedRewiredMemory(size_t pages_per_extent, size_t num_extents) :
         m_instance(pages_per_extent, num_extents),
         m_buffer_start_address(static_cast<char*>(m_instance.get_start_address()) + m_instance.get_allocated_memory_size()),
-        m_allocated_buffers(0)
-        { }
+        m_allocated_buffers(0), m_reclaim_ratio(configuration::rewired_memory_reclaim_ratio()) {
+    reserve_buffer_space();
+    m_instance.set_numa_partition(num_extents); // the buffers are not bound to any partition
+}
 
 
 /*****************************************************************************
@@ -59,7 +64,9 @@ BufferedRewiredMemory::BufferedRewiredMemory(size_t pages_per_extent, size_t num
  *                                                                           *
  *****************************************************************************/
 void BufferedRewiredMemory::add_buffers(size_t num_extents){
+    void* start_address = m_instance.get_start_address(); (void) start_address;
     m_instance.extend(num_extents);
+    assert(m_instance.get_start_address() == start_address && "The memory has been relocated while buffers are in use, see #reserve_buffer_space");
 
     // register the new buffers
     char* buffer_space = static_cast<char*>(m_buffer_start_address) + get_extent_size() * get_total_buffers();
@@ -73,16 +80,48 @@ void BufferedRewiredMemory::add_buffers(size_t num_extents){
     COUT_DEBUG("acquired " << num_extents << " extents. Total buffer capacity: " << get_total_buffers() << " extents");
 }
 
-void* BufferedRewiredMemory::acquire_buffer(){
+void BufferedRewiredMemory::reserve_buffer_space(){
+    assert(get_used_buffers() == 0 && "There are buffers in use!");
+
+    // A rebalance acquires at most one buffer for each extent in the user space, while #add_buffers grows the
+    // buffer space by a factor of 1.5x (or at least 4 extents): the buffer space never exceeds 1.5x the user space + 4 extents.
+    const size_t num_user_extents = get_allocated_extents() - get_total_buffers();
+    const size_t max_memory = (num_user_extents * 3 + 4) * get_extent_size();
+    if(max_memory <= get_max_memory()) return;
+
+    void* old_start_address = m_instance.get_start_address();
+    m_instance.reserve(max_memory);
+
+    // rebase the free buffers, the region may have been relocated
+    char* new_start_address = static_cast<char*>(m_instance.get_start_address());
+    if(new_start_address != old_start_address){
+        const ptrdiff_t shift = new_start_address - static_cast<char*>(old_start_address);
+        m_buffer_start_address = static_cast<char*>(m_buffer_start_address) + shift;
+        for(auto& buffer : m_buffers){ buffer = static_cast<char*>(buffer) + shift; }
+    }
+}
+
+void* BufferedRewiredMemory::acquire_buffer(bool highest_first){
     if(m_buffers.empty()){ add_buffers(max<size_t>(4, m_allocated_buffers * 0.5)); }
     assert(!m_buffers.empty());
-    void* address = m_buffers.back();
-    m_buffers.pop_back();
+    void* address = nullptr;
+    if(highest_first){
+        address = m_buffers.front();
+        m_buffers.pop_front();
+    } else {
+        address = m_buffers.back();
+        m_buffers.pop_back();
+    }
     COUT_DEBUG("address: " << address);
     return address;
 }
 
-void BufferedRewiredMemory::swap_and_release(void* addr1, void* addr2){
+void BufferedRewiredMemory::release_buffer(void* buffer){
+    // keep the list of free buffers sorted in decreasing order
+    m_buffers.insert(upper_bound(begin(m_buffers), end(m_buffers), buffer, greater<void*>()), buffer);
+}
+
+pair<void*, void*> BufferedRewiredMemory::split_user_buffer(void* addr1, void* addr2) const {
     // check whether addr1 or addr2 is the pointer to the buffer
     char* ptr_bufferspace (nullptr);
     char* ptr_userspace (nullptr);
@@ -109,8 +148,22 @@ void BufferedRewiredMemory::swap_and_release(void* addr1, void* addr2){
     }
     COUT_DEBUG("userspace: " << (void*) ptr_userspace << ", bufferspace: " << (void*) ptr_bufferspace);
 
-    m_instance.swap(ptr_userspace, ptr_bufferspace);
-    m_buffers.push_back(ptr_bufferspace);
+    return make_pair(ptr_userspace, ptr_bufferspace);
+}
+
+void BufferedRewiredMemory::swap_and_release(void* addr1, void* addr2){
+    auto addresses = split_user_buffer(addr1, addr2);
+    m_instance.swap(addresses.first, addresses.second);
+    release_buffer(addresses.second);
+}
+
+void BufferedRewiredMemory::swap_and_release(const std::vector<std::pair<void*, void*>>& extents){
+    vector<pair<void*, void*>> addresses;
+    addresses.reserve(extents.size());
+    for(auto& e : extents){ addresses.push_back(split_user_buffer(e.first, e.second)); }
+
+    m_instance.swap(addresses);
+    for(auto& a : addresses){ release_buffer(a.second); }
 }
 
 /*****************************************************************************
@@ -146,6 +199,9 @@ void BufferedRewiredMemory::extend(size_t num_extents){
 
         m_buffer_start_address = static_cast<char*>(m_instance.get_start_address()) + m_instance.get_allocated_memory_size();
     }
+
+    reserve_buffer_space();
+    m_instance.set_numa_partition(get_allocated_extents() - get_total_buffers());
 }
 
 void BufferedRewiredMemory::shrink(size_t num_extents){
@@ -158,10 +214,42 @@ void BufferedRewiredMemory::shrink(size_t num_extents){
     const size_t extent_size = get_extent_size();
     for(size_t i = 0; i < num_extents; i++){
         buffer_address -= extent_size; // in bytes
-        m_buffers.push_front(buffer_address);
+        m_buffers.push_back(buffer_address);
     }
     m_allocated_buffers += num_extents;
     m_buffer_start_address = buffer_address;
+
+    reclaim();
+    m_instance.set_numa_partition(get_allocated_extents() - get_total_buffers());
+}
+
+void BufferedRewiredMemory::reclaim(){
+    assert(get_used_buffers() == 0 && "There are buffers in use!");
+    const size_t num_user_extents = get_allocated_extents() - get_total_buffers();
+    const size_t num_buffers_to_keep = max<size_t>(4, ceil(m_reclaim_ratio * num_user_extents));
+    if(get_total_buffers() <= num_buffers_to_keep) return;
+
+    const size_t num_extents_to_release = get_total_buffers() - num_buffers_to_keep;
+    COUT_DEBUG("buffers: " << get_total_buffers() << ", user extents: " << num_user_extents << ", release: " << num_extents_to_release << " extents");
+    m_instance.shrink(num_extents_to_release);
+    m_allocated_buffers -= num_extents_to_release;
+
+    // rebuild the deque
+    m_buffers.clear();
+    char* buffer_address = (char*) m_buffer_start_address;
+    for(size_t i = 0; i < m_allocated_buffers; i++){
+        m_buffers.push_front(buffer_address);
+        buffer_address += get_extent_size();
+    }
+}
+
+void BufferedRewiredMemory::set_reclaim_ratio(double ratio){
+    if(ratio < 0) RAISE("Invalid ratio: " << ratio);
+    m_reclaim_ratio = ratio;
+}
+
+void BufferedRewiredMemory::set_numa_policy(RewiredMemory::NumaPolicy policy){
+    m_instance.set_numa_policy(policy);
 }
 
 
@@ -26,13 +26,37 @@ class BufferedRewiredMemory {
     RewiredMemory m_instance;
     void* m_buffer_start_address;
     size_t m_allocated_buffers; // the total number of allocated buffers,
-    std::deque<void*> m_buffers; // list of free virtual addresses that can be acquired for buffering
+    std::deque<void*> m_buffers; // list of free virtual addresses that can be acquired for buffering, sorted in decreasing order
+    double m_reclaim_ratio; // after a shrink, the max number of free buffers retained, as a fraction of the extents in use
 
     /**
      * Extend the physical memory to make available additional buffers
      */
     void add_buffers(size_t num_buffers);
 
+    /**
+     * Ensure the reservation of virtual memory can accommodate all buffers that can be acquired for the
+     * current user space, so that #add_buffers never needs to relocate the memory while buffers are in use.
+     * Precondition: no buffers must be in use.
+     */
+    void reserve_buffer_space();
+
+    /**
+     * Return to the OS the physical memory of the free buffers in excess of the reclaim ratio.
+     * Precondition: no buffers must be in use.
+     */
+    void reclaim();
+
+    /**
+     * Given a pair of addresses, retrieve first the address in the user space and second the address of the buffer
+     */
+    std::pair<void*, void*> split_user_buffer(void* addr1, void* addr2) const;
+
+    /**
+     * Return the buffer to the list of free buffers
+     */
+    void release_buffer(void* buffer);
+
 public:
     /**
      * It allocates a chunk of rewired memory
@@ -41,8 +65,11 @@ public:
 
     /**
      * Get a buffer from the free buffer space. A single buffer has the size of an extent.
+     * Free buffers are handed out by increasing address, or by decreasing address if `highest_first' is set.
+     * Acquiring the buffers in the same direction of the extents they will be rewired to, allows
+     * #swap_and_release to coalesce their remapping.
      */
-    void* acquire_buffer();
+    void* acquire_buffer(bool highest_first = false);
 
     /**
      * Rewires the memory of addr1 and addr2. Moreover, it assumes that either addr1
@@ -52,16 +79,35 @@ public:
     void swap_and_release(void* addr1, void* addr2);
 
     /**
-     * Extend the amount of memory available. No buffers must be in use
+     * Rewire all the given pairs of addresses in a single batch. As above, in each pair, exactly one
+     * of the two addresses must refer to the buffer space. All buffers are released at the end.
+     */
+    void swap_and_release(const std::vector<std::pair<void*, void*>>& extents);
+
+    /**
+     * Extend the amount of memory available. No buffers must be in use. The start address may change.
      */
     void extend(size_t num_extents);
 
     /**
-     * Shrink the number of extents in use. The actual physical memory is not released but recycled as buffer space.
+     * Shrink the number of extents in use. The physical memory is recycled as buffer space, up to the reclaim ratio
+     * of the extents still in use, and the rest is returned to the OS. The start address does not change.
      * Precondition: no buffers must be in use.
      */
     void shrink(size_t num_extents);
 
+    /**
+     * Set the max number of free buffers retained by #shrink, as a fraction of the extents in use. By default,
+     * it is given by the configuration parameter `rewired_reclaim'.
+     */
+    void set_reclaim_ratio(double ratio);
+
+    /**
+     * Set the placement of the physical memory among the NUMA nodes. With the partitioned placement, only the
+     * extents in use are partitioned, the buffers are excluded.
+     */
+    void set_numa_policy(RewiredMemory::NumaPolicy policy);
+
     /**
      * Retrieve the pointer to the allocated virtual memory space
      */
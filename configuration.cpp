@@ -73,6 +73,15 @@ Configuration::Configuration() {
             .descr("Capacity of the the internal memory pools");
     PARAMETER(bool, "hugetlb")
         .descr("Use huge pages (2Mb) with the algorithms that support memory rewiring");
+    PARAMETER(bool, "thp")
+        .descr("Request transparent huge pages (madvise) for the memory mapped regions of the algorithms that support memory rewiring. It requires the kernel setting transparent_hugepage/shmem_enabled to be `advise' or `always'");
+    PARAMETER(bool, "prefault")
+        .descr("With the algorithms that support memory rewiring, allocate in a background thread the physical memory for the next resize, and populate the page tables of the new extents when they are acquired");
+    PARAMETER(double, "rewired_reclaim").hint("ratio >= 0").set_default(0.5)
+        .descr("With the algorithms that support memory rewiring, when the data structure shrinks, return to the OS the physical memory of the free buffers in excess of this fraction of the extents in use");
+    PARAMETER(string, "rewired_numa").hint("none|interleaved|local|partitioned").set_default("none")
+        .descr("With the algorithms that support memory rewiring, the placement of the physical memory among the NUMA nodes: the default policy of the process, interleaved among all nodes, on the node of the allocating thread, or partitioned among the nodes by contiguous ranges of extents")
+        .validate_fn([](const string& value){ return value == "none" || value == "interleaved" || value == "local" || value == "partitioned"; });
 }
 
 Configuration::~Configuration() {
@@ -238,4 +247,36 @@ bool use_huge_pages(){
     return false;
 }
 
+bool use_transparent_huge_pages(){
+    try {
+        return ARGREF(bool, "thp").get();
+    } catch( configuration::ConsoleArgumentError& e ){
+        return false; // configuration not initialised
+    }
+}
+
+bool use_prefaulting(){
+    try {
+        return ARGREF(bool, "prefault").get();
+    } catch( configuration::ConsoleArgumentError& e ){
+        return false; // configuration not initialised
+    }
+}
+
+double rewired_memory_reclaim_ratio(){
+    try {
+        return ARGREF(double, "rewired_reclaim").get();
+    } catch( configuration::ConsoleArgumentError& e ){
+        return 0.5; // configuration not initialised, use the default
+    }
+}
+
+string rewired_memory_numa_policy(){
+    try {
+        return ARGREF(string, "rewired_numa").get();
+    } catch( configuration::ConsoleArgumentError& e ){
+        return "none"; // configuration not initialised, use the default
+    }
+}
+
 } // namespace configuration
@@ -98,6 +98,26 @@ public:
  */
 bool use_huge_pages();
 
+/**
+ * Use transparent huge pages (madvise) for the memory mapped regions?
+ */
+bool use_transparent_huge_pages();
+
+/**
+ * Memory rewiring, allocate the physical memory for the next resize in a background thread?
+ */
+bool use_prefaulting();
+
+/**
+ * Memory rewiring, the max number of free buffers retained after a shrink, as a fraction of the extents in use
+ */
+double rewired_memory_reclaim_ratio();
+
+/**
+ * Memory rewiring, the placement of the physical memory among the NUMA nodes: none, interleaved, local or partitioned
+ */
+std::string rewired_memory_numa_policy();
+
 } // namespace configuration
 
 
@@ -502,7 +502,7 @@ void APMA_Baseline::apma_compute_rec(vector<uint16_t>& partitions, int64_t parti
             denom_right++;
             size_t index_cur = index_start + i;
             if(index_cur == weights_next_ptr){
-                size_t count = weights[weights_pos].m_count;
+                size_t count = weights[weights_next_index].m_count;
                 sum_num_left += count;
                 sum_num_right -= count;
                 weights_next_index++;
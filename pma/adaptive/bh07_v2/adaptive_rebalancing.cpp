@@ -190,7 +190,7 @@ void AdaptiveRebalancing::compute_rec(APMA_BH07_v2* instance, VectorOfPartitions
             denom_right++;
             size_t index_cur = index_start + i;
             if(index_cur == weights_next_ptr){
-                size_t count = weights[weights_pos].m_count;
+                size_t count = weights[weights_next_index].m_count;
                 sum_num_left += count;
                 sum_num_right -= count;
                 weights_next_index++;
@@ -29,6 +29,8 @@
 #include "database.hpp"
 #include "iterator.hpp"
 #include "miscellaneous.hpp"
+#include "pma/generic/find_batch.hpp"
+#include "pma/generic/load_sorted.hpp"
 #include "rewired_memory.hpp"
 #include "spread_with_rewiring.hpp"
 #include "sum.hpp"
@@ -236,6 +238,74 @@ bool APMA_BH07_v2::storage_insert_unsafe(size_t segment_id, int64_t key, int64_t
     return minimum;
 }
 
+/*****************************************************************************
+ *                                                                           *
+ *   Bulk loading                                                            *
+ *                                                                           *
+ *****************************************************************************/
+void APMA_BH07_v2::load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz){
+    COUT_DEBUG("Load " << array_sz << " elements");
+    if(array_sz == 0) return; // nothing to load
+    std::pair<int64_t, int64_t>* __restrict A = array; // disable aliasing
+
+    size_t i = 0;
+    if(empty()){ insert_empty(A[0].first, A[0].second); i = 1; }
+
+    auto merge_run = [this](size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+        bool minimum_updated = m_storage.insert_sorted(segment_id, run, run_length);
+        if(minimum_updated) m_index.set_separator_key(segment_id, run[0].first);
+        for(size_t j = 0; j < run_length; j++){ m_predictor.update(segment_id); }
+    };
+    auto rebalance_run = [this](size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+        return rebalance_sorted(segment_id, run, run_length);
+    };
+    clustered_load_sorted(m_index, m_storage, A + i, array_sz - i, merge_run, rebalance_run);
+
+#if defined(DEBUG)
+    COUT_DEBUG("Load done");
+    dump();
+#endif
+}
+
+size_t APMA_BH07_v2::rebalance_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+    size_t window_start {0}, window_length {0}, cardinality_after {0};
+    auto fn_thresholds = [this](int height){ return thresholds(height); };
+    bool is_spread = clustered_find_window(m_storage.m_segment_sizes, m_storage.m_number_segments, m_storage.m_segment_capacity, m_storage.m_height,
+            segment_id, run_length, fn_thresholds, &window_start, &window_length, &cardinality_after);
+    size_t root_room = is_spread ? 0 : clustered_root_room(m_storage.m_number_segments, m_storage.m_segment_capacity, m_storage.m_cardinality, m_storage.m_height, fn_thresholds);
+
+    if(!is_spread && root_room > 0){ // fill the whole array up to the threshold of the root, the rest of the run is inserted after the resize
+        run_length = root_room;
+        window_start = 0;
+        window_length = m_storage.m_number_segments;
+        cardinality_after = m_storage.m_cardinality + run_length;
+    } else if(!is_spread){ // double the capacity, the run is inserted by the next attempt
+        m_storage.m_height++; // implicitly regenerate the thresholds at the next call of thresholds()
+
+        // the array may be far below the lower thresholds of the APMA once the capacity has been doubled, spread the elements evenly
+        VectorOfPartitions partitions = vector_of_partitions(m_memory_pool);
+        partitions.emplace_back(m_storage.m_cardinality, 2 * m_storage.m_number_segments);
+        resize(partitions);
+        return 0;
+    }
+
+    COUT_DEBUG("window: [" << window_start << ", " << window_start + window_length << "), run: " << run_length << ", cardinality: " << cardinality_after);
+
+    // workspace
+    auto fn_deallocate = [this](void* ptr){ m_memory_pool.deallocate(ptr); };
+    unique_ptr<int64_t, decltype(fn_deallocate)> input_keys_ptr{ m_memory_pool.allocate<int64_t>(cardinality_after), fn_deallocate };
+    int64_t* __restrict input_keys = input_keys_ptr.get();
+    unique_ptr<int64_t, decltype(fn_deallocate)> input_values_ptr{ m_memory_pool.allocate<int64_t>(cardinality_after), fn_deallocate };
+    int64_t* __restrict input_values = input_values_ptr.get();
+
+    // gather the window and the run together, then spread them once
+    clustered_gather(m_storage.m_keys, m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity, window_start, window_length, run, run_length, input_keys, input_values);
+    spread_save(window_start, window_length, input_keys, input_values, cardinality_after);
+    m_storage.m_cardinality += run_length;
+
+    return run_length;
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Rebalancing                                                             *
@@ -254,14 +324,14 @@ bool APMA_BH07_v2::rebalance(size_t segment_id, int64_t* key, int64_t* value){
     size_t height = 1;
     COUT_DEBUG("height: " << height << ", density: " << density << ", rho: " << rho << ", theta: " << theta << ", num_elements: " << num_elements_after);
 
-    int window_length = 1;
-    int window_id = segment_id;
-    int window_start = segment_id, window_end = segment_id;
+    int64_t window_length = 1;
+    int64_t window_id = segment_id;
+    int64_t window_start = segment_id, window_end = segment_id;
 
     if(m_storage.m_height > 1){
         // find the bounds of this window
-        int index_left = segment_id -1;
-        int index_right = segment_id +1;
+        int64_t index_left = segment_id -1;
+        int64_t index_right = segment_id +1;
 
         do {
             height++;
@@ -614,10 +684,10 @@ void APMA_BH07_v2::resize_general(const VectorOfPartitions& partitions) {
     // start copying the elements
     bool output_segment_odd = false; // consider '0' as even
     struct {
-        int index = 0; // current position in the vector partitions
-        int segment = 0; // current segment considered
-        int card_per_segment = 0; // cardinality per segment
-        int odd_segments = 0; // number of segments with an additional element than `card_per_segment'
+        int64_t index = 0; // current position in the vector partitions
+        int64_t segment = 0; // current segment considered
+        int64_t card_per_segment = 0; // cardinality per segment
+        int64_t odd_segments = 0; // number of segments with an additional element than `card_per_segment'
     } partition_state;
     partition_state.card_per_segment = partitions[0].m_cardinality / partitions[0].m_segments;
     partition_state.odd_segments = partitions[0].m_cardinality % partitions[0].m_segments;
@@ -708,6 +778,10 @@ int64_t APMA_BH07_v2::find(int64_t key) const {
     if(empty()) return -1;
 
     auto segment_id = m_index.find(key);
+    return find_in_segment(segment_id, key);
+}
+
+int64_t APMA_BH07_v2::find_in_segment(size_t segment_id, int64_t key) const noexcept {
     int64_t* __restrict keys = m_storage.m_keys + segment_id * m_storage.m_segment_capacity;
     size_t sz = m_storage.m_segment_sizes[segment_id];
 
@@ -730,6 +804,13 @@ int64_t APMA_BH07_v2::find(int64_t key) const {
     return -1;
 }
 
+void APMA_BH07_v2::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    if(empty()){ std::fill(out_values, out_values + num_keys, -1); return; }
+
+    clustered_find_batch(m_index, m_storage.m_keys, m_storage.m_segment_sizes, m_storage.m_segment_capacity, keys, out_values, num_keys,
+            [this](uint64_t segment_id, int64_t key){ return find_in_segment(segment_id, key); });
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Iterator                                                                *
@@ -759,6 +840,10 @@ unique_ptr<::pma::Iterator> APMA_BH07_v2::iterator() const {
     return do_sum(m_storage, m_index.find_first(min), m_index.find_last(max), min, max );
 }
 
+void APMA_BH07_v2::scan(int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor) const {
+    do_scan(m_storage, m_index.find_first(min), m_index.find_last(max), min, max, visitor);
+}
+
 
 /*****************************************************************************
  *                                                                           *
@@ -899,6 +984,10 @@ void APMA_BH07_v2::set_record_segment_statistics(bool value) {
     m_segment_statistics = value;
 }
 
+void APMA_BH07_v2::set_index_layout(::pma::StaticIndex::Layout layout) {
+    m_index.set_layout(layout);
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Dump                                                                    *
@@ -18,6 +18,7 @@
 #ifndef ADAPTIVE_BH07_V2_PACKED_MEMORY_ARRAY_HPP_
 #define ADAPTIVE_BH07_V2_PACKED_MEMORY_ARRAY_HPP_
 
+#include "pma/bulk_loading.hpp"
 #include "pma/density_bounds.hpp"
 #include "pma/interface.hpp"
 #include "pma/iterator.hpp"
@@ -35,7 +36,7 @@ namespace pma { namespace adaptive { namespace bh07_v2 {
 class AdaptiveRebalancing; // forward decl.
 class SpreadWithRewiring; // forward decl.
 
-class APMA_BH07_v2 : public ::pma::InterfaceRQ {
+class APMA_BH07_v2 : public ::pma::InterfaceRQ, public ::pma::SortedBulkLoading {
     friend class AdaptiveRebalancing;
     friend class SpreadWithRewiring;
 private:
@@ -71,6 +72,12 @@ private:
      */
     bool rebalance(size_t segment_id, int64_t* insert_new_key, int64_t* insert_new_value);
 
+    /**
+     * Spread the window of the segment together with a sorted run of new elements. Return the number of elements of the run
+     * inserted, 0 if the PMA has only been resized
+     */
+    size_t rebalance_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length);
+
     /**
      * Resize the index, double the capacity of the PMA, rebuild the index
      */
@@ -108,6 +115,11 @@ private:
      */
     std::unique_ptr<::pma::Iterator> empty_iterator() const;
 
+    /**
+     * Retrieve the value associated to the given key in the segment, or -1 if not found
+     */
+    int64_t find_in_segment(size_t segment_id, int64_t key) const noexcept;
+
     /**
      * Rebuild the index from scratch, with a capacity for `num_segments'
      */
@@ -122,6 +134,12 @@ private:
     void dump_storage(std::ostream& out, bool* integrity_check) const;
     void dump_predictor(std::ostream& out, bool* integrity_check) const;
 
+protected:
+    /**
+     * Bulk loading. Merge the runs of elements falling in the same segment in a single pass. A run overflowing its segment is spread together with its window in a single rebalance.
+     */
+    virtual void load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
+
 public:
     APMA_BH07_v2(size_t btree_block_size, size_t pma_segment_size, size_t pages_per_extent, double predictor_scale = 1.0, const DensityBounds& density_bounds = DensityBounds());
 
@@ -138,6 +156,11 @@ public:
      */
     virtual int64_t find(int64_t key) const override;
 
+    /**
+     * Lookup the given sequence of keys, overlapping the accesses to the index and to the segments for groups of keys
+     */
+    virtual void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
     virtual std::unique_ptr<::pma::Iterator> find(int64_t min, int64_t max) const override;
 
     // Return an iterator over all elements of the PMA
@@ -146,6 +169,9 @@ public:
     // Sum all elements in the interval [min, max]
     virtual ::pma::Interface::SumResult sum(int64_t min, int64_t max) const override;
 
+    // Visit all elements in the interval [min, max], a pair of segments at the time
+    virtual void scan(int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor) const override;
+
     // The number of elements stored
     virtual size_t size() const noexcept override;
 
@@ -155,6 +181,9 @@ public:
     // Whether to save segment statistics, at the end, in the table `btree_leaf_statistics' ?
     void set_record_segment_statistics(bool value);
 
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(::pma::StaticIndex::Layout layout);
+
     // Retrieve the associated memory pool
     CachedMemoryPool& memory_pool();
 
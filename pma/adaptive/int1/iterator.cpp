@@ -146,4 +146,17 @@ std::pair<int64_t, int64_t> Iterator::next() {
     return result;
 }
 
+size_t Iterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    if(m_offset >= m_stop) return 0;
+
+    *out_keys = m_pma.m_keys + m_offset;
+    *out_values = m_pma.m_values + m_offset;
+    size_t length = m_stop - m_offset;
+
+    m_offset = m_stop;
+    next_sequence();
+
+    return length;
+}
+
 }}} // pma::adaptive::int1
@@ -27,8 +27,8 @@
 namespace pma { namespace adaptive { namespace int1 {
 
 struct Partition {
-    uint32_t m_cardinality; // total amount of elements
-    uint32_t m_segments; // number of segments
+    uint64_t m_cardinality; // total amount of elements
+    uint64_t m_segments; // number of segments
 
     Partition();
 
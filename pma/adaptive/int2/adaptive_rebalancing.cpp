@@ -78,7 +78,7 @@ void AdaptiveRebalancing::emit(size_t cardinality, size_t number_of_segments){
     m_partitions.push_back({cardinality, number_of_segments});
 }
 
-void AdaptiveRebalancing::move_detector_info(int segment_id, int destination){
+void AdaptiveRebalancing::move_detector_info(int64_t segment_id, int64_t destination){
     if(segment_id >= 0 && m_ptr_move_detector_info){
         m_ptr_move_detector_info->move_section(segment_id, destination);
     }
@@ -126,24 +126,24 @@ AdaptiveRebalancing::find_split_point(Interval* weights, size_t weights_sz, int
 }
 
 
-int AdaptiveRebalancing::rebalancing_paro(Interval* weights, size_t weights_sz, int index_split, size_t cardinality){
+int64_t AdaptiveRebalancing::rebalancing_paro(Interval* weights, size_t weights_sz, int index_split, size_t cardinality){
     COUT_DEBUG("weights_sz: " << weights_sz << ", index_split: " << index_split);
 
     if(index_split < 0){
         return (weights[0].m_start) /2;
     } else  {
-        int base_left = weights[index_split].m_start + weights[index_split].m_length;
+        int64_t base_left = weights[index_split].m_start + weights[index_split].m_length;
         if(index_split +1 == weights_sz){
             return base_left + cardinality /2;
         } else {
-            int base_right = weights[index_split +1].m_start;
+            int64_t base_right = weights[index_split +1].m_start;
             assert(base_left <= base_right);
             return base_left + (base_right - base_left) /2;
         }
     }
 }
 
-int AdaptiveRebalancing::rebalancing_sparu(Interval* weights, size_t weights_sz, int index_split, size_t cardinality){
+int64_t AdaptiveRebalancing::rebalancing_sparu(Interval* weights, size_t weights_sz, int index_split, size_t cardinality){
     assert(index_split >= 0 && index_split < weights_sz && "Index out of bounds");
 //    int segment = candidates[index_split].m_segment_id;
     int weight = weights[index_split].m_weight;
@@ -172,7 +172,7 @@ Optimum AdaptiveRebalancing::find_optimum(Interval* W, size_t W_sz, int balance,
 
     COUT_DEBUG("split point: " << split_point.m_left_index << ", balance: " << split_point.m_left_balance);
 
-    int card_left = -1;
+    int64_t card_left = -1;
     if(W_sz % 2 == 0) { // rebalancing paro
         card_left = rebalancing_paro(W, W_sz, split_point.m_left_index, cardinality);
         COUT_DEBUG("rebalancing_paro left: " << card_left << "/" << cardinality);
@@ -191,7 +191,7 @@ Optimum AdaptiveRebalancing::find_optimum(Interval* W, size_t W_sz, int balance,
 }
 
 Optimum AdaptiveRebalancing::ensure_lower_threshold(size_t left_cardinality_min, size_t left_cardinality_max, Interval* weights, size_t weights_length, int balance, Optimum current){
-    int objective = left_cardinality_min;
+    int64_t objective = left_cardinality_min;
     int idx_split = current.m_weights_index;
     int weight_balance = current.m_weights_balance;
     COUT_DEBUG("init, objective: " << objective << ", idx_split: " << idx_split << ", weight_balance: " << weight_balance);
@@ -309,7 +309,7 @@ Optimum AdaptiveRebalancing::ensure_lower_threshold(size_t left_cardinality_min,
 }
 
 Optimum AdaptiveRebalancing::ensure_upper_threshold(size_t left_cardinality_min, size_t left_cardinality_max, Interval* weights, size_t weights_length, int balance, Optimum current){
-    int objective = left_cardinality_max;
+    int64_t objective = left_cardinality_max;
 
     // find the first index in `weights' such that weights[index].m_start <= objective
     int idx_split = current.m_weights_index;
@@ -340,7 +340,7 @@ Optimum AdaptiveRebalancing::ensure_upper_threshold(size_t left_cardinality_min,
                     objective = w_start;
                 } else { // narrowing section, include as much as possible
                     if(idx_split >= 0){
-                        objective = max<int>(weights[idx_split].m_start + weights[idx_split].m_length, left_cardinality_min);
+                        objective = max<int64_t>(weights[idx_split].m_start + weights[idx_split].m_length, left_cardinality_min);
                     } else {
                         objective = left_cardinality_min;
                     }
@@ -363,7 +363,7 @@ Optimum AdaptiveRebalancing::ensure_upper_threshold(size_t left_cardinality_min,
 
         // if the balance is negative (deletes), expand the right section up as much as possible
         else if (balance_delta < 0){
-            objective = max<int>(left_cardinality_min, w_end);
+            objective = max<int64_t>(left_cardinality_min, w_end);
         }
     } else {
         // but if we are including more narrowing sectors than expanding ones, extend the section up to the minimum cardinality
@@ -469,7 +469,7 @@ void AdaptiveRebalancing::recursion(size_t part_start, size_t part_length, int h
         // step 4: recursion on the right interval
         Interval* W_right = W + w_left_sz;
         auto W_right_sz = W_sz - w_left_sz;
-        int W_offset = opt_left.m_cardinality; // adjust the intervals
+        int64_t W_offset = opt_left.m_cardinality; // adjust the intervals
         for(size_t i = 0; i < W_right_sz; i++){ W_right[i].m_start -= W_offset; }
         recursion(part_start + part_length /2, part_length /2, height -1, W_right, W_right_sz, balance - opt_left.m_weights_balance, cardinality - opt_left.m_cardinality);
 
@@ -500,8 +500,8 @@ void AdaptiveRebalancing::dump() const{
 
 
 Optimum::Optimum() : Optimum(0) {}
-Optimum::Optimum(int cardinality) : Optimum(cardinality, -1, 0) { }
-Optimum::Optimum(int cardinality, int weights_index, int weights_balance) : m_cardinality(cardinality),
+Optimum::Optimum(int64_t cardinality) : Optimum(cardinality, -1, 0) { }
+Optimum::Optimum(int64_t cardinality, int weights_index, int weights_balance) : m_cardinality(cardinality),
         m_weights_index(weights_index), m_weights_balance(weights_balance) { }
 std::ostream& operator<<(std::ostream& out, Optimum opt) {
     out << "{OPT cardinality: " << opt.m_cardinality << ", weights index: " << opt.m_weights_index << ", balance: " << opt.m_weights_balance << "}";
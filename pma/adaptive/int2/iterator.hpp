@@ -40,6 +40,7 @@ public:
 
     virtual bool hasNext() const;
     virtual std::pair<int64_t, int64_t> next();
+    virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values); // the next run of contiguous elements, without copies
 };
 
 
@@ -56,7 +56,7 @@ void MoveDetectorInfo::resize(size_t capacity){
     m_registered_segments_capacity = capacity;
 }
 
-void MoveDetectorInfo::move_section(uint32_t from, uint32_t to){
+void MoveDetectorInfo::move_section(uint64_t from, uint64_t to){
     if(m_registered_segments_sz >= m_registered_segments_capacity){ throw runtime_error("[MoveDetectorInfo::register_section] No space left"); }
     if(from != to) // otherwise it's not moving anything
         m_registered_segments[m_registered_segments_sz++] = {from, to};
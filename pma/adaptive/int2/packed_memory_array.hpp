@@ -24,6 +24,7 @@
 #include <memory>
 #include <random>
 
+#include "pma/bulk_loading.hpp"
 #include "pma/density_bounds.hpp"
 #include "pma/interface.hpp"
 #include "pma/iterator.hpp"
@@ -42,7 +43,7 @@ namespace pma { namespace adaptive { namespace int2 {
 class SpreadWithRewiring; // forward decl.
 class Weights;
 
-class PackedMemoryArray : public InterfaceRQ {
+class PackedMemoryArray : public InterfaceRQ, public SortedBulkLoading {
     friend class SpreadWithRewiring;
     friend class Weights;
 private:
@@ -83,6 +84,12 @@ private:
      */
     bool rebalance(size_t segment_id, int64_t* insert_new_key, int64_t* insert_new_value);
 
+    /**
+     * Spread the window of the segment together with a sorted run of new elements
+     * @return the number of elements of the run inserted, 0 if the PMA has only been resized
+     */
+    size_t rebalance_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length);
+
     /**
      * Resize the index, double the capacity of the PMA, rebuild the index
      * We have two different methods for resizing. In case we are increasing [doubling] the capacity, we extend
@@ -128,6 +135,9 @@ private:
      */
     std::unique_ptr<::pma::Iterator> empty_iterator() const;
 
+    // Retrieve the value associated to the given key in the segment, or -1 if not found
+    int64_t find_in_segment(size_t segment_id, int64_t key) const noexcept;
+
     /**
      * Check whether to record the update in the detector
      */
@@ -155,6 +165,11 @@ protected:
     // Find the position of the key in the given segment, or return -1 if not found.
     int find_key(size_t segment_id, int64_t key) const noexcept;
 
+    /**
+     * Bulk loading. Merge the runs of elements falling in the same segment in a single pass. A run overflowing its segment is spread together with its window in a single rebalance.
+     */
+    virtual void load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
+
 public:
     PackedMemoryArray(size_t pages_per_extent);
 
@@ -180,11 +195,19 @@ public:
      */
     virtual int64_t find(int64_t key) const override;
 
+    /**
+     * Lookup the given sequence of keys, overlapping the accesses to the index and to the segments for groups of keys
+     */
+    virtual void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
     virtual std::unique_ptr<::pma::Iterator> find(int64_t min, int64_t max) const override;
 
     // Sum all elements in the interval [min, max]
     virtual ::pma::Interface::SumResult sum(int64_t min, int64_t max) const override;
 
+    // Visit all elements in the interval [min, max], a pair of segments at the time
+    virtual void scan(int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor) const override;
+
     // Return an iterator over all elements of the PMA
     virtual std::unique_ptr<::pma::Iterator> iterator() const override;
 
@@ -203,6 +226,9 @@ public:
     // Whether to save segment statistics, at the end, in the table `btree_leaf_statistics' ?
     void set_record_segment_statistics(bool value);
 
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(::pma::StaticIndex::Layout layout);
+
     // Accessor to the underlying memory pool
     CachedMemoryPool& memory_pool();
 
@@ -21,6 +21,8 @@
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "buffered_rewired_memory.hpp"
 #include "packed_memory_array.hpp"
@@ -205,37 +207,43 @@ void SpreadWithRewiring::move_current_partition_by(int64_t N){
  *                                                                           *
  *****************************************************************************/
 void SpreadWithRewiring::acquire_free_space(int64_t** space_keys, int64_t** space_values){
-    *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer();
-    *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
-}
-
-void SpreadWithRewiring::rewire_keys(int64_t* addr1, int64_t* addr2){
-    m_instance.m_storage.m_memory_keys->swap_and_release(addr1, addr2);
-}
+    // acquire the buffers in the same direction of the spread
+    *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer(/* highest first ? */ m_move_backwards);
+    *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer(/* highest first ? */ m_move_backwards);
+}
+
+void SpreadWithRewiring::rewire_ready_extents(){
+    if(m_extents_ready == 0) return; // nop
+    COUT_DEBUG("extents: " << m_extents_ready);
+
+    vector<pair<void*, void*>> keys, values;
+    keys.reserve(m_extents_ready);
+    values.reserve(m_extents_ready);
+    for(size_t i = 0; i < m_extents_ready; i++){
+        auto& metadata = m_extents_to_rewire[i];
+        keys.emplace_back(get_start_address(m_instance.m_storage.m_keys, metadata.m_extent_id), metadata.m_buffer_keys);
+        values.emplace_back(get_start_address(m_instance.m_storage.m_values, metadata.m_extent_id), metadata.m_buffer_values);
+    }
+    m_extents_to_rewire.erase(m_extents_to_rewire.begin(), m_extents_to_rewire.begin() + m_extents_ready);
+    m_extents_ready = 0;
 
-void SpreadWithRewiring::rewire_values(int64_t* addr1, int64_t* addr2){
-    m_instance.m_storage.m_memory_values->swap_and_release(addr1, addr2);
+    m_instance.m_storage.m_memory_keys->swap_and_release(keys);
+    m_instance.m_storage.m_memory_values->swap_and_release(values);
 }
 
 void SpreadWithRewiring::reclaim_past_extents(){
     int64_t current_extent_id = get_current_extent();
     COUT_DEBUG("current_extent_id: " << current_extent_id);
     const bool move_backwards = m_move_backwards;
-    while(!m_extents_to_rewire.empty() && (
-            (!move_backwards && (m_extents_to_rewire.front().m_extent_id < current_extent_id)) ||
-            (move_backwards && (m_extents_to_rewire.front().m_extent_id > current_extent_id))
+    while(m_extents_ready < m_extents_to_rewire.size() && (
+            (!move_backwards && (m_extents_to_rewire[m_extents_ready].m_extent_id < current_extent_id)) ||
+            (move_backwards && (m_extents_to_rewire[m_extents_ready].m_extent_id > current_extent_id))
             )){
-        auto& metadata = m_extents_to_rewire.front();
-        auto extent_id = metadata.m_extent_id;
-        auto keys_dst = get_start_address(m_instance.m_storage.m_keys, extent_id);
-        auto keys_src = metadata.m_buffer_keys;
-        auto values_dst = get_start_address(m_instance.m_storage.m_values, extent_id);
-        auto values_src = metadata.m_buffer_values;
-        m_extents_to_rewire.pop_front();
-        COUT_DEBUG("reclaim buffers for keys: " << keys_src << ", values: " << values_src);
-
-        rewire_keys(keys_dst, keys_src);
-        rewire_values(values_dst, values_src);
+        m_extents_ready++;
+    }
+
+    if(m_extents_ready >= m_rewiring_batch_sz){
+        rewire_ready_extents();
     }
 }
 
@@ -293,6 +301,7 @@ void SpreadWithRewiring::spread_window(){
             spread_extent<true>(i);
         }
     }
+    rewire_ready_extents(); // the remaining extents
     assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
     assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
 }
@@ -42,6 +42,8 @@ protected:
     int64_t m_position; // current position in the window being rebalanced
     struct Extent2Rewire{ int64_t m_extent_id; int64_t* m_buffer_keys; int64_t* m_buffer_values; };
     std::deque<Extent2Rewire> m_extents_to_rewire; // a list of extents to be rewired
+    size_t m_extents_ready = 0; // the first extents in m_extents_to_rewire whose content has already been spread, ready to be rewired
+    constexpr static size_t m_rewiring_batch_sz = 64; // the number of ready extents to accumulate before rewiring them in a single batch
     size_t m_partition_id = 0; // current partition
     size_t m_partition_offset = 0; // current offset in the partition
 
@@ -129,13 +131,13 @@ protected:
     void acquire_free_space(int64_t** space_keys, int64_t** space_values);
 
     /**
-     * Rewire these two virtual memory addresses and reclaim the space for the address associated to a buffer
+     * Rewire, in a single batch, the extents ready with their buffers and reclaim the buffers
      */
-    void rewire_keys(int64_t* addr1, int64_t* addr2);
-    void rewire_values(int64_t* addr1, int64_t* addr2);
+    void rewire_ready_extents();
 
     /**
-     * Rewire the used buffers with their associated extents in the PMA
+     * Mark the used buffers whose extents in the PMA have been consumed as ready to be rewired. The actual
+     * rewiring is deferred until enough extents are ready, to coalesce the remapping of consecutive extents.
      */
     void reclaim_past_extents();
 
@@ -18,9 +18,11 @@
 #include "storage.hpp"
 
 #include <algorithm> // max
+#include <cassert>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <numeric>
 #include <stdexcept>
 #include "buffered_rewired_memory.hpp"
@@ -191,6 +193,72 @@ void Storage::dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_seg
     }
 }
 
+bool Storage::insert_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* elements, size_t num_elements, int64_t* out_predecessor, int64_t* out_successor) noexcept {
+    assert(num_elements > 0 && "No elements to insert");
+    assert(m_segment_sizes[segment_id] + num_elements <= m_segment_capacity && "The segment does not have enough room");
+
+    int64_t* __restrict keys = m_keys + segment_id * m_segment_capacity;
+    int64_t* __restrict values = m_values + segment_id * m_segment_capacity;
+    const std::pair<int64_t, int64_t>* __restrict E = elements;
+    const int64_t first = E[0].first;
+    const size_t sz = m_segment_sizes[segment_id];
+    bool minimum = false; // the first inserted key is the new minimum ?
+    int64_t predecessor = std::numeric_limits<int64_t>::min(); // for the detector
+    int64_t successor = std::numeric_limits<int64_t>::max(); // for the detector
+
+    if(segment_id % 2 == 0){ // for even segment ids (0, 2, ...), the elements are at the end of the segment
+        // merge forwards, the new elements are placed before the existing duplicates
+        const size_t stop = m_segment_capacity;
+        size_t input = m_segment_capacity - sz;
+        size_t output = input - num_elements;
+        minimum = (sz == 0) || (first <= keys[input]);
+
+        for(size_t j = 0; j < num_elements; output++){
+            if(input < stop && keys[input] < E[j].first){
+                keys[output] = keys[input];
+                values[output] = values[input];
+                input++;
+            } else {
+                if(j == 0 && output > m_segment_capacity - sz - num_elements){ predecessor = keys[output -1]; }
+                keys[output] = E[j].first;
+                values[output] = E[j].second;
+                j++;
+            }
+        }
+        if(input < stop){ successor = keys[input]; }
+        assert(output == input && "The remaining existing elements are already in place");
+    } else { // for odd segment ids (1, 3, ...), the elements are at the start of the segment
+        // merge backwards, the new elements are placed after the existing duplicates
+        int64_t input = static_cast<int64_t>(sz) -1;
+        int64_t output = sz + num_elements -1;
+        minimum = (sz == 0) || (first < keys[0]);
+
+        for(int64_t j = num_elements -1; j >= 0; output--){
+            if(input >= 0 && keys[input] > E[j].first){
+                keys[output] = keys[input];
+                values[output] = values[input];
+                input--;
+            } else {
+                if(j == static_cast<int64_t>(num_elements) -1 && output < static_cast<int64_t>(sz + num_elements) -1){ successor = keys[output +1]; }
+                keys[output] = E[j].first;
+                values[output] = E[j].second;
+                j--;
+            }
+        }
+        if(input >= 0){ predecessor = keys[input]; }
+        assert(output == input && "The remaining existing elements are already in place");
+    }
+
+    if(out_predecessor) { *out_predecessor = predecessor; }
+    if(out_successor) { *out_successor = successor; }
+
+    // update the cardinality
+    m_segment_sizes[segment_id] += num_elements;
+    m_cardinality += num_elements;
+
+    return minimum;
+}
+
 }}} // pma::adaptive::int1
 
 
@@ -20,6 +20,7 @@
 
 #include <cinttypes>
 #include <cstddef>
+#include <utility>
 
 class RewiredMemory; // forward decl.
 class BufferedRewiredMemory; // forward decl.
@@ -32,9 +33,9 @@ struct Storage {
     uint16_t* m_segment_sizes; // array, containing the cardinalities of each segment
     const uint16_t m_segment_capacity; // the max number of elements in a segment
     uint16_t m_height; // the height of the binary tree for elements
-    uint32_t m_cardinality; // the number of elements contained
-    uint32_t m_capacity; // the size of the array elements
-    uint32_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
+    uint64_t m_cardinality; // the number of elements contained
+    uint64_t m_capacity; // the size of the array elements
+    uint64_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
     const size_t m_pages_per_extent; // number of virtual pages per extent, used in the RewiredMemory
     BufferedRewiredMemory* m_memory_keys; // memory space used for the keys
     BufferedRewiredMemory* m_memory_values; // memory space used for the values
@@ -51,6 +52,13 @@ struct Storage {
      */
     void extend(size_t num_segments);
 
+    /**
+     * Merge the given sorted sequence of elements in the segment. Return true if the first element becomes the new minimum of the segment.
+     * Optionally report the predecessor of the first element and the successor of the last element inserted.
+     * Precondition: the segment has room for all the elements
+     */
+    bool insert_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* elements, size_t num_elements, int64_t* out_predecessor = nullptr, int64_t* out_successor = nullptr) noexcept;
+
     void alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities);
 
     static void dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities);
@@ -21,6 +21,9 @@
 #include <cassert>
 #include <iostream>
 
+#include "miscellaneous.hpp"
+#include "pma/generic/segment_search.hpp"
+
 /*****************************************************************************
  *                                                                           *
  *   DEBUG                                                                   *
@@ -36,111 +39,103 @@
 
 namespace pma { namespace adaptive { namespace int2 {
 
-::pma::Interface::SumResult do_sum(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t min, int64_t max){
-    using SumResult = ::pma::Interface::SumResult;
+// Invoke fn(keys, values, length) for each run of contiguous elements in [min, max], until it returns false
+template<typename Function>
+static void scan_runs(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t min, int64_t max, Function fn){
     if(/* empty ? */storage.m_cardinality == 0 ||
        /* invalid min, max */ max < min ||
-       /* wrong segments */ segment_end < segment_start){ return SumResult{}; }
+       /* wrong segments */ segment_end < segment_start){ return; }
 
-    int64_t* __restrict keys = storage.m_keys;
+    const int64_t* __restrict keys = storage.m_keys;
+    const ssize_t segment_capacity = storage.m_segment_capacity;
+    const ssize_t num_segments = storage.m_number_segments;
 
+    // start of the interval
     bool notfound = true;
     ssize_t segment_id = segment_start;
-    bool segment_even = segment_id % 2 == 0;
-    ssize_t start = -1, stop = -1, offset = -1;
-
-    // start of the interval
-    while(notfound && segment_id < storage.m_number_segments){
-        if(segment_even){
-            stop = (segment_id +1) * storage.m_segment_capacity;
+    ssize_t offset = -1, stop = -1;
+    while(notfound && segment_id < num_segments){
+        ssize_t start;
+        if(segment_id % 2 == 0){ // even, the elements are at the end of the segment
+            stop = (segment_id +1) * segment_capacity;
             start = stop - storage.m_segment_sizes[segment_id];
-            COUT_DEBUG("lower interval, even segment, start: " << start << ", stop: " << stop);
-        } else { // odd
-            start = segment_id * storage.m_segment_capacity;
+        } else { // odd, the elements are at the start of the segment
+            start = segment_id * segment_capacity;
             stop = start + storage.m_segment_sizes[segment_id];
-            COUT_DEBUG("lower interval, odd segment, start: " << start << ", stop: " << stop);
-        }
-        offset = start;
-
-        while(offset < stop && keys[offset] < min) {
-            COUT_DEBUG("lower interval, offset: " << offset << ", key: " << keys[offset] << ", key_min: " << min);
-            offset++;
         }
+        offset = start + segment_lower_bound(keys + start, stop - start, min);
+        COUT_DEBUG("lower interval, segment: " << segment_id << ", start: " << start << ", stop: " << stop << ", offset: " << offset);
 
         notfound = (offset == stop);
-        if(notfound){
-            segment_id++;
-            segment_even = !segment_even; // flip
-        }
+        if(notfound){ segment_id++; }
     }
 
-    if(segment_even && segment_id < (storage.m_number_segments -1)){
-        stop = (segment_id +1) * storage.m_segment_capacity + storage.m_segment_sizes[segment_id +1]; // +1 implicit
-    }
-
-    if(notfound || keys[offset] > max){ return SumResult{}; }
-
-    ssize_t end;
-    { // find the last qualifying index
-        assert(segment_end < storage.m_number_segments);
-        auto interval_start_segment = segment_id;
-        ssize_t segment_id = segment_end;
-        bool segment_even = segment_id % 2 == 0;
-        notfound = true;
-        ssize_t offset, start, stop;
-
-        while(notfound && segment_id >= interval_start_segment){
-            if(segment_even){
-                start = (segment_id +1) * storage.m_segment_capacity -1;
-                stop = start - storage.m_segment_sizes[segment_id];
-            } else { // odd
-                stop = segment_id * storage.m_segment_capacity;
-                start = stop + storage.m_segment_sizes[segment_id] -1;
-            }
-            COUT_DEBUG("upper interval, " << (segment_even ? "even":"odd") << " segment, start: " << start << " [key=" << keys[start] << "], stop: " << stop);
-            offset = start;
+    if(notfound || keys[offset] > max){ return; }
 
-            while(offset >= stop && keys[offset] > max){
-                COUT_DEBUG("upper interval, offset: " << offset << ", key: " << keys[offset] << ", key_max: " << max);
-                offset--;
-            }
+    if(segment_id % 2 == 0 && segment_id < num_segments -1){
+        stop = (segment_id +1) * segment_capacity + storage.m_segment_sizes[segment_id +1]; // +1 implicit
+    }
 
-            notfound = offset < stop;
-            if(notfound){
-                segment_id--;
-                segment_even = !segment_even; // flip
-            }
+    // end of the interval, one past the last qualifying element
+    assert(segment_end < num_segments);
+    ssize_t end = -1;
+    for(ssize_t j = segment_end; end < 0 && j >= segment_id; j--){
+        ssize_t start, stop;
+        if(j % 2 == 0){ // even
+            stop = (j +1) * segment_capacity;
+            start = stop - storage.m_segment_sizes[j];
+        } else { // odd
+            start = j * segment_capacity;
+            stop = start + storage.m_segment_sizes[j];
         }
-
-        end = offset +1;
+        ssize_t count = segment_upper_bound(keys + start, stop - start, max);
+        COUT_DEBUG("upper interval, segment: " << j << ", start: " << start << ", stop: " << stop << ", count: " << count);
+        if(count > 0){ end = start + count; }
     }
 
-    if(end <= offset) return SumResult{};
+    if(end <= offset) return;
     stop = std::min(stop, end);
 
-    int64_t* __restrict values = storage.m_values;
-    SumResult sum;
-    sum.m_first_key = keys[offset];
+    const int64_t* __restrict values = storage.m_values;
+    bool proceed = true;
 
-    while(offset < end){
-        sum.m_num_elements += (stop - offset);
-        while(offset < stop){
-            sum.m_sum_keys += keys[offset];
-            sum.m_sum_values += values[offset];
-            offset++;
-        }
+    while(proceed && offset < end){
+        proceed = fn(keys + offset, values + offset, static_cast<size_t>(stop - offset));
+        offset = stop;
 
         segment_id += 1 + (segment_id % 2 == 0); // next even segment
-        if(segment_id < storage.m_number_segments){
+        if(segment_id < num_segments){
             ssize_t size_lhs = storage.m_segment_sizes[segment_id];
             ssize_t size_rhs = storage.m_segment_sizes[segment_id +1];
-            offset = (segment_id +1) * storage.m_segment_capacity - size_lhs;
+            offset = (segment_id +1) * segment_capacity - size_lhs;
             stop = std::min(end, offset + size_lhs + size_rhs);
+
+            // request the following pair of segments, while processing the current one
+            if(segment_id +2 < num_segments){
+                ssize_t offset_next = (segment_id +3) * segment_capacity - storage.m_segment_sizes[segment_id +2];
+                PREFETCH(keys + offset_next);
+                PREFETCH(values + offset_next);
+            }
         }
     }
-    sum.m_last_key = keys[end -1];
+}
 
+::pma::Interface::SumResult do_sum(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t min, int64_t max){
+    ::pma::Interface::SumResult sum;
+    scan_runs(storage, segment_start, segment_end, min, max, [&sum](const int64_t* keys, const int64_t* values, size_t length){
+        if(sum.m_num_elements == 0){ sum.m_first_key = keys[0]; }
+        sum.m_num_elements += length;
+        segment_sum(keys, values, length, &sum.m_sum_keys, &sum.m_sum_values);
+        sum.m_last_key = keys[length -1];
+        return true;
+    });
     return sum;
 }
 
+void do_scan(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor){
+    scan_runs(storage, segment_start, segment_end, min, max, [&visitor](const int64_t* keys, const int64_t* values, size_t length){
+        return visitor.visit(keys, values, length);
+    });
+}
+
 }}} // namespace pma::adaptive::int2
@@ -25,6 +25,8 @@ namespace pma { namespace adaptive { namespace int2 {
 
 ::pma::Interface::SumResult do_sum(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t key_min, int64_t key_max);
 
+void do_scan(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t key_min, int64_t key_max, ::pma::Interface::ScanVisitor& visitor);
+
 }}} // pma::adaptive::int2
 
 
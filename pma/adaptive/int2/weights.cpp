@@ -110,7 +110,7 @@ Weights::~Weights(){
 
 void Weights::prefix_sum_cardinalities(){
     assert(m_prefix_sum_cardinalities == nullptr && "Already initialised");
-    m_prefix_sum_cardinalities = m_pma.memory_pool().allocate<int32_t>(m_segment_length);
+    m_prefix_sum_cardinalities = m_pma.memory_pool().allocate<int64_t>(m_segment_length);
 
     m_prefix_sum_cardinalities[0] = m_cardinalities[m_segment_start];
     for(size_t i = 1; i < m_segment_length; i++){
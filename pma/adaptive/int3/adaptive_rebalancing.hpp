@@ -36,13 +36,13 @@ class MoveDetectorInfo;
 class PackedMemoryArray;
 
 struct Optimum {
-    int m_cardinality;
+    int64_t m_cardinality;
     int m_weights_index;
     int m_weights_balance;
 
     Optimum();
-    Optimum(int cardinality);
-    Optimum(int cardinality, int weights_index, int weights_balance);
+    Optimum(int64_t cardinality);
+    Optimum(int64_t cardinality, int weights_index, int weights_balance);
 };
 
 std::ostream& operator<<(std::ostream& out, Optimum opt);
@@ -67,17 +67,17 @@ private:
 //    uint64_t m_debug_window_start = 0;
 //    uint64_t m_debug_window_length = 0;
 
-    void move_detector_info(int segment_id, int destination);
+    void move_detector_info(int64_t segment_id, int64_t destination);
 
     /**
      * Find the optimum point using just in the middle between weights[index_split] and weights[index_split +1]
      */
-    int rebalancing_paro(Interval* weights, size_t weights_sz, int index_split, size_t cardinality);
+    int64_t rebalancing_paro(Interval* weights, size_t weights_sz, int index_split, size_t cardinality);
 
     /**
      * Find the optimum point with an odd number of weights
      */
-    int rebalancing_sparu(Interval* weights, size_t weights_sz, int index_split, size_t cardinality);
+    int64_t rebalancing_sparu(Interval* weights, size_t weights_sz, int index_split, size_t cardinality);
 
     // Find the optimum partitions, regardless of the lower & upper thresholds
     Optimum find_optimum(Interval* weights, size_t weights_length, int balance, size_t cardinality);
@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gate_versions.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+
+#include "miscellaneous.hpp"
+
+using namespace std;
+
+namespace pma { namespace adaptive { namespace int3 {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Initialisation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+GateVersions::GateVersions(size_t num_segments, size_t segments_per_gate) {
+    if(segments_per_gate == 0 || hyperceil(segments_per_gate) != segments_per_gate) throw invalid_argument("[GateVersions] The number of segments per gate must be a power of 2");
+    m_gate_shift = __builtin_ctzl(segments_per_gate);
+    resize(num_segments);
+}
+
+void GateVersions::resize(size_t num_segments){
+    size_t num_gates = max<size_t>(1, (num_segments + get_segments_per_gate() -1) >> m_gate_shift);
+    if(num_gates == m_num_gates) return;
+    m_gates.reset(new atomic<uint64_t>[num_gates]);
+    for(size_t i = 0; i < num_gates; i++){ m_gates[i].store(0, memory_order_relaxed); }
+    m_num_gates = num_gates;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Writer                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+void GateVersions::gate_lock(size_t gate_id) noexcept {
+    assert(gate_id < m_num_gates && "Invalid gate");
+    assert(m_gates[gate_id].load(memory_order_relaxed) % 2 == 0 && "Gate already locked");
+    m_gates[gate_id].store(m_gates[gate_id].load(memory_order_relaxed) +1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // the version must be visible before the changes to the segments
+}
+
+void GateVersions::gate_unlock(size_t gate_id) noexcept {
+    assert(gate_id < m_num_gates && "Invalid gate");
+    assert(m_gates[gate_id].load(memory_order_relaxed) % 2 == 1 && "Gate not locked");
+    m_gates[gate_id].store(m_gates[gate_id].load(memory_order_relaxed) +1, memory_order_release);
+}
+
+void GateVersions::global_lock(bool wait_readers) noexcept {
+    assert(m_epoch.m_value.load(memory_order_relaxed) % 2 == 0 && "Already locked");
+    m_epoch.m_value.fetch_add(1, memory_order_seq_cst);
+
+    if(wait_readers){ // new readers will see the odd epoch & back off
+        for(size_t i = 0; i < NUM_READER_SLOTS; i++){
+            while(m_readers[i].m_value.load(memory_order_seq_cst) > 0){ this_thread::yield(); }
+        }
+    }
+}
+
+void GateVersions::global_unlock() noexcept {
+    assert(m_epoch.m_value.load(memory_order_relaxed) % 2 == 1 && "Not locked");
+    m_epoch.m_value.fetch_add(1, memory_order_release);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Readers                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+GateVersions::Slot& GateVersions::reader_slot() noexcept {
+    static atomic<size_t> next_slot { 0 };
+    thread_local size_t slot_id = next_slot.fetch_add(1, memory_order_relaxed) % NUM_READER_SLOTS;
+    return m_readers[slot_id];
+}
+
+uint64_t GateVersions::reader_enter() noexcept {
+    Slot& slot = reader_slot();
+    while(true){
+        slot.m_value.fetch_add(1, memory_order_seq_cst);
+        uint64_t epoch = m_epoch.m_value.load(memory_order_seq_cst);
+        if(epoch % 2 == 0) return epoch;
+
+        // the writer is moving elements across gates or it is waiting for the readers to leave
+        slot.m_value.fetch_sub(1, memory_order_seq_cst);
+        while(m_epoch.m_value.load(memory_order_acquire) == epoch){ this_thread::yield(); }
+    }
+}
+
+void GateVersions::reader_exit() noexcept {
+    reader_slot().m_value.fetch_sub(1, memory_order_release);
+}
+
+bool GateVersions::validate_epoch(uint64_t epoch) const noexcept {
+    atomic_thread_fence(memory_order_acquire); // all reads of the data must complete before reading the epoch again
+    return m_epoch.m_value.load(memory_order_relaxed) == epoch;
+}
+
+uint64_t GateVersions::gate_read(size_t gate_id) const noexcept {
+    assert(gate_id < m_num_gates && "Invalid gate");
+    uint64_t version = m_gates[gate_id].load(memory_order_acquire);
+    while(version % 2 == 1){ // the writer is changing the gate
+        this_thread::yield();
+        version = m_gates[gate_id].load(memory_order_acquire);
+    }
+    return version;
+}
+
+bool GateVersions::validate_gate(size_t gate_id, uint64_t version) const noexcept {
+    assert(gate_id < m_num_gates && "Invalid gate");
+    atomic_thread_fence(memory_order_acquire); // all reads of the data must complete before reading the version again
+    return m_gates[gate_id].load(memory_order_relaxed) == version;
+}
+
+}}} // pma::adaptive::int3
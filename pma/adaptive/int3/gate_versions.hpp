@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PMA_ADAPTIVE_INT3_GATE_VERSIONS_HPP_
+#define PMA_ADAPTIVE_INT3_GATE_VERSIONS_HPP_
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+
+namespace pma { namespace adaptive { namespace int3 {
+
+/**
+ * Optimistic version control between a single writer and many lock-free readers.
+ *
+ * The segments of the PMA are grouped in gates of a fixed size (a power of 2). Each gate has a version
+ * counter, which is odd while the writer is altering the segments of the gate, their sizes or their
+ * separator keys in the index, and even otherwise. Readers record the version of the gate before
+ * accessing its segments and validate it afterwards, retrying on conflict.
+ *
+ * Operations moving elements across gates (rebalances spanning multiple gates) rather bump the global
+ * epoch, invalidating all readers in progress. Operations altering the layout of the memory (resizes)
+ * also wait for all readers to leave before proceeding, so that readers never access memory that has
+ * been released. Readers register themselves in one of a fixed number of slots, one cache line each.
+ */
+class GateVersions {
+    GateVersions(const GateVersions&) = delete;
+    GateVersions& operator=(const GateVersions&) = delete;
+
+    constexpr static size_t NUM_READER_SLOTS = 128; // max number of reader slots, shared among the threads beyond that
+    struct alignas(64) Slot { std::atomic<uint64_t> m_value { 0 }; };
+
+    Slot m_epoch; // global version, odd while an operation spanning multiple gates is in progress
+    Slot m_readers[NUM_READER_SLOTS]; // number of readers active in each slot
+    std::unique_ptr<std::atomic<uint64_t>[]> m_gates; // the version of each gate
+    size_t m_num_gates = 0; // number of gates
+    size_t m_gate_shift = 0; // log2 of the number of segments in a gate
+
+    // Retrieve the slot assigned to the current thread
+    Slot& reader_slot() noexcept;
+
+public:
+    /**
+     * Initialise the versions for `num_segments' segments, grouped in gates of `segments_per_gate' segments
+     */
+    GateVersions(size_t num_segments, size_t segments_per_gate);
+
+    /**
+     * Reset the number of gates, after the PMA has been resized. It must be invoked by the writer while holding the
+     * global latch with the flag `wait_readers' set.
+     */
+    void resize(size_t num_segments);
+
+    /**
+     * Retrieve the gate containing the given segment
+     */
+    size_t get_gate(size_t segment_id) const noexcept { return segment_id >> m_gate_shift; }
+
+    /**
+     * Retrieve the number of segments in each gate
+     */
+    size_t get_segments_per_gate() const noexcept { return static_cast<size_t>(1) << m_gate_shift; }
+
+    /**
+     * Retrieve the number of gates
+     */
+    size_t get_num_gates() const noexcept { return m_num_gates; }
+
+    /**
+     * Writer, start/complete a change restricted to the segments of the given gate
+     */
+    void gate_lock(size_t gate_id) noexcept;
+    void gate_unlock(size_t gate_id) noexcept;
+
+    /**
+     * Writer, start/complete a change spanning multiple gates. If `wait_readers' is set, wait for all readers
+     * to leave before proceeding.
+     */
+    void global_lock(bool wait_readers) noexcept;
+    void global_unlock() noexcept;
+
+    /**
+     * Reader, register the current thread as an active reader. It returns the current global epoch.
+     */
+    uint64_t reader_enter() noexcept;
+
+    /**
+     * Reader, unregister the current thread
+     */
+    void reader_exit() noexcept;
+
+    /**
+     * Reader, check whether the global epoch is still the same
+     */
+    bool validate_epoch(uint64_t epoch) const noexcept;
+
+    /**
+     * Reader, retrieve the current (even) version of the gate, waiting for the writer to complete its change
+     */
+    uint64_t gate_read(size_t gate_id) const noexcept;
+
+    /**
+     * Reader, check whether the version of the gate is still the same
+     */
+    bool validate_gate(size_t gate_id, uint64_t version) const noexcept;
+};
+
+}}} // pma::adaptive::int3
+
+#endif /* PMA_ADAPTIVE_INT3_GATE_VERSIONS_HPP_ */
@@ -35,7 +35,7 @@ class MoveDetectorInfo{
     CachedMemoryPool& m_memory_pool;
     int64_t* m_detector_buffer; // input
     const size_t m_detector_entry_size; // size of each entry in the detector buffer
-    std::pair<uint32_t, uint32_t>* m_registered_segments; // segments that need to be moved
+    std::pair<uint64_t, uint64_t>* m_registered_segments; // segments that need to be moved
     size_t m_registered_segments_capacity; // space in the array m_registered_segments
     size_t m_registered_segments_sz; // current number of segments registered
 
@@ -53,7 +53,7 @@ public:
     void resize(size_t sz);
 
     // Register a section for the detector
-    void move_section(uint32_t from, uint32_t to);
+    void move_section(uint64_t from, uint64_t to);
 
     // Dump the contained information, for debug purposes
     void dump(std::ostream& out) const;
@@ -39,6 +39,11 @@
 #include "iterator.hpp"
 #include "miscellaneous.hpp"
 #include "move_detector_info.hpp"
+#include "pma/generic/find_batch.hpp"
+#include "pma/generic/load_sorted.hpp"
+#include "pma/generic/parallel_spread.hpp"
+#include "pma/generic/segment_search.hpp"
+#include "pma/generic/snapshot.hpp"
 #include "rewired_memory.hpp"
 #include "spread_with_rewiring.hpp"
 #include "sum.hpp"
@@ -68,9 +73,9 @@ namespace pma { namespace adaptive { namespace int3 {
  *****************************************************************************/
 PackedMemoryArray::PackedMemoryArray(size_t pages_per_extent) : PackedMemoryArray(/* B = */ 64, pages_per_extent) { }
 PackedMemoryArray::PackedMemoryArray(size_t btree_block_size, size_t pages_per_extent) : PackedMemoryArray(btree_block_size, btree_block_size, pages_per_extent) { }
-PackedMemoryArray::PackedMemoryArray(size_t btree_block_size, size_t pma_segment_size, size_t pages_per_extent) :
+PackedMemoryArray::PackedMemoryArray(size_t btree_block_size, size_t pma_segment_size, size_t pages_per_extent, bool key_only) :
        m_index(btree_block_size),
-       m_storage(pma_segment_size, pages_per_extent),
+       m_storage(pma_segment_size, pages_per_extent, key_only),
        m_detector(m_knobs, 1, 8),
        m_density_bounds1(0, 0.75, 0.75, 1) /* there is rationale for these hardwired thresholds */{
 }
@@ -179,12 +184,14 @@ void PackedMemoryArray::insert_empty(int64_t key, int64_t value){
     assert(empty());
     assert(m_storage.capacity() > 0 && "The storage does not have any capacity?");
 
+    writer_lock_segment(0);
     m_index.set_separator_key(0, key);
     m_storage.m_segment_sizes[0] = 1;
     size_t pos = m_storage.m_segment_capacity -1;
     m_storage.m_keys[pos] = key;
-    m_storage.m_values[pos] = value;
+    if(!m_storage.m_key_only) m_storage.m_values[pos] = value;
     m_storage.m_cardinality = 1;
+    writer_unlock_segment(0);
 }
 
 void PackedMemoryArray::insert_common(size_t segment_id, int64_t key, int64_t value){
@@ -197,12 +204,98 @@ void PackedMemoryArray::insert_common(size_t segment_id, int64_t key, int64_t va
         rebalance(segment_id, &key, &value);
     } else { // find a spot where to insert this element
         int64_t predecessor, successor;
+        writer_lock_segment(segment_id);
         bool minimum_updated = m_storage.insert(segment_id, key, value, &predecessor, &successor);
-        m_detector.insert(segment_id, predecessor, successor);
 
         // have we just updated the minimum ?
         if (minimum_updated) m_index.set_separator_key(segment_id, key);
+        writer_unlock_segment(segment_id);
+
+        m_detector.insert(segment_id, predecessor, successor);
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Bulk loading                                                            *
+ *                                                                           *
+ *****************************************************************************/
+void PackedMemoryArray::load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz){
+    COUT_DEBUG("Load " << array_sz << " elements");
+    if(array_sz == 0) return; // nothing to load
+    std::pair<int64_t, int64_t>* __restrict A = array; // disable aliasing
+
+    size_t i = 0;
+    if(empty()){ insert_empty(A[0].first, A[0].second); i = 1; }
+
+    auto merge_run = [this](size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+        int64_t predecessor, successor;
+        writer_lock_segment(segment_id);
+        bool minimum_updated = m_storage.insert_sorted(segment_id, run, run_length, &predecessor, &successor);
+        if(minimum_updated) m_index.set_separator_key(segment_id, run[0].first);
+        writer_unlock_segment(segment_id);
+        m_detector.insert(segment_id, predecessor, successor);
+    };
+    auto rebalance_run = [this](size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+        return rebalance_sorted(segment_id, run, run_length);
+    };
+    clustered_load_sorted(m_index, m_storage, A + i, array_sz - i, merge_run, rebalance_run);
+
+#if defined(DEBUG)
+    COUT_DEBUG("Load done");
+    dump();
+#endif
+}
+
+size_t PackedMemoryArray::rebalance_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length){
+    size_t window_start {0}, window_length {0}, cardinality_after {0};
+    auto thresholds = [this](int height){ return get_thresholds(height); };
+    bool is_spread = clustered_find_window(m_storage.m_segment_sizes, m_storage.m_number_segments, m_storage.m_segment_capacity, m_storage.height(),
+            segment_id, run_length, thresholds, &window_start, &window_length, &cardinality_after);
+    size_t root_room = is_spread ? 0 : clustered_root_room(m_storage.m_number_segments, m_storage.m_segment_capacity, m_storage.m_cardinality, m_storage.height(), thresholds);
+
+    if(!is_spread && root_room > 0){ // fill the whole array up to the threshold of the root, the rest of the run is inserted after the resize
+        run_length = root_room;
+        window_start = 0;
+        window_length = m_storage.m_number_segments;
+        cardinality_after = m_storage.m_cardinality + run_length;
+    } else if(!is_spread){ // resize, at most doubling the cardinality the array can hold, without inserting the run yet
+        auto plan = rebalance_plan(true, 0, 0, m_storage.m_cardinality + min(run_length, m_storage.m_cardinality), true);
+        plan.m_is_insert = false;
+        plan.m_cardinality_after = m_storage.m_cardinality;
+        writer_lock(plan);
+        rebalance_run_apma(plan);
+        do_rebalance(plan);
+        writer_unlock(plan);
+        return 0;
     }
+
+    COUT_DEBUG("window: [" << window_start << ", " << window_start + window_length << "), run: " << run_length << ", cardinality: " << cardinality_after);
+    RebalanceMetadata action { m_memory_pool };
+    action.m_operation = RebalanceOperation::REBALANCE;
+    action.m_window_start = window_start;
+    action.m_window_length = window_length;
+    action.m_cardinality_after = cardinality_after;
+
+    // workspace
+    auto fn_deallocate = [this](void* ptr){ m_memory_pool.deallocate(ptr); };
+    unique_ptr<int64_t, decltype(fn_deallocate)> input_keys_ptr{ m_memory_pool.allocate<int64_t>(cardinality_after), fn_deallocate };
+    int64_t* input_keys = input_keys_ptr.get();
+    unique_ptr<int64_t, decltype(fn_deallocate)> input_values_ptr{ m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(cardinality_after), fn_deallocate };
+    int64_t* input_values = m_storage.m_key_only ? input_keys : input_values_ptr.get(); // in the key-only mode, the values are an alias of the keys
+
+    // gather the window and the run together, then spread them once
+    writer_lock(action);
+    clustered_gather(m_storage.m_keys, m_storage.m_key_only ? nullptr : m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity,
+            window_start, window_length, run, run_length, input_keys, input_values_ptr.get());
+    spread_save(window_start, window_length, input_keys, input_values, cardinality_after, nullptr);
+    m_storage.m_cardinality += run_length;
+    writer_unlock(action);
+
+    if(window_length == m_storage.m_number_segments)
+        m_detector.clear();
+
+    return run_length;
 }
 
 /*****************************************************************************
@@ -224,19 +317,21 @@ int64_t PackedMemoryArray::remove(int64_t key){
     int64_t predecessor = numeric_limits<int64_t>::min(); // to forward to the detector/predictor
     int64_t successor = numeric_limits<int64_t>::max(); // to forward to the detector/predictor
 
+    writer_lock_segment(segment_id);
     if (segment_id % 2 == 0) { // even
-        size_t imin = m_storage.m_segment_capacity - sz, i;
-        for(i = imin; i < m_storage.m_segment_capacity; i++){ if(keys[i] == key) break; }
+        size_t imin = m_storage.m_segment_capacity - sz;
+        int64_t position = segment_find(keys + imin, sz, key);
+        size_t i = position >= 0 ? imin + position : m_storage.m_segment_capacity;
         if(i < m_storage.m_segment_capacity){ // found ?
             // to update the predictor/detector
             if(i > imin) predecessor = keys[i-1];
             if(i < m_storage.m_segment_capacity -1) successor = keys[i+1];
 
-            value = values[i];
+            value = m_storage.m_key_only ? key : values[i];
             // shift the rest of the elements by 1
             for(size_t j = i; j > imin; j--){
                 keys[j] = keys[j -1];
-                values[j] = values[j-1];
+                if(!m_storage.m_key_only) values[j] = values[j-1];
             }
 
             sz--;
@@ -253,18 +348,18 @@ int64_t PackedMemoryArray::remove(int64_t key){
         } // end if (found)
     } else { // odd
         // find the key in the segment
-        size_t i = 0;
-        for( ; i < sz; i++){ if(keys[i] == key) break; }
+        int64_t position = segment_find(keys, sz, key);
+        size_t i = position >= 0 ? position : sz;
         if(i < sz){ // found?
             // to update the predictor/detector
             if(i > 0) predecessor = keys[i-1];
             if(i < sz -1) successor = keys[i+1];
 
-            value = values[i];
+            value = m_storage.m_key_only ? key : values[i];
             // shift the rest of the elements by 1
             for(size_t j = i; j < sz - 1; j++){
                 keys[j] = keys[j+1];
-                values[j] = values[j+1];
+                if(!m_storage.m_key_only) values[j] = values[j+1];
             }
 
             sz--;
@@ -277,6 +372,7 @@ int64_t PackedMemoryArray::remove(int64_t key){
             }
         } // end if (found)
     } // end if (odd segment)
+    writer_unlock_segment(segment_id);
 
     // shall we rebalance ?
     if(value != -1){
@@ -284,8 +380,10 @@ int64_t PackedMemoryArray::remove(int64_t key){
 
         if(m_storage.m_number_segments >= 2 * balanced_thresholds_cutoff() && static_cast<double>(m_storage.m_cardinality) < 0.5 * m_storage.capacity()){
             auto plan = rebalance_plan(false, 0, 0, m_storage.m_cardinality, true);
+            writer_lock(plan);
             rebalance_run_apma(plan);
             do_rebalance(plan);
+            writer_unlock(plan);
         } else if(m_storage.m_number_segments > 1) {
             const size_t minimum_size = max<size_t>(get_thresholds(1).first * m_storage.m_segment_capacity, 1); // at least one element per segment
             if(sz < minimum_size){ rebalance(segment_id, nullptr, nullptr); }
@@ -320,8 +418,10 @@ void PackedMemoryArray::rebalance(size_t segment_id, int64_t* key, int64_t* valu
         metadata.m_insert_segment = segment_id;
     }
 
+    writer_lock(metadata);
     rebalance_run_apma(metadata);
     do_rebalance(metadata);
+    writer_unlock(metadata);
 }
 
 void PackedMemoryArray::rebalance_find_window(size_t segment_id, bool is_insertion, int64_t* out_window_start, int64_t* out_window_length, int64_t* out_cardinality_after, bool* out_resize) const {
@@ -350,7 +450,7 @@ void PackedMemoryArray::rebalance_find_window(size_t segment_id, bool is_inserti
 
             // re-align the calibrator tree
             if(window_end > m_storage.m_number_segments){
-                int offset = window_end - m_storage.m_number_segments;
+                int64_t offset = window_end - m_storage.m_number_segments;
                 window_start -= offset;
                 window_end -= offset;
             }
@@ -483,7 +583,7 @@ void PackedMemoryArray::do_rebalance(const RebalanceMetadata& action) {
     case RebalanceOperation::REBALANCE: {
         if (action.m_window_length < m_storage.get_segments_per_extent()){
             spread_local(action); // local to the extent
-        } else { // use rewiring
+        } else if (!spread_parallel(action, action.m_window_length, action.m_window_length)) { // use rewiring
             COUT_DEBUG("REBALANCE w/REWIRING, cardinality: " << action.get_cardinality_after() << ", window: [" << action.m_window_start << ", " << action.m_window_start + action.m_window_length << ")");
             SpreadWithRewiring instance{ this, (size_t) action.m_window_start, (size_t) action.m_window_length, action.m_apma_partitions };
             if(action.m_is_insert){ instance.set_element_to_insert(action.m_insert_key, action.m_insert_value); }
@@ -517,8 +617,8 @@ void PackedMemoryArray::spread_local(const RebalanceMetadata& action){
     auto fn_deallocate = [this](void* ptr){ m_memory_pool.deallocate(ptr); };
     unique_ptr<int64_t, decltype(fn_deallocate)> input_keys_ptr{ m_memory_pool.allocate<int64_t>(action.get_cardinality_after()), fn_deallocate };
     int64_t* __restrict input_keys = input_keys_ptr.get();
-    unique_ptr<int64_t, decltype(fn_deallocate)> input_values_ptr{ m_memory_pool.allocate<int64_t>(action.get_cardinality_after()), fn_deallocate };
-    int64_t* __restrict input_values = input_values_ptr.get();
+    unique_ptr<int64_t, decltype(fn_deallocate)> input_values_ptr{ m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(action.get_cardinality_after()), fn_deallocate };
+    int64_t* input_values = m_storage.m_key_only ? input_keys : input_values_ptr.get(); // in the key-only mode, the values are an alias of the keys
 
     // 1) first copy all elements in input keys
     int64_t insert_position = -1;
@@ -571,14 +671,16 @@ size_t PackedMemoryArray::spread_insert_unsafe(int64_t* __restrict keys_from, in
     size_t i = 0;
     while(i < num_elements && keys_from[i] < new_key){
         keys_to[i] = keys_from[i];
-        values_to[i] = values_from[i];
         i++;
     }
     keys_to[i] = new_key;
-    values_to[i] = new_value;
-
     memcpy(keys_to + i + 1, keys_from + i, (num_elements -i) * sizeof(keys_to[0]));
-    memcpy(values_to + i + 1, values_from + i, (num_elements -i) * sizeof(values_to[0]));
+
+    if(!m_storage.m_key_only){
+        memcpy(values_to, values_from, i * sizeof(values_to[0]));
+        values_to[i] = new_value;
+        memcpy(values_to + i + 1, values_from + i, (num_elements -i) * sizeof(values_to[0]));
+    }
 
     m_storage.m_cardinality++;
 
@@ -612,7 +714,7 @@ void PackedMemoryArray::spread_load(const RebalanceMetadata& action, int64_t* __
             keys_to++; values_to++;
         } else {
             memcpy(keys_to, keys_from, sizeof(keys_to[0]) * length);
-            memcpy(values_to, values_from, sizeof(values_from[0]) * length);
+            if(!m_storage.m_key_only) memcpy(values_to, values_from, sizeof(values_from[0]) * length);
             if(do_insert) { position_key_inserted += length; } // the inserted key has not been yet inserted
         }
 
@@ -637,7 +739,7 @@ void PackedMemoryArray::spread_save(size_t segment_id, int64_t* keys_from, int64
     }
 
     memcpy(keys_to, keys_from, sizeof(keys_to[0]) * cardinality);
-    memcpy(values_to, values_from, sizeof(values_to[0]) * cardinality);
+    if(!m_storage.m_key_only) memcpy(values_to, values_from, sizeof(values_to[0]) * cardinality);
 
     m_index.set_separator_key(segment_id, keys_from[0]);
     m_storage.m_segment_sizes[segment_id] = cardinality;
@@ -682,7 +784,7 @@ void PackedMemoryArray::spread_save(size_t window_start, size_t window_length, i
     if(window_start %2 == 1){
         size_t this_card = card_per_segment + odd_segments;
         memcpy(keys_to, keys_from, sizeof(keys_to[0]) * this_card);
-        memcpy(values_to, values_from, sizeof(values_to[0]) * this_card);
+        if(!m_storage.m_key_only) memcpy(values_to, values_from, sizeof(values_to[0]) * this_card);
         m_index.set_separator_key(window_start, keys_to[0]);
 
         window_start++;
@@ -710,7 +812,7 @@ void PackedMemoryArray::spread_save(size_t window_start, size_t window_length, i
         m_index.set_separator_key(window_start + i,   (keys_from + card_left)[0]);
 
         memcpy(keys_to_start, keys_from, length * sizeof(keys_to_start[0]));
-        memcpy(values_to_start, values_from, length * sizeof(values_from[0]));
+        if(!m_storage.m_key_only) memcpy(values_to_start, values_from, length * sizeof(values_from[0]));
 
         keys_from += length;
         values_from += length;
@@ -725,7 +827,7 @@ void PackedMemoryArray::spread_save(size_t window_start, size_t window_length, i
         m_index.set_separator_key(window_start + window_length -1,  keys_from[0]);
 
         memcpy(keys_to_start, keys_from, card_per_segment * sizeof(keys_to_start[0]));
-        memcpy(values_to_start, values_from, card_per_segment * sizeof(values_from[0]));
+        if(!m_storage.m_key_only) memcpy(values_to_start, values_from, card_per_segment * sizeof(values_from[0]));
     }
 }
 
@@ -755,16 +857,52 @@ void PackedMemoryArray::resize_rebalance(const RebalanceMetadata& action) {
     m_index.rebuild(num_segments_after);
 
     // 2) Spread
-    SpreadWithRewiring rewiring_instance(this, 0, num_segments_after, action.m_apma_partitions );
-    if(action.m_is_insert){ rewiring_instance.set_element_to_insert(action.m_insert_key, action.m_insert_value); }
-    size_t start_position = (num_segments_before -1) * m_storage.m_segment_capacity + m_storage.m_segment_sizes[num_segments_before -1];
-    rewiring_instance.set_absolute_position(start_position);
-    rewiring_instance.execute();
+    if(!spread_parallel(action, num_segments_before, num_segments_after)){
+        SpreadWithRewiring rewiring_instance(this, 0, num_segments_after, action.m_apma_partitions );
+        if(action.m_is_insert){ rewiring_instance.set_element_to_insert(action.m_insert_key, action.m_insert_value); }
+        size_t start_position = (num_segments_before -1) * m_storage.m_segment_capacity + m_storage.m_segment_sizes[num_segments_before -1];
+        rewiring_instance.set_absolute_position(start_position);
+        rewiring_instance.execute();
+    }
 
     // 3) Shrink the PMA
     if(num_segments_after < num_segments_before){ m_storage.shrink(num_segments_before - num_segments_after); }
 }
 
+/*****************************************************************************
+ *                                                                           *
+ *   Parallel spread                                                         *
+ *                                                                           *
+ *****************************************************************************/
+bool PackedMemoryArray::spread_parallel(const RebalanceMetadata& action, size_t input_length, size_t output_length){
+    size_t num_workers = ParallelSpread::get_num_workers(action.get_cardinality_after(), m_spread_threads);
+    if(num_workers <= 1 || !ParallelSpread::is_aligned(m_storage.m_memory_keys, m_storage.m_segment_capacity, action.m_window_start, output_length)) return false;
+    COUT_DEBUG("window start: " << action.m_window_start << ", segments: " << input_length << " -> " << output_length << ", cardinality: " << action.get_cardinality_after() << ", workers: " << num_workers);
+
+    ParallelSpread spread{ m_storage.m_keys, m_storage.m_key_only ? nullptr : m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity,
+        m_storage.m_memory_keys, m_storage.m_key_only ? nullptr : m_storage.m_memory_values, (size_t) action.m_window_start, input_length, output_length };
+    size_t segment_id = 0;
+    for(size_t i = 0; i < action.m_apma_partitions.size(); i++){
+        const auto& partition = action.m_apma_partitions[i];
+        size_t card_per_segment = partition.m_cardinality / partition.m_segments;
+        size_t odd_segments = partition.m_cardinality % partition.m_segments;
+        for(size_t j = 0; j < partition.m_segments; j++){
+            spread.set_output_size(segment_id++, card_per_segment + (j < odd_segments));
+        }
+    }
+    assert(segment_id == output_length && "The partitions do not cover the whole window");
+    if(action.m_is_insert){ spread.set_element_to_insert(action.m_insert_key, action.m_insert_value, action.m_insert_segment); }
+
+    spread.execute(num_workers, &m_index);
+
+    if(action.m_is_insert){
+        m_storage.m_cardinality++;
+        m_detector.insert(spread.get_insert_segment(), spread.get_insert_predecessor(), spread.get_insert_successor());
+    }
+
+    return true;
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Full resize                                                             *
@@ -817,10 +955,10 @@ void PackedMemoryArray::resize(const RebalanceMetadata& action) {
     // start copying the elements
     bool output_segment_odd = false; // consider '0' as even
     struct {
-        int index = 0; // current position in the vector partitions
-        int segment = 0; // current segment considered
-        int card_per_segment = 0; // cardinality per segment
-        int odd_segments = 0; // number of segments with an additional element than `card_per_segment'
+        int64_t index = 0; // current position in the vector partitions
+        int64_t segment = 0; // current segment considered
+        int64_t card_per_segment = 0; // cardinality per segment
+        int64_t odd_segments = 0; // number of segments with an additional element than `card_per_segment'
     } partition_state;
     const auto& partitions = action.m_apma_partitions;
     partition_state.card_per_segment = partitions[0].m_cardinality / partitions[0].m_segments;
@@ -856,7 +994,7 @@ void PackedMemoryArray::resize(const RebalanceMetadata& action) {
             } else {
                 input_copied = output_copied = cpy1;
                 memcpy(output_keys, input_keys, cpy1 * sizeof(m_storage.m_keys[0]));
-                memcpy(output_values, input_values, cpy1 * sizeof(m_storage.m_values[0]));
+                if(!m_storage.m_key_only) memcpy(output_values, input_values, cpy1 * sizeof(m_storage.m_values[0]));
             }
             assert(output_copied >= 1 && "Made no progress");
             output_keys += output_copied; input_keys += input_copied;
@@ -945,53 +1083,45 @@ int PackedMemoryArray::find_position(size_t segment_id, int64_t key) const noexc
     sz = min<size_t>(sz, m_storage.m_segment_capacity); // avoid overflow
 
     int64_t* __restrict keys = m_storage.m_keys + segment_id * m_storage.m_segment_capacity;
-    int start, stop;
-
     if(segment_id % 2 == 0){ // for even segment ids (0, 2, ...), the keys are at the end
-        start = m_storage.m_segment_capacity - sz;
-        stop = m_storage.m_segment_capacity;
-    } else { // odd segment ids (1, 3, ...), the keys are at the start of the segment
-        start = 0;
-        stop = sz;
-    }
+        keys += m_storage.m_segment_capacity - sz;
+    } // odd segment ids (1, 3, ...), the keys are at the start of the segment
 
-    for(int i = start; i < stop; i++){
-        if(keys[i] == key){
-            return i -start;
-        }
-    }
-
-    return -1; // not found
+    return segment_find(keys, sz, key);
 }
 
 
 int64_t PackedMemoryArray::find(int64_t key) const {
     // not worth merging the code with #find_position
+    if(m_gates) return find_optimistic(key);
 
     if(empty()) return -1;
 
     auto segment_id = m_index.find(key);
 //    COUT_DEBUG("key: " << key << ", bucket: " << segment_id);
-    int64_t* __restrict keys = m_storage.m_keys + segment_id * m_storage.m_segment_capacity;
+    return find_in_segment(segment_id, key);
+}
+
+int64_t PackedMemoryArray::find_in_segment(size_t segment_id, int64_t key) const noexcept {
     size_t sz = m_storage.m_segment_sizes[segment_id];
+    size_t start = (segment_id % 2 == 0) ? /* even */ m_storage.m_segment_capacity - sz : /* odd */ 0;
+    size_t offset = segment_id * m_storage.m_segment_capacity + start;
 
-    size_t start, stop;
+    int64_t position = segment_find(m_storage.m_keys + offset, sz, key);
+    if(position < 0) return -1;
 
-    if(segment_id % 2 == 0){ // even
-        stop = m_storage.m_segment_capacity;
-        start = stop - sz;
-    } else { // odd
-        start = 0;
-        stop = sz;
-    }
+    return m_storage.m_values[offset + position];
+}
 
-    for(size_t i = start; i < stop; i++){
-        if(keys[i] == key){
-            return *(m_storage.m_values + segment_id * m_storage.m_segment_capacity + i);
-        }
+void PackedMemoryArray::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    if(m_gates){ // validate each key on its own
+        for(size_t i = 0; i < num_keys; i++){ out_values[i] = find_optimistic(keys[i]); }
+        return;
     }
+    if(empty()){ std::fill(out_values, out_values + num_keys, -1); return; }
 
-    return -1;
+    clustered_find_batch(m_index, m_storage.m_keys, m_storage.m_segment_sizes, m_storage.m_segment_capacity, keys, out_values, num_keys,
+            [this](uint64_t segment_id, int64_t key){ return find_in_segment(segment_id, key); });
 }
 
 /*****************************************************************************
@@ -1020,9 +1150,224 @@ unique_ptr<::pma::Iterator> PackedMemoryArray::iterator() const {
  *                                                                           *
  *****************************************************************************/
 ::pma::Interface::SumResult PackedMemoryArray::sum(int64_t min, int64_t max) const {
+    if(m_gates) return sum_optimistic(min, max);
     return do_sum(m_storage, m_index.find_first(min), m_index.find_last(max), min, max );
 }
 
+void PackedMemoryArray::scan(int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor) const {
+    do_scan(m_storage, m_index.find_first(min), m_index.find_last(max), min, max, visitor);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Concurrent readers                                                      *
+ *                                                                           *
+ *****************************************************************************/
+void PackedMemoryArray::set_concurrent_readers(bool value){
+    // refitting the model of the learned layout may release the memory accessed by the readers
+    if(value && m_index.layout() == ::pma::StaticIndex::Layout::LEARNED){ throw std::invalid_argument("The concurrent readers are not supported with the learned layout of the index"); }
+
+    if(value && !m_gates){
+        m_gates.reset(new GateVersions(m_storage.m_number_segments, m_storage.get_segments_per_extent()));
+    } else if (!value){
+        m_gates.reset();
+    }
+}
+
+bool PackedMemoryArray::has_concurrent_readers() const noexcept {
+    return m_gates.get() != nullptr;
+}
+
+void PackedMemoryArray::writer_lock_segment(size_t segment_id) noexcept {
+    if(m_gates){ m_gates->gate_lock(m_gates->get_gate(segment_id)); }
+}
+
+void PackedMemoryArray::writer_unlock_segment(size_t segment_id) noexcept {
+    if(m_gates){ m_gates->gate_unlock(m_gates->get_gate(segment_id)); }
+}
+
+void PackedMemoryArray::writer_lock(const RebalanceMetadata& action) noexcept {
+    if(!m_gates) return;
+    const size_t gate_start = m_gates->get_gate(action.m_window_start);
+    if(action.m_operation == RebalanceOperation::REBALANCE && gate_start == m_gates->get_gate(action.m_window_start + action.m_window_length -1)){
+        m_gates->gate_lock(gate_start); // the elements only move inside the gate
+    } else {
+        // a resize may release the memory accessed by the readers
+        m_gates->global_lock(/* wait readers ? */ action.m_operation != RebalanceOperation::REBALANCE);
+    }
+}
+
+void PackedMemoryArray::writer_unlock(const RebalanceMetadata& action) {
+    if(!m_gates) return;
+    const size_t gate_start = m_gates->get_gate(action.m_window_start);
+    if(action.m_operation == RebalanceOperation::REBALANCE && gate_start == m_gates->get_gate(action.m_window_start + action.m_window_length -1)){
+        m_gates->gate_unlock(gate_start);
+    } else {
+        if(action.m_operation != RebalanceOperation::REBALANCE){ m_gates->resize(m_storage.m_number_segments); }
+        m_gates->global_unlock();
+    }
+}
+
+bool PackedMemoryArray::segment_covers(size_t segment_id, int64_t key) const noexcept {
+    return (segment_id == 0 || m_index.get_separator_key(segment_id) <= key) &&
+           (segment_id +1 >= m_storage.m_number_segments || key < m_index.get_separator_key(segment_id +1));
+}
+
+int64_t PackedMemoryArray::find_optimistic(int64_t key) const {
+    int64_t value = -1;
+    bool done = false;
+
+    do {
+        uint64_t epoch = m_gates->reader_enter();
+        if(empty()){
+            value = -1;
+            done = true;
+        } else {
+            size_t segment_id = m_index.find(key);
+            size_t gate_id = m_gates->get_gate(segment_id);
+            uint64_t version = m_gates->gate_read(gate_id);
+
+            // the gate may have been altered between the lookup in the index and reading its version
+            if(!segment_covers(segment_id, key)){ segment_id = m_index.find(key); }
+            if(m_gates->get_gate(segment_id) == gate_id){
+                value = find_in_segment(segment_id, key);
+                done = m_gates->validate_gate(gate_id, version) && m_gates->validate_epoch(epoch);
+            }
+        }
+        m_gates->reader_exit();
+    } while(!done);
+
+    return value;
+}
+
+::pma::Interface::SumResult PackedMemoryArray::sum_optimistic(int64_t min, int64_t max) const {
+    SumResult result;
+    bool done = max < min;
+
+    while(!done){
+        uint64_t epoch = m_gates->reader_enter();
+        if(empty()){ m_gates->reader_exit(); break; }
+
+        // first gate
+        size_t segment_start = m_index.find_first(min);
+        size_t gate_id = m_gates->get_gate(segment_start);
+        uint64_t version = m_gates->gate_read(gate_id);
+        segment_start = m_index.find_first(min);
+        bool restart = m_gates->get_gate(segment_start) != gate_id;
+
+        while(!done && !restart){
+            // sum the elements in [min, max] of the segments of the gate
+            SumResult partial;
+            bool last = false; // have we found an element > max ?
+            const size_t segment_end = std::min<size_t>(m_storage.m_number_segments, (gate_id +1) * m_gates->get_segments_per_gate());
+            for(size_t segment_id = segment_start; segment_id < segment_end && !last; segment_id++){
+                size_t sz = std::min<size_t>(m_storage.m_segment_sizes[segment_id], m_storage.m_segment_capacity);
+                size_t offset = segment_id * m_storage.m_segment_capacity + ((segment_id % 2 == 0) ? m_storage.m_segment_capacity - sz : 0);
+                const int64_t* __restrict keys = m_storage.m_keys + offset;
+                const int64_t* __restrict values = m_storage.m_values + offset;
+                for(size_t i = segment_lower_bound(keys, sz, min); i < sz && !last; i++){
+                    if(keys[i] > max){
+                        last = true;
+                    } else {
+                        if(partial.m_num_elements == 0) partial.m_first_key = keys[i];
+                        partial.m_last_key = keys[i];
+                        partial.m_num_elements++;
+                        partial.m_sum_keys += keys[i];
+                        partial.m_sum_values += values[i];
+                    }
+                }
+            }
+
+            if(!m_gates->validate_epoch(epoch)){ // the elements may have moved across the gates
+                restart = true;
+            } else if(!m_gates->validate_gate(gate_id, version)){ // read the gate again
+                if(segment_start != gate_id * m_gates->get_segments_per_gate()){ restart = true; } // first gate, lookup the index again
+                version = m_gates->gate_read(gate_id);
+            } else { // merge the partial result
+                if(partial.m_num_elements > 0){
+                    if(result.m_num_elements == 0) result.m_first_key = partial.m_first_key;
+                    result.m_last_key = partial.m_last_key;
+                    result.m_num_elements += partial.m_num_elements;
+                    result.m_sum_keys += partial.m_sum_keys;
+                    result.m_sum_values += partial.m_sum_values;
+
+                    // resume from the next key in case of restart
+                    if(partial.m_last_key == numeric_limits<int64_t>::max()){ last = true; } else { min = partial.m_last_key +1; }
+                }
+
+                done = last || segment_end == m_storage.m_number_segments || min > max;
+                if(!done){ // next gate
+                    gate_id++;
+                    segment_start = segment_end;
+                    version = m_gates->gate_read(gate_id);
+                }
+            }
+        }
+
+        m_gates->reader_exit();
+    }
+
+    return result;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Snapshot                                                                *
+ *                                                                           *
+ *****************************************************************************/
+void PackedMemoryArray::save(const std::string& path) const {
+    Snapshot::save(path, Snapshot::Algorithm::APMA_INT3, m_storage.m_segment_capacity, m_storage.m_number_segments, m_storage.m_cardinality,
+            m_storage.m_keys, m_storage.m_values, m_storage.m_segment_sizes, m_index);
+}
+
+void PackedMemoryArray::open(const std::string& path){
+    Snapshot snapshot { path, Snapshot::Algorithm::APMA_INT3 };
+    if(snapshot.get_segment_capacity() != m_storage.m_segment_capacity){
+        RAISE_EXCEPTION(SnapshotError, "Snapshot `" << path << "', segment capacity: " << snapshot.get_segment_capacity() << ", expected: " << m_storage.m_segment_capacity);
+    }
+    const size_t num_segments = snapshot.get_number_segments();
+    COUT_DEBUG("path: " << path << ", segments: " << num_segments << ", cardinality: " << snapshot.get_cardinality());
+
+    // allocate the new storage, in case of error only the new storage is released
+    int64_t* ixKeys;
+    int64_t* ixValues;
+    decltype(m_storage.m_segment_sizes) ixSizes;
+    BufferedRewiredMemory* ixRewiredMemoryKeys;
+    BufferedRewiredMemory* ixRewiredMemoryValues;
+    RewiredMemory* ixRewiredMemoryCardinalities;
+    m_storage.alloc_workspace(num_segments, &ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities);
+    auto xDeleter = [&](void*){ Storage::dealloc_workspace(&ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities); };
+    unique_ptr<PackedMemoryArray, decltype(xDeleter)> ixCleanup { this, xDeleter };
+
+    snapshot.load(ixKeys, m_storage.m_key_only ? nullptr : ixValues, ixSizes);
+
+    // replace the previous storage, released by ixCleanup
+    if(m_gates){ m_gates->global_lock(/* wait readers ? */ true); }
+    try {
+        snapshot.load(m_index);
+    } catch(...){
+        if(m_gates){ m_gates->global_unlock(); }
+        throw;
+    }
+    swap(ixKeys, m_storage.m_keys);
+    swap(ixValues, m_storage.m_values);
+    swap(ixSizes, m_storage.m_segment_sizes);
+    swap(ixRewiredMemoryKeys, m_storage.m_memory_keys);
+    swap(ixRewiredMemoryValues, m_storage.m_memory_values);
+    swap(ixRewiredMemoryCardinalities, m_storage.m_memory_sizes);
+    m_storage.m_number_segments = num_segments;
+    m_storage.m_cardinality = snapshot.get_cardinality();
+
+    // reset the auxiliary state, as after a resize
+    m_detector.resize(num_segments);
+    m_primary_densities = num_segments > balanced_thresholds_cutoff();
+    set_thresholds(ceil(log2(num_segments)) +1);
+    if(m_gates){
+        m_gates->resize(num_segments);
+        m_gates->global_unlock();
+    }
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Segment statistics                                                      *
@@ -1161,6 +1506,16 @@ void PackedMemoryArray::set_record_segment_statistics(bool value) {
     m_segment_statistics = value;
 }
 
+void PackedMemoryArray::set_index_layout(::pma::StaticIndex::Layout layout) {
+    if(layout == ::pma::StaticIndex::Layout::LEARNED && has_concurrent_readers()){ throw std::invalid_argument("The learned layout of the index is not supported with the concurrent readers"); }
+    m_index.set_layout(layout);
+}
+
+void PackedMemoryArray::set_spread_threads(size_t num_threads) {
+    if(num_threads == 0) throw std::invalid_argument("The number of threads must be > 0");
+    m_spread_threads = num_threads;
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Dump                                                                    *
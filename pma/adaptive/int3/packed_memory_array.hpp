@@ -20,11 +20,14 @@
 
 #include <memory>
 #include <random>
+#include <string>
 
+#include "pma/bulk_loading.hpp"
 #include "pma/density_bounds.hpp"
 #include "pma/interface.hpp"
 #include "pma/iterator.hpp"
 #include "detector.hpp"
+#include "gate_versions.hpp"
 #include "knobs.hpp"
 #include "memory_pool.hpp"
 #include "partition.hpp"
@@ -37,7 +40,7 @@ namespace pma { namespace adaptive { namespace int3 {
 class SpreadWithRewiring; // forward decl.
 class Weights;
 
-class PackedMemoryArray : public InterfaceRQ {
+class PackedMemoryArray : public InterfaceRQ, public SortedBulkLoading {
     friend class SpreadWithRewiring;
     friend class Weights;
 private:
@@ -50,6 +53,8 @@ private:
     CachedMemoryPool m_memory_pool;
     bool m_segment_statistics = false; // record segment statistics at the end?
     bool m_primary_densities = false; // use the primary thresholds?
+    size_t m_spread_threads = 1; // max number of threads to spread the elements of large windows
+    std::unique_ptr<GateVersions> m_gates; // versions for the optimistic readers, only set when concurrent readers are enabled
 
     // Insert the first element in the (empty) container
     void insert_empty(int64_t key, int64_t value);
@@ -69,6 +74,9 @@ private:
     // Rebalance the storage so that the density thresholds are ensured
     void rebalance(size_t segment_id, int64_t* insert_new_key, int64_t* insert_new_value);
 
+    // Spread the window of the segment together with a sorted run of new elements. Return the number of elements of the run inserted, 0 if the PMA could only be resized
+    size_t rebalance_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* run, size_t run_length);
+
     // Perform the rebalancing action
     void do_rebalance(const RebalanceMetadata& action);
 
@@ -87,6 +95,9 @@ private:
     // Spread (with rewiring) the elements in the given window
     void resize_rebalance(const RebalanceMetadata& action);
 
+    // Spread the elements in the given window with multiple threads, if worth. Return false if the window is too small or not aligned to the extents
+    bool spread_parallel(const RebalanceMetadata& action, size_t input_length, size_t output_length);
+
     // Spread (without rewiring) the elements in the given window
     void spread_local(const RebalanceMetadata& action);
     struct spread_detector_record{ int64_t m_position; int64_t m_predecessor; int64_t m_successor; };
@@ -111,17 +122,43 @@ private:
     // Returns an empty iterator, i.e. with an empty record set!
     std::unique_ptr<pma::Iterator> empty_iterator() const;
 
+    // Retrieve the value associated to the given key in the segment, or -1 if not found
+    int64_t find_in_segment(size_t segment_id, int64_t key) const noexcept;
+
+    // Concurrent readers, the writer starts/completes a change to the given segment
+    void writer_lock_segment(size_t segment_id) noexcept;
+    void writer_unlock_segment(size_t segment_id) noexcept;
+
+    // Concurrent readers, the writer starts/completes a rebalance
+    void writer_lock(const RebalanceMetadata& action) noexcept;
+    void writer_unlock(const RebalanceMetadata& action);
+
+    // Concurrent readers, check whether the given segment is the one where the key should be stored, according to the separator keys
+    bool segment_covers(size_t segment_id, int64_t key) const noexcept;
+
+    // Concurrent readers, lookups and aggregate sums validated through the gate versions
+    int64_t find_optimistic(int64_t key) const;
+    ::pma::Interface::SumResult sum_optimistic(int64_t min, int64_t max) const;
+
 protected:
     // Helper for the class Weights
     // Find the position of the key in the given segment, or return -1 if not found.
     int find_position(size_t segment_id, int64_t key) const noexcept;
 
+    /**
+     * Bulk loading. Merge the runs of elements falling in the same segment in a single pass. A run overflowing its segment is spread together with its window in a single rebalance.
+     */
+    virtual void load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
+
 public:
     PackedMemoryArray(size_t pages_per_extent);
 
     PackedMemoryArray(size_t pma_segment_size, size_t pages_per_extent);
 
-    PackedMemoryArray(size_t index_B, size_t pma_segment_size, size_t pages_per_extent);
+    /**
+     * @param key_only when true, the PMA behaves as a set: only the keys are stored and the value of each element is its own key
+     */
+    PackedMemoryArray(size_t index_B, size_t pma_segment_size, size_t pages_per_extent, bool key_only = false);
 
     virtual ~PackedMemoryArray();
 
@@ -141,11 +178,19 @@ public:
      */
     virtual int64_t find(int64_t key) const override;
 
+    /**
+     * Lookup the given sequence of keys, overlapping the accesses to the index and to the segments for groups of keys
+     */
+    virtual void find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const override;
+
     virtual std::unique_ptr<::pma::Iterator> find(int64_t min, int64_t max) const override;
 
     // Sum all elements in the interval [min, max]
     virtual ::pma::Interface::SumResult sum(int64_t min, int64_t max) const override;
 
+    // Visit all elements in the interval [min, max], a pair of segments at the time
+    virtual void scan(int64_t min, int64_t max, ::pma::Interface::ScanVisitor& visitor) const override;
+
     // Return an iterator over all elements of the PMA
     virtual std::unique_ptr<::pma::Iterator> iterator() const override;
 
@@ -164,6 +209,37 @@ public:
     // Whether to save segment statistics, at the end, in the table `btree_leaf_statistics' ?
     void set_record_segment_statistics(bool value);
 
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(::pma::StaticIndex::Layout layout);
+
+    // Set the max number of threads to use when spreading the elements of large windows (default: 1)
+    void set_spread_threads(size_t num_threads);
+
+    /**
+     * Enable or disable the concurrent readers. When enabled, the methods #find, #find_batch and #sum can be invoked by
+     * any number of threads, concurrently to a single writer performing inserts and removals. The readers do not take any
+     * latch, they validate their accesses through the version of each gate (group of segments) and retry on conflict.
+     * Iterators and scans are not supported by the concurrent readers. It must be set before starting the readers.
+     * The concurrent readers cannot be combined with the learned layout of the index, as the writer may refit its model
+     * while the readers are accessing it.
+     */
+    void set_concurrent_readers(bool value);
+
+    // Check whether the concurrent readers are enabled
+    bool has_concurrent_readers() const noexcept;
+
+    /**
+     * Save the content of the PMA into the given file, see pma::Snapshot for the format
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * Replace the content of the PMA with the snapshot in the given file, previously created with #save. The arrays
+     * are loaded as they are, without reinserting the elements. The snapshot must have been saved by a PMA with the
+     * same segment capacity. The settings of the PMA (knobs, index layout, threads) are not part of the snapshot.
+     */
+    void open(const std::string& path);
+
     // Accessor to the underlying memory pool
     CachedMemoryPool& memory_pool();
 
@@ -21,6 +21,8 @@
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "buffered_rewired_memory.hpp"
 #include "packed_memory_array.hpp"
@@ -208,33 +210,43 @@ void SpreadWithRewiring::move_current_partition_by(int64_t N){
  *                                                                           *
  *****************************************************************************/
 void SpreadWithRewiring::acquire_free_space(int64_t** space_keys, int64_t** space_values){
-    *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer();
-    *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
+    // acquire the buffers in the same direction of the spread
+    *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer(/* highest first ? */ true);
+    if(!m_instance.m_storage.m_key_only){
+        *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer(/* highest first ? */ true);
+    } else { // the values are an alias of the keys
+        *space_values = *space_keys;
+    }
 }
 
-void SpreadWithRewiring::rewire_keys(int64_t* addr1, int64_t* addr2){
-    m_instance.m_storage.m_memory_keys->swap_and_release(addr1, addr2);
-}
+void SpreadWithRewiring::rewire_ready_extents(){
+    if(m_extents_ready == 0) return; // nop
+    COUT_DEBUG("extents: " << m_extents_ready);
+
+    vector<pair<void*, void*>> keys, values;
+    keys.reserve(m_extents_ready);
+    values.reserve(m_extents_ready);
+    for(size_t i = 0; i < m_extents_ready; i++){
+        auto& metadata = m_extents_to_rewire[i];
+        keys.emplace_back(get_start_address(m_instance.m_storage.m_keys, metadata.m_extent_id), metadata.m_buffer_keys);
+        if(!m_instance.m_storage.m_key_only) values.emplace_back(get_start_address(m_instance.m_storage.m_values, metadata.m_extent_id), metadata.m_buffer_values);
+    }
+    m_extents_to_rewire.erase(m_extents_to_rewire.begin(), m_extents_to_rewire.begin() + m_extents_ready);
+    m_extents_ready = 0;
 
-void SpreadWithRewiring::rewire_values(int64_t* addr1, int64_t* addr2){
-    m_instance.m_storage.m_memory_values->swap_and_release(addr1, addr2);
+    m_instance.m_storage.m_memory_keys->swap_and_release(keys);
+    if(!m_instance.m_storage.m_key_only) m_instance.m_storage.m_memory_values->swap_and_release(values);
 }
 
 void SpreadWithRewiring::reclaim_past_extents(){
     int64_t current_extent_id = get_current_extent();
     COUT_DEBUG("current_extent_id: " << current_extent_id);
-    while(!m_extents_to_rewire.empty() && m_extents_to_rewire.front().m_extent_id > current_extent_id) {
-        auto& metadata = m_extents_to_rewire.front();
-        auto extent_id = metadata.m_extent_id;
-        auto keys_dst = get_start_address(m_instance.m_storage.m_keys, extent_id);
-        auto keys_src = metadata.m_buffer_keys;
-        auto values_dst = get_start_address(m_instance.m_storage.m_values, extent_id);
-        auto values_src = metadata.m_buffer_values;
-        m_extents_to_rewire.pop_front();
-        COUT_DEBUG("reclaim buffers for keys: " << keys_src << ", values: " << values_src);
-
-        rewire_keys(keys_dst, keys_src);
-        rewire_values(values_dst, values_src);
+    while(m_extents_ready < m_extents_to_rewire.size() && m_extents_to_rewire[m_extents_ready].m_extent_id > current_extent_id) {
+        m_extents_ready++;
+    }
+
+    if(m_extents_ready >= m_rewiring_batch_sz){
+        rewire_ready_extents();
     }
 }
 
@@ -301,7 +313,7 @@ void SpreadWithRewiring::spread_elements(int64_t* __restrict destination_keys, i
 
             } else { // use memcpy
                 memcpy(output_keys + output_copy_offset, input_keys + input_copy_offset, elements_to_copy * sizeof(output_keys[0]));
-                memcpy(output_values + output_copy_offset, input_values + input_copy_offset, elements_to_copy * sizeof(output_values[0]));
+                if(!m_instance.m_storage.m_key_only) memcpy(output_values + output_copy_offset, input_values + input_copy_offset, elements_to_copy * sizeof(output_values[0]));
                 output_copied = input_copied = elements_to_copy;
             }
             input_run_sz -= input_copied;
@@ -381,15 +393,16 @@ void SpreadWithRewiring::spread_window(){
     assert(m_window_length % m_segments_per_extent == 0 && "Not a multiple");
     assert(m_window_length / m_segments_per_extent > 0 && "Window too small");
     assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-    assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+    assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
 
     int64_t num_extents = m_window_length / m_segments_per_extent;
     for(int64_t i = num_extents -1; i>=0; i--){
         spread_extent(i);
     }
 
+    rewire_ready_extents(); // the remaining extents
     assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-    assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+    assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
 }
 
 
@@ -406,10 +419,11 @@ void SpreadWithRewiring::merge_to_insert(
     COUT_DEBUG("input_to_copy: " << input_to_copy << ", output_lhs_start: " << output_lhs_start << ", output_rhs_start: " << output_rhs_start << ", output_rhs_end: " << output_rhs_end);
 
     int64_t insert_position = -1;
+    const bool key_only = m_instance.m_storage.m_key_only; // skip the values, they are an alias of the keys
 
     if(input_to_copy == 0){ // this is the new minimum
         output_keys[0] = m_insert_key;
-        output_values[0] = m_insert_value;
+        if(!key_only) output_values[0] = m_insert_value;
         insert_position = 0;
     } else {
         assert(input_to_copy > 0);
@@ -417,21 +431,21 @@ void SpreadWithRewiring::merge_to_insert(
         while(j > 0 && input_keys[j -1] > m_insert_key){
             assert(j > 0 && "Underflow");
             output_keys[j] = input_keys[j -1];
-            output_values[j] = input_values[j -1];
+            if(!key_only) output_values[j] = input_values[j -1];
             COUT_DEBUG("[" << j << "] key: " << output_keys[j]);
             j--;
         }
 
         // insert the new element
         output_keys[j] = m_insert_key;
-        output_values[j] = m_insert_value;
+        if(!key_only) output_values[j] = m_insert_value;
         insert_position = j;
         j--;
 
         // finish with memcpy
         assert(j >= -1 && "Underflow");
         memcpy(output_keys, input_keys, (j+1) * sizeof(int64_t));
-        memcpy(output_values, input_values, (j+1) * sizeof(int64_t));
+        if(!key_only) memcpy(output_values, input_values, (j+1) * sizeof(int64_t));
     }
 
     COUT_DEBUG("insert_position: " << insert_position);
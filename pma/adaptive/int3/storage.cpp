@@ -18,12 +18,15 @@
 #include "storage.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include "buffered_rewired_memory.hpp"
 #include "miscellaneous.hpp"
+#include "pma/generic/segment_search.hpp"
 #include "rewired_memory.hpp"
 
 using namespace std;
@@ -49,7 +52,7 @@ namespace pma { namespace adaptive { namespace int3 {
  *                                                                           *
  *****************************************************************************/
 
-Storage::Storage(size_t segment_size, size_t pages_per_extent) : m_segment_capacity(hyperceil(segment_size)), m_pages_per_extent(pages_per_extent){
+Storage::Storage(size_t segment_size, size_t pages_per_extent, bool key_only) : m_segment_capacity(hyperceil(segment_size)), m_pages_per_extent(pages_per_extent), m_key_only(key_only){
     if(hyperceil(segment_size ) > numeric_limits<uint16_t>::max()) throw std::invalid_argument("segment size too big, maximum is " + std::to_string( numeric_limits<uint16_t>::max() ));
     if(m_segment_capacity < 32) throw std::invalid_argument("segment size too small, minimum is 32");
     if(hyperceil(m_pages_per_extent) != m_pages_per_extent) throw std::invalid_argument("pages per extent must be a value from a power of 2");
@@ -95,8 +98,12 @@ void Storage::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** val
 
         *rewired_memory_keys = new BufferedRewiredMemory(m_pages_per_extent, elts_num_extents);
         *keys = (int64_t*) (*rewired_memory_keys)->get_start_address();
-        *rewired_memory_values = new BufferedRewiredMemory(m_pages_per_extent, elts_num_extents);
-        *values = (int64_t*) (*rewired_memory_values)->get_start_address();
+        if(!m_key_only){
+            *rewired_memory_values = new BufferedRewiredMemory(m_pages_per_extent, elts_num_extents);
+            *values = (int64_t*) (*rewired_memory_values)->get_start_address();
+        } else {
+            *values = *keys;
+        }
         *rewired_memory_cardinalities = new RewiredMemory(m_pages_per_extent, card_num_extents, (*rewired_memory_keys)->get_max_memory() * sizeof(uint16_t) / sizeof(int64_t));
         *sizes = (uint16_t*) (*rewired_memory_cardinalities)->get_start_address();
     } else {
@@ -108,10 +115,14 @@ void Storage::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** val
             RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
                     "Requested size: " << elts_space_required_bytes);
         }
-        rc = posix_memalign((void**) values, /* alignment */ 64,  /* size */ elts_space_required_bytes);
-        if(rc != 0) {
-            RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
-                    "Requested size: " << elts_space_required_bytes);
+        if(!m_key_only){
+            rc = posix_memalign((void**) values, /* alignment */ 64,  /* size */ elts_space_required_bytes);
+            if(rc != 0) {
+                RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
+                        "Requested size: " << elts_space_required_bytes);
+            }
+        } else {
+            *values = *keys;
         }
 
         rc = posix_memalign((void**) sizes, /* alignment */ 64,  /* size */ card_space_required_bytes);
@@ -131,7 +142,7 @@ void Storage::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** val
 void Storage::extend(size_t num_segments_to_add){
     COUT_DEBUG("num_segments_to_add: " << num_segments_to_add << ", page size: " << get_memory_page_size());
     assert(m_memory_keys != nullptr);
-    assert(m_memory_values != nullptr);
+    assert((m_key_only || m_memory_values != nullptr));
     assert(m_memory_sizes != nullptr);
 
     const size_t bytes_per_segment = m_segment_capacity * sizeof(m_keys[0]);
@@ -163,14 +174,14 @@ void Storage::extend(size_t num_segments_to_add){
 
     if (elts_num_extents_required > 0){
         m_memory_keys->extend(elts_num_extents_required);
-        m_memory_values->extend(elts_num_extents_required);
+        if(!m_key_only) m_memory_values->extend(elts_num_extents_required);
     }
     if(sizes_num_extents_required > 0){
         m_memory_sizes->extend(sizes_num_extents_required);
     }
 
     m_keys = (int64_t*) m_memory_keys->get_start_address();
-    m_values = (int64_t*) m_memory_values->get_start_address();
+    m_values = m_key_only ? m_keys : (int64_t*) m_memory_values->get_start_address();
     m_segment_sizes = (uint16_t*) m_memory_sizes->get_start_address();
 
     // update the properties
@@ -182,7 +193,7 @@ void Storage::shrink(size_t num_segments_to_remove){
     if(num_segments_to_remove == 0) return; // nop
 
     assert(m_memory_keys != nullptr);
-    assert(m_memory_values != nullptr);
+    assert((m_key_only || m_memory_values != nullptr));
     assert(m_memory_sizes != nullptr);
     assert(num_segments_to_remove % get_segments_per_extent() == 0 && "The number of segments to remove must be a multiple of segments per page");
 
@@ -197,16 +208,22 @@ void Storage::shrink(size_t num_segments_to_remove){
 
     if (elts_num_extents_to_release > 0){
         m_memory_keys->shrink(elts_num_extents_to_release);
-        m_memory_values->shrink(elts_num_extents_to_release);
+        if(!m_key_only) m_memory_values->shrink(elts_num_extents_to_release);
     }
 
-    // we cannot shrink the array sizes
+    // release the extents of the cardinalities no longer needed
+    const size_t sizes_total_bytes = num_segments_after * sizeof(m_segment_sizes[0]);
+    const size_t sizes_num_extents_after = max<size_t>(1, (sizes_total_bytes + m_memory_sizes->get_extent_size() -1) / m_memory_sizes->get_extent_size()); // round up
+    if(m_memory_sizes->get_allocated_extents() > sizes_num_extents_after){
+        m_memory_sizes->shrink(m_memory_sizes->get_allocated_extents() - sizes_num_extents_after);
+    }
 
     // update the properties
     m_number_segments = num_segments_after;
 }
 
 void Storage::dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities){
+    if(*values == *keys){ *values = nullptr; } // key-only mode, the values are an alias of the keys
     if(*rewired_memory_keys != nullptr){
         *keys = nullptr;
          delete *rewired_memory_keys; *rewired_memory_keys = nullptr;
@@ -272,7 +289,7 @@ int64_t Storage::get_minimum(size_t segment_id) const noexcept {
 
 size_t Storage::memory_footprint() const noexcept {
     size_t memory_keys = m_memory_keys != nullptr ? m_memory_keys->get_allocated_memory_size() : capacity() * sizeof(m_keys[0]);
-    size_t memory_values = m_memory_values != nullptr ? m_memory_values->get_allocated_memory_size() : capacity() * sizeof(m_values[0]);
+    size_t memory_values = m_key_only ? 0 : m_memory_values != nullptr ? m_memory_values->get_allocated_memory_size() : capacity() * sizeof(m_values[0]);
     size_t memory_sizes = m_memory_sizes != nullptr ? m_memory_sizes->get_allocated_memory_size() : capacity() * sizeof(m_segment_sizes[0]);
     return memory_keys + memory_values + memory_sizes;
 }
@@ -294,20 +311,16 @@ bool Storage::insert(size_t segment_id, int64_t key, int64_t value, int64_t* out
     if(segment_id % 2 == 0){ // for even segment ids (0, 2, ...), insert at the end of the segment
         size_t stop = m_segment_capacity -1;
         size_t start = m_segment_capacity - sz -1;
-        size_t i = start;
-
-        while(i < stop && keys[i+1] < key){
-            keys[i] = keys[i+1];
-            i++;
-        }
+        size_t num_lesser = segment_lower_bound(keys + start +1, sz, key);
+        size_t i = start + num_lesser;
 
 //        COUT_DEBUG("(even) segment_id: " << segment_id << ", start: " << start << ", stop: " << stop << ", key: " << key << ", value: " << value << ", position: " << i);
+        memmove(keys + start, keys + start +1, num_lesser * sizeof(keys[0]));
         keys[i] = key;
-
-        for(size_t j = start; j < i; j++){
-            values[j] = values[j+1];
+        if(!m_key_only){
+            memmove(values + start, values + start +1, num_lesser * sizeof(values[0]));
+            values[i] = value;
         }
-        values[i] = value;
 
         minimum = (i == start);
         bool maximum = (i == stop);
@@ -316,19 +329,15 @@ bool Storage::insert(size_t segment_id, int64_t key, int64_t value, int64_t* out
         if(out_predecessor) { *out_predecessor = minimum ? std::numeric_limits<int64_t>::min() : keys[i -1]; }
         if(out_successor) { *out_successor = maximum ? std::numeric_limits<int64_t>::max() : keys[i +1]; }
     } else { // for odd segment ids (1, 3, ...), insert at the front of the segment
-        size_t i = sz;
-        while(i > 0 && keys[i-1] > key){
-            keys[i] = keys[i-1];
-            i--;
-        }
+        size_t i = segment_upper_bound(keys, sz, key);
 
 //        COUT_DEBUG("(odd) segment_id: " << segment_id << ", key: " << key << ", value: " << value << ", position: " << i);
+        memmove(keys + i +1, keys + i, (sz - i) * sizeof(keys[0]));
         keys[i] = key;
-
-        for(size_t j = sz; j > i; j--){
-            values[j] = values[j-1];
+        if(!m_key_only){
+            memmove(values + i +1, values + i, (sz - i) * sizeof(values[0]));
+            values[i] = value;
         }
-        values[i] = value;
 
         minimum = (i == 0);
         bool maximum = (i == sz);
@@ -345,4 +354,70 @@ bool Storage::insert(size_t segment_id, int64_t key, int64_t value, int64_t* out
     return minimum;
 }
 
+bool Storage::insert_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* elements, size_t num_elements, int64_t* out_predecessor, int64_t* out_successor) noexcept {
+    assert(num_elements > 0 && "No elements to insert");
+    assert(m_segment_sizes[segment_id] + num_elements <= m_segment_capacity && "The segment does not have enough room");
+
+    int64_t* __restrict keys = m_keys + segment_id * m_segment_capacity;
+    int64_t* __restrict values = m_values + segment_id * m_segment_capacity;
+    const std::pair<int64_t, int64_t>* __restrict E = elements;
+    const int64_t first = E[0].first;
+    const size_t sz = m_segment_sizes[segment_id];
+    bool minimum = false; // the first inserted key is the new minimum ?
+    int64_t predecessor = std::numeric_limits<int64_t>::min(); // for the detector
+    int64_t successor = std::numeric_limits<int64_t>::max(); // for the detector
+
+    if(segment_id % 2 == 0){ // for even segment ids (0, 2, ...), the elements are at the end of the segment
+        // merge forwards, the new elements are placed before the existing duplicates
+        const size_t stop = m_segment_capacity;
+        size_t input = m_segment_capacity - sz;
+        size_t output = input - num_elements;
+        minimum = (sz == 0) || (first <= keys[input]);
+
+        for(size_t j = 0; j < num_elements; output++){
+            if(input < stop && keys[input] < E[j].first){
+                keys[output] = keys[input];
+                if(!m_key_only) values[output] = values[input];
+                input++;
+            } else {
+                if(j == 0 && output > m_segment_capacity - sz - num_elements){ predecessor = keys[output -1]; }
+                keys[output] = E[j].first;
+                if(!m_key_only) values[output] = E[j].second;
+                j++;
+            }
+        }
+        if(input < stop){ successor = keys[input]; }
+        assert(output == input && "The remaining existing elements are already in place");
+    } else { // for odd segment ids (1, 3, ...), the elements are at the start of the segment
+        // merge backwards, the new elements are placed after the existing duplicates
+        int64_t input = static_cast<int64_t>(sz) -1;
+        int64_t output = sz + num_elements -1;
+        minimum = (sz == 0) || (first < keys[0]);
+
+        for(int64_t j = num_elements -1; j >= 0; output--){
+            if(input >= 0 && keys[input] > E[j].first){
+                keys[output] = keys[input];
+                if(!m_key_only) values[output] = values[input];
+                input--;
+            } else {
+                if(j == static_cast<int64_t>(num_elements) -1 && output < static_cast<int64_t>(sz + num_elements) -1){ successor = keys[output +1]; }
+                keys[output] = E[j].first;
+                if(!m_key_only) values[output] = E[j].second;
+                j--;
+            }
+        }
+        if(input >= 0){ predecessor = keys[input]; }
+        assert(output == input && "The remaining existing elements are already in place");
+    }
+
+    if(out_predecessor) { *out_predecessor = predecessor; }
+    if(out_successor) { *out_successor = successor; }
+
+    // update the cardinality
+    m_segment_sizes[segment_id] += num_elements;
+    m_cardinality += num_elements;
+
+    return minimum;
+}
+
 }}} // pma::adaptive::int3
@@ -20,6 +20,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 
 // forward declarations
 class BufferedRewiredMemory;
@@ -29,18 +30,24 @@ namespace pma { namespace adaptive { namespace int3 {
 
 struct Storage {
     int64_t* m_keys; // pma for the keys
-    int64_t* m_values; // pma for the values
+    int64_t* m_values; // pma for the values. In the key-only mode, it is an alias of m_keys
     uint16_t* m_segment_sizes; // array, containing the cardinalities of each segment
     const uint16_t m_segment_capacity; // the max number of elements in a segment
-    uint32_t m_cardinality; // the number of elements contained
-    uint32_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
+    uint64_t m_cardinality; // the number of elements contained
+    uint64_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
     const size_t m_pages_per_extent; // number of virtual pages per extent, used in the RewiredMemory
+    const bool m_key_only; // whether only the keys are stored, without the array for the values
     BufferedRewiredMemory* m_memory_keys = nullptr; // memory space used for the keys
     BufferedRewiredMemory* m_memory_values = nullptr; // memory space used for the values
     RewiredMemory* m_memory_sizes = nullptr; // memory space used for the segment cardinalities
 
 public:
-    Storage(uint64_t segment_size, uint64_t pages_per_extents);
+    /**
+     * Init the storage. In the key-only mode, the array for the values is not allocated: m_values becomes an alias
+     * of m_keys, so that the value associated to each element is its own key. The writers must skip the updates
+     * to the values in this mode.
+     */
+    Storage(uint64_t segment_size, uint64_t pages_per_extents, bool key_only = false);
 
     ~Storage();
 
@@ -70,6 +77,13 @@ public:
      */
     bool insert(size_t segment_id, int64_t key, int64_t value, int64_t* out_predecessor = nullptr, int64_t* out_successor = nullptr) noexcept;
 
+    /**
+     * Merge the given sorted sequence of elements in the segment. Return true if the first element becomes the new minimum of the segment.
+     * Optionally report the predecessor of the first element and the successor of the last element inserted.
+     * Precondition: the segment has room for all the elements
+     */
+    bool insert_sorted(size_t segment_id, const std::pair<int64_t, int64_t>* elements, size_t num_elements, int64_t* out_predecessor = nullptr, int64_t* out_successor = nullptr) noexcept;
+
     /**
      * Retrieve the number of segments per extent
      */
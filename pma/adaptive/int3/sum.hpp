@@ -25,6 +25,8 @@ namespace pma { namespace adaptive { namespace int3 {
 
 ::pma::Interface::SumResult do_sum(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t key_min, int64_t key_max);
 
+void do_scan(const Storage& storage, int64_t segment_start, int64_t segment_end, int64_t key_min, int64_t key_max, ::pma::Interface::ScanVisitor& visitor);
+
 }}} // pma::adaptive::int3
 
 #endif /* PMA_ADAPTIVE_INT3_SUM_HPP_ */
@@ -30,10 +30,10 @@ namespace pma { namespace adaptive { namespace int3 {
 class PackedMemoryArray;
 
 struct Interval {
-    uint32_t m_start;
+    uint64_t m_start;
     uint16_t m_length;
     int16_t m_weight;
-    int32_t m_associated_segment;
+    int64_t m_associated_segment;
 
     // do not bother with the exact type of numerics
     template <typename T1, typename T2, typename T3, typename T4>
@@ -62,7 +62,7 @@ private:
     // intermediate information
     int64_t* m_timestamps = nullptr;
     int64_t m_timestamps_length = 0;
-    int32_t* m_prefix_sum_cardinalities = nullptr;
+    int64_t* m_prefix_sum_cardinalities = nullptr;
 
     bool m_output_released = false; // already returned the vector of intervals (a call to ::release())
     VectorOfIntervals m_output; // output
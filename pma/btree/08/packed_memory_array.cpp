@@ -100,6 +100,10 @@ size_t PackedMemoryArray8::memory_footprint() const {
     return sizeof(PackedMemoryArray8) + m_index.memory_footprint() + m_storage.memory_footprint();
 }
 
+void PackedMemoryArray8::set_index_layout(StaticIndex::Layout layout) {
+    m_index.set_layout(layout);
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Insert                                                                  *
@@ -280,7 +284,7 @@ void PackedMemoryArray8::rebalance_find_window(size_t segment_id, bool is_insert
 
             // re-align the calibrator tree
             if(window_end > m_storage.m_number_segments){
-                int offset = window_end - m_storage.m_number_segments;
+                int64_t offset = window_end - m_storage.m_number_segments;
                 window_start -= offset;
                 window_end -= offset;
             }
@@ -128,6 +128,9 @@ public:
     // Dump the content of the data structure to stdout (for debugging purposes)
     virtual void dump() const override;
 
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(StaticIndex::Layout layout);
+
     // Memory footprint
     virtual size_t memory_footprint() const override;
 };
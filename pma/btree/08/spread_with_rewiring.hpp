@@ -44,6 +44,8 @@ class SpreadWithRewiring {
     int64_t m_position = -1; // current position in the source segment
     struct Extent2Rewire{ int64_t m_extent_id; int64_t* m_buffer_keys; int64_t* m_buffer_values; };
     std::deque<Extent2Rewire> m_extents_to_rewire; // a list of extents to be rewired
+    size_t m_extents_ready = 0; // the first extents in m_extents_to_rewire whose content has already been spread, ready to be rewired
+    constexpr static size_t m_rewiring_batch_sz = 64; // the number of ready extents to accumulate before rewiring them in a single batch
 
     size_t get_segment_capacity() const; // the capacity of a single segment, in terms of number of elements
     int64_t position2segment(int64_t position) const;
@@ -53,8 +55,7 @@ class SpreadWithRewiring {
     size_t get_offset(int64_t relative_extent_id) const;
     int64_t* get_start_address(int64_t* array, int64_t relative_extent_id) const;
     void acquire_free_space(int64_t** space_keys, int64_t** space_values);
-    void rewire_keys(int64_t* addr1, int64_t* addr2);
-    void rewire_values(int64_t* addr1, int64_t* addr2);
+    void rewire_ready_extents();
     void reclaim_past_extents();
     void spread_elements(int64_t* __restrict destination_keys, int64_t* __restrict destination_values, size_t extent_id, size_t num_elements);
     void spread_extent(int64_t extent_id, size_t num_elements);
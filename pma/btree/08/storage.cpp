@@ -200,7 +200,12 @@ void Storage::shrink(size_t num_segments_to_remove){
         m_memory_values->shrink(elts_num_extents_to_release);
     }
 
-    // we cannot shrink the array sizes
+    // release the extents of the cardinalities no longer needed
+    const size_t sizes_total_bytes = num_segments_after * sizeof(m_segment_sizes[0]);
+    const size_t sizes_num_extents_after = max<size_t>(1, (sizes_total_bytes + m_memory_sizes->get_extent_size() -1) / m_memory_sizes->get_extent_size()); // round up
+    if(m_memory_sizes->get_allocated_extents() > sizes_num_extents_after){
+        m_memory_sizes->shrink(m_memory_sizes->get_allocated_extents() - sizes_num_extents_after);
+    }
 
     // update the properties
     m_number_segments = num_segments_after;
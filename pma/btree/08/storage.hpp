@@ -41,8 +41,8 @@ class Storage {
     int64_t* m_values; // pma for the values
     uint16_t* m_segment_sizes; // array, containing the cardinalities of each segment
     const uint16_t m_segment_capacity; // the max number of elements in a segment
-    uint32_t m_cardinality; // the number of elements contained
-    uint32_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
+    uint64_t m_cardinality; // the number of elements contained
+    uint64_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
     const size_t m_pages_per_extent; // number of virtual pages per extent, used in the RewiredMemory
     BufferedRewiredMemory* m_memory_keys = nullptr; // memory space used for the keys
     BufferedRewiredMemory* m_memory_values = nullptr; // memory space used for the values
@@ -0,0 +1,401 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "adapter.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "pma/generic/segment_search.hpp" // segment_sum
+
+using namespace std;
+
+namespace pma { namespace v10 {
+
+// the domain of the keys of type K, as int64_t. The composite keys cover the whole domain of int64_t
+template<typename K>
+static constexpr int64_t domain_min() noexcept {
+    if constexpr (std::is_same_v<K, CompositeKey32> || std::is_same_v<K, int64_t>){
+        return numeric_limits<int64_t>::min();
+    } else {
+        return std::is_unsigned_v<K> ? 0 : static_cast<int64_t>(numeric_limits<K>::min());
+    }
+}
+template<typename K>
+static constexpr int64_t domain_max() noexcept {
+    if constexpr (sizeof(K) >= sizeof(int64_t)){
+        return numeric_limits<int64_t>::max();
+    } else {
+        return static_cast<int64_t>(numeric_limits<K>::max());
+    }
+}
+template<typename K>
+constexpr int64_t DOMAIN_MIN = domain_min<K>();
+template<typename K>
+constexpr int64_t DOMAIN_MAX = domain_max<K>();
+
+// convert a key of the interface, in the domain of K, to the type K
+template<typename K>
+static K to_key(int64_t key) noexcept {
+    if constexpr (std::is_same_v<K, CompositeKey32>){
+        return CompositeKey32{ static_cast<int32_t>(key >> 32), static_cast<uint32_t>(key) };
+    } else {
+        return static_cast<K>(key);
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Adapter                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K>
+PackedMemoryArray10<K>::PackedMemoryArray10(size_t segment_capacity, size_t index_B) : m_pma(segment_capacity, index_B) { }
+
+template<typename K>
+PackedMemoryArray10<K>::~PackedMemoryArray10() { }
+
+template<typename K>
+bool PackedMemoryArray10<K>::is_representable(int64_t key) noexcept {
+    return DOMAIN_MIN<K> <= key && key <= DOMAIN_MAX<K>;
+}
+
+template<typename K>
+K PackedMemoryArray10<K>::clamp(int64_t key) noexcept {
+    return to_key<K>(std::min(std::max(key, DOMAIN_MIN<K>), DOMAIN_MAX<K>));
+}
+
+template<typename K>
+int64_t PackedMemoryArray10<K>::to_int64(const K& key) noexcept {
+    if constexpr (std::is_same_v<K, CompositeKey32>){
+        return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(key.m_high)) << 32) | key.m_low);
+    } else {
+        return static_cast<int64_t>(key);
+    }
+}
+
+template<typename K>
+void PackedMemoryArray10<K>::insert(int64_t key, int64_t value){
+    if(!is_representable(key)){ throw std::invalid_argument("The key " + to_string(key) + " is out of the domain of the keys of " + to_string(sizeof(K)) + " bytes"); }
+    m_pma.insert(to_key<K>(key), value);
+}
+
+template<typename K>
+int64_t PackedMemoryArray10<K>::remove(int64_t key){
+    int64_t value = -1;
+    if(is_representable(key)){ m_pma.remove(to_key<K>(key), &value); }
+    return value;
+}
+
+template<typename K>
+int64_t PackedMemoryArray10<K>::find(int64_t key) const {
+    int64_t value = -1;
+    if(is_representable(key)){ m_pma.find(to_key<K>(key), &value); }
+    return value;
+}
+
+template<typename K>
+unique_ptr<pma::Iterator> PackedMemoryArray10<K>::iterator() const {
+    return make_unique<Iterator>(m_pma);
+}
+
+template<typename K>
+pma::Interface::SumResult PackedMemoryArray10<K>::sum(int64_t min, int64_t max) const {
+    SumResult sum;
+    pma::scan(*this, min, max, [&sum](const int64_t* keys, const int64_t* values, size_t length){
+        if(sum.m_num_elements == 0) sum.m_first_key = keys[0];
+        sum.m_last_key = keys[length -1];
+        sum.m_num_elements += length;
+        segment_sum(keys, values, length, &sum.m_sum_keys, &sum.m_sum_values);
+        return true;
+    });
+    return sum;
+}
+
+template<typename K>
+void PackedMemoryArray10<K>::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    if(min > max || max < DOMAIN_MIN<K> || min > DOMAIN_MAX<K>) return;
+
+    if constexpr (std::is_same_v<K, int64_t>){
+        m_pma.scan(min, max, [&visitor](const int64_t* keys, const int64_t* values, size_t length){
+            return visitor.visit(keys, values, length);
+        });
+    } else { // convert the keys of each run, spanning up to two clustered segments
+        unique_ptr<int64_t[]> workspace { new int64_t[2 * m_pma.get_segment_capacity()] };
+        m_pma.scan(clamp(min), clamp(max), [&visitor, &workspace](const K* keys, const int64_t* values, size_t length){
+            for(size_t i = 0; i < length; i++){ workspace[i] = to_int64(keys[i]); }
+            return visitor.visit(workspace.get(), values, length);
+        });
+    }
+}
+
+template<typename K>
+size_t PackedMemoryArray10<K>::size() const {
+    return m_pma.size();
+}
+
+template<typename K>
+size_t PackedMemoryArray10<K>::memory_footprint() const {
+    return sizeof(*this) - sizeof(m_pma) + m_pma.memory_footprint();
+}
+
+template<typename K>
+void PackedMemoryArray10<K>::dump() const {
+    m_pma.dump(cout);
+}
+
+template<typename K>
+void PackedMemoryArray10<K>::set_index_layout(StaticIndex::Layout layout){
+    m_pma.set_index_layout(layout);
+}
+
+template<typename K>
+const PackedMemoryArray<K, int64_t>& PackedMemoryArray10<K>::pma() const noexcept {
+    return m_pma;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Iterator                                                                *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K>
+PackedMemoryArray10<K>::Iterator::Iterator(const PackedMemoryArray<K, int64_t>& pma) : m_pma(pma) {
+    if constexpr (!std::is_same_v<K, int64_t>){
+        m_buffers[0].reset(new int64_t[pma.get_segment_capacity()]);
+        m_buffers[1].reset(new int64_t[pma.get_segment_capacity()]);
+    }
+    if(!pma.empty()) next_segment();
+}
+
+template<typename K>
+void PackedMemoryArray10<K>::Iterator::next_segment(){
+    assert(m_offset >= m_stop);
+    const K* keys { nullptr };
+    size_t size = 0;
+    while(m_next_segment < m_pma.get_number_segments() && (size = m_pma.get_segment(m_next_segment, &keys, &m_values)) == 0){ m_next_segment++; }
+    if(size == 0) return; // depleted
+
+    if constexpr (std::is_same_v<K, int64_t>){
+        m_keys = keys;
+    } else {
+        m_current_buffer = 1 - m_current_buffer;
+        int64_t* buffer = m_buffers[m_current_buffer].get();
+        for(size_t i = 0; i < size; i++){ buffer[i] = to_int64(keys[i]); }
+        m_keys = buffer;
+    }
+    m_offset = 0;
+    m_stop = size;
+    m_next_segment++;
+}
+
+template<typename K>
+bool PackedMemoryArray10<K>::Iterator::hasNext() const {
+    return m_offset < m_stop;
+}
+
+template<typename K>
+std::pair<int64_t, int64_t> PackedMemoryArray10<K>::Iterator::next() {
+    pair<int64_t, int64_t> result { m_keys[m_offset], m_values[m_offset] };
+
+    m_offset++;
+    if(m_offset >= m_stop) next_segment();
+
+    return result;
+}
+
+template<typename K>
+size_t PackedMemoryArray10<K>::Iterator::next_block(const int64_t** out_keys, const int64_t** out_values){
+    assert(out_keys != nullptr && out_values != nullptr);
+    if(!hasNext()) return 0;
+
+    size_t length = m_stop - m_offset;
+    *out_keys = m_keys + m_offset;
+    *out_values = m_values + m_offset;
+
+    m_offset = m_stop;
+    next_segment();
+
+    return length;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Variable length payloads                                                *
+ *                                                                           *
+ *****************************************************************************/
+VarlenPackedMemoryArray10::VarlenPackedMemoryArray10(size_t segment_capacity, size_t payload_size, size_t pages_per_extent, size_t index_B) :
+        m_pma(segment_capacity, pages_per_extent, index_B), m_payload_size(payload_size) {
+    if(payload_size < sizeof(int64_t)) throw std::invalid_argument("The payload size must be at least " + to_string(sizeof(int64_t)) + " bytes");
+    if(2 * payload_size - sizeof(int64_t) > ValueHeap::MAX_LENGTH) throw std::invalid_argument("The payload size is too big, max: " + to_string((ValueHeap::MAX_LENGTH + sizeof(int64_t)) / 2) + " bytes");
+    m_payload.reset(new char[2 * payload_size]);
+    memset(m_payload.get(), '#', 2 * payload_size);
+}
+
+VarlenPackedMemoryArray10::~VarlenPackedMemoryArray10() { }
+
+size_t VarlenPackedMemoryArray10::get_payload_length(int64_t key) const noexcept {
+    const uint64_t hash = (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32; // Fibonacci hashing
+    return sizeof(int64_t) + hash % (2 * (m_payload_size - sizeof(int64_t)) +1);
+}
+
+int64_t VarlenPackedMemoryArray10::get_value(std::string_view payload) noexcept {
+    assert(payload.size() >= sizeof(int64_t));
+    int64_t value;
+    memcpy(&value, payload.data(), sizeof(value));
+    return value;
+}
+
+void VarlenPackedMemoryArray10::insert(int64_t key, int64_t value){
+    memcpy(m_payload.get(), &value, sizeof(value));
+    m_pma.insert(key, m_payload.get(), get_payload_length(key));
+}
+
+int64_t VarlenPackedMemoryArray10::remove(int64_t key){
+    string_view payload;
+    if(!m_pma.find(key, &payload)) return -1;
+    int64_t value = get_value(payload);
+    m_pma.remove(key);
+    return value;
+}
+
+int64_t VarlenPackedMemoryArray10::find(int64_t key) const {
+    string_view payload;
+    return m_pma.find(key, &payload) ? get_value(payload) : -1;
+}
+
+unique_ptr<pma::Iterator> VarlenPackedMemoryArray10::iterator() const {
+    return make_unique<Iterator>(m_pma);
+}
+
+pma::Interface::SumResult VarlenPackedMemoryArray10::sum(int64_t min, int64_t max) const {
+    SumResult sum;
+    pma::scan(*this, min, max, [&sum](const int64_t* keys, const int64_t* values, size_t length){
+        if(sum.m_num_elements == 0) sum.m_first_key = keys[0];
+        sum.m_last_key = keys[length -1];
+        sum.m_num_elements += length;
+        segment_sum(keys, values, length, &sum.m_sum_keys, &sum.m_sum_values);
+        return true;
+    });
+    return sum;
+}
+
+void VarlenPackedMemoryArray10::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    const size_t capacity = m_pma.pma().get_segment_capacity();
+    unique_ptr<int64_t[]> keys { new int64_t[capacity] };
+    unique_ptr<int64_t[]> values { new int64_t[capacity] };
+    size_t length = 0;
+    bool stop = false;
+
+    m_pma.scan(min, max, [&](int64_t key, string_view payload){
+        keys[length] = key;
+        values[length] = get_value(payload);
+        length++;
+        if(length == capacity){
+            stop = !visitor.visit(keys.get(), values.get(), length);
+            length = 0;
+        }
+        return !stop;
+    });
+
+    if(!stop && length > 0){ visitor.visit(keys.get(), values.get(), length); }
+}
+
+size_t VarlenPackedMemoryArray10::size() const {
+    return m_pma.size();
+}
+
+size_t VarlenPackedMemoryArray10::memory_footprint() const {
+    return sizeof(*this) - sizeof(m_pma) + m_pma.memory_footprint() + 2 * m_payload_size;
+}
+
+void VarlenPackedMemoryArray10::dump() const {
+    m_pma.dump(cout);
+}
+
+void VarlenPackedMemoryArray10::set_index_layout(StaticIndex::Layout layout){
+    m_pma.set_index_layout(layout);
+}
+
+const VarlenPackedMemoryArray<int64_t>& VarlenPackedMemoryArray10::pma() const noexcept {
+    return m_pma;
+}
+
+VarlenPackedMemoryArray10::Iterator::Iterator(const VarlenPackedMemoryArray<int64_t>& pma) : m_pma(pma) {
+    m_buffers[0].reset(new int64_t[pma.pma().get_segment_capacity()]);
+    m_buffers[1].reset(new int64_t[pma.pma().get_segment_capacity()]);
+    if(!pma.empty()) next_segment();
+}
+
+void VarlenPackedMemoryArray10::Iterator::next_segment(){
+    assert(m_offset >= m_stop);
+    const ValueRef* refs { nullptr };
+    size_t size = 0;
+    while(m_next_segment < m_pma.pma().get_number_segments() && (size = m_pma.pma().get_segment(m_next_segment, &m_keys, &refs)) == 0){ m_next_segment++; }
+    if(size == 0) return; // depleted
+
+    m_current_buffer = 1 - m_current_buffer;
+    int64_t* buffer = m_buffers[m_current_buffer].get();
+    for(size_t i = 0; i < size; i++){ buffer[i] = get_value(m_pma.heap().get(refs[i])); }
+    m_values = buffer;
+    m_offset = 0;
+    m_stop = size;
+    m_next_segment++;
+}
+
+bool VarlenPackedMemoryArray10::Iterator::hasNext() const {
+    return m_offset < m_stop;
+}
+
+std::pair<int64_t, int64_t> VarlenPackedMemoryArray10::Iterator::next() {
+    pair<int64_t, int64_t> result { m_keys[m_offset], m_values[m_offset] };
+
+    m_offset++;
+    if(m_offset >= m_stop) next_segment();
+
+    return result;
+}
+
+size_t VarlenPackedMemoryArray10::Iterator::next_block(const int64_t** out_keys, const int64_t** out_values){
+    assert(out_keys != nullptr && out_values != nullptr);
+    if(!hasNext()) return 0;
+
+    size_t length = m_stop - m_offset;
+    *out_keys = m_keys + m_offset;
+    *out_values = m_values + m_offset;
+
+    m_offset = m_stop;
+    next_segment();
+
+    return length;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Instantiations                                                          *
+ *                                                                           *
+ *****************************************************************************/
+template class PackedMemoryArray10<uint32_t>;
+template class PackedMemoryArray10<uint64_t>;
+template class PackedMemoryArray10<int64_t>;
+template class PackedMemoryArray10<CompositeKey32>;
+
+}} // pma::v10
@@ -0,0 +1,211 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BTREE_10_ADAPTER_HPP_
+#define BTREE_10_ADAPTER_HPP_
+
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include "pma/interface.hpp"
+#include "pma/iterator.hpp"
+#include "packed_memory_array.hpp"
+#include "varlen_pma.hpp"
+
+namespace pma { namespace v10 {
+
+/**
+ * Composite key for the adapter: the 32 most significant bits of the keys of the interface, e.g. a tenant, and
+ * the 32 least significant bits, e.g. a timestamp. The lexicographic order of the pairs is the same of the keys.
+ */
+using CompositeKey32 = CompositeKey<int32_t, uint32_t>;
+
+/**
+ * Adapter of the templated PackedMemoryArray<K, int64_t> to the common Interface, for the integer keys of type K
+ * or the composite keys CompositeKey32. The keys given to the interface are converted to K and back to int64_t.
+ * The insertion of a key that cannot be represented by K is an error, while the lookups of such keys simply do
+ * not find anything.
+ *
+ * The adapter is instantiated in adapter.cpp for the keys of type uint32_t, uint64_t, int64_t and CompositeKey32.
+ */
+template<typename K>
+class PackedMemoryArray10 : public Interface {
+    static_assert(std::is_integral_v<K> || std::is_same_v<K, CompositeKey32>, "The adapter only supports integer keys and CompositeKey32");
+    PackedMemoryArray<K, int64_t> m_pma;
+
+    // Check whether the given key can be represented by the type K
+    static bool is_representable(int64_t key) noexcept;
+
+    // Convert the key to the type K, clamping it to the domain of K
+    static K clamp(int64_t key) noexcept;
+
+    // Convert the key back to the type of the interface
+    static int64_t to_int64(const K& key) noexcept;
+
+public:
+    /**
+     * Iterator over all elements of the adapter. For keys of type int64_t, the blocks point directly to the segments,
+     * otherwise the keys of each segment are converted into a buffer owned by the iterator.
+     */
+    class Iterator : public pma::Iterator {
+        const PackedMemoryArray<K, int64_t>& m_pma;
+        std::unique_ptr<int64_t[]> m_buffers[2]; // converted keys, used in turns
+        int m_current_buffer = 0; // the buffer of the current segment
+        const int64_t* m_keys = nullptr; // the keys of the current segment
+        const int64_t* m_values = nullptr; // the values of the current segment
+        size_t m_next_segment = 0; // the next segment to fetch
+        size_t m_offset = 0; // the position in the current segment
+        size_t m_stop = 0; // the number of elements in the current segment
+
+        void next_segment(); // fetch the next non empty segment
+
+    public:
+        Iterator(const PackedMemoryArray<K, int64_t>& pma);
+        virtual bool hasNext() const;
+        virtual std::pair<int64_t, int64_t> next();
+        virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values);
+    };
+
+    PackedMemoryArray10(size_t segment_capacity = 64, size_t index_B = 64);
+
+    virtual ~PackedMemoryArray10();
+
+    // Insert the given key/value
+    virtual void insert(int64_t key, int64_t value) override;
+
+    // Remove the given key from the data structure. Returns its value if found, otherwise -1.
+    virtual int64_t remove(int64_t key) override;
+
+    // Find the element with the given `key'. It returns its value if found, otherwise the value -1.
+    virtual int64_t find(int64_t key) const override;
+
+    // Return an iterator over all elements of the PMA
+    virtual std::unique_ptr<pma::Iterator> iterator() const override;
+
+    // Sum all elements in the interval [min, max]
+    virtual SumResult sum(int64_t min, int64_t max) const override;
+
+    // Visit all elements in the interval [min, max], a segment at the time
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+
+    // The number of elements stored
+    virtual size_t size() const override;
+
+    // Memory footprint
+    virtual size_t memory_footprint() const override;
+
+    // Dump the content of the data structure to stdout (for debugging purposes)
+    virtual void dump() const override;
+
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(StaticIndex::Layout layout);
+
+    // The underlying PMA
+    const PackedMemoryArray<K, int64_t>& pma() const noexcept;
+};
+
+/**
+ * Adapter of the VarlenPackedMemoryArray<int64_t> to the common Interface. Each value is stored as a variable length
+ * payload in the value heap: its 8 bytes, followed by a filler up to a length drawn from the key, in the interval
+ * [8, 2 * payload_size - 8]. The lookups and the scans read the value back from the first 8 bytes of the payload.
+ */
+class VarlenPackedMemoryArray10 : public Interface {
+    VarlenPackedMemoryArray<int64_t> m_pma;
+    const size_t m_payload_size; // the average length of the payloads, in bytes
+    std::unique_ptr<char[]> m_payload; // buffer to build the payload of a new element
+
+    // The length of the payload for the given key
+    size_t get_payload_length(int64_t key) const noexcept;
+
+    // Read the value stored in the given payload
+    static int64_t get_value(std::string_view payload) noexcept;
+
+public:
+    /**
+     * Iterator over all elements of the adapter. The values of each segment are read from the heap into a buffer
+     * owned by the iterator.
+     */
+    class Iterator : public pma::Iterator {
+        const VarlenPackedMemoryArray<int64_t>& m_pma;
+        std::unique_ptr<int64_t[]> m_buffers[2]; // values read from the heap, used in turns
+        int m_current_buffer = 0; // the buffer of the current segment
+        const int64_t* m_keys = nullptr; // the keys of the current segment
+        const int64_t* m_values = nullptr; // the values of the current segment
+        size_t m_next_segment = 0; // the next segment to fetch
+        size_t m_offset = 0; // the position in the current segment
+        size_t m_stop = 0; // the number of elements in the current segment
+
+        void next_segment(); // fetch the next non empty segment
+
+    public:
+        Iterator(const VarlenPackedMemoryArray<int64_t>& pma);
+        virtual bool hasNext() const;
+        virtual std::pair<int64_t, int64_t> next();
+        virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values);
+    };
+
+    /**
+     * Create an empty container, with the given capacity for each segment, the average length of the payloads in bytes,
+     * the size of an extent of the value heap in terms of virtual pages and the node size of the static index
+     */
+    VarlenPackedMemoryArray10(size_t segment_capacity = 64, size_t payload_size = 64, size_t pages_per_extent = 16, size_t index_B = 64);
+
+    virtual ~VarlenPackedMemoryArray10();
+
+    // Insert the given key/value
+    virtual void insert(int64_t key, int64_t value) override;
+
+    // Remove the given key from the data structure. Returns its value if found, otherwise -1.
+    virtual int64_t remove(int64_t key) override;
+
+    // Find the element with the given `key'. It returns its value if found, otherwise the value -1.
+    virtual int64_t find(int64_t key) const override;
+
+    // Return an iterator over all elements of the PMA
+    virtual std::unique_ptr<pma::Iterator> iterator() const override;
+
+    // Sum all elements in the interval [min, max]
+    virtual SumResult sum(int64_t min, int64_t max) const override;
+
+    // Visit all elements in the interval [min, max], in runs of up to a segment
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+
+    // The number of elements stored
+    virtual size_t size() const override;
+
+    // Memory footprint, including the value heap
+    virtual size_t memory_footprint() const override;
+
+    // Dump the content of the data structure to stdout (for debugging purposes)
+    virtual void dump() const override;
+
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(StaticIndex::Layout layout);
+
+    // The underlying PMA
+    const VarlenPackedMemoryArray<int64_t>& pma() const noexcept;
+};
+
+extern template class PackedMemoryArray10<uint32_t>;
+extern template class PackedMemoryArray10<uint64_t>;
+extern template class PackedMemoryArray10<int64_t>;
+extern template class PackedMemoryArray10<CompositeKey32>;
+
+}} // pma::v10
+
+#endif /* BTREE_10_ADAPTER_HPP_ */
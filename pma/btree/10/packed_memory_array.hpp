@@ -0,0 +1,824 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BTREE_10_PACKED_MEMORY_ARRAY_HPP_
+#define BTREE_10_PACKED_MEMORY_ARRAY_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib> // posix_memalign
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "memory_pool.hpp"
+#include "pma/density_bounds.hpp"
+#include "pma/generic/static_index.hpp"
+
+namespace pma { namespace v10 {
+
+/**
+ * A key made of two components, compared in lexicographic order, e.g. <tenant, timestamp>.
+ */
+template<typename H, typename L>
+struct CompositeKey {
+    H m_high; // the most significant component
+    L m_low; // the least significant component
+
+    bool operator<(const CompositeKey& other) const noexcept { return m_high < other.m_high || (!(other.m_high < m_high) && m_low < other.m_low); }
+    bool operator==(const CompositeKey& other) const noexcept { return !(*this < other) && !(other < *this); }
+    bool operator!=(const CompositeKey& other) const noexcept { return !(*this == other); }
+};
+
+template<typename H, typename L>
+std::ostream& operator<<(std::ostream& out, const CompositeKey<H, L>& key){
+    out << "(" << key.m_high << ", " << key.m_low << ")";
+    return out;
+}
+
+/**
+ * Order preserving projection of the keys of type K into int64_t, to store the separator keys in a StaticIndex:
+ * k1 < k2 implies project(k1) <= project(k2). The projection is injective (exact) for the integer keys and for
+ * the composite keys whose components, once concatenated, fit in 64 bits. For the larger composite keys, it only
+ * retains the most significant component, and the segments sharing the same projection are discriminated by
+ * comparing their minima.
+ *
+ * Define a specialisation to index other types of keys.
+ */
+template<typename K>
+struct KeyProjection {
+    static_assert(std::is_integral_v<K>, "Define a specialisation of KeyProjection for this type of keys");
+
+    // The number of significant bits of the projection
+    static constexpr int bits = sizeof(K) * 8;
+
+    // Whether distinct keys have distinct projections
+    static constexpr bool exact = true;
+
+    // Map the key into [0, 2^bits), preserving the order
+    static uint64_t to_unsigned(K key) noexcept {
+        if constexpr (std::is_signed_v<K>){
+            using U = std::make_unsigned_t<K>;
+            return static_cast<U>(static_cast<U>(key) ^ (static_cast<U>(1) << (bits -1)));
+        } else {
+            return static_cast<uint64_t>(key);
+        }
+    }
+
+    static int64_t project(K key) noexcept {
+        uint64_t value = to_unsigned(key);
+        return (bits == 64) ? static_cast<int64_t>(value ^ (1ull << 63)) : static_cast<int64_t>(value);
+    }
+};
+
+template<typename H, typename L>
+struct KeyProjection<CompositeKey<H, L>> {
+    static constexpr bool exact = KeyProjection<H>::exact && KeyProjection<L>::exact && KeyProjection<H>::bits + KeyProjection<L>::bits <= 64;
+    static constexpr int bits = exact ? KeyProjection<H>::bits + KeyProjection<L>::bits : KeyProjection<H>::bits;
+
+    static uint64_t to_unsigned(const CompositeKey<H, L>& key) noexcept {
+        if constexpr (exact){
+            return (KeyProjection<H>::to_unsigned(key.m_high) << KeyProjection<L>::bits) | KeyProjection<L>::to_unsigned(key.m_low);
+        } else {
+            return KeyProjection<H>::to_unsigned(key.m_high);
+        }
+    }
+
+    static int64_t project(const CompositeKey<H, L>& key) noexcept {
+        uint64_t value = to_unsigned(key);
+        return (bits == 64) ? static_cast<int64_t>(value ^ (1ull << 63)) : static_cast<int64_t>(value);
+    }
+};
+
+/**
+ * Clustered PMA for keys of type K and values of type V. Both types must be trivially copyable, as the elements
+ * are moved with memcpy, and the keys need to define a strict weak ordering through the operator < and a
+ * KeyProjection into int64_t.
+ *
+ * The keys and the values are stored in two separate arrays, split in segments of fixed capacity. As in btreecc_pma7,
+ * the segments are clustered in pairs: the elements of the even segments are stored at the end of the segment and
+ * those of the odd segments at the start, so that each pair forms a single run in memory. The separator keys are
+ * indexed by a StaticIndex, through their KeyProjection. The number of segments is always a power of 2: rebalances
+ * spread the elements of a window of segments, as determined by the density thresholds of the calibrator tree, and
+ * resizes rebuild the whole array.
+ *
+ * With smaller keys, a segment spans less cache lines, e.g. 32-bit keys double the number of keys in a cache line.
+ * The adapter to the common Interface, for integer keys and int64_t values, is the class PackedMemoryArray10 in
+ * pma/btree/10/adapter.hpp.
+ */
+template<typename K, typename V>
+class PackedMemoryArray {
+    static_assert(std::is_trivially_copyable_v<K>, "The keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable_v<V>, "The values must be trivially copyable");
+    PackedMemoryArray(const PackedMemoryArray&) = delete;
+    PackedMemoryArray& operator=(const PackedMemoryArray&) = delete;
+    using Projection = KeyProjection<K>;
+
+    const size_t m_segment_capacity; // the max number of elements in a segment
+    uint64_t m_cardinality = 0; // the number of elements contained
+    uint64_t m_number_segments = 0; // the number of segments, always a power of 2
+    K* m_keys = nullptr; // the keys, m_segment_capacity for each segment
+    V* m_values = nullptr; // the values, m_segment_capacity for each segment
+    uint16_t* m_sizes = nullptr; // the cardinality of each segment
+    StaticIndex m_index; // the projection of the minimum of each segment
+    CachedDensityBounds m_density_bounds;
+    CachedMemoryPool m_memory_pool;
+    std::function<void(const K*, V*, size_t, bool)> m_rebalance_listener; // invoked on the gathered elements, before they are spread
+
+    // Allocate/release the arrays for the given number of segments
+    void alloc_workspace(size_t num_segments, K** keys, V** values, uint16_t** sizes);
+    static void dealloc_workspace(K** keys, V** values, uint16_t** sizes);
+
+    // Whether the two keys are equal
+    static bool equal(const K& k1, const K& k2) noexcept;
+
+    // The position in m_keys and m_values of the first element of the given segment, holding `size' elements
+    size_t get_offset(size_t segment_id, size_t size) const noexcept;
+
+    // The minimum of the given (non empty) segment
+    const K& get_minimum(size_t segment_id) const noexcept;
+
+    // Find the last segment whose minimum is less or equal (include_equal = true) or strictly less (include_equal = false)
+    // than the given key, or the first segment if there is none. With include_equal, it is the segment where the key
+    // should be stored, otherwise it is the first segment that may contain the key, in case of duplicates.
+    template<bool include_equal> size_t find_segment(const K& key) const noexcept;
+
+    // Position of the first key in the segment that is not less than the given key, relative to the segment offset
+    size_t segment_lower_bound(size_t segment_id, const K& key) const noexcept;
+
+    // Position of the first key in the segment that is greater than the given key, relative to the segment offset
+    size_t segment_upper_bound(size_t segment_id, const K& key) const noexcept;
+
+    // Insert the first element in the (empty) container
+    void insert_empty(const K& key, const V& value);
+
+    // Insert the element in the given segment, which must not be full. Return true if the element is the new minimum of the segment
+    bool storage_insert(size_t segment_id, const K& key, const V& value);
+
+    // Determine the window to rebalance, according to the density thresholds
+    void rebalance_find_window(size_t segment_id, bool is_insert, size_t* out_window_start, size_t* out_window_length, bool* out_resize) const;
+
+    // Rebalance the storage so that the density thresholds are ensured, optionally inserting a new element
+    void rebalance(size_t segment_id, const K* insert_key, const V* insert_value);
+
+    // Copy the elements of the window, and the element to insert, into the given arrays. Return the number of elements copied.
+    size_t gather(size_t window_start, size_t window_length, const K* insert_key, const V* insert_value, K* out_keys, V* out_values) const;
+
+    // Invoke the rebalance listener, if set, on the elements about to be spread
+    void notify_rebalance(const K* keys, V* values, size_t cardinality, bool is_resize);
+
+    // Evenly spread the given elements in the segments of the window
+    void spread(size_t window_start, size_t window_length, const K* keys, const V* values, size_t cardinality);
+
+    // Rebuild the storage with `num_segments' segments, optionally inserting a new element
+    void resize(size_t num_segments, const K* insert_key, const V* insert_value);
+
+    // Retrieve the height of the calibrator tree
+    int height() const noexcept;
+
+public:
+    /**
+     * Create an empty PMA, with the given capacity for each segment and the given node size for the static index
+     */
+    PackedMemoryArray(size_t segment_capacity = 64, size_t index_B = 64);
+
+    /**
+     * Create an empty PMA, with the given capacity for each segment and explicit density thresholds, rather than
+     * those set in the configuration
+     */
+    PackedMemoryArray(size_t segment_capacity, const CachedDensityBounds& density_bounds, size_t index_B = 64);
+
+    /**
+     * Destructor
+     */
+    ~PackedMemoryArray();
+
+    /**
+     * Insert the given key/value. Duplicate keys are allowed.
+     */
+    void insert(const K& key, const V& value);
+
+    /**
+     * Remove one element with the given key. If found, it returns true and stores its value in `out_value', if not null.
+     */
+    bool remove(const K& key, V* out_value = nullptr);
+
+    /**
+     * Find one element with the given key. If found, it returns true and stores its value in `out_value', if not null.
+     */
+    bool find(const K& key, V* out_value = nullptr) const;
+
+    /**
+     * Remove all elements, shrinking the array to a single segment
+     */
+    void clear();
+
+    /**
+     * Visit all elements in the interval [min, max], in sorted order, a run at the time. A run is made of the elements
+     * that are contiguous in memory, up to a pair of clustered segments. The callback has the signature
+     * bool callback(const K* keys, const V* values, size_t length) and returns false to stop the scan.
+     */
+    template<typename Callback>
+    void scan(const K& min, const K& max, Callback&& callback) const;
+
+    /**
+     * Retrieve the content of the given segment. It returns its cardinality.
+     */
+    size_t get_segment(size_t segment_id, const K** out_keys, const V** out_values) const noexcept;
+
+    /**
+     * Retrieve the content of the given segment, with the values open to updates. The keys cannot be altered.
+     */
+    size_t get_segment(size_t segment_id, const K** out_keys, V** out_values) noexcept;
+
+    /**
+     * Set a callback invoked by each rebalance and resize on the elements of the window, once gathered in sorted
+     * order and before they are spread again. It has the signature void listener(const K* keys, V* values, size_t
+     * cardinality, bool is_resize), where is_resize is true when the window spans the whole array. The listener
+     * can alter the values, e.g. to relocate the data they refer to.
+     */
+    void set_rebalance_listener(std::function<void(const K*, V*, size_t, bool)> listener);
+
+    /**
+     * Set the layout of the separator keys in the static index
+     */
+    void set_index_layout(StaticIndex::Layout layout);
+
+    // The number of segments in the array
+    size_t get_number_segments() const noexcept;
+
+    // The max capacity of each segment
+    size_t get_segment_capacity() const noexcept;
+
+    // The number of elements stored
+    size_t size() const noexcept;
+
+    // Is this container empty?
+    bool empty() const noexcept;
+
+    // Memory footprint, in bytes
+    size_t memory_footprint() const noexcept;
+
+    // Dump the content of the data structure to the given output stream (for debugging purposes)
+    void dump(std::ostream& out = std::cout) const;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Initialisation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+PackedMemoryArray<K, V>::PackedMemoryArray(size_t segment_capacity, size_t index_B) : PackedMemoryArray(segment_capacity, CachedDensityBounds{}, index_B) { }
+
+template<typename K, typename V>
+PackedMemoryArray<K, V>::PackedMemoryArray(size_t segment_capacity, const CachedDensityBounds& density_bounds, size_t index_B) : m_segment_capacity(segment_capacity),
+        m_index(index_B), m_density_bounds(density_bounds) {
+    if(segment_capacity > std::numeric_limits<uint16_t>::max()) throw std::invalid_argument("The segment size is too big, max: " + std::to_string(std::numeric_limits<uint16_t>::max()));
+    if(segment_capacity < 2) throw std::invalid_argument("The segment size is too small, min: 2");
+
+    alloc_workspace(1, &m_keys, &m_values, &m_sizes);
+    m_number_segments = 1;
+    m_density_bounds.thresholds(1, 1); // cache the thresholds for the current height
+}
+
+template<typename K, typename V>
+PackedMemoryArray<K, V>::~PackedMemoryArray(){
+    dealloc_workspace(&m_keys, &m_values, &m_sizes);
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::alloc_workspace(size_t num_segments, K** out_keys, V** out_values, uint16_t** out_sizes){
+    assert(out_keys != nullptr && out_values != nullptr && out_sizes != nullptr);
+    *out_keys = nullptr; *out_values = nullptr; *out_sizes = nullptr;
+
+    void* keys { nullptr }; void* values { nullptr }; void* sizes { nullptr };
+    int rc = posix_memalign(&keys, /* alignment */ 64, num_segments * m_segment_capacity * sizeof(K));
+    if(rc != 0) { throw std::bad_alloc(); }
+    rc = posix_memalign(&values, /* alignment */ 64, num_segments * m_segment_capacity * sizeof(V));
+    if(rc != 0) { free(keys); throw std::bad_alloc(); }
+    rc = posix_memalign(&sizes, /* alignment */ 64, num_segments * sizeof(uint16_t));
+    if(rc != 0) { free(keys); free(values); throw std::bad_alloc(); }
+    memset(sizes, 0, num_segments * sizeof(uint16_t));
+
+    *out_keys = reinterpret_cast<K*>(keys);
+    *out_values = reinterpret_cast<V*>(values);
+    *out_sizes = reinterpret_cast<uint16_t*>(sizes);
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::dealloc_workspace(K** keys, V** values, uint16_t** sizes){
+    free(*keys); *keys = nullptr;
+    free(*values); *values = nullptr;
+    free(*sizes); *sizes = nullptr;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Properties                                                              *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::size() const noexcept {
+    return m_cardinality;
+}
+
+template<typename K, typename V>
+bool PackedMemoryArray<K, V>::empty() const noexcept {
+    return m_cardinality == 0;
+}
+
+template<typename K, typename V>
+int PackedMemoryArray<K, V>::height() const noexcept {
+    return log2(m_number_segments) +1;
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::get_number_segments() const noexcept {
+    return m_number_segments;
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::get_segment_capacity() const noexcept {
+    return m_segment_capacity;
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::set_index_layout(StaticIndex::Layout layout){
+    m_index.set_layout(layout);
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::memory_footprint() const noexcept {
+    return sizeof(*this) + m_number_segments * (m_segment_capacity * (sizeof(K) + sizeof(V)) + sizeof(uint16_t)) + m_index.memory_footprint();
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Segments                                                                *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+bool PackedMemoryArray<K, V>::equal(const K& k1, const K& k2) noexcept {
+    return !(k1 < k2) && !(k2 < k1);
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::get_offset(size_t segment_id, size_t size) const noexcept {
+    size_t offset = segment_id * m_segment_capacity;
+    if(segment_id % 2 == 0){ offset += m_segment_capacity - size; } // even segment, the elements are at the end
+    return offset;
+}
+
+template<typename K, typename V>
+const K& PackedMemoryArray<K, V>::get_minimum(size_t segment_id) const noexcept {
+    assert(m_sizes[segment_id] > 0 && "Empty segment");
+    return m_keys[get_offset(segment_id, m_sizes[segment_id])];
+}
+
+template<typename K, typename V>
+template<bool include_equal>
+size_t PackedMemoryArray<K, V>::find_segment(const K& key) const noexcept {
+    const int64_t projection = Projection::project(key);
+    if constexpr (Projection::exact){
+        return include_equal ? m_index.find(projection) : m_index.find_first(projection);
+    } else {
+        // the separators of the segments in (lo, hi] share the same projection of the key, compare their minima
+        size_t lo = m_index.find_first(projection);
+        size_t hi = (projection < std::numeric_limits<int64_t>::max()) ? m_index.find_first(projection +1) : m_number_segments -1;
+        while(lo < hi){
+            size_t mid = (lo + hi +1) / 2;
+            const K& minimum = get_minimum(mid);
+            if(include_equal ? !(key < minimum) : (minimum < key)){
+                lo = mid;
+            } else {
+                hi = mid -1;
+            }
+        }
+        return lo;
+    }
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::segment_lower_bound(size_t segment_id, const K& key) const noexcept {
+    const size_t size = m_sizes[segment_id];
+    const K* keys = m_keys + get_offset(segment_id, size);
+    return std::lower_bound(keys, keys + size, key) - keys;
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::segment_upper_bound(size_t segment_id, const K& key) const noexcept {
+    const size_t size = m_sizes[segment_id];
+    const K* keys = m_keys + get_offset(segment_id, size);
+    return std::upper_bound(keys, keys + size, key) - keys;
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::get_segment(size_t segment_id, const K** out_keys, const V** out_values) const noexcept {
+    assert(segment_id < m_number_segments && "Invalid segment");
+    const size_t size = m_sizes[segment_id];
+    const size_t offset = get_offset(segment_id, size);
+    *out_keys = m_keys + offset;
+    *out_values = m_values + offset;
+    return size;
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::get_segment(size_t segment_id, const K** out_keys, V** out_values) noexcept {
+    assert(segment_id < m_number_segments && "Invalid segment");
+    const size_t size = m_sizes[segment_id];
+    const size_t offset = get_offset(segment_id, size);
+    *out_keys = m_keys + offset;
+    *out_values = m_values + offset;
+    return size;
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::set_rebalance_listener(std::function<void(const K*, V*, size_t, bool)> listener){
+    m_rebalance_listener = std::move(listener);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Insert                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::insert(const K& key, const V& value){
+    if(empty()){
+        insert_empty(key, value);
+        return;
+    }
+
+    size_t segment_id = find_segment</* include equal ? */ true>(key);
+    if(m_sizes[segment_id] == m_segment_capacity){
+        rebalance(segment_id, &key, &value);
+    } else {
+        bool minimum_updated = storage_insert(segment_id, key, value);
+
+        // have we just updated the minimum ?
+        if(minimum_updated) m_index.set_separator_key(segment_id, Projection::project(key));
+    }
+}
+
+template<typename K, typename V>
+bool PackedMemoryArray<K, V>::storage_insert(size_t segment_id, const K& key, const V& value){
+    const size_t size = m_sizes[segment_id];
+    assert(size < m_segment_capacity && "This segment is full!");
+    size_t position = segment_upper_bound(segment_id, key);
+    K* __restrict keys = m_keys + get_offset(segment_id, size);
+    V* __restrict values = m_values + get_offset(segment_id, size);
+
+    if(segment_id % 2 == 0){ // for even segment ids (0, 2, ...), shift the elements before the new one towards the start of the segment
+        memmove(keys -1, keys, position * sizeof(K));
+        memmove(values -1, values, position * sizeof(V));
+        keys[position -1] = key;
+        values[position -1] = value;
+    } else { // for odd segment ids (1, 3, ...), shift the elements after the new one towards the end of the segment
+        memmove(keys + position +1, keys + position, (size - position) * sizeof(K));
+        memmove(values + position +1, values + position, (size - position) * sizeof(V));
+        keys[position] = key;
+        values[position] = value;
+    }
+
+    m_sizes[segment_id]++;
+    m_cardinality++;
+
+    return position == 0;
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::insert_empty(const K& key, const V& value){
+    assert(empty());
+    size_t offset = get_offset(0, 1);
+    m_keys[offset] = key;
+    m_values[offset] = value;
+    m_sizes[0] = 1;
+    m_index.set_separator_key(0, Projection::project(key));
+    m_cardinality = 1;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Remove                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+bool PackedMemoryArray<K, V>::remove(const K& key, V* out_value){
+    if(empty()) return false;
+
+    size_t segment_id = find_segment</* include equal ? */ true>(key);
+    size_t size = m_sizes[segment_id];
+    size_t position = segment_lower_bound(segment_id, key);
+    K* __restrict keys = m_keys + get_offset(segment_id, size);
+    V* __restrict values = m_values + get_offset(segment_id, size);
+    if(position == size || !equal(keys[position], key)) return false; // not found
+
+    if(out_value != nullptr) *out_value = values[position];
+    if(segment_id % 2 == 0){ // even segment, shift the elements before towards the end
+        memmove(keys +1, keys, position * sizeof(K));
+        memmove(values +1, values, position * sizeof(V));
+        keys++;
+    } else { // odd segment, shift the elements after towards the start
+        memmove(keys + position, keys + position +1, (size - position -1) * sizeof(K));
+        memmove(values + position, values + position +1, (size - position -1) * sizeof(V));
+    }
+    size--;
+    m_sizes[segment_id] = size;
+    m_cardinality--;
+
+    // update the minimum
+    if(position == 0 && size > 0){ m_index.set_separator_key(segment_id, Projection::project(keys[0])); }
+
+    // shall we rebalance ?
+    if(m_number_segments > 1){
+        // is the global density of the array less than 50% ?
+        if(static_cast<double>(m_cardinality) < 0.5 * m_number_segments * m_segment_capacity){
+            resize(m_number_segments / 2, nullptr, nullptr);
+        } else { // shall we rebalance the current segment?
+            const size_t minimum_size = std::max<size_t>(m_density_bounds.thresholds(1).first * m_segment_capacity, 1); // at least one element per segment
+            if(size < minimum_size){ rebalance(segment_id, nullptr, nullptr); }
+        }
+    }
+
+    return true;
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::clear(){
+    K* keys; V* values; uint16_t* sizes;
+    alloc_workspace(1, &keys, &values, &sizes);
+    dealloc_workspace(&m_keys, &m_values, &m_sizes);
+    m_keys = keys; m_values = values; m_sizes = sizes;
+    m_number_segments = 1;
+    m_cardinality = 0;
+    m_index.rebuild(1);
+    m_density_bounds.thresholds(1, 1);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Rebalance                                                               *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::rebalance(size_t segment_id, const K* insert_key, const V* insert_value){
+    assert(((insert_key && insert_value) || (!insert_key && !insert_value)) && "Either both key & value are specified (insert) or none of them is (delete)");
+    const bool is_insert = insert_key != nullptr;
+
+    size_t window_start {0}, window_length {0};
+    bool do_resize { false };
+    rebalance_find_window(segment_id, is_insert, &window_start, &window_length, &do_resize);
+
+    if(do_resize){
+        size_t num_segments = is_insert ? m_number_segments * 2 : std::max<size_t>(1, m_number_segments / 2);
+        resize(num_segments, insert_key, insert_value);
+    } else {
+        K* keys = m_memory_pool.allocate<K>(window_length * m_segment_capacity +1);
+        V* values = m_memory_pool.allocate<V>(window_length * m_segment_capacity +1);
+        size_t cardinality = gather(window_start, window_length, insert_key, insert_value, keys, values);
+        notify_rebalance(keys, values, cardinality, window_length == m_number_segments);
+        spread(window_start, window_length, keys, values, cardinality);
+        m_cardinality += is_insert;
+        m_memory_pool.deallocate(keys);
+        m_memory_pool.deallocate(values);
+    }
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::rebalance_find_window(size_t segment_id, bool is_insert, size_t* out_window_start, size_t* out_window_length, bool* out_resize) const {
+    assert(out_window_start != nullptr && out_window_length != nullptr && out_resize != nullptr);
+    assert(segment_id < m_number_segments && "Invalid segment");
+
+    size_t window_length = 1;
+    size_t window_start = segment_id;
+    size_t cardinality_after = m_sizes[segment_id] + is_insert;
+    int height = 1;
+    // these inits are only valid for the edge case that the calibrator tree has height 1, i.e. the data structure contains only one segment
+    double rho = 0.0, theta = 1.0, density = static_cast<double>(cardinality_after)/m_segment_capacity;
+
+    // determine the window to rebalance. The number of segments is a power of 2, the windows are always aligned
+    if(m_number_segments > 1){
+        int64_t index_left = static_cast<int64_t>(segment_id) -1;
+        size_t index_right = segment_id +1;
+
+        do {
+            height++;
+            window_length *= 2;
+            window_start = (segment_id / window_length) * window_length;
+            size_t window_end = window_start + window_length;
+
+            // find the number of elements in the interval
+            while(index_left >= static_cast<int64_t>(window_start)){
+                cardinality_after += m_sizes[index_left];
+                index_left--;
+            }
+            while(index_right < window_end){
+                cardinality_after += m_sizes[index_right];
+                index_right++;
+            }
+
+            auto density_bounds = m_density_bounds.thresholds(height);
+            rho = density_bounds.first;
+            theta = density_bounds.second;
+            density = static_cast<double>(cardinality_after) / (window_length * m_segment_capacity);
+
+        } while( ((is_insert && density > theta) || (!is_insert && density < rho)) && window_length < m_number_segments);
+    }
+
+    *out_window_start = window_start;
+    *out_window_length = window_length;
+    *out_resize = (is_insert && density > theta) || (!is_insert && (density < rho || cardinality_after < window_length));
+}
+
+template<typename K, typename V>
+size_t PackedMemoryArray<K, V>::gather(size_t window_start, size_t window_length, const K* insert_key, const V* insert_value, K* out_keys, V* out_values) const {
+    size_t cardinality = 0;
+    size_t insert_position = 0;
+    for(size_t segment_id = window_start, end = window_start + window_length; segment_id < end; segment_id++){
+        size_t size = m_sizes[segment_id];
+        size_t offset = get_offset(segment_id, size);
+        const K* keys = m_keys + offset;
+        memcpy(out_keys + cardinality, keys, size * sizeof(K));
+        memcpy(out_values + cardinality, m_values + offset, size * sizeof(V));
+        if(insert_key != nullptr && size > 0 && !(*insert_key < keys[0])){ insert_position = cardinality + segment_upper_bound(segment_id, *insert_key); }
+        cardinality += size;
+    }
+
+    if(insert_key != nullptr){
+        memmove(out_keys + insert_position +1, out_keys + insert_position, (cardinality - insert_position) * sizeof(K));
+        memmove(out_values + insert_position +1, out_values + insert_position, (cardinality - insert_position) * sizeof(V));
+        out_keys[insert_position] = *insert_key;
+        out_values[insert_position] = *insert_value;
+        cardinality++;
+    }
+
+    return cardinality;
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::notify_rebalance(const K* keys, V* values, size_t cardinality, bool is_resize){
+    if(m_rebalance_listener){ m_rebalance_listener(keys, values, cardinality, is_resize); }
+}
+
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::spread(size_t window_start, size_t window_length, const K* keys, const V* values, size_t cardinality){
+    const size_t elements_per_segment = cardinality / window_length;
+    const size_t odd_segments = cardinality % window_length;
+    assert(elements_per_segment + (odd_segments > 0) <= m_segment_capacity && "Segment overfilled");
+
+    for(size_t i = 0; i < window_length; i++){
+        size_t segment_id = window_start + i;
+        size_t size = elements_per_segment + (i < odd_segments);
+        size_t offset = get_offset(segment_id, size);
+        memcpy(m_keys + offset, keys, size * sizeof(K));
+        memcpy(m_values + offset, values, size * sizeof(V));
+        m_sizes[segment_id] = size;
+        if(size > 0){ m_index.set_separator_key(segment_id, Projection::project(keys[0])); }
+        keys += size;
+        values += size;
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Resize                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::resize(size_t num_segments, const K* insert_key, const V* insert_value){
+    const size_t cardinality = m_cardinality + (insert_key != nullptr);
+
+    // gather all elements
+    K* keys = m_memory_pool.allocate<K>(cardinality);
+    V* values = m_memory_pool.allocate<V>(cardinality);
+    size_t count = gather(0, m_number_segments, insert_key, insert_value, keys, values);
+    assert(count == cardinality);
+    (void) count;
+    notify_rebalance(keys, values, cardinality, /* resize ? */ true);
+
+    // avoid empty segments
+    while(num_segments > 1 && num_segments > cardinality){ num_segments /= 2; }
+    // ensure the new array can store all elements
+    while(num_segments * m_segment_capacity < cardinality){ num_segments *= 2; }
+
+    // replace the storage
+    K* new_keys; V* new_values; uint16_t* new_sizes;
+    alloc_workspace(num_segments, &new_keys, &new_values, &new_sizes);
+    dealloc_workspace(&m_keys, &m_values, &m_sizes);
+    m_keys = new_keys; m_values = new_values; m_sizes = new_sizes;
+    m_number_segments = num_segments;
+    m_index.rebuild(num_segments);
+    m_cardinality = cardinality;
+    m_density_bounds.thresholds(height(), height()); // update the cached thresholds
+    spread(0, num_segments, keys, values, cardinality);
+
+    m_memory_pool.deallocate(keys);
+    m_memory_pool.deallocate(values);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Find & scan                                                             *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+bool PackedMemoryArray<K, V>::find(const K& key, V* out_value) const {
+    if(empty()) return false;
+
+    size_t segment_id = find_segment</* include equal ? */ true>(key);
+    size_t size = m_sizes[segment_id];
+    size_t position = segment_lower_bound(segment_id, key);
+    size_t offset = get_offset(segment_id, size);
+    if(position < size && equal(m_keys[offset + position], key)){
+        if(out_value != nullptr) *out_value = m_values[offset + position];
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<typename K, typename V>
+template<typename Callback>
+void PackedMemoryArray<K, V>::scan(const K& min, const K& max, Callback&& callback) const {
+    if(max < min || empty()) return;
+
+    // the elements in [run_start, run_end) of m_keys and m_values qualify and have not been visited yet
+    size_t run_start = 0, run_end = 0;
+    for(size_t segment_id = find_segment</* include equal ? */ false>(min); segment_id < m_number_segments; segment_id++){
+        size_t size = m_sizes[segment_id];
+        size_t offset = get_offset(segment_id, size);
+        const K* keys = m_keys + offset;
+        if(size == 0 || max < keys[0]) break;
+
+        size_t start = (keys[0] < min) ? segment_lower_bound(segment_id, min) : 0;
+        size_t stop = (max < keys[size -1]) ? segment_upper_bound(segment_id, max) : size;
+        if(start >= stop) continue;
+
+        if(offset + start != run_end){ // not contiguous with the current run
+            if(run_start < run_end && !callback(m_keys + run_start, m_values + run_start, run_end - run_start)) return;
+            run_start = offset + start;
+        }
+        run_end = offset + stop;
+        if(stop < size) break; // the rest of the segment is greater than max
+    }
+
+    if(run_start < run_end){ callback(m_keys + run_start, m_values + run_start, run_end - run_start); }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Dump                                                                    *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K, typename V>
+void PackedMemoryArray<K, V>::dump(std::ostream& out) const {
+    out << "[PMA] cardinality: " << m_cardinality << ", capacity: " << m_number_segments * m_segment_capacity << ", " <<
+            "height: "<< height() << ", #segments: " << m_number_segments << ", blksz #elements: " << m_segment_capacity <<
+            ", key size: " << sizeof(K) << " bytes, value size: " << sizeof(V) << " bytes" << std::endl;
+
+    size_t tot_count = 0;
+    for(size_t i = 0; i < m_number_segments; i++){
+        const K* keys = m_keys + get_offset(i, m_sizes[i]);
+        out << "[" << i << "] size: " << m_sizes[i] << ", separator: " << m_index.get_separator_key(i);
+        out << " :: ";
+        for(size_t j = 0; j < m_sizes[i]; j++){
+            if(j > 0) out << ", ";
+            out << keys[j];
+        }
+        out << std::endl;
+
+        if(i > 0 && m_sizes[i] > 0 && Projection::project(keys[0]) != m_index.get_separator_key(i)) out << " (ERROR: invalid separator key)" << std::endl;
+        for(size_t j = 1; j < m_sizes[i]; j++){ if(keys[j] < keys[j -1]) out << " (ERROR: order mismatch at position " << j << ")" << std::endl; }
+        tot_count += m_sizes[i];
+    }
+
+    if(tot_count != m_cardinality){
+        out << " (ERROR: size mismatch, pma registered cardinality: " << m_cardinality << ", computed cardinality: " << tot_count <<  ")" << std::endl;
+    }
+}
+
+}} // pma::v10
+
+#endif /* BTREE_10_PACKED_MEMORY_ARRAY_HPP_ */
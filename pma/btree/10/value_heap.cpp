@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "value_heap.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "rewired_memory.hpp"
+
+using namespace std;
+
+namespace pma { namespace v10 {
+
+ValueHeap::ValueHeap(size_t pages_per_extent, size_t initial_capacity) : m_memory(nullptr), m_buffer(nullptr), m_capacity(0) {
+    if(pages_per_extent == 0) throw std::invalid_argument("The number of pages per extent must be greater than 0");
+    m_memory = new RewiredMemory(pages_per_extent, 1);
+    const size_t extent_size = m_memory->get_extent_size();
+    size_t num_extents = (initial_capacity + extent_size -1) / extent_size;
+    if(num_extents > 1){ m_memory->extend(num_extents -1); }
+    m_buffer = reinterpret_cast<char*>(m_memory->get_start_address());
+    m_capacity = m_memory->get_allocated_memory_size();
+}
+
+ValueHeap::~ValueHeap(){
+    delete m_memory; m_memory = nullptr;
+}
+
+void ValueHeap::ensure_capacity(size_t length){
+    if(m_used + length <= m_capacity) return;
+
+    // grow geometrically, to amortise the cost of the remaps
+    const size_t extent_size = m_memory->get_extent_size();
+    size_t required_extents = (m_used + length - m_capacity + extent_size -1) / extent_size;
+    size_t num_extents = std::max(required_extents, m_memory->get_allocated_extents() / 2);
+    m_memory->extend(num_extents);
+    m_buffer = reinterpret_cast<char*>(m_memory->get_start_address());
+    m_capacity = m_memory->get_allocated_memory_size();
+}
+
+ValueRef ValueHeap::append(const void* data, size_t length){
+    if(length > MAX_LENGTH) throw std::invalid_argument("The payload is too long: " + to_string(length) + " bytes, max: " + to_string(MAX_LENGTH) + " bytes");
+    if(m_used + length >= (1ull << 40)) throw std::length_error("The heap is full");
+    assert((data != nullptr || length == 0) && "Null pointer");
+    ensure_capacity(length);
+
+    ValueRef ref;
+    ref.m_offset = m_used;
+    ref.m_length = length;
+    if(length > 0){ memcpy(m_buffer + m_used, data, length); }
+    m_used += length;
+    m_live += length;
+    return ref;
+}
+
+ValueRef ValueHeap::relocate(const ValueHeap& source, ValueRef ref){
+    assert(ref.m_offset + ref.m_length <= source.m_used && "Invalid reference");
+    ensure_capacity(ref.m_length); // it may move the buffer of `source', if it is the same heap
+    return append(source.m_buffer + ref.m_offset, ref.m_length);
+}
+
+void ValueHeap::release(ValueRef ref) noexcept {
+    assert(ref.m_length <= m_live && "Invalid reference");
+    m_live -= ref.m_length;
+}
+
+}} // pma::v10
@@ -0,0 +1,110 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BTREE_10_VALUE_HEAP_HPP_
+#define BTREE_10_VALUE_HEAP_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <string_view>
+
+class RewiredMemory; // forward decl.
+
+namespace pma { namespace v10 {
+
+/**
+ * Reference to a payload stored in a ValueHeap: its offset in the heap and its length, in bytes, packed in 8 bytes.
+ */
+struct ValueRef {
+    uint64_t m_offset : 40; // up to 1 TB of payloads
+    uint64_t m_length : 24; // up to 16 MB for each payload
+};
+static_assert(sizeof(ValueRef) == sizeof(uint64_t), "Expected a ValueRef to be 8 bytes");
+
+/**
+ * An append-only log of variable length payloads, backed by rewired memory. New payloads are always appended at the
+ * end of the log, growing the physical memory an extent at the time, and are referred by their offset, which is
+ * stable as the start address of the log may change when it is extended. Released payloads are only accounted
+ * as garbage: the space is reclaimed by copying the live payloads into a new heap.
+ */
+class ValueHeap {
+    ValueHeap(const ValueHeap&) = delete;
+    ValueHeap& operator=(const ValueHeap&) = delete;
+
+    RewiredMemory* m_memory; // the underlying storage
+    char* m_buffer; // the start address of the storage
+    uint64_t m_capacity; // amount of physical memory allocated, in bytes
+    uint64_t m_used = 0; // amount of memory consumed by the log, in bytes
+    uint64_t m_live = 0; // amount of memory referred by the live payloads, in bytes
+
+    // Ensure the log can accommodate another `length' bytes
+    void ensure_capacity(size_t length);
+
+public:
+    // The max length of a single payload, in bytes
+    static constexpr size_t MAX_LENGTH = (1ull << 24) -1;
+
+    /**
+     * Create a new heap, with the given number of bytes initially allocated. The size of an extent is given
+     * in terms of virtual pages.
+     */
+    ValueHeap(size_t pages_per_extent = 1, size_t initial_capacity = 0);
+
+    /**
+     * Destructor
+     */
+    ~ValueHeap();
+
+    /**
+     * Append a copy of the given payload at the end of the log
+     */
+    ValueRef append(const void* data, size_t length);
+
+    /**
+     * Copy the payload referred by the given reference, from the heap `source', at the end of this log.
+     * The same heap can be both the source and the destination.
+     */
+    ValueRef relocate(const ValueHeap& source, ValueRef ref);
+
+    /**
+     * Mark the payload as garbage
+     */
+    void release(ValueRef ref) noexcept;
+
+    /**
+     * Retrieve the payload for the given reference. The view is valid until the next append or relocate.
+     */
+    std::string_view get(ValueRef ref) const noexcept {
+        return std::string_view{ m_buffer + ref.m_offset, ref.m_length };
+    }
+
+    // The amount of memory consumed by the log, in bytes
+    uint64_t used() const noexcept { return m_used; }
+
+    // The amount of memory referred by the live payloads, in bytes
+    uint64_t live() const noexcept { return m_live; }
+
+    // The amount of memory that is no longer referred, in bytes
+    uint64_t garbage() const noexcept { return m_used - m_live; }
+
+    // The amount of physical memory allocated, in bytes
+    uint64_t memory_footprint() const noexcept { return m_capacity; }
+};
+
+}} // pma::v10
+
+#endif /* BTREE_10_VALUE_HEAP_HPP_ */
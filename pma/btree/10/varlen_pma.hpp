@@ -0,0 +1,218 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BTREE_10_VARLEN_PMA_HPP_
+#define BTREE_10_VARLEN_PMA_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string_view>
+
+#include "packed_memory_array.hpp"
+#include "value_heap.hpp"
+
+namespace pma { namespace v10 {
+
+/**
+ * Clustered PMA for keys of type K and variable length payloads. The value slots of the PMA only store a reference
+ * to the payloads, which are kept in a ValueHeap, an append-only log on rewired memory.
+ *
+ * The position of the payloads in the log follows the order of the keys. The payloads are moved by the spreads of the
+ * underlying clustered PMA, through its rebalance listener:
+ * - each resize rebuilds the whole log in key order, dropping the garbage. Its cost is amortised over the updates
+ *   that doubled or halved the array, as for the keys;
+ * - a rebalance relocates the payloads of its window at the end of the log, in the same order the elements are spread,
+ *   only when they are fragmented, that is when a scan of the window would jump in the log more than once per
+ *   segment on average. Otherwise the payloads are left in place and only their references are moved. The jumps
+ *   are introduced by the updates, as the new payloads are appended at the end of the log, hence the payloads of
+ *   a window are copied again only after about one update for each of its segments, rather than by each rebalance.
+ * Between two resizes, the log is also compacted when the garbage exceeds the size of the live payloads. In this
+ * way, a range scan reads the payloads mostly sequentially.
+ */
+template<typename K>
+class VarlenPackedMemoryArray {
+    VarlenPackedMemoryArray(const VarlenPackedMemoryArray&) = delete;
+    VarlenPackedMemoryArray& operator=(const VarlenPackedMemoryArray&) = delete;
+
+    PackedMemoryArray<K, ValueRef> m_pma; // the keys and the references to the payloads
+    const size_t m_pages_per_extent; // the size of an extent of the heap, in terms of virtual pages
+    std::unique_ptr<ValueHeap> m_heap; // the payloads
+
+    // Relocate the payloads of a rebalanced window, if they are fragmented
+    void on_rebalance(ValueRef* refs, size_t cardinality, bool is_resize);
+
+    // Compact the heap if the garbage exceeds the live payloads
+    void check_garbage();
+
+public:
+    /**
+     * Create an empty PMA, with the given capacity for each segment and node size for the static index. The heap for
+     * the payloads grows by extents of `pages_per_extent' virtual pages.
+     */
+    VarlenPackedMemoryArray(size_t segment_capacity = 64, size_t pages_per_extent = 16, size_t index_B = 64);
+
+    /**
+     * Insert a copy of the given payload, with length in bytes. Duplicate keys are allowed.
+     */
+    void insert(const K& key, const void* data, size_t length);
+
+    /**
+     * Remove one element with the given key. Return true if found, false otherwise.
+     */
+    bool remove(const K& key);
+
+    /**
+     * Find one element with the given key. If found, it returns true and stores a view to its payload in `out_payload',
+     * if not null. The view is only valid until the next update of the data structure.
+     */
+    bool find(const K& key, std::string_view* out_payload = nullptr) const;
+
+    /**
+     * Visit all elements in the interval [min, max], in sorted order. The callback has the signature
+     * bool callback(const K& key, std::string_view payload) and returns false to stop the scan.
+     */
+    template<typename Callback>
+    void scan(const K& min, const K& max, Callback&& callback) const;
+
+    /**
+     * Copy all live payloads into a new heap, in key order, and release the old heap
+     */
+    void compact();
+
+    // The number of elements stored
+    size_t size() const noexcept { return m_pma.size(); }
+
+    // Is this container empty?
+    bool empty() const noexcept { return m_pma.empty(); }
+
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(StaticIndex::Layout layout) { m_pma.set_index_layout(layout); }
+
+    // The keys and the references to the payloads
+    const PackedMemoryArray<K, ValueRef>& pma() const noexcept { return m_pma; }
+
+    // The heap of the payloads
+    const ValueHeap& heap() const noexcept { return *m_heap; }
+
+    // Memory footprint, in bytes, including the heap
+    size_t memory_footprint() const noexcept { return sizeof(*this) - sizeof(m_pma) + m_pma.memory_footprint() + m_heap->memory_footprint(); }
+
+    // Dump the content of the data structure to the given output stream (for debugging purposes)
+    void dump(std::ostream& out = std::cout) const;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+template<typename K>
+VarlenPackedMemoryArray<K>::VarlenPackedMemoryArray(size_t segment_capacity, size_t pages_per_extent, size_t index_B) :
+    m_pma(segment_capacity, index_B), m_pages_per_extent(pages_per_extent), m_heap(new ValueHeap(pages_per_extent)) {
+    m_pma.set_rebalance_listener([this](const K*, ValueRef* refs, size_t cardinality, bool is_resize){
+        on_rebalance(refs, cardinality, is_resize);
+    });
+}
+
+template<typename K>
+void VarlenPackedMemoryArray<K>::insert(const K& key, const void* data, size_t length){
+    ValueRef ref = m_heap->append(data, length);
+    m_pma.insert(key, ref);
+    check_garbage();
+}
+
+template<typename K>
+bool VarlenPackedMemoryArray<K>::remove(const K& key){
+    ValueRef ref;
+    if(!m_pma.find(key, &ref)) return false;
+    m_heap->release(ref); // before the removal, as it may resize the heap
+    bool found = m_pma.remove(key);
+    assert(found && "The element should have been found");
+    (void) found;
+    check_garbage();
+    return true;
+}
+
+template<typename K>
+bool VarlenPackedMemoryArray<K>::find(const K& key, std::string_view* out_payload) const {
+    ValueRef ref;
+    if(!m_pma.find(key, &ref)) return false;
+    if(out_payload != nullptr) *out_payload = m_heap->get(ref);
+    return true;
+}
+
+template<typename K>
+template<typename Callback>
+void VarlenPackedMemoryArray<K>::scan(const K& min, const K& max, Callback&& callback) const {
+    m_pma.scan(min, max, [this, &callback](const K* keys, const ValueRef* refs, size_t length){
+        for(size_t i = 0; i < length; i++){
+            if(!callback(keys[i], m_heap->get(refs[i]))) return false;
+        }
+        return true;
+    });
+}
+
+template<typename K>
+void VarlenPackedMemoryArray<K>::on_rebalance(ValueRef* refs, size_t cardinality, bool is_resize){
+    if(is_resize){ // rebuild the whole heap
+        std::unique_ptr<ValueHeap> heap { new ValueHeap(m_pages_per_extent, m_heap->live()) };
+        for(size_t i = 0; i < cardinality; i++){ refs[i] = heap->relocate(*m_heap, refs[i]); }
+        m_heap = std::move(heap);
+    } else { // move the payloads of the window at the end of the log, if they are fragmented
+        size_t num_jumps = 0;
+        for(size_t i = 1; i < cardinality; i++){ num_jumps += (refs[i].m_offset != refs[i -1].m_offset + refs[i -1].m_length); }
+        if(num_jumps * m_pma.get_segment_capacity() <= cardinality) return; // at most one jump per segment
+
+        for(size_t i = 0; i < cardinality; i++){
+            ValueRef ref = refs[i];
+            refs[i] = m_heap->relocate(*m_heap, ref);
+            m_heap->release(ref);
+        }
+    }
+}
+
+template<typename K>
+void VarlenPackedMemoryArray<K>::check_garbage(){
+    // avoid compacting a small heap, the cost would not be amortised
+    if(m_heap->garbage() > m_heap->live() && m_heap->garbage() > m_heap->memory_footprint() / 4){ compact(); }
+}
+
+template<typename K>
+void VarlenPackedMemoryArray<K>::compact(){
+    std::unique_ptr<ValueHeap> heap { new ValueHeap(m_pages_per_extent, m_heap->live()) };
+    const K* keys { nullptr };
+    ValueRef* refs { nullptr };
+    for(size_t segment_id = 0, end = m_pma.get_number_segments(); segment_id < end; segment_id++){
+        size_t size = m_pma.get_segment(segment_id, &keys, &refs);
+        for(size_t i = 0; i < size; i++){ refs[i] = heap->relocate(*m_heap, refs[i]); }
+    }
+    assert(heap->used() == m_heap->live() && "Some payloads have not been relocated");
+    m_heap = std::move(heap);
+}
+
+template<typename K>
+void VarlenPackedMemoryArray<K>::dump(std::ostream& out) const {
+    out << "[Varlen PMA] heap used: " << m_heap->used() << " bytes, live: " << m_heap->live() << " bytes, garbage: " << m_heap->garbage() << " bytes, " <<
+            "allocated: " << m_heap->memory_footprint() << " bytes" << std::endl;
+    m_pma.dump(out);
+}
+
+}} // pma::v10
+
+#endif /* BTREE_10_VARLEN_PMA_HPP_ */
@@ -2221,6 +2221,10 @@ void BTreePMACC5::set_record_segment_statistics(bool value) {
     m_segment_statistics = value;
 }
 
+void BTreePMACC5::set_index_layout(::pma::StaticIndex::Layout layout) {
+    m_index.set_layout(layout);
+}
+
 
 /*****************************************************************************
  *                                                                           *
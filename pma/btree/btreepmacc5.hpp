@@ -345,6 +345,9 @@ public:
 
     // Whether to save segment statistics, at the end, in the table `btree_leaf_statistics' ?
     void set_record_segment_statistics(bool value);
+
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(::pma::StaticIndex::Layout layout);
 };
 
 } // namespace pma
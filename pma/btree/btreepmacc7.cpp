@@ -31,7 +31,12 @@
 #include "database.hpp"
 #include "errorhandling.hpp"
 #include "miscellaneous.hpp"
+#include "pma/generic/compressed_segment.hpp"
+#include "pma/generic/parallel_spread.hpp"
+#include "pma/generic/segment_search.hpp"
+#include "pma/generic/snapshot.hpp"
 #include "rewired_memory.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 using namespace pma::btree_pmacc7_details;
@@ -423,9 +428,9 @@ void BTreePMACC7::record_rebalancing_statistics() const {
 
 BTreePMACC7::BTreePMACC7(size_t pages_per_extent) : BTreePMACC7(/* B = */ 64, pages_per_extent) { }
 BTreePMACC7::BTreePMACC7(size_t btree_block_size, size_t pages_per_extent) : BTreePMACC7(btree_block_size, btree_block_size, pages_per_extent) { }
-BTreePMACC7::BTreePMACC7(size_t btree_block_size, size_t pma_segment_size, size_t pages_per_extent) :
+BTreePMACC7::BTreePMACC7(size_t btree_block_size, size_t pma_segment_size, size_t pages_per_extent, bool key_only, size_t bits_per_key) :
        m_index(btree_block_size),
-       m_storage(pma_segment_size, pages_per_extent) {
+       m_storage(pma_segment_size, pages_per_extent, key_only, bits_per_key) {
 }
 
 BTreePMACC7::~BTreePMACC7() {
@@ -438,11 +443,16 @@ BTreePMACC7::~BTreePMACC7() {
 #endif
 }
 
-PMA::PMA(size_t segment_size, size_t pages_per_extent) : m_segment_capacity(hyperceil(segment_size)), m_pages_per_extent(pages_per_extent){
+PMA::PMA(size_t segment_size, size_t pages_per_extent, bool key_only, size_t bits_per_key) : m_segment_capacity(hyperceil(segment_size)), m_pages_per_extent(pages_per_extent), m_key_only(key_only),
+        m_compressed_bytes(m_segment_capacity * bits_per_key / 8){
     if(hyperceil(segment_size ) > numeric_limits<uint16_t>::max()) throw std::invalid_argument("segment size too big, maximum is " + std::to_string( numeric_limits<uint16_t>::max() ));
     if(m_segment_capacity < 32) throw std::invalid_argument("segment size too small, minimum is 32");
     if(hyperceil(m_pages_per_extent) != m_pages_per_extent) throw std::invalid_argument("pages per extent must be a value from a power of 2");
     if(get_memory_page_size() % (m_segment_capacity * sizeof(m_keys[0])) != 0) throw std::invalid_argument("segment capacity must be a divisor of the virtual page size");
+    // the compressed segments must be a power of 2, to fit the extents of the rewired memory
+    if(bits_per_key != 0 && bits_per_key != 8 && bits_per_key != 16 && bits_per_key != 32) throw std::invalid_argument("bits per key must be 0 (uncompressed keys), 8, 16 or 32");
+    // at least two keys of any width must fit in a segment
+    if(is_compressed() && m_compressed_bytes < COMPRESSED_SEGMENT_HEADER + 2 * sizeof(int64_t) + COMPRESSED_SEGMENT_PADDING) throw std::invalid_argument("the space for the compressed keys is too small, segment_size * bits_per_key must be at least 512 bits");
 
     m_capacity = m_segment_capacity;
     m_number_segments = 1;
@@ -471,7 +481,8 @@ void PMA::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values,
     unique_ptr<PMA, decltype(onErrorDeleter)> onError{this, onErrorDeleter};
 
     const size_t extent_size = m_pages_per_extent * get_memory_page_size();
-    const size_t elts_space_required_bytes = num_segments * m_segment_capacity * sizeof(m_keys[0]);
+    const size_t elts_space_required_bytes = num_segments * get_segment_key_bytes();
+    const size_t values_space_required_bytes = num_segments * m_segment_capacity * sizeof(m_values[0]);
     const size_t card_space_required_bytes = max<size_t>(2, num_segments) * sizeof(m_segment_sizes[0]);
     bool use_rewired_memory = elts_space_required_bytes >= extent_size;
 
@@ -483,9 +494,16 @@ void PMA::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values,
 
         *rewired_memory_keys = new BufferedRewiredMemory(m_pages_per_extent, elts_num_extents);
         *keys = (int64_t*) (*rewired_memory_keys)->get_start_address();
-        *rewired_memory_values = new BufferedRewiredMemory(m_pages_per_extent, elts_num_extents);
-        *values = (int64_t*) (*rewired_memory_values)->get_start_address();
-        *rewired_memory_cardinalities = new RewiredMemory(m_pages_per_extent, card_num_extents, (*rewired_memory_keys)->get_max_memory() * sizeof(uint16_t) / sizeof(int64_t));
+        if(!m_key_only){
+            // with compressed keys, the extents of the values are larger, to contain the same segments of the extents of the keys
+            const size_t values_pages_per_extent = m_pages_per_extent * (m_segment_capacity * sizeof(m_values[0]) / get_segment_key_bytes());
+            *rewired_memory_values = new BufferedRewiredMemory(values_pages_per_extent, elts_num_extents);
+            *values = (int64_t*) (*rewired_memory_values)->get_start_address();
+        } else {
+            *values = *keys;
+        }
+        const size_t card_max_memory = (*rewired_memory_keys)->get_max_memory() / get_segment_key_bytes() * m_segment_capacity * sizeof(uint16_t);
+        *rewired_memory_cardinalities = new RewiredMemory(m_pages_per_extent, card_num_extents, card_max_memory);
         *sizes = (uint16_t*) (*rewired_memory_cardinalities)->get_start_address();
     } else {
         COUT_DEBUG("posix_memalign with " << num_segments << " segments (" << elts_space_required_bytes << " bytes)");
@@ -496,10 +514,14 @@ void PMA::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values,
             RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
                     "Requested size: " << elts_space_required_bytes);
         }
-        rc = posix_memalign((void**) values, /* alignment */ 64,  /* size */ elts_space_required_bytes);
-        if(rc != 0) {
-            RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
-                    "Requested size: " << elts_space_required_bytes);
+        if(!m_key_only){
+            rc = posix_memalign((void**) values, /* alignment */ 64,  /* size */ values_space_required_bytes);
+            if(rc != 0) {
+                RAISE_EXCEPTION(Exception, "[Storage::alloc_workspace] It cannot obtain a chunk of aligned memory. " <<
+                        "Requested size: " << values_space_required_bytes);
+            }
+        } else {
+            *values = *keys;
         }
 
         rc = posix_memalign((void**) sizes, /* alignment */ 64,  /* size */ card_space_required_bytes);
@@ -519,10 +541,10 @@ void PMA::alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values,
 void PMA::extend(size_t num_segments_to_add){
     COUT_DEBUG("num_segments_to_add: " << num_segments_to_add << ", page size: " << get_memory_page_size());
     assert(m_memory_keys != nullptr);
-    assert(m_memory_values != nullptr);
+    assert(m_key_only || m_memory_values != nullptr);
     assert(m_memory_sizes != nullptr);
 
-    const size_t bytes_per_segment = m_segment_capacity * sizeof(m_keys[0]);
+    const size_t bytes_per_segment = get_segment_key_bytes(); // the extents of the values contain the same segments
     constexpr size_t bytes_per_size = sizeof(m_segment_sizes[0]);
     const size_t bytes_per_extent = m_pages_per_extent * get_memory_page_size();
 
@@ -546,14 +568,14 @@ void PMA::extend(size_t num_segments_to_add){
 
     if (elts_num_extents_required > 0){
         m_memory_keys->extend(elts_num_extents_required);
-        m_memory_values->extend(elts_num_extents_required);
+        if(!m_key_only) m_memory_values->extend(elts_num_extents_required);
     }
     if(sizes_num_extents_required > 0){
         m_memory_sizes->extend(sizes_num_extents_required);
     }
 
     m_keys = (int64_t*) m_memory_keys->get_start_address();
-    m_values = (int64_t*) m_memory_values->get_start_address();
+    m_values = m_key_only ? m_keys : (int64_t*) m_memory_values->get_start_address();
     m_segment_sizes = (uint16_t*) m_memory_sizes->get_start_address();
 
     // update the properties
@@ -564,6 +586,7 @@ void PMA::extend(size_t num_segments_to_add){
 }
 
 void PMA::dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities){
+    if(*values == *keys){ *values = nullptr; } // key-only mode, the values are an alias of the keys
     if(*rewired_memory_keys != nullptr){
         *keys = nullptr;
          delete *rewired_memory_keys; *rewired_memory_keys = nullptr;
@@ -584,6 +607,21 @@ void PMA::dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_segment
     }
 }
 
+size_t PMA::get_segment_key_bytes() const noexcept {
+    return is_compressed() ? m_compressed_bytes : m_segment_capacity * sizeof(m_keys[0]);
+}
+
+uint8_t* PMA::get_compressed_segment(size_t segment_id) const noexcept {
+    assert(is_compressed());
+    return reinterpret_cast<uint8_t*>(m_keys) + segment_id * m_compressed_bytes;
+}
+
+size_t PMA::get_offset(size_t segment_id, size_t size) const noexcept {
+    size_t offset = segment_id * m_segment_capacity;
+    if(segment_id % 2 == 0){ offset += m_segment_capacity - size; } // even segment, the elements are at the end
+    return offset;
+}
+
 size_t BTreePMACC7::size() const {
     return m_storage.m_cardinality;
 }
@@ -626,8 +664,12 @@ void BTreePMACC7::insert_empty(int64_t key, int64_t value){
     m_index.set_separator_key(0, key);
     m_storage.m_segment_sizes[0] = 1;
     size_t pos = m_storage.m_segment_capacity -1;
-    m_storage.m_keys[pos] = key;
-    m_storage.m_values[pos] = value;
+    if(m_storage.is_compressed()){
+        compressed_segment_store(m_storage.get_compressed_segment(0), &key, 1);
+    } else {
+        m_storage.m_keys[pos] = key;
+    }
+    if(!m_storage.m_key_only) m_storage.m_values[pos] = value;
     m_storage.m_cardinality = 1;
 }
 
@@ -637,6 +679,11 @@ void BTreePMACC7::insert_common(size_t segment_id, int64_t key, int64_t value){
 
     COUT_DEBUG("segment_id: " << segment_id << ", element: <" << key << ", " << value << ">");
 
+    if(m_storage.is_compressed()){
+        if(!compressed_insert(segment_id, key, value)){ rebalance(segment_id, &key, &value); }
+        return;
+    }
+
     // is this bucket full ?
     auto bucket_cardinality = m_storage.m_segment_sizes[segment_id];
     if(bucket_cardinality == m_storage.m_segment_capacity){
@@ -670,10 +717,12 @@ bool BTreePMACC7::storage_insert_unsafe(size_t segment_id, int64_t key, int64_t
         COUT_DEBUG("(even) segment_id: " << segment_id << ", start: " << start << ", stop: " << stop << ", key: " << key << ", value: " << value << ", position: " << i);
         keys[i] = key;
 
-        for(size_t j = start; j < i; j++){
-            values[j] = values[j+1];
+        if(!m_storage.m_key_only){
+            for(size_t j = start; j < i; j++){
+                values[j] = values[j+1];
+            }
+            values[i] = value;
         }
-        values[i] = value;
 
         minimum = (i == start);
     } else { // for odd segment ids (1, 3, ...), insert at the front of the segment
@@ -686,10 +735,12 @@ bool BTreePMACC7::storage_insert_unsafe(size_t segment_id, int64_t key, int64_t
         COUT_DEBUG("(odd) segment_id: " << segment_id << ", key: " << key << ", value: " << value << ", position: " << i);
         keys[i] = key;
 
-        for(size_t j = sz; j > i; j--){
-            values[j] = values[j-1];
+        if(!m_storage.m_key_only){
+            for(size_t j = sz; j > i; j--){
+                values[j] = values[j-1];
+            }
+            values[i] = value;
         }
-        values[i] = value;
 
         minimum = (i == 0);
     }
@@ -705,14 +756,16 @@ void BTreePMACC7::spread_insert_unsafe(int64_t* __restrict keys_from, int64_t* _
     size_t i = 0;
     while(i < num_elements && keys_from[i] < new_key){
         keys_to[i] = keys_from[i];
-        values_to[i] = values_from[i];
         i++;
     }
     keys_to[i] = new_key;
-    values_to[i] = new_value;
-
     memcpy(keys_to + i + 1, keys_from + i, (num_elements -i) * sizeof(keys_to[0]));
-    memcpy(values_to + i + 1, values_from + i, (num_elements -i) * sizeof(values_to[0]));
+
+    if(!m_storage.m_key_only){
+        memcpy(values_to, values_from, i * sizeof(values_to[0]));
+        values_to[i] = new_value;
+        memcpy(values_to + i + 1, values_from + i, (num_elements -i) * sizeof(values_to[0]));
+    }
 
     m_storage.m_cardinality++;
 }
@@ -791,7 +844,11 @@ class SpreadWithRewiring {
 
     void acquire_free_space(int64_t** space_keys, int64_t** space_values){
         *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer();
-        *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
+        if(!m_instance.m_storage.m_key_only){
+            *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
+        } else { // the values are an alias of the keys
+            *space_values = *space_keys;
+        }
     }
 
     void rewire_keys(int64_t* addr1, int64_t* addr2){
@@ -816,7 +873,7 @@ class SpreadWithRewiring {
             COUT_DEBUG("reclaim buffers for keys: " << keys_src << ", values: " << values_src);
 
             rewire_keys(keys_dst, keys_src);
-            rewire_values(values_dst, values_src);
+            if(!m_instance.m_storage.m_key_only) rewire_values(values_dst, values_src);
         }
     }
 
@@ -855,7 +912,7 @@ class SpreadWithRewiring {
                 const size_t input_copy_offset = input_run_sz - elements_to_copy;
                 const size_t output_copy_offset = output_run_sz - elements_to_copy;
                 memcpy(output_keys + output_copy_offset, input_keys + input_copy_offset, elements_to_copy * sizeof(output_keys[0]));
-                memcpy(output_values + output_copy_offset, input_values + input_copy_offset, elements_to_copy * sizeof(output_values[0]));
+                if(!m_instance.m_storage.m_key_only) memcpy(output_values + output_copy_offset, input_values + input_copy_offset, elements_to_copy * sizeof(output_values[0]));
                 input_run_sz -= elements_to_copy;
                 output_run_sz -= elements_to_copy;
 
@@ -916,12 +973,12 @@ class SpreadWithRewiring {
         int64_t odd_extents = m_cardinality % num_extents;
 
         assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-        assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+        assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
         for(int64_t i = num_extents -1; i >= 0; i--){
             spread_extent(i, elements_per_extent + (i < odd_extents));
         }
         assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-        assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+        assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
     }
 
     void update_segment_sizes(){
@@ -1050,20 +1107,20 @@ void BTreePMACC7::rebalance(size_t segment_id, int64_t* key, int64_t* value){
     profiler.search_start();
 
     COUT_DEBUG("segment_id: " << segment_id);
-    size_t num_elements = is_insert ? m_storage.m_segment_capacity +1 : m_storage.m_segment_sizes[segment_id];
+    size_t num_elements = m_storage.m_segment_sizes[segment_id] + is_insert; // with uncompressed keys, the segment is full on insert
     // these inits are only valid for the edge case that the calibrator tree has height 1, i.e. the data structure contains only one segment
     double rho = 0.0, theta = 1.0, density = static_cast<double>(num_elements)/m_storage.m_segment_capacity;
     size_t height = 1;
     COUT_DEBUG("height: " << height << ", density: " << density << ", rho: " << rho << ", theta: " << theta << ", num_elements: " << num_elements);
 
-    int window_length = 1;
-    int window_id = segment_id;
-    int window_start = segment_id, window_end = segment_id;
+    int64_t window_length = 1;
+    int64_t window_id = segment_id;
+    int64_t window_start = segment_id, window_end = segment_id;
 
     if(m_storage.m_height > 1){
         // find the bounds of this window
-        int index_left = segment_id -1;
-        int index_right = segment_id +1;
+        int64_t index_left = segment_id -1;
+        int64_t index_right = segment_id +1;
 
         do {
             height++;
@@ -1096,6 +1153,13 @@ void BTreePMACC7::rebalance(size_t segment_id, int64_t* key, int64_t* value){
 
     profiler.search_stop();
 
+    if(m_storage.is_compressed()){
+        spread_insert spread_insert { is_insert ? *key : 0, is_insert ? *value : 0, segment_id };
+        bool do_resize = (is_insert && density > theta) || (!is_insert && density < rho);
+        compressed_rebalance(window_start, window_length, num_elements, do_resize, is_insert ? &spread_insert : nullptr);
+        return;
+    }
+
     if((is_insert &&  density <= theta) || (!is_insert && density >= rho)){
         spread_insert spread_insert, *spread_insert_ptr = nullptr;
         if(is_insert){ spread_insert = { *key, *value, segment_id }; spread_insert_ptr = &spread_insert; }
@@ -1143,6 +1207,18 @@ void BTreePMACC7::resize_rewire(int64_t* new_key, int64_t* new_value){
     const size_t num_segments_after = num_segments_before * 2;
     COUT_DEBUG("segments: " << num_segments_before << " -> " << num_segments_after);
 
+    // with multiple threads?
+    const size_t cardinality_after = m_storage.m_cardinality + (new_key != nullptr ? 1 : 0);
+    if(ParallelSpread::get_num_workers(cardinality_after, m_spread_threads) > 1 &&
+            ParallelSpread::is_aligned(m_storage.m_memory_keys, m_storage.m_segment_capacity, 0, num_segments_after)){
+        spread_insert spread_insert, *spread_insert_ptr = nullptr;
+        if(new_key != nullptr){ spread_insert = { *new_key, *new_value, m_index.find(*new_key) }; spread_insert_ptr = &spread_insert; }
+        m_storage.extend(num_segments_before);
+        m_index.rebuild(num_segments_after);
+        spread_parallel(cardinality_after, 0, num_segments_before, num_segments_after, spread_insert_ptr);
+        return;
+    }
+
     // 1) Extend the PMA
     m_storage.extend(num_segments_before);
     m_index.rebuild(num_segments_after);
@@ -1223,7 +1299,7 @@ void BTreePMACC7::resize_general(int64_t* new_key, int64_t* new_value) {
             size_t cpy1 = min(elements_to_copy, input_size);
             memcpy(output_keys, input_keys, cpy1 * sizeof(m_storage.m_keys[0]));
             output_keys += cpy1; input_keys += cpy1;
-            memcpy(output_values, input_values, cpy1 * sizeof(m_storage.m_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values, input_values, cpy1 * sizeof(m_storage.m_values[0]));
             output_values += cpy1; input_values += cpy1;
             input_size -= cpy1;
             COUT_DEBUG("cpy1: " << cpy1 << ", elements_to_copy: " << elements_to_copy - cpy1 << ", input_size: " << input_size);
@@ -1281,6 +1357,8 @@ void BTreePMACC7::resize_general(int64_t* new_key, int64_t* new_value) {
 }
 
 void BTreePMACC7::spread(size_t cardinality, size_t segment_start, size_t num_segments, spread_insert* spread_insertion){
+    if(spread_parallel(cardinality, segment_start, num_segments, num_segments, spread_insertion)) return;
+
     // Use rewiring ?
     if((m_storage.m_memory_keys != nullptr) && (num_segments * m_storage.m_segment_capacity * sizeof(int64_t) >= m_storage.m_memory_keys->get_extent_size())){
         // if spread_insertion != nullptr, cardinality already counts the element to be inserted
@@ -1292,6 +1370,22 @@ void BTreePMACC7::spread(size_t cardinality, size_t segment_start, size_t num_se
     }
 }
 
+bool BTreePMACC7::spread_parallel(size_t cardinality, size_t segment_start, size_t input_length, size_t output_length, spread_insert* spread_insertion){
+    // if spread_insertion != nullptr, cardinality already counts the element to be inserted
+    size_t num_workers = ParallelSpread::get_num_workers(cardinality, m_spread_threads);
+    if(num_workers <= 1 || !ParallelSpread::is_aligned(m_storage.m_memory_keys, m_storage.m_segment_capacity, segment_start, output_length)) return false;
+    COUT_DEBUG("cardinality: " << cardinality << ", start: " << segment_start << ", segments: " << input_length << " -> " << output_length << ", workers: " << num_workers);
+
+    ParallelSpread spread{ m_storage.m_keys, m_storage.m_key_only ? nullptr : m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity,
+        m_storage.m_memory_keys, m_storage.m_key_only ? nullptr : m_storage.m_memory_values, segment_start, input_length, output_length };
+    spread.set_output_size_uniform(cardinality);
+    if(spread_insertion != nullptr){ spread.set_element_to_insert(spread_insertion->m_key, spread_insertion->m_value, spread_insertion->m_segment_id); }
+    spread.execute(num_workers, &m_index);
+    if(spread_insertion != nullptr){ m_storage.m_cardinality++; }
+
+    return true;
+}
+
 void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, size_t num_segments, spread_insert* spread_insertion){
     int64_t insert_segment_id = spread_insertion != nullptr ? static_cast<int64_t>(spread_insertion->m_segment_id) - segment_start : -1;
     COUT_DEBUG("size: " << cardinality << ", start: " << segment_start << ", length: " << num_segments << ", insertion segment: " << insert_segment_id);
@@ -1310,9 +1404,9 @@ void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, si
     auto& memory_pool = m_memory_pool;
     auto memory_pool_deleter = [&memory_pool](void* ptr){ memory_pool.deallocate(ptr); };
     unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_keys_ptr { m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
-    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_values_ptr {  m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
+    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_values_ptr {  m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
     int64_t* __restrict input_chunk2_keys = input_chunk2_keys_ptr.get();
-    int64_t* __restrict input_chunk2_values = input_chunk2_values_ptr.get();
+    int64_t* __restrict input_chunk2_values = m_storage.m_key_only ? input_chunk2_keys : input_chunk2_values_ptr.get();
 
     // input chunk1 (it overlaps the current window)
     int64_t* __restrict input_chunk1_keys = nullptr;
@@ -1337,7 +1431,7 @@ void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, si
                 input_chunk2_space_left--;
             } else {
                 memcpy(input_chunk2_keys + input_chunk2_space_left - elements2copy, output_keys + output_start, elements2copy * sizeof(input_chunk2_keys[0]));
-                memcpy(input_chunk2_values + input_chunk2_space_left - elements2copy, output_values + output_start, elements2copy * sizeof(input_chunk2_values[0]));
+                if(!m_storage.m_key_only) memcpy(input_chunk2_values + input_chunk2_space_left - elements2copy, output_values + output_start, elements2copy * sizeof(input_chunk2_values[0]));
             }
             input_chunk2_space_left -= elements2copy;
 
@@ -1367,7 +1461,7 @@ void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, si
                 input_chunk1_current--;
             } else {
                 memcpy(output_keys + input_chunk1_current - elements2copy, output_keys + output_start, elements2copy * sizeof(output_keys[0]));
-                memcpy(output_values + input_chunk1_current - elements2copy, output_values + output_start, elements2copy * sizeof(output_values[0]));
+                if(!m_storage.m_key_only) memcpy(output_values + input_chunk1_current - elements2copy, output_values + output_start, elements2copy * sizeof(output_values[0]));
             }
             input_chunk1_current -= elements2copy;
 
@@ -1420,7 +1514,7 @@ void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, si
             size_t elements2copy = min(output_end - output_current, input_size - input_current);
             COUT_DEBUG("elements2copy: " << elements2copy << " output_start: " << output_start << ", output_end: " << output_end << ", output_current: " << output_current);
             memcpy(output_keys + output_current, input_keys + input_current, elements2copy * sizeof(output_keys[0]));
-            memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
             output_current += elements2copy;
             input_current += elements2copy;
             // switch to the second chunk
@@ -1445,6 +1539,7 @@ void BTreePMACC7::spread_two_copies(size_t cardinality, size_t segment_start, si
  *****************************************************************************/
 int64_t BTreePMACC7::remove(int64_t key){
     if(empty()) return -1;
+    if(m_storage.is_compressed()) return compressed_remove(key);
 
     auto segment_id = m_index.find(key);
     COUT_DEBUG("key: " << key << ", bucket: " << segment_id);
@@ -1459,11 +1554,11 @@ int64_t BTreePMACC7::remove(int64_t key){
         size_t imin = m_storage.m_segment_capacity - sz, i;
         for(i = imin; i < m_storage.m_segment_capacity; i++){ if(keys[i] == key) break; }
         if(i < m_storage.m_segment_capacity){ // found ?
-            value = values[i];
+            value = m_storage.m_key_only ? key : values[i];
             // shift the rest of the elements by 1
             for(size_t j = i; j > imin; j--){
                 keys[j] = keys[j -1];
-                values[j] = values[j-1];
+                if(!m_storage.m_key_only) values[j] = values[j-1];
             }
 
             sz--;
@@ -1483,11 +1578,11 @@ int64_t BTreePMACC7::remove(int64_t key){
         size_t i = 0;
         for( ; i < sz; i++){ if(keys[i] == key) break; }
         if(i < sz){ // found?
-            value = values[i];
+            value = m_storage.m_key_only ? key : values[i];
             // shift the rest of the elements by 1
             for(size_t j = i; j < sz - 1; j++){
                 keys[j] = keys[j+1];
-                values[j] = values[j+1];
+                if(!m_storage.m_key_only) values[j] = values[j+1];
             }
 
             sz--;
@@ -1522,6 +1617,7 @@ int64_t BTreePMACC7::remove(int64_t key){
  *****************************************************************************/
 int64_t BTreePMACC7::find(int64_t key) const {
     if(empty()) return -1;
+    if(m_storage.is_compressed()) return compressed_find(key);
 
     auto segment_id = m_index.find(key);
 //    COUT_DEBUG("key: " << key << ", bucket: " << segment_id);
@@ -1692,6 +1788,19 @@ std::pair<int64_t, int64_t> Iterator::next() {
     return result;
 }
 
+size_t Iterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    if(m_offset >= m_stop) return 0;
+
+    *out_keys = m_pma.m_keys + m_offset;
+    *out_values = m_pma.m_values + m_offset;
+    size_t length = m_stop - m_offset;
+
+    m_offset = m_stop;
+    next_sequence();
+
+    return length;
+}
+
 } // namespace btree_pmacc7_details
 
 unique_ptr<pma::Iterator> BTreePMACC7::empty_iterator() const{
@@ -1700,10 +1809,14 @@ unique_ptr<pma::Iterator> BTreePMACC7::empty_iterator() const{
 
 unique_ptr<pma::Iterator> BTreePMACC7::find(int64_t min, int64_t max) const {
     if(empty()) return empty_iterator();
+    if(m_storage.is_compressed()) return make_unique<btree_pmacc7_details::CompressedIterator>(m_storage, m_index.find_first(min), m_index.find_last(max), min, max);
     return make_unique<btree_pmacc7_details::Iterator> (m_storage, m_index.find_first(min), m_index.find_last(max), min, max );
 }
 unique_ptr<pma::Iterator> BTreePMACC7::iterator() const {
     if(empty()) return empty_iterator();
+    if(m_storage.is_compressed()){
+        return make_unique<btree_pmacc7_details::CompressedIterator>(m_storage, 0, m_storage.m_number_segments -1, numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max());
+    }
     return make_unique<btree_pmacc7_details::Iterator> (m_storage, 0, m_storage.m_number_segments -1,
             numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max()
     );
@@ -1711,116 +1824,576 @@ unique_ptr<pma::Iterator> BTreePMACC7::iterator() const {
 
 /*****************************************************************************
  *                                                                           *
- *   Aggregate sum                                                           *
+ *   Aggregate sum & scan                                                    *
  *                                                                           *
  *****************************************************************************/
-pma::Interface::SumResult BTreePMACC7::sum(int64_t min, int64_t max) const {
-    if((min > max) || empty()){ return SumResult{}; }
-    int64_t segment_start = m_index.find_first(min);
-    int64_t segment_end = m_index.find_last(max);
-    if(segment_end < segment_start){ return SumResult{}; }
+namespace btree_pmacc7_details {
+// Invoke fn(keys, values, length) for each run of contiguous elements in [min, max], until it returns false
+template<typename Function>
+static void scan_runs(const PMA& storage, int64_t segment_start, int64_t segment_end, int64_t min, int64_t max, Function fn){
+    if(segment_end < segment_start){ return; }
 
-    int64_t* __restrict keys = m_storage.m_keys;
+    const int64_t* __restrict keys = storage.m_keys;
+    const ssize_t segment_capacity = storage.m_segment_capacity;
+    const ssize_t num_segments = storage.m_number_segments;
 
+    // start of the interval
     bool notfound = true;
     ssize_t segment_id = segment_start;
-    bool segment_even = segment_id % 2 == 0;
-    ssize_t start = -1, stop = -1, offset = -1;
+    ssize_t offset = -1, stop = -1;
+    while(notfound && segment_id < num_segments){
+        ssize_t start;
+        if(segment_id % 2 == 0){ // even, the elements are at the end of the segment
+            stop = (segment_id +1) * segment_capacity;
+            start = stop - storage.m_segment_sizes[segment_id];
+        } else { // odd, the elements are at the start of the segment
+            start = segment_id * segment_capacity;
+            stop = start + storage.m_segment_sizes[segment_id];
+        }
+        offset = start + segment_lower_bound(keys + start, stop - start, min);
+        COUT_DEBUG("lower interval, segment: " << segment_id << ", start: " << start << ", stop: " << stop << ", offset: " << offset);
 
-    // start of the interval
-    while(notfound && segment_id < m_storage.m_number_segments){
-        if(segment_even){
-            stop = (segment_id +1) * m_storage.m_segment_capacity;
-            start = stop - m_storage.m_segment_sizes[segment_id];
-            COUT_DEBUG("lower interval, even segment, start: " << start << ", stop: " << stop);
+        notfound = (offset == stop);
+        if(notfound){ segment_id++; }
+    }
+
+    if(notfound || keys[offset] > max){ return; }
+
+    if(segment_id % 2 == 0 && segment_id < num_segments -1){
+        stop = (segment_id +1) * segment_capacity + storage.m_segment_sizes[segment_id +1]; // +1 implicit
+    }
+
+    // end of the interval, one past the last qualifying element
+    assert(segment_end < num_segments);
+    ssize_t end = -1;
+    for(ssize_t j = segment_end; end < 0 && j >= segment_id; j--){
+        ssize_t start, stop;
+        if(j % 2 == 0){ // even
+            stop = (j +1) * segment_capacity;
+            start = stop - storage.m_segment_sizes[j];
         } else { // odd
-            start = segment_id * m_storage.m_segment_capacity;
-            stop = start + m_storage.m_segment_sizes[segment_id];
-            COUT_DEBUG("lower interval, odd segment, start: " << start << ", stop: " << stop);
+            start = j * segment_capacity;
+            stop = start + storage.m_segment_sizes[j];
         }
-        offset = start;
+        ssize_t count = segment_upper_bound(keys + start, stop - start, max);
+        COUT_DEBUG("upper interval, segment: " << j << ", start: " << start << ", stop: " << stop << ", count: " << count);
+        if(count > 0){ end = start + count; }
+    }
 
-        while(offset < stop && keys[offset] < min) {
-            COUT_DEBUG("lower interval, offset: " << offset << ", key: " << keys[offset] << ", key_min: " << min);
-            offset++;
+    if(end <= offset) return;
+    stop = std::min(stop, end);
+
+    const int64_t* __restrict values = storage.m_values;
+    bool proceed = true;
+
+    while(proceed && offset < end){
+        proceed = fn(keys + offset, values + offset, static_cast<size_t>(stop - offset));
+        offset = stop;
+
+        segment_id += 1 + (segment_id % 2 == 0); // next even segment
+        if(segment_id < num_segments){
+            ssize_t size_lhs = storage.m_segment_sizes[segment_id];
+            ssize_t size_rhs = storage.m_segment_sizes[segment_id +1];
+            offset = (segment_id +1) * segment_capacity - size_lhs;
+            stop = std::min(end, offset + size_lhs + size_rhs);
+
+            // request the following pair of segments, while processing the current one
+            if(segment_id +2 < num_segments){
+                ssize_t offset_next = (segment_id +3) * segment_capacity - storage.m_segment_sizes[segment_id +2];
+                PREFETCH(keys + offset_next);
+                PREFETCH(values + offset_next);
+            }
         }
+    }
+}
+} // namespace btree_pmacc7_details
 
-        notfound = (offset == stop);
-        if(notfound){
-            segment_id++;
-            segment_even = !segment_even; // flip
+pma::Interface::SumResult BTreePMACC7::sum(int64_t min, int64_t max) const {
+    SumResult sum;
+    if((min > max) || empty()){ return sum; }
+
+    auto fn = [&sum](const int64_t* keys, const int64_t* values, size_t length){
+        if(sum.m_num_elements == 0){ sum.m_first_key = keys[0]; }
+        sum.m_num_elements += length;
+        segment_sum(keys, values, length, &sum.m_sum_keys, &sum.m_sum_values);
+        sum.m_last_key = keys[length -1];
+        return true;
+    };
+
+    if(m_storage.is_compressed()){
+        compressed_scan(min, max, fn);
+    } else {
+        scan_runs(m_storage, m_index.find_first(min), m_index.find_last(max), min, max, fn);
+    }
+
+    return sum;
+}
+
+void BTreePMACC7::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    if((min > max) || empty()){ return; }
+
+    auto fn = [&visitor](const int64_t* keys, const int64_t* values, size_t length){
+        return visitor.visit(keys, values, length);
+    };
+
+    if(m_storage.is_compressed()){
+        compressed_scan(min, max, fn);
+    } else {
+        scan_runs(m_storage, m_index.find_first(min), m_index.find_last(max), min, max, fn);
+    }
+}
+
+
+/*****************************************************************************
+ *                                                                           *
+ *   Compressed keys                                                         *
+ *                                                                           *
+ *****************************************************************************/
+bool BTreePMACC7::compressed_insert(size_t segment_id, int64_t key, int64_t value){
+    const size_t size = m_storage.m_segment_sizes[segment_id];
+    if(size == m_storage.m_segment_capacity) return false; // the segment is full
+    uint8_t* segment = m_storage.get_compressed_segment(segment_id);
+
+    // does the new key fit the space of the segment?
+    if(size > 0){
+        int64_t min = std::min(compressed_segment_get_base(segment), key);
+        int64_t max = std::max(compressed_segment_key(segment, size -1), key);
+        if(!compressed_segment_fits(min, max, size +1, m_storage.m_compressed_bytes)) return false;
+    }
+
+    // insert the key
+    size_t position = compressed_segment_upper_bound(segment, size, key);
+    int64_t* keys = m_memory_pool.allocate<int64_t>(size +1);
+    compressed_segment_load(segment, size, keys);
+    memmove(keys + position +1, keys + position, (size - position) * sizeof(keys[0]));
+    keys[position] = key;
+    compressed_segment_store(segment, keys, size +1);
+    m_memory_pool.deallocate(keys);
+
+    // insert the value
+    if(!m_storage.m_key_only){
+        int64_t* values = m_storage.m_values + m_storage.get_offset(segment_id, size);
+        if(segment_id % 2 == 0){ // even segment, the elements are at the end, shift the preceding elements towards the start
+            memmove(values -1, values, position * sizeof(values[0]));
+            values[position -1] = value;
+        } else { // odd segment, the elements are at the start, shift the following elements towards the end
+            memmove(values + position +1, values + position, (size - position) * sizeof(values[0]));
+            values[position] = value;
         }
     }
 
-    if(segment_even && segment_id < (m_storage.m_number_segments -1)){
-        stop = (segment_id +1) * m_storage.m_segment_capacity + m_storage.m_segment_sizes[segment_id +1]; // +1 implicit
+    m_storage.m_segment_sizes[segment_id]++;
+    m_storage.m_cardinality++;
+
+    // have we just updated the minimum ?
+    if(position == 0) m_index.set_separator_key(segment_id, key);
+
+    return true;
+}
+
+int64_t BTreePMACC7::compressed_remove(int64_t key){
+    auto segment_id = m_index.find(key);
+    COUT_DEBUG("key: " << key << ", segment: " << segment_id);
+    uint8_t* segment = m_storage.get_compressed_segment(segment_id);
+    size_t size = m_storage.m_segment_sizes[segment_id];
+    size_t position = compressed_segment_lower_bound(segment, size, key);
+    if(position == size || compressed_segment_key(segment, position) != key) return -1; // not found
+
+    int64_t* values = m_storage.m_values + m_storage.get_offset(segment_id, size);
+    int64_t value = m_storage.m_key_only ? key : values[position];
+
+    // remove the key. Removing an element never increases the space of the encoded keys
+    int64_t* keys = m_memory_pool.allocate<int64_t>(size);
+    compressed_segment_load(segment, size, keys);
+    memmove(keys + position, keys + position +1, (size - position -1) * sizeof(keys[0]));
+    size--;
+    compressed_segment_store(segment, keys, size);
+    int64_t minimum = keys[0];
+    m_memory_pool.deallocate(keys);
+
+    // remove the value
+    if(!m_storage.m_key_only){
+        if(segment_id % 2 == 0){ // even segment, shift the preceding elements towards the end
+            memmove(values +1, values, position * sizeof(values[0]));
+        } else { // odd segment, shift the following elements towards the start
+            memmove(values + position, values + position +1, (size - position) * sizeof(values[0]));
+        }
     }
 
-    if(notfound || keys[offset] > max){ return SumResult{}; }
+    m_storage.m_segment_sizes[segment_id] = size;
+    m_storage.m_cardinality--;
 
-    ssize_t end;
-    { // find the last qualifying index
-        assert(segment_end < m_storage.m_number_segments);
-        auto interval_start_segment = segment_id;
-        ssize_t segment_id = segment_end;
-        bool segment_even = segment_id % 2 == 0;
-        notfound = true;
-        ssize_t offset, start, stop;
+    // update the minimum
+    if(position == 0){
+        if(m_storage.m_cardinality == 0){ // global minimum
+            m_index.set_separator_key(0, numeric_limits<int64_t>::min());
+        } else if(size > 0){ // otherwise we are going to rebalance this segment anyway
+            m_index.set_separator_key(segment_id, minimum);
+        }
+    }
 
-        while(notfound && segment_id >= interval_start_segment){
-            if(segment_even){
-                start = (segment_id +1) * m_storage.m_segment_capacity -1;
-                stop = start - m_storage.m_segment_sizes[segment_id];
-            } else { // odd
-                stop = segment_id * m_storage.m_segment_capacity;
-                start = stop + m_storage.m_segment_sizes[segment_id] -1;
-            }
-            COUT_DEBUG("upper interval, " << (segment_even ? "even":"odd") << " segment, start: " << start << " [key=" << keys[start] << "], stop: " << stop);
-            offset = start;
+    // shall we rebalance ?
+    if(m_storage.m_number_segments > 1){
+        const size_t minimum_size = max<size_t>(thresholds(1).first * m_storage.m_segment_capacity, 1); // at least one element per segment
+        if(size < minimum_size){ rebalance(segment_id, nullptr, nullptr); }
+    }
 
-            while(offset >= stop && keys[offset] > max){
-                COUT_DEBUG("upper interval, offset: " << offset << ", key: " << keys[offset] << ", key_max: " << max);
-                offset--;
-            }
+#if defined(DEBUG)
+    dump();
+#endif
 
-            notfound = offset < stop;
-            if(notfound){
-                segment_id--;
-                segment_even = !segment_even; // flip
+    return value;
+}
+
+int64_t BTreePMACC7::compressed_find(int64_t key) const {
+    auto segment_id = m_index.find(key);
+    const uint8_t* segment = m_storage.get_compressed_segment(segment_id);
+    size_t size = m_storage.m_segment_sizes[segment_id];
+    size_t position = compressed_segment_lower_bound(segment, size, key);
+    if(position < size && compressed_segment_key(segment, position) == key){
+        return m_storage.m_key_only ? key : m_storage.m_values[m_storage.get_offset(segment_id, size) + position];
+    } else {
+        return -1;
+    }
+}
+
+void BTreePMACC7::compressed_rebalance(size_t window_start, size_t window_length, size_t cardinality, bool do_resize, spread_insert* insertion){
+    // the density thresholds are satisfied, but the keys of the window may still not fit the space of their segments
+    // once spread. In this case, keep enlarging the window
+    while(!do_resize && !compressed_spread(cardinality, window_start, window_length, insertion)){
+        if(window_length < m_storage.m_number_segments){
+            size_t sibling_start = (window_start / window_length) % 2 == 0 ? window_start + window_length : window_start - window_length;
+            for(size_t i = sibling_start; i < sibling_start + window_length; i++){ cardinality += m_storage.m_segment_sizes[i]; }
+            window_length *= 2;
+            window_start = (window_start / window_length) * window_length;
+            COUT_DEBUG("the keys do not fit, window enlarged to [" << window_start << ", " << window_start + window_length << ")");
+        } else {
+            do_resize = true;
+        }
+    }
+
+    if(do_resize){
+        compressed_resize(insertion);
+    }
+}
+
+bool BTreePMACC7::compressed_spread(size_t cardinality, size_t window_start, size_t window_length, spread_insert* insertion){
+    // if insertion != nullptr, cardinality already counts the element to be inserted
+    COUT_DEBUG("cardinality: " << cardinality << ", window: [" << window_start << ", " << window_start + window_length << ")");
+
+    if(ParallelSpread::is_aligned(m_storage.m_memory_keys, m_storage.m_segment_capacity, window_start, window_length, m_storage.m_compressed_bytes)){
+        // large windows, encode the keys straight into the buffers of the rewired memory
+        ParallelSpread spread{ m_storage.m_keys, m_storage.m_key_only ? nullptr : m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity,
+            m_storage.m_memory_keys, m_storage.m_key_only ? nullptr : m_storage.m_memory_values, window_start, window_length, window_length, m_storage.m_compressed_bytes };
+        spread.set_output_size_uniform(cardinality);
+        if(insertion != nullptr){ spread.set_element_to_insert(insertion->m_key, insertion->m_value, insertion->m_segment_id); }
+        if(!spread.fits()) return false;
+        spread.execute(ParallelSpread::get_num_workers(cardinality, m_spread_threads), &m_index);
+    } else {
+        // small windows, gather the elements in a workspace
+        auto& memory_pool = m_memory_pool;
+        auto memory_pool_deleter = [&memory_pool](void* ptr){ memory_pool.deallocate(ptr); };
+        unique_ptr<int64_t, decltype(memory_pool_deleter)> keys_ptr { m_memory_pool.allocate<int64_t>(cardinality), memory_pool_deleter };
+        unique_ptr<int64_t, decltype(memory_pool_deleter)> values_ptr { m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(cardinality), memory_pool_deleter };
+        compressed_gather(window_start, window_length, insertion, keys_ptr.get(), values_ptr.get());
+        if(!compressed_fits(keys_ptr.get(), cardinality, window_length)) return false;
+        compressed_store(window_start, window_length, keys_ptr.get(), values_ptr.get(), cardinality);
+    }
+
+    if(insertion != nullptr){ m_storage.m_cardinality++; }
+    return true;
+}
+
+void BTreePMACC7::compressed_resize(spread_insert* insertion){
+    const bool is_insert = insertion != nullptr;
+    const size_t cardinality = m_storage.m_cardinality + is_insert;
+
+    if(is_insert && m_storage.m_memory_keys != nullptr){
+        // extend the rewired memory and spread the elements in place, until the keys fit their segments
+        const size_t num_segments_before = m_storage.m_number_segments;
+        bool done = false;
+        do {
+            m_storage.extend(m_storage.m_number_segments);
+            COUT_DEBUG("segments: " << num_segments_before << " -> " << m_storage.m_number_segments);
+
+            ParallelSpread spread{ m_storage.m_keys, m_storage.m_key_only ? nullptr : m_storage.m_values, m_storage.m_segment_sizes, m_storage.m_segment_capacity,
+                m_storage.m_memory_keys, m_storage.m_key_only ? nullptr : m_storage.m_memory_values, 0, num_segments_before, m_storage.m_number_segments, m_storage.m_compressed_bytes };
+            spread.set_output_size_uniform(cardinality);
+            spread.set_element_to_insert(insertion->m_key, insertion->m_value, insertion->m_segment_id);
+            done = spread.fits();
+            if(done){
+                m_index.rebuild(m_storage.m_number_segments);
+                spread.execute(ParallelSpread::get_num_workers(cardinality, m_spread_threads), &m_index);
             }
+        } while(!done);
+        m_storage.m_cardinality = cardinality;
+    } else {
+        // gather all elements and rebuild the arrays
+        auto& memory_pool = m_memory_pool;
+        auto memory_pool_deleter = [&memory_pool](void* ptr){ memory_pool.deallocate(ptr); };
+        unique_ptr<int64_t, decltype(memory_pool_deleter)> keys_ptr { m_memory_pool.allocate<int64_t>(cardinality), memory_pool_deleter };
+        unique_ptr<int64_t, decltype(memory_pool_deleter)> values_ptr { m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(cardinality), memory_pool_deleter };
+        compressed_gather(0, m_storage.m_number_segments, insertion, keys_ptr.get(), values_ptr.get());
+        size_t num_segments = is_insert ? m_storage.m_number_segments * 2 : max<size_t>(1, m_storage.m_number_segments / 2);
+        compressed_rebuild(keys_ptr.get(), values_ptr.get(), cardinality, num_segments);
+    }
+
+    // side effect: regenerate the thresholds
+    thresholds(m_storage.m_height, m_storage.m_height);
+}
+
+void BTreePMACC7::compressed_rebuild(const int64_t* keys, const int64_t* values, size_t cardinality, size_t num_segments){
+    // avoid empty segments
+    while(num_segments > 1 && num_segments > cardinality){ num_segments /= 2; }
+    // the density of the new array must not exceed the upper threshold of the root
+    auto root_threshold = [this](size_t num_segments){ int height = log2(num_segments) +1; return thresholds(height, height).second; };
+    while(num_segments * m_storage.m_segment_capacity * root_threshold(num_segments) < cardinality){ num_segments *= 2; }
+    // the keys must fit the space of their segments. Two keys of any width always fit a segment
+    while(!compressed_fits(keys, cardinality, num_segments)){ num_segments *= 2; }
+    COUT_DEBUG("segments: " << m_storage.m_number_segments << " -> " << num_segments << ", cardinality: " << cardinality);
+
+    // replace the storage, the previous workspace is released by ixCleanup
+    int64_t* ixKeys;
+    int64_t* ixValues;
+    decltype(m_storage.m_segment_sizes) ixSizes;
+    BufferedRewiredMemory* ixRewiredMemoryKeys;
+    BufferedRewiredMemory* ixRewiredMemoryValues;
+    RewiredMemory* ixRewiredMemoryCardinalities;
+    m_storage.alloc_workspace(num_segments, &ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities);
+    swap(ixKeys, m_storage.m_keys);
+    swap(ixValues, m_storage.m_values);
+    swap(ixSizes, m_storage.m_segment_sizes);
+    swap(ixRewiredMemoryKeys, m_storage.m_memory_keys);
+    swap(ixRewiredMemoryValues, m_storage.m_memory_values);
+    swap(ixRewiredMemoryCardinalities, m_storage.m_memory_sizes);
+    auto xDeleter = [&](void*){ PMA::dealloc_workspace(&ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities); };
+    unique_ptr<BTreePMACC7, decltype(xDeleter)> ixCleanup { this, xDeleter };
+
+    m_storage.m_capacity = num_segments * m_storage.m_segment_capacity;
+    m_storage.m_number_segments = num_segments;
+    m_storage.m_height = log2(num_segments) +1;
+    m_storage.m_cardinality = cardinality;
+    m_index.rebuild(num_segments);
+
+    if(cardinality == 0){
+        m_storage.m_segment_sizes[0] = 0;
+        m_index.set_separator_key(0, numeric_limits<int64_t>::min());
+    } else {
+        compressed_store(0, num_segments, keys, values, cardinality);
+    }
+}
+
+size_t BTreePMACC7::compressed_gather(size_t window_start, size_t window_length, const spread_insert* insertion, int64_t* __restrict out_keys, int64_t* __restrict out_values) const {
+    size_t cardinality = 0;
+    for(size_t segment_id = window_start, end = window_start + window_length; segment_id < end; segment_id++){
+        size_t size = m_storage.m_segment_sizes[segment_id];
+        compressed_segment_load(m_storage.get_compressed_segment(segment_id), size, out_keys + cardinality);
+        if(out_values != nullptr){ memcpy(out_values + cardinality, m_storage.m_values + m_storage.get_offset(segment_id, size), size * sizeof(out_values[0])); }
+        cardinality += size;
+    }
+
+    if(insertion != nullptr){
+        size_t position = segment_upper_bound(out_keys, cardinality, insertion->m_key);
+        memmove(out_keys + position +1, out_keys + position, (cardinality - position) * sizeof(out_keys[0]));
+        out_keys[position] = insertion->m_key;
+        if(out_values != nullptr){
+            memmove(out_values + position +1, out_values + position, (cardinality - position) * sizeof(out_values[0]));
+            out_values[position] = insertion->m_value;
         }
+        cardinality++;
+    }
+
+    return cardinality;
+}
+
+bool BTreePMACC7::compressed_fits(const int64_t* keys, size_t cardinality, size_t num_segments) const {
+    const size_t elements_per_segment = cardinality / num_segments;
+    const size_t odd_segments = cardinality % num_segments;
+    if(elements_per_segment + (odd_segments > 0) > m_storage.m_segment_capacity) return false;
 
-        end = offset +1;
+    for(size_t i = 0; i < num_segments; i++){
+        size_t size = elements_per_segment + (i < odd_segments);
+        if(size > 0 && !compressed_segment_fits(keys[0], keys[size -1], size, m_storage.m_compressed_bytes)) return false;
+        keys += size;
     }
 
-    if(end <= offset) return SumResult{};
-    stop = std::min(stop, end);
+    return true;
+}
 
-    int64_t* __restrict values = m_storage.m_values;
-    SumResult sum;
-    sum.m_first_key = keys[offset];
+void BTreePMACC7::compressed_store(size_t window_start, size_t window_length, const int64_t* keys, const int64_t* values, size_t cardinality){
+    assert(compressed_fits(keys, cardinality, window_length));
+    const size_t elements_per_segment = cardinality / window_length;
+    const size_t odd_segments = cardinality % window_length;
 
-    while(offset < end){
-        sum.m_num_elements += (stop - offset);
-        while(offset < stop){
-            sum.m_sum_keys += keys[offset];
-            sum.m_sum_values += values[offset];
-            offset++;
+    for(size_t i = 0; i < window_length; i++){
+        size_t segment_id = window_start + i;
+        size_t size = elements_per_segment + (i < odd_segments);
+        compressed_segment_store(m_storage.get_compressed_segment(segment_id), keys, size);
+        if(values != nullptr){
+            memcpy(m_storage.m_values + m_storage.get_offset(segment_id, size), values, size * sizeof(values[0]));
+            values += size;
         }
+        m_storage.m_segment_sizes[segment_id] = size;
+        if(size > 0){ m_index.set_separator_key(segment_id, keys[0]); }
+        keys += size;
+    }
+}
 
-        segment_id += 1 + (segment_id % 2 == 0); // next even segment
-        if(segment_id < m_storage.m_number_segments){
-            ssize_t size_lhs = m_storage.m_segment_sizes[segment_id];
-            ssize_t size_rhs = m_storage.m_segment_sizes[segment_id +1];
-            offset = (segment_id +1) * m_storage.m_segment_capacity - size_lhs;
-            stop = std::min(end, offset + size_lhs + size_rhs);
+void BTreePMACC7::compressed_load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz){
+    // a few elements, insert them one by one
+    if(array_sz * m_storage.m_segment_capacity < m_storage.m_cardinality){
+        for(size_t i = 0; i < array_sz; i++){ insert(array[i].first, array[i].second); }
+        return;
+    }
+
+    // otherwise merge them with the current elements and rebuild the arrays
+    const size_t cardinality = m_storage.m_cardinality + array_sz;
+    unique_ptr<int64_t[]> current_keys { new int64_t[m_storage.m_cardinality] };
+    unique_ptr<int64_t[]> current_values { m_storage.m_key_only ? nullptr : new int64_t[m_storage.m_cardinality] };
+    if(!empty()){ compressed_gather(0, m_storage.m_number_segments, nullptr, current_keys.get(), current_values.get()); } // the sizes of an empty array are not initialised
+    unique_ptr<int64_t[]> keys { new int64_t[cardinality] };
+    unique_ptr<int64_t[]> values { m_storage.m_key_only ? nullptr : new int64_t[cardinality] };
+    size_t i = 0, j = 0, k = 0;
+    while(i < m_storage.m_cardinality || j < array_sz){
+        if(j == array_sz || (i < m_storage.m_cardinality && current_keys[i] <= array[j].first)){
+            keys[k] = current_keys[i];
+            if(!m_storage.m_key_only) values[k] = current_values[i];
+            i++;
+        } else {
+            keys[k] = array[j].first;
+            if(!m_storage.m_key_only) values[k] = array[j].second;
+            j++;
         }
+        k++;
     }
-    sum.m_last_key = keys[end -1];
+    current_keys.reset();
+    current_values.reset();
 
-    return sum;
+    compressed_rebuild(keys.get(), values.get(), cardinality, m_storage.m_number_segments);
+    thresholds(m_storage.m_height, m_storage.m_height); // side effect: regenerate the thresholds
 }
 
+template<typename Function>
+void BTreePMACC7::compressed_scan(int64_t min, int64_t max, Function fn) const {
+    const size_t segment_start = m_index.find_first(min);
+    const size_t segment_end = m_index.find_last(max);
+    unique_ptr<int64_t[]> keys { new int64_t[m_storage.m_segment_capacity] }; // the decoded keys of the current segment
+
+    for(size_t segment_id = segment_start; segment_id <= segment_end; segment_id++){
+        const uint8_t* segment = m_storage.get_compressed_segment(segment_id);
+        size_t size = m_storage.m_segment_sizes[segment_id];
+        size_t start = 0, stop = size;
+        if(segment_id == segment_start){ start = compressed_segment_lower_bound(segment, size, min); }
+        if(segment_id == segment_end){ stop = compressed_segment_upper_bound(segment, size, max); }
+        if(start >= stop) continue;
+
+        compressed_segment_load(segment, stop, keys.get());
+        const int64_t* values = m_storage.m_key_only ? keys.get() : m_storage.m_values + m_storage.get_offset(segment_id, size);
+        if(!fn(keys.get() + start, values + start, stop - start)) return;
+    }
+}
+
+void BTreePMACC7::compressed_dump_storage(std::ostream& out, bool* integrity_check) const {
+    int64_t previous_key = numeric_limits<int64_t>::min();
+    unique_ptr<int64_t[]> keys { new int64_t[m_storage.m_segment_capacity] };
+    size_t tot_count = 0;
+
+    for(size_t i = 0; i < m_storage.m_number_segments; i++){
+        const uint8_t* segment = m_storage.get_compressed_segment(i);
+        size_t size = m_storage.m_segment_sizes[i];
+        const int64_t* values = m_storage.m_key_only ? keys.get() : m_storage.m_values + m_storage.get_offset(i, size);
+        compressed_segment_load(segment, size, keys.get());
+        out << "[" << i << "] base: " << compressed_segment_get_base(segment) << ", width: " << compressed_segment_get_width(segment) << ", size: " << size << " :: ";
+
+        for(size_t j = 0; j < size; j++){
+            if(j > 0) out << ", ";
+            out << "<" << keys[j] << ", " << values[j] << ">";
+
+            // sanity check
+            if(keys[j] < previous_key){
+                out << " (ERROR: order mismatch: " << previous_key << " > " << keys[j] << ")";
+                if(integrity_check) *integrity_check = false;
+            }
+            previous_key = keys[j];
+        }
+        out << endl;
+
+        if(size > 0 && keys[0] != m_index.get_separator_key(i)){
+            out << " (ERROR: invalid pivot, minimum: " << keys[0] << ", pivot: " << m_index.get_separator_key(i) <<  ")" << endl;
+            if(integrity_check) *integrity_check = false;
+        }
+        if(size > 0 && !compressed_segment_fits(keys[0], keys[size -1], size, m_storage.m_compressed_bytes)){
+            out << " (ERROR: the compressed keys overflow the segment)" << endl;
+            if(integrity_check) *integrity_check = false;
+        }
+
+        tot_count += size;
+    }
+
+    if(m_storage.m_cardinality != tot_count){
+        out << " (ERROR: size mismatch, pma registered cardinality: " << m_storage.m_cardinality << ", computed cardinality: " << tot_count <<  ")" << endl;
+        if(integrity_check) *integrity_check = false;
+    }
+}
+
+namespace btree_pmacc7_details {
+
+CompressedIterator::CompressedIterator(const PMA& storage, size_t segment_start, size_t segment_end, int64_t key_min, int64_t key_max) :
+        m_pma(storage), m_next_segment(segment_start), m_segment_end(segment_end), m_key_max(key_max) {
+    if(segment_start > segment_end) throw invalid_argument("segment_start > segment_end");
+    m_buffers[0].reset(new int64_t[storage.m_segment_capacity]);
+    m_buffers[1].reset(new int64_t[storage.m_segment_capacity]);
+    if(segment_end >= storage.m_number_segments) return;
+    next_segment(key_min);
+}
+
+void CompressedIterator::next_segment(int64_t key_min) {
+    m_offset = m_stop = 0;
+    while(m_offset >= m_stop && m_next_segment <= m_segment_end){
+        size_t segment_id = m_next_segment++;
+        const uint8_t* segment = m_pma.get_compressed_segment(segment_id);
+        size_t size = m_pma.m_segment_sizes[segment_id];
+        m_offset = compressed_segment_lower_bound(segment, size, key_min);
+        m_stop = compressed_segment_upper_bound(segment, size, m_key_max);
+        if(m_stop < size){ m_segment_end = segment_id; } // the following segments contain only keys greater than key_max
+
+        if(m_offset < m_stop){
+            m_current_buffer = 1 - m_current_buffer;
+            int64_t* keys = m_buffers[m_current_buffer].get();
+            compressed_segment_load(segment, m_stop, keys);
+            m_keys = keys;
+            m_values = m_pma.m_key_only ? keys : m_pma.m_values + m_pma.get_offset(segment_id, size);
+        }
+    }
+}
+
+bool CompressedIterator::hasNext() const {
+    return m_offset < m_stop;
+}
+
+std::pair<int64_t, int64_t> CompressedIterator::next() {
+    pair<int64_t, int64_t> result { m_keys[m_offset], m_values[m_offset] };
+
+    m_offset++;
+    if(m_offset >= m_stop) next_segment(numeric_limits<int64_t>::min());
+
+    return result;
+}
+
+size_t CompressedIterator::next_block(const int64_t** out_keys, const int64_t** out_values) {
+    if(m_offset >= m_stop) return 0;
+
+    *out_keys = m_keys + m_offset;
+    *out_values = m_values + m_offset;
+    size_t length = m_stop - m_offset;
+
+    m_offset = m_stop;
+    next_segment(numeric_limits<int64_t>::min()); // decoded in the other buffer, the current block stays valid
+
+    return length;
+}
+
+} // namespace btree_pmacc7_details
 
 /*****************************************************************************
  *                                                                           *
@@ -1895,7 +2468,11 @@ class SpreadWithRewiringBulkLoading {
 
     void acquire_free_space(int64_t** space_keys, int64_t** space_values){
         *space_keys = (int64_t*) m_instance.m_storage.m_memory_keys->acquire_buffer();
-        *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
+        if(!m_instance.m_storage.m_key_only){
+            *space_values = (int64_t*) m_instance.m_storage.m_memory_values->acquire_buffer();
+        } else { // the values are an alias of the keys
+            *space_values = *space_keys;
+        }
     }
 
     void rewire_keys(int64_t* addr1, int64_t* addr2){
@@ -1920,7 +2497,7 @@ class SpreadWithRewiringBulkLoading {
 //            COUT_DEBUG("reclaim buffers for keys: " << keys_src << ", values: " << values_src);
 
             rewire_keys(keys_dst, keys_src);
-            rewire_values(values_dst, values_src);
+            if(!m_instance.m_storage.m_key_only) rewire_values(values_dst, values_src);
         }
     }
 
@@ -1973,7 +2550,7 @@ class SpreadWithRewiringBulkLoading {
             while(k >= 0 && input1_index >= 0 && input2_index >= 0){
                 if(input1_keys[ input1_index ] > input2_elts[ input2_index ].first ){
                     output_keys[k] = input1_keys[ input1_index ];
-                    output_values[k] = input1_values[ input1_index ];
+                    if(!m_instance.m_storage.m_key_only) output_values[k] = input1_values[ input1_index ];
                     input1_index--;
 
                     // fetch the next input sequence
@@ -1993,7 +2570,7 @@ class SpreadWithRewiringBulkLoading {
                     }
                 } else {
                     output_keys[k] = input2_elts[ input2_index ].first;
-                    output_values[k] = input2_elts[ input2_index ].second;
+                    if(!m_instance.m_storage.m_key_only) output_values[k] = input2_elts[ input2_index ].second;
                     input2_index--;
                 }
 
@@ -2002,7 +2579,7 @@ class SpreadWithRewiringBulkLoading {
 
             while(k >= 0 && input1_index >= 0){
                 output_keys[k] = input1_keys[ input1_index ];
-                output_values[k] = input1_values[ input1_index ];
+                if(!m_instance.m_storage.m_key_only) output_values[k] = input1_values[ input1_index ];
                 input1_index--;
 
                 // fetch the next input sequence
@@ -2026,7 +2603,7 @@ class SpreadWithRewiringBulkLoading {
 
             while(k >= 0 && input2_index >= 0){
                 output_keys[k] = input2_elts[ input2_index ].first;
-                output_values[k] = input2_elts[ input2_index ].second;
+                if(!m_instance.m_storage.m_key_only) output_values[k] = input2_elts[ input2_index ].second;
                 input2_index--;
                 k--;
             }
@@ -2073,12 +2650,12 @@ class SpreadWithRewiringBulkLoading {
         int64_t odd_extents = m_cardinality % num_extents;
 
         assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-        assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+        assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
         for(int64_t i = num_extents -1; i >= 0; i--){
             spread_extent(i, elements_per_extent + (i < odd_extents));
         }
         assert(m_instance.m_storage.m_memory_keys->get_used_buffers() == 0 && "All buffers should have been released");
-        assert(m_instance.m_storage.m_memory_values->get_used_buffers() == 0 && "All buffers should have been released");
+        assert((m_instance.m_storage.m_key_only || m_instance.m_storage.m_memory_values->get_used_buffers() == 0) && "All buffers should have been released");
     }
 
     void update_segment_sizes(){
@@ -2169,7 +2746,7 @@ public:
  *****************************************************************************/
 namespace btree_pmacc7_details {
 
-BlkRunInfo::BlkRunInfo(uint64_t array_index, uint32_t segment_id) : m_run_start(array_index), m_run_length(1), m_cardinality(0), m_window_start(segment_id), m_window_length(1), m_valid(true){ }
+BlkRunInfo::BlkRunInfo(uint64_t array_index, uint64_t segment_id) : m_run_start(array_index), m_run_length(1), m_cardinality(0), m_window_start(segment_id), m_window_length(1), m_valid(true){ }
 
 std::ostream& operator<<(std::ostream& out, const BlkRunInfo& entry){
     out << "{run start: " << entry.m_run_start << ", length: " << entry.m_run_length << ", window start: " << entry.m_window_start << ", "
@@ -2183,6 +2760,7 @@ std::ostream& operator<<(std::ostream& out, const BlkRunInfo& entry){
 void BTreePMACC7::load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz) {
     COUT_DEBUG("Load " << array_sz << " elements");
     if(array_sz == 0) return; // nothing to load
+    if(m_storage.is_compressed()){ compressed_load_sorted(array, array_sz); return; }
 
     if(empty()){
         // Special case, the current data structure is empty
@@ -2227,7 +2805,7 @@ BlkRunVector BTreePMACC7::load_generate_runs(std::pair<int64_t, int64_t>* array,
         assert(min <= A[i].first && A[i].first <= max && "Invalid segment selected to place the given element");
 
         // Create a new run
-        BlkRunInfo entry{i, static_cast<uint32_t>(segment_id)};
+        BlkRunInfo entry{i, static_cast<uint64_t>(segment_id)};
         i++;
         while(i < array_sz && A[i].first <= max){
             assert(A[i].first >= min && "The input array is not sorted");
@@ -2245,11 +2823,11 @@ BlkRunVector BTreePMACC7::load_generate_runs(std::pair<int64_t, int64_t>* array,
 bool BTreePMACC7::load_fuse_runs(BlkRunVector& runs){
     uint16_t* __restrict sizes = m_storage.m_segment_sizes;
 
-    for(int i = 0, sz = runs.size(); i < sz; i++){
+    for(int64_t i = 0, sz = runs.size(); i < sz; i++){
         if(!runs[i].m_valid) continue; // this run has already been fused with a previous run
         auto& run = runs[i];
 
-        int segment_id = run.m_window_start;
+        int64_t segment_id = run.m_window_start;
         assert(run.m_window_length == 1 && "This run has already been manipulated/fused?");
 
         size_t num_elements = run.m_cardinality;
@@ -2257,20 +2835,20 @@ bool BTreePMACC7::load_fuse_runs(BlkRunVector& runs){
         size_t height = 1;
 //        COUT_DEBUG("run[" << i << "]: " << run << ", height: " << height << ", density: " << density << ", theta: " << theta << ", num_elements: " << num_elements);
 
-        int window_length = 1;
-        int window_id = segment_id;
-        int window_start = segment_id, window_end = segment_id;
+        int64_t window_length = 1;
+        int64_t window_id = segment_id;
+        int64_t window_start = segment_id, window_end = segment_id;
 
         if(m_storage.m_height > 1 && density > theta){
             // find the bounds of this window
-            int windex_left = segment_id -1;
-            int windex_right = segment_id +1;
+            int64_t windex_left = segment_id -1;
+            int64_t windex_right = segment_id +1;
 
             // references to the previous & next runs
-            int sindex_left = i -1;
-            int sindex_right = i +1;
-            int srun_left = -1;
-            int srun_right = -1;
+            int64_t sindex_left = i -1;
+            int64_t sindex_right = i +1;
+            int64_t srun_left = -1;
+            int64_t srun_right = -1;
             while(sindex_left >= 0 && srun_left < 0){
                 if(runs[sindex_left].m_valid){
                     srun_left = runs[sindex_left].m_window_start + runs[sindex_left].m_window_length -1;
@@ -2301,7 +2879,7 @@ bool BTreePMACC7::load_fuse_runs(BlkRunVector& runs){
                         run.m_run_start = runs[sindex_left].m_run_start;
                         run.m_run_length += runs[sindex_left].m_run_length;
                         runs[sindex_left].m_valid = false; // ignore this run
-                        windex_left = static_cast<int>(runs[sindex_left].m_window_start) -1;
+                        windex_left = static_cast<int64_t>(runs[sindex_left].m_window_start) -1;
 
                         // move to the next run
                         sindex_left--; srun_left = -1;
@@ -2414,14 +2992,14 @@ void BTreePMACC7::load_merge_single(size_t segment_id, std::pair<int64_t, int64_
     auto& memory_pool = m_memory_pool;
     auto memory_pool_deleter = [&memory_pool](void* ptr){ memory_pool.deallocate(ptr); };
     unique_ptr<int64_t, decltype(memory_pool_deleter)> input_keys_ptr { m_memory_pool.allocate<int64_t>(input_size), memory_pool_deleter };
-    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_values_ptr {  m_memory_pool.allocate<int64_t>(input_size), memory_pool_deleter };
+    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_values_ptr {  m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(input_size), memory_pool_deleter };
     int64_t* __restrict input_keys = input_keys_ptr.get();
-    int64_t* __restrict input_values = input_values_ptr.get();
+    int64_t* __restrict input_values = m_storage.m_key_only ? input_keys : input_values_ptr.get();
 
     { // move the current elements into the temporary arrays
         size_t start = (segment_id % 2 == 0) ? m_storage.m_segment_capacity - input_size : 0;
         memcpy(input_keys, output_keys + start, input_size * sizeof(input_keys[0]));
-        memcpy(input_values, output_values + start, input_size * sizeof(input_values[0]));
+        if(!m_storage.m_key_only) memcpy(input_values, output_values + start, input_size * sizeof(input_values[0]));
     }
 
 //    // debug only
@@ -2447,11 +3025,11 @@ void BTreePMACC7::load_merge_single(size_t segment_id, std::pair<int64_t, int64_
         while(output_current < output_end && input_current < input_size && sequence_current < sequence_size){
             if(sequence[sequence_current].first < input_keys[input_current] ){
                 output_keys[output_current] = sequence[sequence_current].first;
-                output_values[output_current] = sequence[sequence_current].second;
+                if(!m_storage.m_key_only) output_values[output_current] = sequence[sequence_current].second;
                 sequence_current++;
             } else {
                 output_keys[output_current] = input_keys[input_current];
-                output_values[output_current] = input_values[input_current];
+                if(!m_storage.m_key_only) output_values[output_current] = input_values[input_current];
                 input_current++;
             }
             output_current++;
@@ -2461,7 +3039,7 @@ void BTreePMACC7::load_merge_single(size_t segment_id, std::pair<int64_t, int64_
             assert((output_end - output_current) == (input_size - input_current) && "Missing elements to copy");
             size_t elements2copy = output_end - output_current;
             memcpy(output_keys + output_current, input_keys + input_current, elements2copy * sizeof(input_keys[0]));
-            memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(input_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(input_values[0]));
             output_current += elements2copy; // redundant, only for validation purposes
             input_current += elements2copy; // redundant
         }
@@ -2469,7 +3047,7 @@ void BTreePMACC7::load_merge_single(size_t segment_id, std::pair<int64_t, int64_
         /* else */
         while(output_current < output_end && sequence_current < sequence_size){
             output_keys[output_current] = sequence[sequence_current].first;
-            output_values[output_current] = sequence[sequence_current].second;
+            if(!m_storage.m_key_only) output_values[output_current] = sequence[sequence_current].second;
             sequence_current++;
             output_current++;
         }
@@ -2505,9 +3083,9 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
     auto& memory_pool = m_memory_pool;
     auto memory_pool_deleter = [&memory_pool](void* ptr){ memory_pool.deallocate(ptr); };
     unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_keys_ptr { m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
-    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_values_ptr {  m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
+    unique_ptr<int64_t, decltype(memory_pool_deleter)> input_chunk2_values_ptr {  m_storage.m_key_only ? nullptr : m_memory_pool.allocate<int64_t>(input_chunk2_capacity), memory_pool_deleter };
     int64_t* __restrict input_chunk2_keys = input_chunk2_keys_ptr.get();
-    int64_t* __restrict input_chunk2_values = input_chunk2_values_ptr.get();
+    int64_t* __restrict input_chunk2_values = m_storage.m_key_only ? input_chunk2_keys : input_chunk2_values_ptr.get();
 
     // input chunk1 (it overlaps the current window)
     int64_t* __restrict input_chunk1_keys = nullptr;
@@ -2525,7 +3103,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
         while(output_segment_id >= 0 && input_chunk2_space_left > 0){
             size_t elements2copy = min(input_chunk2_space_left, output_current - output_start);
             memcpy(input_chunk2_keys + input_chunk2_space_left - elements2copy, output_keys + output_current - elements2copy, elements2copy * sizeof(input_chunk2_keys[0]));
-            memcpy(input_chunk2_values + input_chunk2_space_left - elements2copy, output_values + output_current - elements2copy, elements2copy * sizeof(input_chunk2_values[0]));
+            if(!m_storage.m_key_only) memcpy(input_chunk2_values + input_chunk2_space_left - elements2copy, output_values + output_current - elements2copy, elements2copy * sizeof(input_chunk2_values[0]));
 
             output_current -= elements2copy;
             input_chunk2_space_left -= elements2copy;
@@ -2551,7 +3129,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
         while(output_segment_id >= 0){
             size_t elements2copy = output_current - output_start;
             memcpy(output_keys + input_chunk1_current - elements2copy, output_keys + output_current - elements2copy, elements2copy * sizeof(output_keys[0]));
-            memcpy(output_values + input_chunk1_current - elements2copy, output_values + output_current - elements2copy, elements2copy * sizeof(output_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values + input_chunk1_current - elements2copy, output_values + output_current - elements2copy, elements2copy * sizeof(output_values[0]));
 
             input_chunk1_current -= elements2copy;
             output_current -= elements2copy;
@@ -2621,7 +3199,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
 //            COUT_DEBUG("<merge> output_start: " << output_start << ", output_end: " << output_end << ", output_current: " << output_current << ", pma key: " << input_keys[input_current] << ", sequence key: " << sequence[sequence_current].first);
             if(input_keys[input_current] <= sequence[sequence_current].first){
                 output_keys[output_current] = input_keys[input_current];
-                output_values[output_current] = input_values[input_current];
+                if(!m_storage.m_key_only) output_values[output_current] = input_values[input_current];
                 input_current++;
 
                 // switch to the second chunk
@@ -2633,7 +3211,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
                 }
             } else {
                 output_keys[output_current] = sequence[sequence_current].first;
-                output_values[output_current] = sequence[sequence_current].second;
+                if(!m_storage.m_key_only) output_values[output_current] = sequence[sequence_current].second;
                 sequence_current++;
             }
             output_current++;
@@ -2642,7 +3220,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
         while(output_current < output_end && input_current < input_size){
             size_t elements2copy = min(output_end - output_current, input_size - input_current);
             memcpy(output_keys + output_current, input_keys + input_current, elements2copy * sizeof(output_keys[0]));
-            memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
             output_current += elements2copy;
             input_current += elements2copy;
             // switch to the second chunk
@@ -2656,7 +3234,7 @@ void BTreePMACC7::load_merge_multi(size_t window_start, size_t window_length, st
         // only merge from the user batch
         while(output_current < output_end && sequence_current < sequence_sz){
             output_keys[output_current] = sequence[sequence_current].first;
-            output_values[output_current] = sequence[sequence_current].second;
+            if(!m_storage.m_key_only) output_values[output_current] = sequence[sequence_current].second;
             sequence_current++;
             output_current++;
         }
@@ -2761,7 +3339,7 @@ void BTreePMACC7::load_resize_general(std::pair<int64_t, int64_t>* __restrict ba
 //            COUT_DEBUG("<merge> output_current: " << output_current << ", key PMA: " << input_keys[input_current] << ", key batch: " << batch[batch_current].first);
             if(input_keys[input_current] < batch[batch_current].first){ // fetch the next element from the PMA
                 output_keys[output_current] = input_keys[input_current];
-                output_values[output_current] = input_values[input_current];
+                if(!m_storage.m_key_only) output_values[output_current] = input_values[input_current];
                 input_current++;
 
                 if(input_current >= input_end){ // move to the next input chunk
@@ -2774,7 +3352,7 @@ void BTreePMACC7::load_resize_general(std::pair<int64_t, int64_t>* __restrict ba
 
             } else { // fetch the next element from the batch being loaded
                 output_keys[output_current] = batch[batch_current].first;
-                output_values[output_current] = batch[batch_current].second;
+                if(!m_storage.m_key_only) output_values[output_current] = batch[batch_current].second;
                 batch_current++;
             }
 
@@ -2786,7 +3364,7 @@ void BTreePMACC7::load_resize_general(std::pair<int64_t, int64_t>* __restrict ba
             size_t elements2copy = min(output_end - output_current, input_end - input_current);
 //            COUT_DEBUG("<pma> output_current: " << output_current << ", input_current: " << input_current << ", input_end: " << input_end << ", elements2copy: " << elements2copy);
             memcpy(output_keys + output_current, input_keys + input_current, elements2copy * sizeof(output_keys[0]));
-            memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
+            if(!m_storage.m_key_only) memcpy(output_values + output_current, input_values + input_current, elements2copy * sizeof(output_values[0]));
 
             input_current += elements2copy;
             output_current += elements2copy;
@@ -2806,7 +3384,7 @@ void BTreePMACC7::load_resize_general(std::pair<int64_t, int64_t>* __restrict ba
             assert((output_end - output_current) <= (batch_size - batch_current) && "Missing elements to copy");
             while(output_current < output_end){
                 output_keys[output_current] = batch[batch_current].first;
-                output_values[output_current] = batch[batch_current].second;
+                if(!m_storage.m_key_only) output_values[output_current] = batch[batch_current].second;
                 output_current++;
                 batch_current++;
             }
@@ -2843,7 +3421,7 @@ void BTreePMACC7::load_empty_single(std::pair<int64_t, int64_t>* __restrict arra
 
     for(size_t i = 0, j = output_start; i < array_sz; i++, j++){
         m_storage.m_keys[j] = array[i].first;
-        m_storage.m_values[j] = array[i].second;
+        if(!m_storage.m_key_only) m_storage.m_values[j] = array[i].second;
     }
 
     m_index.set_separator_key(0, array[0].first);
@@ -2878,23 +3456,35 @@ void BTreePMACC7::load_empty_multi(std::pair<int64_t, int64_t>* __restrict array
         output_sizes[i] = elements_per_segment + (i < odd_segments);
     }
 
-    // 4) copy the elements into the sparse arrays
-    size_t array_current = 0;
-    for(size_t i = 0; i < num_segments; i+= 2){
-        const size_t output_start = (i+1) * m_storage.m_segment_capacity - output_sizes[i];
-        const size_t output_end = output_start + output_sizes[i] + output_sizes[i+1];
+    // 4) copy the elements into the sparse arrays. With multiple threads, each worker is assigned a range of pairs of segments
+    const size_t num_pairs = num_segments / 2;
+    const size_t num_workers = std::min(ParallelSpread::get_num_workers(array_sz, get_load_threads()), num_pairs);
+    auto copy_segments = [&](size_t worker_id){
+        const size_t segment_start = 2 * (num_pairs * worker_id / num_workers);
+        const size_t segment_end = 2 * (num_pairs * (worker_id +1) / num_workers);
+        size_t array_current = segment_start * elements_per_segment + std::min(segment_start, odd_segments);
 
-        for(size_t output_current = output_start; output_current < output_end; output_current++){
-            output_keys[output_current] = array[array_current].first;
-            output_values[output_current] = array[array_current].second;
-            array_current++;
+        for(size_t i = segment_start; i < segment_end; i+= 2){
+            const size_t output_start = (i+1) * m_storage.m_segment_capacity - output_sizes[i];
+            const size_t output_end = output_start + output_sizes[i] + output_sizes[i+1];
+
+            for(size_t output_current = output_start; output_current < output_end; output_current++){
+                output_keys[output_current] = array[array_current].first;
+                if(!m_storage.m_key_only) output_values[output_current] = array[array_current].second;
+                array_current++;
+            }
         }
+        assert((segment_end < num_segments || array_current == array_sz) && "All elements should have been copied");
+    };
+    run_workers(num_workers, copy_segments);
 
-        // update the separator keys in the static index
+    // update the separator keys in the static index. This is done by a single thread, as the learned layout of the index
+    // may refit its model while the keys are being updated
+    for(size_t i = 0; i < num_segments; i++){
+        // even segments are clustered at the end, odd segments at the start
+        const size_t output_start = (i % 2 == 0) ? (i+1) * m_storage.m_segment_capacity - output_sizes[i] : i * m_storage.m_segment_capacity;
         m_index.set_separator_key(i, output_keys[output_start]);
-        m_index.set_separator_key(i+1, output_keys[output_start + output_sizes[i]]);
     }
-    assert(array_current == array_sz && "All elements should have been copied");
 
     // 5) update the PMA properties
     m_storage.m_cardinality = array_sz;
@@ -2912,6 +3502,7 @@ int64_t BTreePMACC7::get_minimum(size_t segment_id) const {
 
     assert(segment_id < m_storage.m_number_segments && "Invalid segment");
     assert(sizes[segment_id] > 0 && "The segment is empty!");
+    if(m_storage.is_compressed()){ return compressed_segment_get_base(m_storage.get_compressed_segment(segment_id)); }
 
     if(segment_id % 2 == 0){ // even segment
         return keys[(segment_id +1) * m_storage.m_segment_capacity - sizes[segment_id]];
@@ -3058,6 +3649,62 @@ void BTreePMACC7::set_record_segment_statistics(bool value) {
     m_segment_statistics = value;
 }
 
+void BTreePMACC7::set_index_layout(::pma::StaticIndex::Layout layout) {
+    m_index.set_layout(layout);
+}
+
+void BTreePMACC7::set_spread_threads(size_t num_threads) {
+    if(num_threads == 0) throw std::invalid_argument("The number of threads must be > 0");
+    m_spread_threads = num_threads;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Snapshot                                                                *
+ *                                                                           *
+ *****************************************************************************/
+void BTreePMACC7::save(const std::string& path) const {
+    if(m_storage.is_compressed()) RAISE_EXCEPTION(SnapshotError, "Snapshot `" << path << "', the snapshots of a PMA with compressed keys are not supported");
+    Snapshot::save(path, Snapshot::Algorithm::BTREE_PMACC7, m_storage.m_segment_capacity, m_storage.m_number_segments, m_storage.m_cardinality,
+            m_storage.m_keys, m_storage.m_values, m_storage.m_segment_sizes, m_index);
+}
+
+void BTreePMACC7::open(const std::string& path){
+    if(m_storage.is_compressed()) RAISE_EXCEPTION(SnapshotError, "Snapshot `" << path << "', the snapshots of a PMA with compressed keys are not supported");
+    Snapshot snapshot { path, Snapshot::Algorithm::BTREE_PMACC7 };
+    if(snapshot.get_segment_capacity() != m_storage.m_segment_capacity){
+        RAISE_EXCEPTION(SnapshotError, "Snapshot `" << path << "', segment capacity: " << snapshot.get_segment_capacity() << ", expected: " << m_storage.m_segment_capacity);
+    }
+    const size_t num_segments = snapshot.get_number_segments();
+    if(hyperceil(num_segments) != num_segments){ RAISE_EXCEPTION(SnapshotError, "Snapshot `" << path << "', the number of segments is not a power of 2: " << num_segments); }
+    COUT_DEBUG("path: " << path << ", segments: " << num_segments << ", cardinality: " << snapshot.get_cardinality());
+
+    // allocate the new storage, in case of error only the new storage is released
+    int64_t* ixKeys;
+    int64_t* ixValues;
+    decltype(m_storage.m_segment_sizes) ixSizes;
+    BufferedRewiredMemory* ixRewiredMemoryKeys;
+    BufferedRewiredMemory* ixRewiredMemoryValues;
+    RewiredMemory* ixRewiredMemoryCardinalities;
+    m_storage.alloc_workspace(num_segments, &ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities);
+    auto xDeleter = [&](void*){ PMA::dealloc_workspace(&ixKeys, &ixValues, &ixSizes, &ixRewiredMemoryKeys, &ixRewiredMemoryValues, &ixRewiredMemoryCardinalities); };
+    unique_ptr<BTreePMACC7, decltype(xDeleter)> ixCleanup { this, xDeleter };
+    snapshot.load(ixKeys, m_storage.m_key_only ? nullptr : ixValues, ixSizes);
+    snapshot.load(m_index);
+
+    // replace the previous storage, released by ixCleanup
+    swap(ixKeys, m_storage.m_keys);
+    swap(ixValues, m_storage.m_values);
+    swap(ixSizes, m_storage.m_segment_sizes);
+    swap(ixRewiredMemoryKeys, m_storage.m_memory_keys);
+    swap(ixRewiredMemoryValues, m_storage.m_memory_values);
+    swap(ixRewiredMemoryCardinalities, m_storage.m_memory_sizes);
+    m_storage.m_capacity = num_segments * m_storage.m_segment_capacity;
+    m_storage.m_number_segments = num_segments;
+    m_storage.m_height = log2(num_segments) +1;
+    m_storage.m_cardinality = snapshot.get_cardinality();
+}
+
 /*****************************************************************************
  *                                                                           *
  *   Memory footprint                                                        *
@@ -3066,7 +3713,7 @@ void BTreePMACC7::set_record_segment_statistics(bool value) {
 
 size_t BTreePMACC7::memory_footprint() const {
     size_t space_index = m_index.memory_footprint();
-    size_t space_elts = 2ull * m_storage.m_number_segments * m_storage.m_segment_capacity * sizeof(m_storage.m_keys);
+    size_t space_elts = m_storage.m_number_segments * (m_storage.get_segment_key_bytes() + (m_storage.m_key_only ? 0ull : m_storage.m_segment_capacity * sizeof(m_storage.m_values[0])));
     size_t space_cards = max<size_t>(2, m_storage.m_number_segments) * sizeof(m_storage.m_segment_sizes[0]);
 
     return sizeof(BTreePMACC7) + space_index + space_elts + space_cards;
@@ -3103,6 +3750,8 @@ void BTreePMACC7::dump_storage(std::ostream& out, bool* integrity_check) const {
         return;
     }
 
+    if(m_storage.is_compressed()){ compressed_dump_storage(out, integrity_check); return; }
+
     int64_t previous_key = numeric_limits<int64_t>::min();
 
     int64_t* keys = m_storage.m_keys;
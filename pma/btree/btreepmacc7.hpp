@@ -17,6 +17,8 @@
 
 /** As BTreePMACC7 (not 6!), plus:
  * - rewired memory
+ * - optionally, compressed keys: the keys of each segment are stored as a base and a sequence of bit-packed offsets, in a fixed
+ *   space of segment_size * bits_per_key bits (see compressed_segment.hpp). The values keep the clustered layout.
  */
 
 #ifndef BTREEPMACC7_HPP_
@@ -52,8 +54,8 @@ class Instrumentation {
         uint64_t m_time_total;  // total time, in microsecs
         uint64_t m_time_search; // search phase, in microsecs
         uint64_t m_time_operation; // spread/resize time, in microsecs
-        uint32_t m_length; // window length in case of ::spread or new capacity in case of ::resize
-        uint32_t m_previous; // 0 in case of ::spread and old capacity in case of ::resize;
+        uint64_t m_length; // window length in case of ::spread or new capacity in case of ::resize
+        uint64_t m_previous; // 0 in case of ::spread and old capacity in case of ::resize;
         bool m_on_insert; // true if the rebalance occurred after an insert operation, false otherwise
     };
 
@@ -66,8 +68,8 @@ public:
         Timer m_timer_total;
         Timer m_timer_search;
         Timer m_timer_operation; // either spread or resize
-        uint32_t m_length = 0; // total number of segments, or new capacity in case of resizing
-        uint32_t m_previous = 0; // previous capacity in case of resizing
+        uint64_t m_length = 0; // total number of segments, or new capacity in case of resizing
+        uint64_t m_previous = 0; // previous capacity in case of resizing
         const bool m_on_insert;
 
     public:
@@ -108,9 +110,9 @@ public:
     struct CompleteStatistics {
         StatisticsRebalances m_cumulative; // total
         Statistics m_search; // search only
-        std::vector<std::pair<uint32_t, Statistics>> m_spread; // invocations to ::spread
-        std::vector<std::pair<uint32_t, Statistics>> m_resize_up; // increase the capacity
-        std::vector<std::pair<uint32_t, Statistics>> m_resize_down; // halve the capacity
+        std::vector<std::pair<uint64_t, Statistics>> m_spread; // invocations to ::spread
+        std::vector<std::pair<uint64_t, Statistics>> m_resize_up; // increase the capacity
+        std::vector<std::pair<uint64_t, Statistics>> m_resize_down; // halve the capacity
     };
     CompleteStatistics statistics() const;
 
@@ -139,20 +141,22 @@ public:
 
 struct PMA {
     int64_t* m_keys; // pma for the keys
-    int64_t* m_values; // pma for the values
+    int64_t* m_values; // pma for the values, an alias of m_keys in key-only mode
     uint16_t* m_segment_sizes; // array, containing the cardinalities of each segment
     const uint16_t m_segment_capacity; // the max number of elements in a segment
     uint16_t m_height; // the height of the binary tree for elements
-    uint32_t m_cardinality; // the number of elements contained
-    uint32_t m_capacity; // the size of the array elements
-    uint32_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
+    uint64_t m_cardinality; // the number of elements contained
+    uint64_t m_capacity; // the size of the array elements
+    uint64_t m_number_segments; // the total number of segments, i.e. capacity / segment_size
     const size_t m_pages_per_extent; // number of virtual pages per extent, used in the RewiredMemory
+    const bool m_key_only; // whether to store only the keys, the value of each element is its own key
+    const size_t m_compressed_bytes; // the space of the compressed keys of a segment, in bytes, or 0 if the keys are not compressed
     BufferedRewiredMemory* m_memory_keys = nullptr; // memory space used for the keys
     BufferedRewiredMemory* m_memory_values = nullptr; // memory space used for the values
     RewiredMemory* m_memory_sizes = nullptr; // memory space used for the segment cardinalities
 
     // Initialise the PMA for a given segment size
-    PMA(size_t segment_size, size_t pages_per_extent);
+    PMA(size_t segment_size, size_t pages_per_extent, bool key_only = false, size_t bits_per_key = 0);
 
     // Clean up
     ~PMA();
@@ -165,6 +169,18 @@ struct PMA {
     void alloc_workspace(size_t num_segments, int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities);
 
     static void dealloc_workspace(int64_t** keys, int64_t** values, decltype(m_segment_sizes)* sizes, BufferedRewiredMemory** rewired_memory_keys, BufferedRewiredMemory** rewired_memory_values, RewiredMemory** rewired_memory_cardinalities);
+
+    // Whether the keys are stored compressed
+    bool is_compressed() const noexcept { return m_compressed_bytes > 0; }
+
+    // The space taken by the keys of a segment, in bytes
+    size_t get_segment_key_bytes() const noexcept;
+
+    // The compressed keys of the given segment
+    uint8_t* get_compressed_segment(size_t segment_id) const noexcept;
+
+    // The position in m_values of the first element of the given segment, holding `size' elements
+    size_t get_offset(size_t segment_id, size_t size) const noexcept;
 };
 
 /*****************************************************************************
@@ -187,6 +203,33 @@ public:
 
     virtual bool hasNext() const;
     virtual std::pair<int64_t, int64_t> next();
+    virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values); // the next run of contiguous elements, without copies
+};
+
+/**
+ * Iterator over the PMA with compressed keys. The keys of each segment are decoded in a buffer owned by the iterator.
+ */
+class CompressedIterator : public pma::Iterator {
+    const PMA& m_pma;
+    size_t m_next_segment = 0; // the next segment to decode
+    size_t m_segment_end = 0; // the last segment to visit
+    int64_t m_key_max = 0; // the upper bound of the interval
+    std::unique_ptr<int64_t[]> m_buffers[2]; // the decoded keys, alternate the buffers as the last block fetched must stay valid
+    int m_current_buffer = 0;
+    const int64_t* m_keys = nullptr; // the keys of the current segment
+    const int64_t* m_values = nullptr; // the values of the current segment
+    size_t m_offset = 0; // the position of the next element in the current segment
+    size_t m_stop = 0; // one past the last qualifying element in the current segment
+
+    // Decode the next qualifying segment, starting from the given key
+    void next_segment(int64_t key_min);
+
+public:
+    CompressedIterator(const PMA& storage, size_t segment_start, size_t segment_end, int64_t key_min, int64_t key_max);
+
+    virtual bool hasNext() const;
+    virtual std::pair<int64_t, int64_t> next();
+    virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values);
 };
 
 /*****************************************************************************
@@ -198,8 +241,8 @@ struct BlkRunInfo {
     uint64_t m_run_start; // start position in the sorted array for this run
     uint64_t m_run_length; // the number of elements of this run
     uint64_t m_cardinality; // the total cardinality = m_run_length + segment_sizes[i] /@ Range[i, m_segment_start, m_segment_start + m_segment_length -1]
-    uint32_t m_window_start; // the first segment associated to this run
-    uint32_t m_window_length; // the number of segments encompassed by this run
+    uint64_t m_window_start; // the first segment associated to this run
+    uint64_t m_window_length; // the number of segments encompassed by this run
     bool m_valid; // whether this entry is valid or should be ignored in the merge
 
     /**
@@ -207,7 +250,7 @@ struct BlkRunInfo {
      * @param array_index the start position in the loaded array
      * @param segment_id the segment associated to this run
      */
-    BlkRunInfo(uint64_t array_index, uint32_t segment_id);
+    BlkRunInfo(uint64_t array_index, uint64_t segment_id);
 };
 
 using BlkRunAllocator = CachedAllocator<BlkRunInfo>;
@@ -236,6 +279,7 @@ private:
     CachedMemoryPool m_memory_pool;
     CachedDensityBounds m_density_bounds;
     bool m_segment_statistics = false; // record segment statistics at the end?
+    size_t m_spread_threads = 1; // max number of threads to spread the elements of large windows
 
     // Insert an element in the given segment. It assumes that there is still room available
     // It returns true if the inserted key is the minimum in the interval
@@ -274,6 +318,25 @@ private:
     struct spread_insert { int64_t m_key; int64_t m_value; size_t m_segment_id; };
     void spread(size_t cardinality, size_t segment_start, size_t num_segments, spread_insert* m_insertion);
     void spread_two_copies(size_t cardinality, size_t segment_start, size_t num_segments, spread_insert* m_insertion);
+    bool spread_parallel(size_t cardinality, size_t segment_start, size_t input_length, size_t output_length, spread_insert* m_insertion);
+
+    /**
+     * Compressed keys. The rebalances gather the elements of the window, or use a ParallelSpread, encoding the keys of the
+     * output segments directly. A window whose keys do not fit its segments, once spread, is enlarged until the whole array is resized.
+     */
+    bool compressed_insert(size_t segment_id, int64_t key, int64_t value); // false if the key does not fit the segment
+    int64_t compressed_remove(int64_t key);
+    void compressed_rebalance(size_t window_start, size_t window_length, size_t cardinality, bool do_resize, spread_insert* insertion);
+    bool compressed_spread(size_t cardinality, size_t window_start, size_t window_length, spread_insert* insertion); // false if the keys do not fit
+    void compressed_resize(spread_insert* insertion);
+    void compressed_rebuild(const int64_t* keys, const int64_t* values, size_t cardinality, size_t num_segments);
+    size_t compressed_gather(size_t window_start, size_t window_length, const spread_insert* insertion, int64_t* out_keys, int64_t* out_values) const;
+    bool compressed_fits(const int64_t* keys, size_t cardinality, size_t num_segments) const;
+    void compressed_store(size_t window_start, size_t window_length, const int64_t* keys, const int64_t* values, size_t cardinality);
+    void compressed_load_sorted(std::pair<int64_t, int64_t>* array, size_t array_sz);
+    int64_t compressed_find(int64_t key) const;
+    template<typename Function> void compressed_scan(int64_t min, int64_t max, Function fn) const;
+    void compressed_dump_storage(std::ostream& out, bool* integrity_check) const;
 
     /**
      * Helper, copy the elements from <key_from,values_from> into the arrays <keys_to, values_to> and insert the new pair <key/value> in the sequence.
@@ -331,7 +394,11 @@ public:
 
     BTreePMACC7(size_t pma_segment_size, size_t pages_per_extent);
 
-    BTreePMACC7(size_t index_B, size_t pma_segment_size, size_t pages_per_extent);
+    /**
+     * @param key_only when true, the PMA behaves as a set: only the keys are stored and the value of each element is its own key
+     * @param bits_per_key if not 0, store the keys compressed, in a space of pma_segment_size * bits_per_key bits per segment. Either 8, 16 or 32.
+     */
+    BTreePMACC7(size_t index_B, size_t pma_segment_size, size_t pages_per_extent, bool key_only = false, size_t bits_per_key = 0);
 
     virtual ~BTreePMACC7();
 
@@ -359,6 +426,9 @@ public:
     // Sum all elements in the interval [min, max]
     virtual SumResult sum(int64_t min, int64_t max) const override;
 
+    // Visit all elements in the interval [min, max], a pair of segments at the time
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+
     // The number of elements stored
     virtual size_t size() const override;
 
@@ -374,6 +444,24 @@ public:
     // Whether to save segment statistics, at the end, in the table `btree_leaf_statistics' ?
     void set_record_segment_statistics(bool value);
 
+    // Set the layout of the separator keys in the static index
+    void set_index_layout(::pma::StaticIndex::Layout layout);
+
+    // Set the max number of threads to use when spreading the elements of large windows (default: 1)
+    void set_spread_threads(size_t num_threads);
+
+    /**
+     * Save the content of the PMA into the given file, see pma::Snapshot for the format. Not supported with compressed keys.
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * Replace the content of the PMA with the snapshot in the given file, previously created with #save. The arrays
+     * are loaded as they are, without reinserting the elements. The snapshot must have been saved by a PMA with the
+     * same segment capacity.
+     */
+    void open(const std::string& path);
+
     // Memory footprint
     virtual size_t memory_footprint() const override;
 };
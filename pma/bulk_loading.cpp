@@ -16,22 +16,78 @@
  */
 
 #include "bulk_loading.hpp"
+
 #include <algorithm>
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.hpp"
 
 using namespace std;
 
 namespace pma {
 
+// Do not split the input in chunks smaller than this amount of elements
+static constexpr size_t MIN_ELEMENTS_PER_WORKER = 1ull << 16;
+
+/*****************************************************************************
+ *                                                                           *
+ *   BulkLoading                                                             *
+ *                                                                           *
+ *****************************************************************************/
 BulkLoading::~BulkLoading(){ };
 
+void BulkLoading::set_load_threads(size_t num_threads){
+    if(num_threads == 0) throw std::invalid_argument("The number of threads must be > 0");
+    m_load_threads = num_threads;
+}
+
 void SortedBulkLoading::load(std::pair<int64_t, int64_t>* array, size_t array_sz){
-    auto comparator = [](auto& e1, auto& e2){
-        return e1.first < e2.first;
-    };
-    std::sort(array, array + array_sz, comparator);
+    sort_elements(array, array_sz, get_load_threads());
     load_sorted(array, array_sz);
 }
 
-} // namespace pma
+/*****************************************************************************
+ *                                                                           *
+ *   Parallel sort                                                           *
+ *                                                                           *
+ *****************************************************************************/
+void sort_elements(std::pair<int64_t, int64_t>* array, size_t array_sz, size_t num_threads){
+    auto comparator = [](const pair<int64_t, int64_t>& e1, const pair<int64_t, int64_t>& e2){
+        return e1.first < e2.first;
+    };
+    const size_t num_workers = std::max<size_t>(1, std::min<size_t>(num_threads, array_sz / MIN_ELEMENTS_PER_WORKER));
+    auto chunk_start = [&](size_t chunk_id){ return array + (array_sz * chunk_id) / num_workers; };
+
+    // 1) check whether the array is already sorted, each worker checks its own chunk and the boundary with the next one
+    unique_ptr<bool[]> chunk_sorted { new bool[num_workers] };
+    run_workers(num_workers, [&](size_t worker_id){
+        auto* start = chunk_start(worker_id);
+        auto* end = (worker_id +1 < num_workers) ? chunk_start(worker_id +1) +1 : array + array_sz;
+        chunk_sorted[worker_id] = std::is_sorted(start, end, comparator);
+    });
+    if(std::all_of(chunk_sorted.get(), chunk_sorted.get() + num_workers, [](bool value){ return value; })) return;
 
+    // 2) sort the single chunks
+    run_workers(num_workers, [&](size_t worker_id){
+        std::sort(chunk_start(worker_id), chunk_start(worker_id +1), comparator);
+    });
 
+    // 3) merge the sorted chunks pairwise, halving the number of runs at each round
+    for(size_t width = 1; width < num_workers; width *= 2){
+        const size_t num_merges = (num_workers + 2 * width -1) / (2 * width);
+        run_workers(num_merges, [&](size_t merge_id){
+            size_t first = merge_id * 2 * width;
+            size_t middle = std::min(first + width, num_workers);
+            size_t last = std::min(first + 2 * width, num_workers);
+            if(middle < last){
+                std::inplace_merge(chunk_start(first), chunk_start(middle), chunk_start(last), comparator);
+            }
+        });
+    }
+    assert(std::is_sorted(array, array + array_sz, comparator));
+}
+
+} // namespace pma
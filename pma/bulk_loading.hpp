@@ -28,12 +28,24 @@ namespace pma {
  * Interface to load batch of elements in the container
  */
 class BulkLoading {
+    size_t m_load_threads = 1; // max number of threads to sort & load a batch
+
 public:
     /**
      * Public destructor
      */
     virtual ~BulkLoading();
 
+    /**
+     * Set the max number of threads, including the caller, the implementation can employ to load a batch
+     */
+    void set_load_threads(size_t num_threads);
+
+    /**
+     * Retrieve the max number of threads that can be employed to load a batch
+     */
+    size_t get_load_threads() const noexcept { return m_load_threads; }
+
     /**
      * Load the given array of pairs key/value
      * @param array the elements to load. The array is not guaranteed to remain constant. The memory
@@ -45,8 +57,8 @@ public:
 
 
 /**
- * Convenience class for bulk loading. It sorts the input elements and pass the array
- * to the interface implementation
+ * Convenience class for bulk loading. It sorts the input elements, with up to #get_load_threads() threads,
+ * and pass the array to the interface implementation
  */
 class SortedBulkLoading : public BulkLoading {
 protected:
@@ -65,5 +77,13 @@ public:
     void load(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
 };
 
+
+/**
+ * Sort the given array of pairs key/value by key, with up to `num_threads' threads, including the caller. The
+ * array is sorted in chunks by the single threads, then the sorted chunks are merged pairwise. If the array
+ * is already sorted, it is left untouched.
+ */
+void sort_elements(std::pair<int64_t, int64_t>* array, size_t array_sz, size_t num_threads = 1);
+
 } // namespace pma
 #endif /* PMA_BULK_LOADING_HPP_ */
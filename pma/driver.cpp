@@ -31,6 +31,7 @@
 #include "factory.hpp"
 #include "interface.hpp"
 #include "miscellaneous.hpp"
+#include "wal.hpp"
 
 #include "experiments/aging.hpp"
 #include "experiments/bandwidth_idls.hpp"
@@ -61,6 +62,10 @@
 #include "btree/btreepmacc5.hpp"
 #include "btree/btreepmacc7.hpp"
 #include "btree/08/packed_memory_array.hpp"
+#include "btree/10/adapter.hpp"
+
+#include "generic/snapshot.hpp"
+#include "generic/static_index.hpp"
 
 #include "external/dfr/dfr.hpp"
 #include "external/iejoin/khayyat.hpp"
@@ -75,6 +80,18 @@ namespace pma {
 
 static bool initialised = false;
 
+// Retrieve the layout of the static index, as set by the parameter --index_layout
+static StaticIndex::Layout get_index_layout(){
+    string layout = ARGREF(string, "index_layout");
+    if(layout == "eytzinger"){
+        return StaticIndex::Layout::EYTZINGER;
+    } else if(layout == "learned"){
+        return StaticIndex::Layout::LEARNED;
+    } else {
+        return StaticIndex::Layout::BTREE;
+    }
+}
+
 void initialise() {
 //    if(initialised) RAISE_EXCEPTION(Exception, "Function pma::initialise() already called once");
     if(initialised) return;
@@ -82,6 +99,18 @@ void initialise() {
     PARAMETER(uint64_t, "inode_block_size").alias("iB");
     PARAMETER(uint64_t, "leaf_block_size").alias("lB");
     PARAMETER(uint64_t, "extent_size").descr("The size of an extent used for memory rewiring. It is defined as a multiple in terms of a page size.");
+    PARAMETER(string, "index_layout").hint("btree|eytzinger|learned").set_default("btree")
+        .descr("The layout of the separator keys in the static index. Only significant for the algorithms based on a static index: dense_array, btreecc_pma5b, btreecc_pma7b, btreecc_pma8, btreecc_pma10, btreecc_pma10_varlen, bh07_v2b, apma_int2b and apma_int3.")
+        .validate_fn([](const std::string& layout){ return layout == "btree" || layout == "eytzinger" || layout == "learned"; });
+    PARAMETER(uint64_t, "spread_threads").hint("N >= 1").set_default(1)
+        .descr("Max number of threads to spread the elements of large windows during a rebalance. Only significant for apma_int3 and btreecc_pma7b.")
+        .validate_fn([](uint64_t value){ return value >= 1; });
+    PARAMETER(uint64_t, "build_threads").hint("N >= 1").set_default(1)
+        .descr("Max number of threads to merge the delta into the static arrays, when rebuilding the data structure. Only significant for dense_array.")
+        .validate_fn([](uint64_t value){ return value >= 1; });
+    PARAMETER(uint64_t, "load_threads").hint("N >= 1").set_default(1)
+        .descr("Max number of threads to sort and load a batch of elements in bulk. Only significant for the experiment `bulk_loading' and for the bulk load of btree_v2.")
+        .validate_fn([](uint64_t value){ return value >= 1; });
 
     /**
      * Basic PMA implementations
@@ -131,6 +160,7 @@ void initialise() {
         bool record_leaf_statistics { false };
         ARGREF(bool, "record_leaf_statistics").get(record_leaf_statistics);
         btree->set_record_leaf_statistics(record_leaf_statistics);
+        btree->set_load_threads(ARGREF(uint64_t, "load_threads"));
 
         return btree;
     });
@@ -150,12 +180,19 @@ void initialise() {
         auto iB = ARGREF(uint64_t, "inode_block_size").get();
         LOG_VERBOSE("[dense_array] Parameter inode_block_size ignored: " << iB);
         auto lB = ARGREF(uint64_t, "leaf_block_size").get();
-        LOG_VERBOSE("[dense_array] block size: " << lB << ", huge pages: " << (configuration::use_huge_pages() ? "true" : "false"));
-        return make_unique<abtree::DenseArray>(lB);
+        LOG_VERBOSE("[dense_array] block size: " << lB << ", huge pages: " << (configuration::use_huge_pages() ? "true" : "false") << ", thp: " << (configuration::use_transparent_huge_pages() ? "true" : "false") << ", index layout: " << get_index_layout());
+        auto algorithm = make_unique<abtree::DenseArray>(lB);
+        algorithm->set_index_layout(get_index_layout());
+        algorithm->set_build_threads(ARGREF(uint64_t, "build_threads"));
+        return algorithm;
     });
 
     PARAMETER(bool, "abtree_random_permutation")
         .descr("Randomly permute the nodes in the tree. Only significant for the baseline abtree implementation (btree_v2).");
+    PARAMETER(bool, "abtree_slab_allocator")
+        .descr("Allocate the nodes of the tree from large chunks of memory, rather than individually from the heap. A new node is placed in the same chunk of its sibling, if possible. It cannot be combined with --abtree_random_permutation. Only significant for the baseline abtree implementation (btree_v2).");
+    PARAMETER(bool, "abtree_defragment")
+        .descr("After each batch of updates, relocate the leaves in key order into new chunks of memory. It requires --abtree_slab_allocator. Only significant for the baseline abtree implementation (btree_v2).");
     PARAMETER(bool, "record_leaf_statistics")
         .descr("When deleting the index, record in the table `btree_leaf_statistics' the statistics related to the memory distance among consecutive leaves/segments. Supported only by the algorithms btree_v2, btreecc_pma4 and apma_clocked");
 
@@ -196,6 +233,7 @@ void initialise() {
         uint64_t lB = ARGREF(uint64_t, "lB");
         LOG_VERBOSE("[btreecc_pma5b] index block size (iB): " << iB << ", segment size (lB): " << lB);
         auto algorithm = make_unique<BTreePMACC5>(iB, lB);
+        algorithm->set_index_layout(get_index_layout());
 
         // Record leaf statistics?
         bool record_leaf_statistics { false };
@@ -204,7 +242,10 @@ void initialise() {
 
         return algorithm;
     });
-    REGISTER_PMA("btreecc_pma7b", "Clustered PMA with memory rewiring. Set the size of an extent with the option --extent_size=N",
+    PARAMETER(uint64_t, "bits_per_key").hint("0|8|16|32").set_default(0)
+        .descr("Store the keys of each segment bit-packed as offsets from the minimum of the segment, reserving on average N bits per key. Set 0 to store the keys uncompressed. Only significant for btreecc_pma7b and btreecc_pma7b_keys.")
+        .validate_fn([](uint64_t value){ return value == 0 || value == 8 || value == 16 || value == 32; });
+    REGISTER_PMA("btreecc_pma7b", "Clustered PMA with memory rewiring. Set the size of an extent with the option --extent_size=N and compress the keys with --bits_per_key=N",
             []{
         uint64_t iB = ARGREF(uint64_t, "iB");
         uint64_t lB = ARGREF(uint64_t, "lB");
@@ -212,9 +253,34 @@ void initialise() {
         if(!param_extent_mult.is_set())
             RAISE_EXCEPTION(configuration::ConsoleArgumentError, "[btreecc_pma7] Mandatory parameter --extent size not set.");
         uint64_t extent_mult = param_extent_mult.get();
+        uint64_t bits_per_key = ARGREF(uint64_t, "bits_per_key");
         LOG_VERBOSE("[btreecc_pma7b] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
-                "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
-        auto algorithm = make_unique<BTreePMACC7>(iB, lB, extent_mult);
+                "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes), bits per key: " << bits_per_key);
+        auto algorithm = make_unique<BTreePMACC7>(iB, lB, extent_mult, /* key only ? */ false, bits_per_key);
+        algorithm->set_index_layout(get_index_layout());
+        algorithm->set_spread_threads(ARGREF(uint64_t, "spread_threads"));
+
+        // Record leaf statistics?
+        bool record_leaf_statistics { false };
+        ARGREF(bool, "record_leaf_statistics").get(record_leaf_statistics);
+        algorithm->set_record_segment_statistics(record_leaf_statistics);
+
+        return algorithm;
+    });
+    REGISTER_PMA("btreecc_pma7b_keys", "Clustered PMA with memory rewiring, storing only the keys (set semantics, the value of each element is its key). Set the size of an extent with the option --extent_size=N and compress the keys with --bits_per_key=N",
+            []{
+        uint64_t iB = ARGREF(uint64_t, "iB");
+        uint64_t lB = ARGREF(uint64_t, "lB");
+        auto param_extent_mult = ARGREF(uint64_t, "extent_size");
+        if(!param_extent_mult.is_set())
+            RAISE_EXCEPTION(configuration::ConsoleArgumentError, "[btreecc_pma7b_keys] Mandatory parameter --extent size not set.");
+        uint64_t extent_mult = param_extent_mult.get();
+        uint64_t bits_per_key = ARGREF(uint64_t, "bits_per_key");
+        LOG_VERBOSE("[btreecc_pma7b_keys] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
+                "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes), bits per key: " << bits_per_key);
+        auto algorithm = make_unique<BTreePMACC7>(iB, lB, extent_mult, /* key only ? */ true, bits_per_key);
+        algorithm->set_index_layout(get_index_layout());
+        algorithm->set_spread_threads(ARGREF(uint64_t, "spread_threads"));
 
         // Record leaf statistics?
         bool record_leaf_statistics { false };
@@ -234,6 +300,7 @@ void initialise() {
         LOG_VERBOSE("[btreecc_pma8] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
                 "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
         auto algorithm = make_unique<v8::PackedMemoryArray8>(iB, lB, extent_mult);
+        algorithm->set_index_layout(get_index_layout());
 
         // Record leaf statistics?
         bool record_leaf_statistics { false };
@@ -242,6 +309,63 @@ void initialise() {
 
         return algorithm;
     });
+    PARAMETER(string, "key_type").hint("u32|u64|i64|composite").set_default("i64")
+        .descr("The type of the keys stored, as unsigned 32 bit, unsigned 64 bit or signed 64 bit integers, or as composite keys <high 32 bits, low 32 bits>, e.g. <tenant, timestamp>. Only significant for btreecc_pma10. The keys generated by the experiment must fit the type chosen.")
+        .validate_fn([](const std::string& type){ return type == "u32" || type == "u64" || type == "i64" || type == "composite"; });
+    REGISTER_PMA("btreecc_pma10", "Clustered PMA templated on the type of the keys, without memory rewiring. Set the type of the keys with --key_type=u32|u64|i64|composite",
+            []() -> unique_ptr<Interface> {
+        uint64_t iB = ARGREF(uint64_t, "iB");
+        uint64_t lB = ARGREF(uint64_t, "lB");
+        string key_type = ARGREF(string, "key_type");
+        LOG_VERBOSE("[btreecc_pma10] index block size (iB): " << iB << ", segment size (lB): " << lB << ", key type: " << key_type);
+
+        // Record leaf statistics?
+        bool record_leaf_statistics { false };
+        ARGREF(bool, "record_leaf_statistics").get(record_leaf_statistics);
+        if(record_leaf_statistics){ std::cerr << "[btreecc_pma10] Warning: parameter --record_leaf_statistics ignored" << endl; }
+
+        if(key_type == "u32"){
+            auto algorithm = make_unique<v10::PackedMemoryArray10<uint32_t>>(lB, iB);
+            algorithm->set_index_layout(get_index_layout());
+            return algorithm;
+        } else if(key_type == "u64"){
+            auto algorithm = make_unique<v10::PackedMemoryArray10<uint64_t>>(lB, iB);
+            algorithm->set_index_layout(get_index_layout());
+            return algorithm;
+        } else if(key_type == "composite"){
+            auto algorithm = make_unique<v10::PackedMemoryArray10<v10::CompositeKey32>>(lB, iB);
+            algorithm->set_index_layout(get_index_layout());
+            return algorithm;
+        } else {
+            auto algorithm = make_unique<v10::PackedMemoryArray10<int64_t>>(lB, iB);
+            algorithm->set_index_layout(get_index_layout());
+            return algorithm;
+        }
+    });
+    PARAMETER(uint64_t, "payload_size").hint("N >= 8").set_default(64)
+        .descr("The average length of the payloads, in bytes. Only significant for btreecc_pma10_varlen.")
+        .validate_fn([](uint64_t value){ return value >= sizeof(int64_t) && 2 * value - sizeof(int64_t) <= v10::ValueHeap::MAX_LENGTH; });
+    REGISTER_PMA("btreecc_pma10_varlen", "Clustered PMA storing the values as variable length payloads in a heap on rewired memory. Set the average length of the payloads with --payload_size=N and the size of an extent of the heap with --extent_size=N",
+            []{
+        uint64_t iB = ARGREF(uint64_t, "iB");
+        uint64_t lB = ARGREF(uint64_t, "lB");
+        uint64_t payload_size = ARGREF(uint64_t, "payload_size");
+        auto param_extent_mult = ARGREF(uint64_t, "extent_size");
+        if(!param_extent_mult.is_set())
+            RAISE_EXCEPTION(configuration::ConsoleArgumentError, "[btreecc_pma10_varlen] Mandatory parameter --extent size not set.");
+        uint64_t extent_mult = param_extent_mult.get();
+        LOG_VERBOSE("[btreecc_pma10_varlen] index block size (iB): " << iB << ", segment size (lB): " << lB << ", payload size: " << payload_size << " bytes, "
+                "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
+        auto algorithm = make_unique<v10::VarlenPackedMemoryArray10>(lB, payload_size, extent_mult, iB);
+        algorithm->set_index_layout(get_index_layout());
+
+        // Record leaf statistics?
+        bool record_leaf_statistics { false };
+        ARGREF(bool, "record_leaf_statistics").get(record_leaf_statistics);
+        if(record_leaf_statistics){ std::cerr << "[btreecc_pma10_varlen] Warning: parameter --record_leaf_statistics ignored" << endl; }
+
+        return algorithm;
+    });
 
 
     PARAMETER(double, "apma_predictor_scale").descr("The scale parameter to re-adjust the capacity of the predictor").set_default(1.0);
@@ -265,6 +389,7 @@ void initialise() {
                 "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes), predictor scale: " << predictor_scale);
 
         auto algorithm = make_unique<adaptive::bh07_v2::APMA_BH07_v2>(iB, lB, extent_mult, predictor_scale);
+        algorithm->set_index_layout(get_index_layout());
 
         // Record leaf statistics?
         bool record_leaf_statistics { false };
@@ -321,6 +446,7 @@ void initialise() {
         LOG_VERBOSE("[apma_int2b] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
                 "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
         auto algorithm = make_unique<adaptive::int2::PackedMemoryArray>(iB, lB, extent_mult);
+        algorithm->set_index_layout(get_index_layout());
 
         // Rank threshold
         auto argument_rank = ARGREF(double, "apma_rank");
@@ -348,6 +474,33 @@ void initialise() {
         LOG_VERBOSE("[apma_int3] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
                 "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
         auto algorithm = make_unique<adaptive::int3::PackedMemoryArray>(iB, lB, extent_mult);
+        algorithm->set_index_layout(get_index_layout());
+        algorithm->set_spread_threads(ARGREF(uint64_t, "spread_threads"));
+
+        // Rank threshold
+        auto argument_rank = ARGREF(double, "apma_rank");
+        if(argument_rank.is_set()){ algorithm->knobs().m_rank_threshold = argument_rank.get(); }
+
+        // Record leaf statistics?
+        bool record_leaf_statistics { false };
+        ARGREF(bool, "record_leaf_statistics").get(record_leaf_statistics);
+        algorithm->set_record_segment_statistics(record_leaf_statistics);
+
+        return algorithm;
+    });
+
+    REGISTER_PMA("apma_int3_keys", "Adaptive PMA with memory rewiring & Katriel's thresholds, storing only the keys (set semantics, the value of each element is its key). Set the size of an extent with the option --extent_size=N", [](){
+        uint64_t iB = ARGREF(uint64_t, "iB");
+        uint64_t lB = ARGREF(uint64_t, "lB");
+        auto param_extent_mult = ARGREF(uint64_t, "extent_size");
+        if(!param_extent_mult.is_set())
+            RAISE_EXCEPTION(configuration::ConsoleArgumentError, "[apma_int3_keys] Mandatory parameter --extent size not set.");
+        uint64_t extent_mult = param_extent_mult.get();
+        LOG_VERBOSE("[apma_int3_keys] index block size (iB): " << iB << ", segment size (lB): " << lB << ", "
+                "extent size: " << extent_mult << " (" << get_memory_page_size() * extent_mult << " bytes)");
+        auto algorithm = make_unique<adaptive::int3::PackedMemoryArray>(iB, lB, extent_mult, /* key only ? */ true);
+        algorithm->set_index_layout(get_index_layout());
+        algorithm->set_spread_threads(ARGREF(uint64_t, "spread_threads"));
 
         // Rank threshold
         auto argument_rank = ARGREF(double, "apma_rank");
@@ -584,8 +737,10 @@ void initialise() {
             is_initial_size_uniform = true;
         }
 
-        LOG_VERBOSE("bulk loading, initial size: " << initial_size << ", batch size: " << batch_size << ", number of batches: " << num_batches << ", init uniform: " << boolalpha << is_initial_size_uniform);
-        return make_unique<ExperimentBulkLoading>(interface, initial_size, batch_size, num_batches, is_initial_size_uniform);
+        uint64_t load_threads = ARGREF(uint64_t, "load_threads");
+
+        LOG_VERBOSE("bulk loading, initial size: " << initial_size << ", batch size: " << batch_size << ", number of batches: " << num_batches << ", init uniform: " << boolalpha << is_initial_size_uniform << ", load threads: " << load_threads);
+        return make_unique<ExperimentBulkLoading>(interface, initial_size, batch_size, num_batches, is_initial_size_uniform, load_threads);
     });
 
 
@@ -620,11 +775,26 @@ void initialise() {
     PARAMETER(int64_t, "idls_group_size").hint("N >= 1").set_default(1)
             .descr("Size of consecutive inserts/deletes in the IDLS experiment.")
             .validate_fn([](int64_t value){ return value >= 1; });
+    PARAMETER(int64_t, "lookup_batch").hint("N >= 1").set_default(1)
+            .descr("Perform the lookups in batches of `N' keys at the time. Only valid for the experiments `insert_lookup' and `idls'.")
+            .validate_fn([](int64_t value){ return value >= 1; });
     PARAMETER(string, "idls_delete_distribution")
             .descr("The distribution for the deletions in the IDLS experiment. By default it's the same as inserts. Valid values are `uniform' and `zipf'.");
     PARAMETER(double, "idls_delete_alpha")
             .descr("Rho factor in case the delete distribution is Zipf");
 
+    // Write-ahead log
+    PARAMETER(string, "wal").hint("directory")
+            .descr("Make the updates of the algorithm durable with a write-ahead log, stored in the given directory. Any log already present in the directory is discarded, unless --wal_replay is set.");
+    PARAMETER(bool, "wal_replay")
+            .descr("Before running the experiment, restore the algorithm from the log already present in the directory given by --wal: the snapshot of the last checkpoint, if any, and then the updates in the log after it. Snapshots are only supported by apma_int3 and btreecc_pma7b (with uncompressed keys): at the end of the experiment, these algorithms save a checkpoint, which discards the log it includes. For the other algorithms, the log is retained in full.");
+    PARAMETER(int64_t, "wal_fsync_interval").hint("millisecs").set_default(10)
+            .descr("The max delay between an update and its record in the write-ahead log being synced to disk. All updates within the interval are synced together. If 0, each update is synced before returning.")
+            .validate_fn([](int64_t value){ return value >= 0; });
+    PARAMETER(uint64_t, "wal_segment_size").hint("MB").set_default(64)
+            .descr("The size of each segment (file) of the write-ahead log, in MB.")
+            .validate_fn([](uint64_t value){ return value >= 1; });
+
     // Density constraints
     PARAMETER(double, "rho_0").hint().set_default(0.08)
             .descr("Lower density in the PMA for the lowest level of the calibrator tree, i.e. the segments.");
@@ -661,6 +831,31 @@ void initialise() {
 }
 
 
+// Restore the snapshot of the last checkpoint of the write-ahead log, if any, in the given algorithm
+static void restore_snapshot(Interface* algorithm, const string& path){
+    if(path.empty()) return; // there is no checkpoint
+    LOG_VERBOSE("[WAL] restore the snapshot " << path);
+    if(auto apma = dynamic_cast<adaptive::int3::PackedMemoryArray*>(algorithm); apma != nullptr){
+        apma->open(path);
+    } else if (auto btree = dynamic_cast<BTreePMACC7*>(algorithm); btree != nullptr){
+        btree->open(path);
+    } else {
+        RAISE_EXCEPTION(Exception, "[WAL] The algorithm cannot restore the snapshot " << path);
+    }
+}
+
+// Save the snapshot of the given algorithm, for a checkpoint of the write-ahead log
+static void save_snapshot(Interface& algorithm, const string& path){
+    LOG_VERBOSE("[WAL] save the snapshot " << path);
+    if(auto apma = dynamic_cast<adaptive::int3::PackedMemoryArray*>(&algorithm); apma != nullptr){
+        apma->save(path);
+    } else if (auto btree = dynamic_cast<BTreePMACC7*>(&algorithm); btree != nullptr){
+        btree->save(path);
+    } else {
+        RAISE_EXCEPTION(SnapshotError, "[WAL] The algorithm cannot save a snapshot");
+    }
+}
+
 void execute(){
     if(!initialised) RAISE_EXCEPTION(Exception, "pma::initialise() has not been called");
 
@@ -669,8 +864,33 @@ void execute(){
     shared_ptr<Experiment> experiment;
 
     // standard single-payload scenario
-    experiment = factory().make_experiment(name_experiment, factory().make_algorithm(name_algorithm));
+    unique_ptr<Interface> algorithm = factory().make_algorithm(name_algorithm);
+
+    // make the updates durable
+    shared_ptr<WriteAheadLog> wal;
+    auto arg_wal = ARGREF(string, "wal");
+    if(arg_wal.is_set()){
+        string directory = arg_wal.get();
+        int64_t fsync_interval = ARGREF(int64_t, "wal_fsync_interval");
+        uint64_t segment_size = ARGREF(uint64_t, "wal_segment_size");
+        bool replay = ARGREF(bool, "wal_replay");
+        LOG_VERBOSE("[WAL] directory: " << directory << ", fsync interval: " << fsync_interval << " ms, segment size: " << segment_size << " MB, replay: " << boolalpha << replay);
+        if(replay){ restore_snapshot(algorithm.get(), WriteAheadLog::get_checkpoint_snapshot(directory)); }
+        wal = make_shared<WriteAheadLog>(move(algorithm), directory, chrono::milliseconds(fsync_interval), segment_size << 20, replay);
+        if(replay){ LOG_VERBOSE("[WAL] replayed updates: " << wal->get_replayed_updates() << ", cardinality: " << wal->size()); }
+    }
+
+    experiment = factory().make_experiment(name_experiment, wal ? wal : shared_ptr<Interface>{ move(algorithm) });
     experiment->execute();
+
+    // checkpoint the final state, to bound the size of the log
+    if(wal){
+        try {
+            wal->checkpoint(save_snapshot);
+        } catch(SnapshotError& e){
+            cerr << "[WAL] Warning: checkpoint skipped, the log is retained in full. " << e.what() << endl;
+        }
+    }
 }
 
 
@@ -31,6 +31,8 @@
 #include "miscellaneous.hpp"
 #include "profiler.hpp"
 #include "timer.hpp"
+#include "pma/bulk_loading.hpp"
+#include "pma/wal.hpp"
 
 #define RAISE(message) RAISE_EXCEPTION(pma::ExperimentError, message)
 // Report the given message `preamble' together with the associated `time' in milliseconds
@@ -43,15 +45,20 @@ using namespace std;
 
 namespace pma {
 
+// Retrieve the ABTree of the given instance, unwrapping the write-ahead log, if present
+static ABTree* get_abtree(Interface* instance){
+    if(auto wal = dynamic_cast<WriteAheadLog*>(instance); wal != nullptr){ instance = wal->get_implementation(); }
+    return dynamic_cast<ABTree*>(instance);
+}
 
 ExperimentAging::ExperimentAging(shared_ptr<Interface> abtree_instance, size_t initial_size, size_t total_operations, size_t batch_size,
         size_t scan_warmup, size_t scan_num_trials,
         const std::string& temporary_folder, uint64_t seed):
-    m_instance(dynamic_pointer_cast<ABTree>(abtree_instance)), m_initial_size(initial_size),
+    m_instance(abtree_instance), m_abtree(get_abtree(abtree_instance.get())), m_initial_size(initial_size),
     m_total_operations(total_operations), m_batch_size(batch_size), m_scan_warmup(scan_warmup), m_scan_trials(scan_num_trials),
     m_temporary_folder(temporary_folder), m_distribution_seed(seed)
  {
-    if(m_instance.get() == nullptr) RAISE("Invalid instance: it's not an ABTree!");
+    if(m_abtree == nullptr) RAISE("Invalid instance: it's not an ABTree!");
     if(m_instance->size() != 0) { RAISE("The given instance is not empty"); }
     if(m_initial_size <= 0) RAISE("Invalid value for the argument initial size, expected to be > 0: " << m_initial_size);
     if(m_total_operations <= 0) RAISE("Invalid value for the argument `total_operations', expected to be > 0: " << m_total_operations);
@@ -187,7 +194,7 @@ size_t ExperimentAging::run_load(){
     input.close();
 
     Timer timer {true};
-    m_instance->load(elements, m_initial_size);
+    dynamic_cast<BulkLoading*>(m_instance.get())->load(elements, m_initial_size); // either the ABTree or the write-ahead log
     timer.stop();
 
     REPORT_TIME("Loaded " << m_initial_size << " elements. Elapsed time:", timer.milliseconds());
@@ -265,7 +272,7 @@ void ExperimentAging::run(){
         Timer t_scan;
 
         // get the avg memory distance among the leaves
-        auto stats = m_instance->get_stats_leaf_distance();
+        auto stats = m_abtree->get_stats_leaf_distance();
 
         // perform `m_scan_trials' scans
         ONLY_IF_PROFILING_ENABLED( BranchMispredictionsProfiler profiler; profiler.start() );
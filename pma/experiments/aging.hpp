@@ -40,7 +40,8 @@ namespace pma {
  *      2e- End while, goto 2b.
  */
 class ExperimentAging : public Experiment {
-    std::shared_ptr<abtree::ABTree> m_instance; // the data structure we are testing
+    std::shared_ptr<Interface> m_instance; // the data structure we are testing, possibly wrapped by a write-ahead log
+    abtree::ABTree* m_abtree; // the actual ABTree tested, to retrieve the statistics on its leaves
     const size_t m_initial_size; // the initial number of elements to load
     const size_t m_total_operations; // total number of insert/delete operations
     const size_t m_batch_size; // interleave `m_batch_size' insert/delete operation at time, then perform the scans
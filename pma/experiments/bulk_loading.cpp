@@ -61,12 +61,13 @@ uint32_t ExperimentBulkLoading::random_generator_max(){
     return result;
 }
 
-ExperimentBulkLoading::ExperimentBulkLoading(shared_ptr<Interface> interface, size_t initial_size, size_t batch_size, size_t num_batches, bool initial_size_uniform) :
-        m_interface(interface), m_initial_size(initial_size), m_batch_size(batch_size), m_num_batches(num_batches), m_initial_size_uniform(initial_size_uniform){
+ExperimentBulkLoading::ExperimentBulkLoading(shared_ptr<Interface> interface, size_t initial_size, size_t batch_size, size_t num_batches, bool initial_size_uniform, size_t load_threads) :
+        m_interface(interface), m_initial_size(initial_size), m_batch_size(batch_size), m_num_batches(num_batches), m_initial_size_uniform(initial_size_uniform), m_load_threads(load_threads){
     if(m_batch_size == 0) RAISE("Invalid value for batch size: " << m_batch_size);
     if(m_num_batches == 0) RAISE("Invalid value for `num_batches': " << m_num_batches);
+    if(m_load_threads == 0) RAISE("Invalid value for `load_threads': " << m_load_threads);
     // side effect: check that the given PMA supports bulk loads
-    if(m_batch_size > 1) get_bulk_loading_interface(m_interface);
+    if(m_batch_size > 1) get_bulk_loading_interface(m_interface)->set_load_threads(m_load_threads);
     // check that the distribution is compatible with the uniform distribution
     if(m_initial_size_uniform && m_initial_size > 0){
         string distribution = ARGREF(string, "distribution");
@@ -149,9 +150,11 @@ void ExperimentBulkLoading::preprocess(){
     }
 
 
-    // thread pinning
-    pin_thread_to_cpu();
-    m_thread_pinned = true;
+    // thread pinning. The workers spawned to load a batch would inherit the affinity of this thread, do not pin it to a single cpu
+    if(m_load_threads == 1){
+        pin_thread_to_cpu();
+        m_thread_pinned = true;
+    }
     LOG_VERBOSE("Experiment ready to begin!");
 }
 
@@ -183,6 +186,7 @@ void ExperimentBulkLoading::run_insert(){
 
     config().db()->add("bulk_loading")
             ("size", m_initial_size)
+            ("threads", m_load_threads)
             ("time", timer.microseconds());
 }
 
@@ -221,10 +225,11 @@ void ExperimentBulkLoading::run_load(){
 
         config().db()->add("bulk_loading")
                 ("size", initial_size)
+                ("threads", m_load_threads)
                 ("time", timer_batch.microseconds());
     }
 
-    REPORT_TIME(m_num_batches << " batches loaded in: ", timer_total);
+    REPORT_TIME(m_num_batches << " batches loaded with " << m_load_threads << " thread(s) in: ", timer_total);
 }
 
 
@@ -40,6 +40,7 @@ class ExperimentBulkLoading : public Experiment {
     const size_t m_num_batches; // the number of batches to load
     std::unique_ptr<distribution::Distribution> m_distribution; // the distribution for the batches to load
     bool m_initial_size_uniform; // whether to load the first `m_initial_elements' following an uniform distribution
+    const size_t m_load_threads; // max number of threads the data structure can employ to load a batch
     bool m_thread_pinned = false; // record whether the thread has been pinned
 
 private:
@@ -95,8 +96,9 @@ public:
      * @param batch_size the size of each batch, in terms of number of elements
      * @param num_batches the number of batches to load
      * @param initial_size_uniform whether to load the first `initial_size' elements following an uniform distribution
+     * @param load_threads the max number of threads the data structure can employ to load a batch
      */
-    ExperimentBulkLoading(std::shared_ptr<Interface> interface, size_t initial_size, size_t batch_size, size_t num_batches, bool initial_size_uniform);
+    ExperimentBulkLoading(std::shared_ptr<Interface> interface, size_t initial_size, size_t batch_size, size_t num_batches, bool initial_size_uniform, size_t load_threads = 1);
 
     /**
      * Destructor
@@ -17,13 +17,17 @@
 
 #include "idls.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <memory>
 
 #include "configuration.hpp"
+#include "console_arguments.hpp"
 #include "database.hpp"
 #include "miscellaneous.hpp" // pin_thread_to_cpu(), unpin_thread()
 #include "pma/interface.hpp"
+#include "pma/wal.hpp"
 
 using namespace std;
 
@@ -190,17 +194,39 @@ void ExperimentIDLS::run_lookups(){
     auto lookup_step_ptr = m_keys_experiment.lookup_step();
     auto distribution = lookup_step_ptr.get();
 
-    for(size_t i = 0; i < N_lookups; i++){
-        assert(distribution->hasNext() && "Expected `N_lookups' keys");
-        auto key = distribution->next();
-        assert(key > 0 && "Expected a positive value for the key");
+    size_t batch_sz = ARGREF(int64_t, "lookup_batch");
+    if(batch_sz <= 1){
+        for(size_t i = 0; i < N_lookups; i++){
+            assert(distribution->hasNext() && "Expected `N_lookups' keys");
+            auto key = distribution->next();
+            assert(key > 0 && "Expected a positive value for the key");
 
 #if !defined(NDEBUG)
-        auto value = pma->find(key);
-        assert(value == key && "Key/value mismatch");
+            auto value = pma->find(key);
+            assert(value == key && "Key/value mismatch");
 #else
-        pma->find(key);
+            pma->find(key);
 #endif
+        }
+    } else { // perform the lookups in batches
+        unique_ptr<int64_t[]> keys { new int64_t[batch_sz] };
+        unique_ptr<int64_t[]> values { new int64_t[batch_sz] };
+        for(size_t i = 0; i < N_lookups; i += batch_sz){
+            size_t sz = min(batch_sz, N_lookups - i);
+            for(size_t j = 0; j < sz; j++){
+                assert(distribution->hasNext() && "Expected `N_lookups' keys");
+                keys[j] = distribution->next();
+                assert(keys[j] > 0 && "Expected a positive value for the key");
+            }
+
+            pma->find_batch(keys.get(), values.get(), sz);
+
+#if !defined(NDEBUG)
+            for(size_t j = 0; j < sz; j++){
+                assert(values[j] == keys[j] && "Key/value mismatch");
+            }
+#endif
+        }
     }
 }
 
@@ -289,6 +315,24 @@ void ExperimentIDLS::run(){
     REPORT_TIME("Additional insertions: " << count_insertions << " in sequences of " << N_consecutive_operations << " operations. Elapsed time:", t_insert.milliseconds());
     REPORT_TIME("Additional deletions: " << count_deletions << " in sequences of " << N_consecutive_operations << " operations. Elapsed time:", t_delete.milliseconds());
 
+    // Overhead of the write-ahead log
+    if(auto wal = dynamic_cast<WriteAheadLog*>(m_pma.get()); wal != nullptr){
+        Timer t_flush(true);
+        wal->flush(); // wait for the last group commit
+        t_flush.stop();
+        auto stats = wal->get_statistics();
+        REPORT_TIME("Write-ahead log, " << stats << ", final flush. Elapsed time:", t_flush.milliseconds());
+        config().db()->add("idls_wal")
+                        ("records", stats.m_num_records)
+                        ("bytes", stats.m_num_bytes)
+                        ("group_commits", stats.m_num_group_commits)
+                        ("segments", stats.m_num_segments)
+                        ("stalls", stats.m_num_stalls)
+                        ("t_log_writer", stats.m_time_flush_usecs / 1000)
+                        ("t_flush", t_flush.milliseconds<uint64_t>())
+                        ;
+    }
+
     // Lookups
     Timer t_lookups;
     if(N_lookups > 0){
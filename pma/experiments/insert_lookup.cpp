@@ -17,8 +17,10 @@
 
 #include "insert_lookup.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <memory>
 #include <random>
 
 #include "configuration.hpp"
@@ -75,8 +77,21 @@ void ExperimentInsertLookup::do_lookups(Interface* pma, Distribution* permutatio
     mt19937_64 random_generator(seed);
     uniform_int_distribution<int64_t> distribution(0, pma->size() == 0 ? 0 : pma->size() -1);
 
-    for(size_t i = 0; i < N_lookups; i++){
-        pma->find(permutation->get( distribution(random_generator) ).first +1 );
+    size_t batch_sz = ARGREF(int64_t, "lookup_batch");
+    if(batch_sz <= 1){
+        for(size_t i = 0; i < N_lookups; i++){
+            pma->find(permutation->get( distribution(random_generator) ).first +1 );
+        }
+    } else { // perform the lookups in batches
+        unique_ptr<int64_t[]> keys { new int64_t[batch_sz] };
+        unique_ptr<int64_t[]> values { new int64_t[batch_sz] };
+        for(size_t i = 0; i < N_lookups; i += batch_sz){
+            size_t sz = min(batch_sz, N_lookups - i);
+            for(size_t j = 0; j < sz; j++){
+                keys[j] = permutation->get( distribution(random_generator) ).first +1;
+            }
+            pma->find_batch(keys.get(), values.get(), sz);
+        }
     }
 }
 
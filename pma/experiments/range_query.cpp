@@ -101,15 +101,14 @@ public:
     ContainerKeysSparse(Interface* pma){
         m_keys.reserve(pma->size());
         auto it = pma->iterator();
-        int64_t i = 0;
-        while(it->hasNext()){
-            int64_t key = it->next().first;
-
-            int64_t prefix_sum = key;
-            if(i>0) prefix_sum += m_keys[i-1].second;
-
-            m_keys.emplace_back(key, prefix_sum);
-            i++;
+        int64_t prefix_sum = 0;
+        const int64_t* keys = nullptr;
+        const int64_t* values = nullptr;
+        while(size_t length = it->next_block(&keys, &values)){
+            for(size_t i = 0; i < length; i++){
+                prefix_sum += keys[i];
+                m_keys.emplace_back(keys[i], prefix_sum);
+            }
         }
     }
 
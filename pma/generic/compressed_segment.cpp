@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "compressed_segment.hpp"
+
+#include <cassert>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "segment_search.hpp"
+
+using namespace std;
+
+namespace pma {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Encode                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+void compressed_segment_encode(const int64_t* keys, size_t num_keys, int64_t base, int width, uint8_t* out) noexcept {
+    assert(width >= 0 && width <= 64);
+    if(width == 0) return; // nothing to store
+
+    uint64_t buffer = 0; // bits not written yet
+    int filled = 0; // number of bits used in the buffer
+    for(size_t i = 0; i < num_keys; i++){
+        assert(keys[i] >= base && "The base must be the minimum of the run");
+        uint64_t offset = static_cast<uint64_t>(keys[i]) - static_cast<uint64_t>(base);
+        buffer |= offset << filled;
+        filled += width;
+        if(filled >= 64){ // flush the buffer
+            memcpy(out, &buffer, sizeof(buffer));
+            out += sizeof(buffer);
+            filled -= 64;
+            buffer = (filled == 0) ? 0 : offset >> (width - filled);
+        }
+    }
+
+    // last bits
+    if(filled > 0){ memcpy(out, &buffer, (filled + 7) / 8); }
+}
+
+void compressed_segment_store(uint8_t* segment, const int64_t* keys, size_t num_keys) noexcept {
+    int64_t base = num_keys > 0 ? keys[0] : 0;
+    uint8_t width = num_keys > 0 ? compressed_segment_width(keys[0], keys[num_keys -1]) : 0;
+    memcpy(segment, &base, sizeof(base));
+    segment[sizeof(base)] = width;
+    compressed_segment_encode(keys, num_keys, base, width, segment + COMPRESSED_SEGMENT_HEADER);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Decode                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+
+void decode_scalar(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t* out_keys) noexcept {
+    for(size_t i = 0; i < num_keys; i++){
+        out_keys[i] = compressed_segment_get(in, i, base, width);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void decode_avx2(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t* out_keys) noexcept {
+    const __m256i vbase = _mm256_set1_epi64x(base);
+    size_t i = 0;
+
+    switch(width){
+    case 8: // byte aligned widths, zero extend the offsets
+        for( ; i + 4 <= num_keys; i += 4){
+            uint32_t packed; memcpy(&packed, in + i, sizeof(packed));
+            __m256i offsets = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_keys + i), _mm256_add_epi64(vbase, offsets));
+        }
+        break;
+    case 16:
+        for( ; i + 4 <= num_keys; i += 4){
+            __m256i offsets = _mm256_cvtepu16_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i * 2)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_keys + i), _mm256_add_epi64(vbase, offsets));
+        }
+        break;
+    case 32:
+        for( ; i + 4 <= num_keys; i += 4){
+            __m256i offsets = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_keys + i), _mm256_add_epi64(vbase, offsets));
+        }
+        break;
+    default:
+        if(width > 0 && width <= 56){ // each offset is contained in the 8 bytes starting at its first byte
+            const __m256i vmask = _mm256_set1_epi64x((static_cast<int64_t>(1) << width) -1);
+            const __m256i vstep = _mm256_set1_epi64x(4 * width);
+            const __m256i vseven = _mm256_set1_epi64x(7);
+            __m256i vbit = _mm256_setr_epi64x(0, width, 2 * width, 3 * width); // bit offset of each lane
+            for( ; i + 4 <= num_keys; i += 4){
+                __m256i vbyte = _mm256_srli_epi64(vbit, 3);
+                __m256i words = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(in), vbyte, 1);
+                __m256i offsets = _mm256_and_si256(_mm256_srlv_epi64(words, _mm256_and_si256(vbit, vseven)), vmask);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_keys + i), _mm256_add_epi64(vbase, offsets));
+                vbit = _mm256_add_epi64(vbit, vstep);
+            }
+        }
+    }
+
+    // remainder, or widths in (56, 64]
+    for( ; i < num_keys; i++){ out_keys[i] = compressed_segment_get(in, i, base, width); }
+}
+#endif
+
+} // anonymous namespace
+
+void compressed_segment_decode(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t* out_keys) noexcept {
+    if(width == 0){
+        for(size_t i = 0; i < num_keys; i++){ out_keys[i] = base; }
+#if defined(__x86_64__)
+    } else if(segment_search_kernel() != SegmentSearchKernel::SCALAR){
+        decode_avx2(in, num_keys, base, width, out_keys);
+#endif
+    } else {
+        decode_scalar(in, num_keys, base, width, out_keys);
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Search                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+
+/**
+ * Branchless binary search on the encoded offsets.
+ * Invariant: all offsets before `base' qualify, all offsets after base + num_keys do not.
+ */
+template<bool upper_bound>
+size_t bound(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t key) noexcept {
+    if(key < base) return 0;
+    const uint64_t target = static_cast<uint64_t>(key) - static_cast<uint64_t>(base);
+    if(width < 64 && (target >> width) > 0) return num_keys; // greater than any encoded offset
+
+    size_t first = 0;
+    while(num_keys > 1){
+        size_t half = num_keys / 2;
+        uint64_t offset = static_cast<uint64_t>(compressed_segment_get(in, first + half, 0, width));
+        bool qualifies = upper_bound ? (offset <= target) : (offset < target);
+        first = qualifies ? first + half : first; // cmov
+        num_keys -= half;
+    }
+    if(num_keys == 1){
+        uint64_t offset = static_cast<uint64_t>(compressed_segment_get(in, first, 0, width));
+        first += upper_bound ? (offset <= target) : (offset < target);
+    }
+    return first;
+}
+
+} // anonymous namespace
+
+size_t compressed_segment_lower_bound(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t key) noexcept {
+    return bound</* upper bound ? */ false>(in, num_keys, base, width, key);
+}
+
+size_t compressed_segment_upper_bound(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t key) noexcept {
+    return bound</* upper bound ? */ true>(in, num_keys, base, width, key);
+}
+
+} // namespace pma
@@ -0,0 +1,156 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERIC_COMPRESSED_SEGMENT_HPP_
+#define GENERIC_COMPRESSED_SEGMENT_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+
+namespace pma {
+
+/**
+ * Frame-of-reference compression for the sorted run of keys of a PMA segment. A run is represented by its
+ * minimum (the base), kept by the caller, and by the offsets of each key from the base. The offsets are
+ * bit-packed in a little-endian bit stream, all with the same width: the number of bits of the largest offset,
+ * i.e. max - min. A run where all keys are equal has width 0 and does not take any space.
+ *
+ * The keys can be accessed at random, without decoding the whole run. The functions accessing an encoded run
+ * may read up to COMPRESSED_SEGMENT_PADDING bytes past its end, the caller must ensure this memory is readable.
+ * The decoder is vectorised with AVX2, when the current CPU supports it, according to the kernel selected for
+ * the segment search (see segment_search.hpp).
+ */
+constexpr size_t COMPRESSED_SEGMENT_PADDING = 8;
+
+/**
+ * Retrieve the number of bits required to encode the keys in the interval [min, max], with min <= max
+ */
+inline int compressed_segment_width(int64_t min, int64_t max) noexcept {
+    uint64_t range = static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+    return range == 0 ? 0 : 64 - __builtin_clzll(range);
+}
+
+/**
+ * Retrieve the space, in bytes, required to encode `num_keys' with the given width
+ */
+inline size_t compressed_segment_bytes(size_t num_keys, int width) noexcept {
+    return (num_keys * width + 7) / 8;
+}
+
+/**
+ * Encode the sorted keys[0, num_keys) as offsets from `base', with the given width, into `out'. The output must
+ * have room for compressed_segment_bytes(num_keys, width) bytes.
+ */
+void compressed_segment_encode(const int64_t* keys, size_t num_keys, int64_t base, int width, uint8_t* out) noexcept;
+
+/**
+ * Decode the first `num_keys' of the given run into the array `out_keys'
+ */
+void compressed_segment_decode(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t* out_keys) noexcept;
+
+/**
+ * Retrieve the key at the given position of the run
+ */
+inline int64_t compressed_segment_get(const uint8_t* in, size_t position, int64_t base, int width) noexcept {
+    if(width == 0) return base;
+    const size_t bit = position * width;
+    const size_t shift = bit % 8;
+    uint64_t word;
+    memcpy(&word, in + bit / 8, sizeof(word));
+    uint64_t offset = word >> shift;
+    if(shift + width > 64){ offset |= static_cast<uint64_t>(in[bit / 8 + 8]) << (64 - shift); } // only for widths > 56
+    if(width < 64){ offset &= (static_cast<uint64_t>(1) << width) -1; }
+    return static_cast<int64_t>(static_cast<uint64_t>(base) + offset);
+}
+
+/**
+ * Retrieve the number of keys in the run strictly less than `key', with a binary search on the encoded offsets
+ */
+size_t compressed_segment_lower_bound(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t key) noexcept;
+
+/**
+ * Retrieve the number of keys in the run less or equal than `key', with a binary search on the encoded offsets
+ */
+size_t compressed_segment_upper_bound(const uint8_t* in, size_t num_keys, int64_t base, int width, int64_t key) noexcept;
+
+/**
+ * Layout of a segment whose keys are stored compressed in a fixed amount of space: the base (8 bytes) and the width
+ * (1 byte) of the run, followed by the encoded offsets. The padding read past the end of the run must be part of the
+ * space of the segment.
+ */
+constexpr size_t COMPRESSED_SEGMENT_HEADER = sizeof(int64_t) + sizeof(uint8_t);
+
+/**
+ * Retrieve the base of the run stored in the given segment
+ */
+inline int64_t compressed_segment_get_base(const uint8_t* segment) noexcept {
+    int64_t base;
+    memcpy(&base, segment, sizeof(base));
+    return base;
+}
+
+/**
+ * Retrieve the width of the run stored in the given segment
+ */
+inline int compressed_segment_get_width(const uint8_t* segment) noexcept {
+    return segment[sizeof(int64_t)];
+}
+
+/**
+ * Check whether `num_keys' keys in the interval [min, max] fit in a segment of `segment_bytes' bytes
+ */
+inline bool compressed_segment_fits(int64_t min, int64_t max, size_t num_keys, size_t segment_bytes) noexcept {
+    return num_keys <= 1 || COMPRESSED_SEGMENT_HEADER + compressed_segment_bytes(num_keys, compressed_segment_width(min, max)) + COMPRESSED_SEGMENT_PADDING <= segment_bytes;
+}
+
+/**
+ * Store the sorted keys[0, num_keys) in the given segment, header included
+ */
+void compressed_segment_store(uint8_t* segment, const int64_t* keys, size_t num_keys) noexcept;
+
+/**
+ * Decode the first `num_keys' of the given segment into the array `out_keys'
+ */
+inline void compressed_segment_load(const uint8_t* segment, size_t num_keys, int64_t* out_keys) noexcept {
+    compressed_segment_decode(segment + COMPRESSED_SEGMENT_HEADER, num_keys, compressed_segment_get_base(segment), compressed_segment_get_width(segment), out_keys);
+}
+
+/**
+ * Retrieve the key at the given position of the segment
+ */
+inline int64_t compressed_segment_key(const uint8_t* segment, size_t position) noexcept {
+    return compressed_segment_get(segment + COMPRESSED_SEGMENT_HEADER, position, compressed_segment_get_base(segment), compressed_segment_get_width(segment));
+}
+
+/**
+ * Retrieve the number of keys in the first `num_keys' of the segment strictly less than `key'
+ */
+inline size_t compressed_segment_lower_bound(const uint8_t* segment, size_t num_keys, int64_t key) noexcept {
+    return compressed_segment_lower_bound(segment + COMPRESSED_SEGMENT_HEADER, num_keys, compressed_segment_get_base(segment), compressed_segment_get_width(segment), key);
+}
+
+/**
+ * Retrieve the number of keys in the first `num_keys' of the segment less or equal than `key'
+ */
+inline size_t compressed_segment_upper_bound(const uint8_t* segment, size_t num_keys, int64_t key) noexcept {
+    return compressed_segment_upper_bound(segment + COMPRESSED_SEGMENT_HEADER, num_keys, compressed_segment_get_base(segment), compressed_segment_get_width(segment), key);
+}
+
+} // namespace pma
+
+#endif /* GENERIC_COMPRESSED_SEGMENT_HPP_ */
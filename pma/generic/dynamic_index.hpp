@@ -20,7 +20,7 @@
 
 #include <cassert>
 #include <cinttypes>
-#include <cstdlib> // posix_memalign
+#include <cstring> // memcpy
 #include <iomanip>
 #include <iostream>
 #if defined(HAVE_LIBNUMA)
@@ -31,6 +31,8 @@
 #include <stdexcept>
 
 #include "miscellaneous.hpp" // to_string_with_unit_suffix
+#include "node_search.hpp"
+#include "slab_allocator.hpp"
 
 namespace pma {
 
@@ -38,6 +40,7 @@ namespace pma {
  * Generic implementation of an (a,b)-tree, with separator keys, for keys and values of type K and V.
  * The maximum number of separator keys in the intermediate nodes is `inode_b', while `leaf_b'
  * is the maximum capacity, in terms of number of elements, in the leaves.
+ * The nodes are allocated from slab allocators, a new node is placed in the same chunk of its sibling, if possible.
  */
 template<typename K, typename V, int inode_b = 64, int leaf_b = 64>
 class DynamicIndex {
@@ -79,15 +82,20 @@ class DynamicIndex {
     K* KEYS(const Leaf* leaf) const;
     V* VALUES(const Leaf* leaf) const;
 
+    mutable SlabAllocator m_allocator_inodes; // the allocator for the internal nodes
+    mutable SlabAllocator m_allocator_leaves; // the allocator for the leaves
     Node* m_root; // current root
     uint64_t m_cardinality; // number of elements inside the B-Tree
     int m_height =1; // number of levels, or height of the tree
     mutable uint64_t m_num_inodes; // number of internal nodes allocated, to compute the memory footprint
     mutable uint64_t m_num_leaves; // number of leaves allocated, to compute the memory footprint
 
-    // Create a new node / leaf
-    InternalNode* create_inode() const;
-    Leaf* create_leaf() const;
+    // Create a new node / leaf, possibly close to the given `hint'
+    InternalNode* create_inode(const Node* hint = nullptr) const;
+    Leaf* create_leaf(const Leaf* hint = nullptr) const;
+
+    // Relocate the leaves of the subtree rooted at `node' into the given allocator, in key order
+    void defragment_rec(Node* node, int depth, SlabAllocator* allocator, Leaf** previous);
 
     // Get the memory size of an internal node / leaf
     constexpr size_t memsize_inode() const;
@@ -96,6 +104,9 @@ class DynamicIndex {
     // Retrieve the minimum capacity of the nodes at depth `depth' (depth starts from 0).
     size_t lowerbound(int depth) const;
 
+    // Prefetch the header & the keys of the node at depth `depth', before searching it
+    void prefetch(const Node* node, int depth) const;
+
     // Delete an existing node / leaf
     void delete_node(Node* node, int depth) const;
 
@@ -201,6 +212,12 @@ public:
      */
     void clear();
 
+    /**
+     * Relocate all leaves, in key order, into a new set of chunks, so that logically consecutive leaves are also
+     * adjacent in memory
+     */
+    void defragment();
+
     /**
      * Retrieve the memory footprint of this index, in bytes
      */
@@ -221,7 +238,7 @@ public:
 
 template<typename K, typename V, int inode_b, int leaf_b>
 DynamicIndex<K, V, inode_b, leaf_b>::DynamicIndex() :
-    m_root(nullptr), m_cardinality(0), m_num_inodes(0), m_num_leaves(0){
+    m_allocator_inodes(memsize_inode()), m_allocator_leaves(memsize_leaf()), m_root(nullptr), m_cardinality(0), m_num_inodes(0), m_num_leaves(0){
     m_root = create_leaf();
 }
 
@@ -231,14 +248,12 @@ DynamicIndex<K, V, inode_b, leaf_b>::~DynamicIndex() {
 }
 
 template<typename K, typename V, int inode_b, int leaf_b>
-typename DynamicIndex<K, V, inode_b, leaf_b>::Leaf* DynamicIndex<K, V, inode_b, leaf_b>::create_leaf() const {
+typename DynamicIndex<K, V, inode_b, leaf_b>::Leaf* DynamicIndex<K, V, inode_b, leaf_b>::create_leaf(const Leaf* hint) const {
     static_assert(!std::is_polymorphic<Leaf>::value, "Expected a non polymorphic type (no vtable)");
     static_assert(sizeof(Leaf) == 24, "Expected 24 bytes for the cardinality + ptr previous + ptr next");
 
     // (cardinality) 1 + (ptr left/right) 2 + (keys=) leaf_b + (values) leaf_b == 2 * leaf_b + 1;
-    Leaf* ptr (nullptr);
-    int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_leaf());
-    if(rc != 0) throw std::runtime_error("DynamicIndex::create_leaf, cannot obtain a chunk of aligned memory");
+    Leaf* ptr = reinterpret_cast<Leaf*>(m_allocator_leaves.allocate(hint));
     ptr->N = 0;
     ptr->next = ptr->previous = nullptr;
 
@@ -247,14 +262,12 @@ typename DynamicIndex<K, V, inode_b, leaf_b>::Leaf* DynamicIndex<K, V, inode_b,
 }
 
 template<typename K, typename V, int inode_b, int leaf_b>
-typename DynamicIndex<K, V, inode_b, leaf_b>::InternalNode* DynamicIndex<K, V, inode_b, leaf_b>::create_inode() const {
+typename DynamicIndex<K, V, inode_b, leaf_b>::InternalNode* DynamicIndex<K, V, inode_b, leaf_b>::create_inode(const Node* hint) const {
     static_assert(!std::is_polymorphic<InternalNode>::value, "Expected a non polymorphic type (no vtable)");
     static_assert(sizeof(InternalNode) == 8, "Expected only 8 bytes for the cardinality");
 
     // (cardinality) 1 + (keys=) intnode_b + (pointers) intnode_b +1 == 2 * intnode_b +2;
-    InternalNode* ptr (nullptr);
-    int rc = posix_memalign((void**) &ptr, /* alignment = */ 64,  /* size = */ memsize_inode());
-    if(rc != 0) throw std::runtime_error("ABTree::create_internal_node, cannot obtain a chunk of aligned memory");
+    InternalNode* ptr = reinterpret_cast<InternalNode*>(m_allocator_inodes.allocate(hint));
     ptr->N = 0;
 
     m_num_inodes++;
@@ -276,12 +289,12 @@ void DynamicIndex<K, V, inode_b, leaf_b>::delete_node(Node* node, int depth) con
 
         assert(m_num_inodes > 0 && "Underflow");
         m_num_inodes--;
+        m_allocator_inodes.deallocate(node);
     } else {
         assert(m_num_leaves > 0 && "Underflow");
         m_num_leaves--;
+        m_allocator_leaves.deallocate(node);
     }
-
-    free(node);
 }
 
 template<typename K, typename V, int inode_b, int leaf_b>
@@ -300,6 +313,12 @@ size_t DynamicIndex<K, V, inode_b, leaf_b>::lowerbound(int depth) const{
     return is_leaf ? leaf_b/2 : inode_b/2;
 }
 
+template<typename K, typename V, int inode_b, int leaf_b>
+void DynamicIndex<K, V, inode_b, leaf_b>::prefetch(const Node* node, int depth) const {
+    bool is_leaf = (depth == m_height -1);
+    node_prefetch(node, is_leaf ? sizeof(Leaf) + sizeof(K) * leaf_b : sizeof(InternalNode) + sizeof(K) * inode_b);
+}
+
 template<typename K, typename V, int inode_b, int leaf_b>
 bool DynamicIndex<K, V, inode_b, leaf_b>::Node::empty() const {
     return N == 0;
@@ -342,6 +361,45 @@ void DynamicIndex<K, V, inode_b, leaf_b>::clear() {
     m_height = 1;
 }
 
+template<typename K, typename V, int inode_b, int leaf_b>
+void DynamicIndex<K, V, inode_b, leaf_b>::defragment() {
+    // the leaves are copied in key order, the new chunks hand out their slots sequentially
+    SlabAllocator allocator { memsize_leaf() };
+    Leaf* previous = nullptr;
+    defragment_rec(m_root, 0, &allocator, &previous);
+    if(previous != nullptr){ previous->next = nullptr; }
+    m_allocator_leaves.swap(allocator); // the old chunks are released by the dtor of `allocator'
+}
+
+template<typename K, typename V, int inode_b, int leaf_b>
+void DynamicIndex<K, V, inode_b, leaf_b>::defragment_rec(Node* node, int depth, SlabAllocator* allocator, Leaf** previous) {
+    if(depth == m_height -1){ // only the root
+        assert(node == m_root);
+        Leaf* copy = reinterpret_cast<Leaf*>(allocator->allocate());
+        memcpy(copy, node, memsize_leaf());
+        copy->previous = nullptr;
+        *previous = copy;
+        m_root = copy;
+    } else if (depth +1 == m_height -1){ // parent of leaves
+        InternalNode* inode = reinterpret_cast<InternalNode*>(node);
+        Node** children = CHILDREN(inode);
+        for(size_t i = 0; i < inode->N; i++){
+            Leaf* copy = reinterpret_cast<Leaf*>(allocator->allocate());
+            memcpy(copy, children[i], memsize_leaf());
+            copy->previous = *previous;
+            if(*previous != nullptr){ (*previous)->next = copy; }
+            children[i] = copy;
+            *previous = copy;
+        }
+    } else {
+        InternalNode* inode = reinterpret_cast<InternalNode*>(node);
+        Node** children = CHILDREN(inode);
+        for(size_t i = 0; i < inode->N; i++){
+            defragment_rec(children[i], depth +1, allocator, previous);
+        }
+    }
+}
+
 template<typename K, typename V, int inode_b, int leaf_b>
 uint64_t DynamicIndex<K, V, inode_b, leaf_b>::memory_footprint() const {
     return sizeof(*this) + m_num_inodes * memsize_inode() + m_num_leaves * memsize_leaf();
@@ -371,10 +429,9 @@ void DynamicIndex<K, V, inode_b, leaf_b>::insert(Node* node, const K key, const
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
 
         assert(inode->N > 0);
-        size_t i = 0, last_key = inode->N -1;
-        K* __restrict keys = KEYS(inode);
-        while(i < last_key && key > keys[i]) i++;
+        size_t i = node_lower_bound<inode_b>(KEYS(inode), inode->N -1, key);
         node = CHILDREN(inode)[i];
+        prefetch(node, depth +1);
 
         // before moving to its child, check whether it is full. If this is the case
         // we need to make a recursive call to check again whether we need to split the
@@ -432,7 +489,7 @@ void DynamicIndex<K, V, inode_b, leaf_b>::split(InternalNode* inode, size_t chil
     if(child_is_leaf){
         // split a leaf in half
         Leaf* l1 = reinterpret_cast<Leaf*>(CHILDREN(inode)[child_index]);
-        Leaf* l2 = create_leaf();
+        Leaf* l2 = create_leaf(/* hint */ l1);
 
         assert(l1->N <= leaf_b);
 
@@ -460,7 +517,7 @@ void DynamicIndex<K, V, inode_b, leaf_b>::split(InternalNode* inode, size_t chil
     // split an internal node
     else {
         InternalNode* n1 = reinterpret_cast<InternalNode*>(CHILDREN(inode)[child_index]);
-        InternalNode* n2 = create_inode();
+        InternalNode* n2 = create_inode(/* hint */ n1);
 
         size_t thres = n1->N /2;
         n2->N = n1->N - (thres +1);
@@ -1001,9 +1058,9 @@ bool DynamicIndex<K, V, inode_b, leaf_b>::remove_any(Node* node, const K key, V*
 
     while(depth < m_height -1){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = node->N;
+        size_t N = node->N;
         assert(N > 0);
-        while(i < N -1 && KEYS(inode)[i] < key) i++;
+        size_t i = node_lower_bound<inode_b>(KEYS(inode), N -1, key);
         if(omin == nullptr && i < N -1 && KEYS(inode)[i] == key){
             // in case omin != nullptr, then i = 0 and we are already following the min
             // from another internal node. This tree has many duplicates.
@@ -1038,8 +1095,7 @@ bool DynamicIndex<K, V, inode_b, leaf_b>::remove_any(Node* node, const K key, V*
                 leaf->N -= 1;
                 element_removed = true;
             } else if(keys[N-1] > key){
-                size_t i = 0;
-                while(i < N && keys[i] < key) i++;
+                size_t i = node_lower_bound<leaf_b>(keys, N, key);
                 if(i < N && keys[i] == key){
                     if(out_value) *out_value = values[i];
                     for(size_t j = i; j < leaf->N -1; j++){
@@ -1090,18 +1146,18 @@ bool DynamicIndex<K, V, inode_b, leaf_b>::find_any(const K key, V* out_value) co
     // use tail recursion on the internal nodes
     for(int depth = 0, l = m_height -1; depth < l; depth++){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = inode->N -1;
+        size_t N = inode->N -1;
         assert(N > 0 && N <= inode_b);
-        K* __restrict keys = KEYS(inode);
-        while(i < N && keys[i] <= key) i++;
+        size_t i = node_upper_bound<inode_b>(KEYS(inode), N, key);
         node = CHILDREN(inode)[i];
+        prefetch(node, depth +1);
     }
 
     // base case, this is a leaf
     Leaf* leaf = reinterpret_cast<Leaf*>(node);
-    size_t i = 0, N = leaf->N;
+    size_t N = leaf->N;
     K* __restrict keys = KEYS(leaf);
-    while(i < N && keys[i] < key) i++;
+    size_t i = node_lower_bound<leaf_b>(keys, N, key);
     if(i < N && keys[i] == key){
         if(out_value) *out_value = VALUES(leaf)[i];
         return true;
@@ -1120,17 +1176,17 @@ bool DynamicIndex<K, V, inode_b, leaf_b>::find_first(const K key, K* out_key, V*
     // use tail recursion on the internal nodes
     for(int depth = 0, l = m_height -1; depth < l; depth++){
         InternalNode* inode = reinterpret_cast<InternalNode*>(node);
-        size_t i = 0, N = inode->N -1;
+        size_t N = inode->N -1;
         assert(N > 0 && N <= inode_b);
-        K* __restrict keys = KEYS(inode);
-        while(i < N && keys[i] < key) i++;
+        size_t i = node_lower_bound<inode_b>(KEYS(inode), N, key);
         node = CHILDREN(inode)[i];
+        prefetch(node, depth +1);
     }
 
     Leaf* leaf = reinterpret_cast<Leaf*>(node);
-    size_t i = 0, N = leaf->N;
+    size_t N = leaf->N;
     K* __restrict keys = KEYS(leaf);
-    while(i < N && keys[i] < key) i++;
+    size_t i = node_lower_bound<leaf_b>(keys, N, key);
     if(i < N && keys[i] == key){ // exact match
         if(out_key) *out_key = KEYS(leaf)[i];
         *out_value = VALUES(leaf)[i];
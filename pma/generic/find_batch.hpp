@@ -0,0 +1,68 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef GENERIC_FIND_BATCH_HPP_
+#define GENERIC_FIND_BATCH_HPP_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+
+#include "miscellaneous.hpp" // PREFETCH
+#include "static_index.hpp"
+
+namespace pma {
+
+/**
+ * Retrieve the values of a sequence of keys in a clustered PMA indexed by a StaticIndex, where the even segments
+ * store their elements at the end and the odd segments at the start. Implementation of Interface::find_batch
+ * for the adaptive PMAs (apma_int2, apma_int3, bh07_v2).
+ *
+ * The keys are looked up in groups: the segments of the whole group are first resolved with StaticIndex::find_batch
+ * and requested in advance, then each key is searched in its segment with find_in_segment(segment_id, key), which
+ * returns the value associated to the key, or -1 if not found.
+ */
+template<typename SegmentSize, typename FindInSegment>
+void clustered_find_batch(const StaticIndex& index, const int64_t* segment_keys, const SegmentSize* segment_sizes, size_t segment_capacity,
+        const int64_t* keys, int64_t* out_values, size_t num_keys, FindInSegment find_in_segment){
+    constexpr size_t group_sz = 16;
+    uint64_t segments[group_sz];
+    for(size_t i = 0; i < num_keys; i += group_sz){
+        size_t sz = std::min(group_sz, num_keys - i);
+        index.find_batch(keys + i, segments, sz);
+
+        // request the segments of the whole group before searching them
+        for(size_t j = 0; j < sz; j++){
+            size_t segment_id = segments[j];
+            PREFETCH(segment_sizes + segment_id);
+            if(segment_id % 2 == 0){ // even segment, the keys are at the end
+                PREFETCH(segment_keys + (segment_id +1) * segment_capacity -1);
+            } else { // odd segment, the keys are at the start
+                PREFETCH(segment_keys + segment_id * segment_capacity);
+            }
+        }
+
+        for(size_t j = 0; j < sz; j++){
+            out_values[i + j] = find_in_segment(segments[j], keys[i + j]);
+        }
+    }
+}
+
+} // namespace pma
+
+#endif /* GENERIC_FIND_BATCH_HPP_ */
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef GENERIC_LOAD_SORTED_HPP_
+#define GENERIC_LOAD_SORTED_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "static_index.hpp"
+
+/**
+ * Helpers to implement SortedBulkLoading::load_sorted in the clustered PMAs (apma_int2, apma_int3, bh07_v2), where the
+ * even segments store their elements at the end and the odd segments at the start.
+ */
+namespace pma {
+
+/**
+ * Load a sorted sequence of elements in a non empty PMA. The elements are split in runs falling in the same segment.
+ * A run that fits in its segment is merged with merge_run(segment_id, elements, num_elements). Otherwise the whole run
+ * is handed to rebalance_run(segment_id, elements, num_elements), that spreads the window of the segment together with
+ * (a prefix of) the run, or only resizes the PMA, and returns the number of elements of the run it absorbed. The rest of
+ * the run is retried on the new layout.
+ */
+template<typename Storage, typename MergeRun, typename RebalanceRun>
+void clustered_load_sorted(const StaticIndex& index, const Storage& storage, const std::pair<int64_t, int64_t>* elements, size_t num_elements, MergeRun merge_run, RebalanceRun rebalance_run){
+    size_t i = 0;
+    while(i < num_elements){
+        // the run of elements [i, run_end) all fall in the same segment
+        size_t segment_id = index.find(elements[i].first);
+        size_t run_end = i +1;
+        if(segment_id +1 < storage.m_number_segments){
+            int64_t fence_key = index.get_separator_key(segment_id +1);
+            while(run_end < num_elements && elements[run_end].first < fence_key) run_end++;
+        } else {
+            run_end = num_elements;
+        }
+
+        size_t run_length = run_end - i;
+        size_t free_slots = storage.m_segment_capacity - storage.m_segment_sizes[segment_id];
+        if(run_length <= free_slots){
+            merge_run(segment_id, elements + i, run_length);
+            i = run_end;
+        } else if(storage.m_number_segments == 1 && free_slots > 0){ // there is no window to spread, fill the segment before resizing
+            merge_run(segment_id, elements + i, free_slots);
+            i += free_slots;
+        } else {
+            i += rebalance_run(segment_id, elements + i, run_length);
+        }
+    }
+}
+
+/**
+ * Find the window of the calibrator tree, containing the given segment, that can absorb `num_insertions' new elements
+ * without exceeding its upper density threshold, as given by thresholds(height). Returns false if not even the root
+ * can absorb the new elements, that is, the PMA needs to be resized first.
+ */
+template<typename SegmentSize, typename Thresholds>
+bool clustered_find_window(const SegmentSize* segment_sizes, size_t num_segments, size_t segment_capacity, int calibrator_height,
+        size_t segment_id, size_t num_insertions, Thresholds thresholds, size_t* out_window_start, size_t* out_window_length, size_t* out_cardinality_after){
+    int64_t window_length = 1;
+    int64_t window_id = segment_id;
+    int64_t window_start = segment_id /* incl */, window_end = segment_id +1 /* excl */;
+    size_t cardinality_after = segment_sizes[segment_id] + num_insertions;
+    int height = 1;
+    double theta = 1.0, density = static_cast<double>(cardinality_after) / segment_capacity;
+
+    if(calibrator_height > 1){
+        int64_t index_left = segment_id -1;
+        int64_t index_right = segment_id +1;
+
+        do {
+            height++;
+            window_length *= 2;
+            window_id /= 2;
+            window_start = window_id * window_length;
+            window_end = window_start + window_length;
+
+            // re-align the calibrator tree
+            if(window_end > static_cast<int64_t>(num_segments)){
+                int64_t offset = window_end - num_segments;
+                window_start -= offset;
+                window_end -= offset;
+            }
+
+            theta = thresholds(height).second;
+
+            // find the number of elements in the interval
+            while(index_left >= window_start){
+                cardinality_after += segment_sizes[index_left];
+                index_left--;
+            }
+            while(index_right < window_end){
+                cardinality_after += segment_sizes[index_right];
+                index_right++;
+            }
+
+            density = static_cast<double>(cardinality_after) / (window_length * segment_capacity);
+        } while(density > theta && height < calibrator_height);
+    }
+
+    *out_window_start = window_start;
+    *out_window_length = window_length;
+    *out_cardinality_after = cardinality_after;
+    return density <= theta;
+}
+
+/**
+ * Retrieve how many elements can still be added to the whole array without exceeding the upper density threshold of
+ * the root of the calibrator tree, as given by thresholds(calibrator_height). When the root cannot absorb a whole run,
+ * the PMA is first filled up to this threshold, and only then resized: spreading the current elements over a capacity
+ * sized for the whole run could leave some segments empty.
+ */
+template<typename Thresholds>
+size_t clustered_root_room(size_t num_segments, size_t segment_capacity, size_t cardinality, int calibrator_height, Thresholds thresholds){
+    double theta = calibrator_height > 1 ? thresholds(calibrator_height).second : 1.0; // as in clustered_find_window
+    size_t root_cardinality = static_cast<size_t>(theta * num_segments * segment_capacity);
+    return root_cardinality > cardinality ? root_cardinality - cardinality : 0;
+}
+
+/**
+ * Copy the elements of the segments [window_start, window_start + window_length) into keys_to/values_to, merged with
+ * the sorted sequence `run'. In the key-only mode, both `values' and `values_to' are nullptr.
+ */
+template<typename SegmentSize>
+void clustered_gather(const int64_t* keys, const int64_t* values, const SegmentSize* segment_sizes, size_t segment_capacity,
+        size_t window_start, size_t window_length, const std::pair<int64_t, int64_t>* run, size_t run_length, int64_t* keys_to, int64_t* values_to){
+    size_t j = 0; // next element to merge from the run
+    for(size_t segment_id = window_start, window_end = window_start + window_length; segment_id < window_end; segment_id++){
+        size_t sz = segment_sizes[segment_id];
+        if(sz == 0) continue;
+        size_t offset = segment_id * segment_capacity + (segment_id % 2 == 0 ? segment_capacity - sz : 0);
+        const int64_t* segment_keys = keys + offset;
+        const int64_t* segment_values = values ? values + offset : nullptr;
+
+        if(j == run_length || run[j].first > segment_keys[sz -1]){ // nothing to merge in this segment
+            memcpy(keys_to, segment_keys, sz * sizeof(keys_to[0]));
+            if(values_to) memcpy(values_to, segment_values, sz * sizeof(values_to[0]));
+            keys_to += sz;
+            if(values_to) values_to += sz;
+        } else {
+            for(size_t k = 0; k < sz; k++){
+                while(j < run_length && run[j].first < segment_keys[k]){
+                    *(keys_to++) = run[j].first;
+                    if(values_to) *(values_to++) = run[j].second;
+                    j++;
+                }
+                *(keys_to++) = segment_keys[k];
+                if(values_to) *(values_to++) = segment_values[k];
+            }
+        }
+    }
+
+    // the rest of the run
+    for( ; j < run_length; j++){
+        *(keys_to++) = run[j].first;
+        if(values_to) *(values_to++) = run[j].second;
+    }
+}
+
+} // namespace pma
+
+#endif /* GENERIC_LOAD_SORTED_HPP_ */
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef GENERIC_NODE_SEARCH_HPP_
+#define GENERIC_NODE_SEARCH_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace pma {
+
+/**
+ * Search kernels for the sorted keys inside the nodes of a B+ tree, such as abtree::ABTree and pma::DynamicIndex.
+ *
+ * Unlike the kernels of segment_search.hpp, which are resolved at runtime through a function pointer, these are
+ * meant to be inlined in the traversal of the tree. The instruction set is selected at compile time: AVX-512 or
+ * AVX2 when the translation unit is compiled for them (e.g. -march=native with --enable-optimize), otherwise a
+ * scalar fallback. The vectorised kernels only apply to keys of type int64_t.
+ *
+ * The template argument `capacity' is the maximum number of keys that can be stored in the node, when known at
+ * compile time. If it does not exceed NODE_SEARCH_UNROLL_MAX, the kernel is a branch-free count over the whole
+ * node, fully unrolled by the compiler, which may read the unused slots of the node up to its capacity. Otherwise
+ * (or with capacity = 0, unknown) a branchless binary search narrows the run before the linear count.
+ */
+#if defined(__AVX2__) || defined(__AVX512F__)
+constexpr size_t NODE_SEARCH_UNROLL_MAX = 64;
+#else
+constexpr size_t NODE_SEARCH_UNROLL_MAX = 16;
+#endif
+
+namespace node_search_details {
+
+constexpr size_t CACHE_LINE = 64;
+
+// Once the binary search narrowed the run to this number of keys, switch to the linear count
+#if defined(__AVX2__) || defined(__AVX512F__)
+constexpr size_t LINEAR_THRESHOLD = 16;
+#else
+constexpr size_t LINEAR_THRESHOLD = 8;
+#endif
+
+template<bool upper_bound, typename K>
+inline bool qualifies(const K& candidate, const K& key) noexcept {
+    return upper_bound ? !(key < candidate) : (candidate < key);
+}
+
+// Count the qualifying keys in keys[0, num_keys), scalar kernel
+template<bool upper_bound, typename K>
+inline size_t count_scalar(const K* __restrict keys, size_t num_keys, const K& key) noexcept {
+    size_t count = 0;
+    for(size_t i = 0; i < num_keys; i++){ count += qualifies<upper_bound>(keys[i], key); }
+    return count;
+}
+
+#if defined(__AVX512F__)
+template<bool upper_bound>
+inline size_t count_simd(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m512i vkey = _mm512_set1_epi64(key);
+    size_t count = 0;
+    for(size_t i = 0; i < num_keys; i += 8){
+        __mmask8 mask = (num_keys - i >= 8) ? 0xFF : (1u << (num_keys - i)) -1;
+        __m512i vkeys = _mm512_maskz_loadu_epi64(mask, keys + i);
+        count += __builtin_popcount(upper_bound ? _mm512_mask_cmple_epi64_mask(mask, vkeys, vkey) : _mm512_mask_cmplt_epi64_mask(mask, vkeys, vkey));
+    }
+    return count;
+}
+
+template<bool upper_bound, size_t capacity>
+inline size_t count_unrolled_simd(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m512i vkey = _mm512_set1_epi64(key);
+    size_t count = 0;
+#pragma GCC unroll 8
+    for(size_t i = 0; i < capacity; i += 8){
+        size_t remaining = (num_keys > i) ? num_keys - i : 0;
+        __mmask8 mask = (remaining >= 8) ? 0xFF : (1u << remaining) -1;
+        __m512i vkeys = _mm512_maskz_loadu_epi64(mask, keys + i);
+        count += __builtin_popcount(upper_bound ? _mm512_mask_cmple_epi64_mask(mask, vkeys, vkey) : _mm512_mask_cmplt_epi64_mask(mask, vkeys, vkey));
+    }
+    return count;
+}
+#elif defined(__AVX2__)
+// Bitmask of the lanes of keys[i, i+4) that qualify
+template<bool upper_bound>
+inline unsigned mask_avx2(const int64_t* keys, __m256i vkey) noexcept {
+    __m256i vkeys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+    if(upper_bound){ // keys[i] <= key
+        return ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vkeys, vkey))) & 0xF;
+    } else { // keys[i] < key
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vkey, vkeys)));
+    }
+}
+
+template<bool upper_bound>
+inline size_t count_simd(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m256i vkey = _mm256_set1_epi64x(key);
+    size_t count = 0;
+    size_t i = 0;
+    for( ; i + 4 <= num_keys; i += 4){ count += __builtin_popcount(mask_avx2<upper_bound>(keys + i, vkey)); }
+    for( ; i < num_keys; i++){ count += qualifies<upper_bound>(keys[i], key); }
+    return count;
+}
+
+template<bool upper_bound, size_t capacity>
+inline size_t count_unrolled_simd(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    static_assert(capacity % 4 == 0, "Expected a capacity multiple of the vector length");
+    const __m256i vkey = _mm256_set1_epi64x(key);
+    size_t count = 0;
+#pragma GCC unroll 16
+    for(size_t i = 0; i < capacity; i += 4){
+        size_t remaining = (num_keys > i) ? num_keys - i : 0;
+        unsigned lanes = (remaining >= 4) ? 0xF : (1u << remaining) -1;
+        count += __builtin_popcount(mask_avx2<upper_bound>(keys + i, vkey) & lanes);
+    }
+    return count;
+}
+#endif
+
+template<bool upper_bound, typename K>
+inline size_t count(const K* __restrict keys, size_t num_keys, const K& key) noexcept {
+#if defined(__AVX2__) || defined(__AVX512F__)
+    if constexpr (std::is_same_v<K, int64_t>){ return count_simd<upper_bound>(keys, num_keys, key); }
+#endif
+    return count_scalar<upper_bound>(keys, num_keys, key);
+}
+
+template<bool upper_bound, size_t capacity, typename K>
+inline size_t count_unrolled(const K* __restrict keys, size_t num_keys, const K& key) noexcept {
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<K, int64_t> && capacity % 8 == 0){ return count_unrolled_simd<upper_bound, capacity>(keys, num_keys, key); }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<K, int64_t> && capacity % 4 == 0){ return count_unrolled_simd<upper_bound, capacity>(keys, num_keys, key); }
+#endif
+    size_t result = 0;
+#pragma GCC unroll 16
+    for(size_t i = 0; i < capacity; i++){ result += (i < num_keys) & qualifies<upper_bound>(keys[i], key); }
+    return result;
+}
+
+template<bool upper_bound, size_t capacity, typename K>
+inline size_t bound(const K* keys, size_t num_keys, const K& key) noexcept {
+    if constexpr (capacity > 0 && capacity <= NODE_SEARCH_UNROLL_MAX){
+        return count_unrolled<upper_bound, capacity>(keys, num_keys, key);
+    } else { // invariant: all keys before `base' qualify, all keys after base + num_keys do not
+        const K* base = keys;
+        while(num_keys > LINEAR_THRESHOLD){
+            size_t half = num_keys / 2;
+            base = qualifies<upper_bound>(base[half], key) ? base + half : base; // cmov
+            num_keys -= half;
+        }
+        return (base - keys) + count<upper_bound>(base, num_keys, key);
+    }
+}
+
+} // namespace node_search_details
+
+/**
+ * Retrieve the number of keys in the sorted array keys[0, num_keys) strictly less than `key'
+ */
+template<size_t capacity = 0, typename K>
+inline size_t node_lower_bound(const K* keys, size_t num_keys, const K& key) noexcept {
+    return node_search_details::bound</* upper bound ? */ false, capacity>(keys, num_keys, key);
+}
+
+/**
+ * Retrieve the number of keys in the sorted array keys[0, num_keys) less or equal than `key'
+ */
+template<size_t capacity = 0, typename K>
+inline size_t node_upper_bound(const K* keys, size_t num_keys, const K& key) noexcept {
+    return node_search_details::bound</* upper bound ? */ true, capacity>(keys, num_keys, key);
+}
+
+/**
+ * Prefetch the first `length' bytes starting from the given address, e.g. the header and the keys of the
+ * child node to visit next, so that their cache lines are fetched in parallel rather than one at the time
+ * by the search in the node.
+ */
+inline void node_prefetch(const void* address, size_t length) noexcept {
+    const char* base = reinterpret_cast<const char*>(address);
+    for(size_t offset = 0; offset < length; offset += node_search_details::CACHE_LINE){
+        __builtin_prefetch(base + offset, /* read only */ 0, /* temporal locality */ 3);
+    }
+}
+
+} // namespace pma
+
+#endif /* GENERIC_NODE_SEARCH_HPP_ */
@@ -0,0 +1,373 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "parallel_spread.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "buffered_rewired_memory.hpp"
+#include "compressed_segment.hpp"
+#include "segment_search.hpp"
+#include "static_index.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace pma {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Debug                                                                   *
+ *                                                                           *
+ *****************************************************************************/
+//#define DEBUG
+#define COUT_DEBUG_FORCE(msg) std::cout << "[ParallelSpread::" << __FUNCTION__ << "] " << msg << std::endl
+#if defined(DEBUG)
+    #define COUT_DEBUG(msg) COUT_DEBUG_FORCE(msg)
+#else
+    #define COUT_DEBUG(msg)
+#endif
+
+/*****************************************************************************
+ *                                                                           *
+ *   Initialisation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+// Below this amount of elements per worker, the cost of dispatching the workers is not repaid
+constexpr size_t MIN_ELEMENTS_PER_WORKER = 1ull << 16;
+
+ParallelSpread::ParallelSpread(int64_t* keys, int64_t* values, uint16_t* segment_sizes, size_t segment_capacity, BufferedRewiredMemory* memory_keys, BufferedRewiredMemory* memory_values,
+        size_t window_start, size_t input_length, size_t output_length, size_t compressed_bytes) :
+        m_keys(keys), m_values(values), m_segment_sizes(segment_sizes), m_segment_capacity(segment_capacity), m_compressed_bytes(compressed_bytes),
+        m_memory_keys(memory_keys), m_memory_values(memory_values),
+        m_segments_per_extent(memory_keys != nullptr ? memory_keys->get_extent_size() / get_segment_key_bytes() : 0),
+        m_window_start(window_start), m_input_length(input_length), m_output_length(output_length), m_output_sizes(output_length, 0) {
+    if(input_length == 0 || output_length == 0) throw invalid_argument("[ParallelSpread] Empty window");
+    if(memory_keys == nullptr || (values != nullptr && memory_values == nullptr)) throw invalid_argument("[ParallelSpread] The storage is not backed by rewired memory");
+    if(!is_aligned(memory_keys, segment_capacity, window_start, output_length, compressed_bytes)) throw invalid_argument("[ParallelSpread] The window is not aligned to the extents");
+    if(values != nullptr && memory_values->get_extent_size() != m_segments_per_extent * segment_capacity * sizeof(int64_t)) throw invalid_argument("[ParallelSpread] The extents of the keys and the values do not contain the same segments");
+}
+
+void ParallelSpread::set_output_size(size_t segment_id, size_t cardinality){
+    assert(segment_id < m_output_length && "Invalid segment");
+    assert(cardinality <= m_segment_capacity && "Overflow");
+    m_output_sizes[segment_id] = cardinality;
+}
+
+void ParallelSpread::set_output_size_uniform(size_t cardinality){
+    size_t card_per_segment = cardinality / m_output_length;
+    size_t odd_segments = cardinality % m_output_length;
+    for(size_t i = 0; i < m_output_length; i++){
+        set_output_size(i, card_per_segment + (i < odd_segments));
+    }
+}
+
+void ParallelSpread::set_element_to_insert(int64_t key, int64_t value, size_t segment_id){
+    assert(segment_id >= m_window_start && segment_id < m_window_start + m_input_length && "The segment is not part of the input window");
+    m_insert = true;
+    m_insert_key = key;
+    m_insert_value = value;
+    m_insert_input_segment = segment_id;
+}
+
+bool ParallelSpread::is_aligned(BufferedRewiredMemory* memory_keys, size_t segment_capacity, size_t window_start, size_t output_length, size_t compressed_bytes) noexcept {
+    if(memory_keys == nullptr) return false;
+    size_t segments_per_extent = memory_keys->get_extent_size() / (compressed_bytes > 0 ? compressed_bytes : segment_capacity * sizeof(int64_t));
+    return segments_per_extent > 0 && window_start % segments_per_extent == 0 && output_length % segments_per_extent == 0;
+}
+
+size_t ParallelSpread::get_num_workers(size_t cardinality, size_t num_threads) noexcept {
+    return max<size_t>(1, min<size_t>(num_threads, cardinality / MIN_ELEMENTS_PER_WORKER));
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Spread                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+size_t ParallelSpread::get_offset(size_t segment_id, size_t cardinality) const {
+    size_t offset = segment_id * m_segment_capacity;
+    if(segment_id % 2 == 0){ offset += m_segment_capacity - cardinality; } // even segment, the elements are at the end
+    return offset;
+}
+
+size_t ParallelSpread::get_segment_key_bytes() const {
+    return m_compressed_bytes > 0 ? m_compressed_bytes : m_segment_capacity * sizeof(int64_t);
+}
+
+const uint8_t* ParallelSpread::get_compressed_segment(size_t segment_id) const {
+    return reinterpret_cast<const uint8_t*>(m_keys) + segment_id * m_compressed_bytes;
+}
+
+int64_t ParallelSpread::get_key(size_t segment_id, size_t cardinality, size_t position) const {
+    if(m_compressed_bytes > 0){
+        return compressed_segment_key(get_compressed_segment(segment_id), position);
+    } else {
+        return m_keys[get_offset(segment_id, cardinality) + position];
+    }
+}
+
+int64_t ParallelSpread::get_key_by_rank(size_t rank) const {
+    if(rank == m_insert_rank) return m_insert_key;
+    size_t input_rank = rank - (rank > m_insert_rank);
+    size_t input_segment = upper_bound(begin(m_input_start), end(m_input_start) -1, input_rank) - begin(m_input_start) -1;
+    size_t segment_sz = m_input_start[input_segment +1] - m_input_start[input_segment];
+    return get_key(m_window_start + input_segment, segment_sz, input_rank - m_input_start[input_segment]);
+}
+
+size_t ParallelSpread::get_num_output_extents() const {
+    return m_output_length / m_segments_per_extent;
+}
+
+bool ParallelSpread::get_input_extents(size_t extent_id, size_t* out_first, size_t* out_last) const {
+    size_t rank_start = m_output_start[extent_id * m_segments_per_extent];
+    size_t rank_end = m_output_start[(extent_id +1) * m_segments_per_extent];
+    if(rank_start >= rank_end) return false;
+    // skip the new element, it is not part of the input
+    if(rank_start == m_insert_rank) rank_start++;
+    else if(rank_end -1 == m_insert_rank) rank_end--;
+    if(rank_start >= rank_end) return false;
+
+    auto input_rank = [this](size_t rank){ return rank - (rank > m_insert_rank); };
+    auto input_segment = [this](size_t rank){ return static_cast<size_t>(upper_bound(begin(m_input_start), end(m_input_start) -1, rank) - begin(m_input_start)) -1; };
+    *out_first = input_segment(input_rank(rank_start)) / m_segments_per_extent;
+    *out_last = input_segment(input_rank(rank_end -1)) / m_segments_per_extent;
+    return true;
+}
+
+void ParallelSpread::copy_elements(size_t rank_start, size_t rank_end, size_t& input_segment, int64_t* __restrict keys_to, int64_t* __restrict values_to, int64_t* decoded_keys, size_t& decoded_segment) const {
+    const bool key_only = m_values == nullptr;
+    size_t rank = rank_start;
+    while(rank < rank_end){
+        if(rank == m_insert_rank){ // the new element
+            *(keys_to++) = m_insert_key;
+            if(!key_only) *(values_to++) = m_insert_value;
+            rank++;
+            continue;
+        }
+
+        size_t input_rank = rank - (rank > m_insert_rank);
+        while(m_input_start[input_segment +1] <= input_rank) input_segment++; // skip the segments already consumed
+        size_t segment_sz = m_input_start[input_segment +1] - m_input_start[input_segment];
+        size_t position = input_rank - m_input_start[input_segment];
+        size_t length = min(segment_sz - position, rank_end - rank);
+        if(rank < m_insert_rank && m_insert_rank < rank + length){ length = m_insert_rank - rank; } // stop before the new element
+
+        size_t offset = get_offset(m_window_start + input_segment, segment_sz) + position;
+        if(m_compressed_bytes > 0){
+            if(decoded_segment != input_segment){
+                compressed_segment_load(get_compressed_segment(m_window_start + input_segment), segment_sz, decoded_keys);
+                decoded_segment = input_segment;
+            }
+            memcpy(keys_to, decoded_keys + position, length * sizeof(int64_t));
+        } else {
+            memcpy(keys_to, m_keys + offset, length * sizeof(int64_t));
+        }
+        if(!key_only) memcpy(values_to, m_values + offset, length * sizeof(int64_t));
+        keys_to += length;
+        if(!key_only) values_to += length;
+        rank += length;
+    }
+}
+
+void ParallelSpread::spread_extent(size_t extent_id){
+    int64_t *buffer_keys {nullptr}, *buffer_values {nullptr};
+    { // acquire the buffers in the same direction of the spread, as SpreadWithRewiring
+        scoped_lock<mutex> lock(m_mutex);
+        buffer_keys = (int64_t*) m_memory_keys->acquire_buffer(/* highest first ? */ false);
+        buffer_values = m_values != nullptr ? (int64_t*) m_memory_values->acquire_buffer(/* highest first ? */ false) : nullptr;
+    }
+    m_extents[extent_id] = Extent2Rewire{ buffer_keys, buffer_values };
+
+    const size_t segment_base = extent_id * m_segments_per_extent; // relative to the window
+    size_t rank = m_output_start[segment_base];
+    size_t input_rank = rank - (rank > m_insert_rank);
+    size_t input_segment = upper_bound(begin(m_input_start), end(m_input_start) -1, input_rank) - begin(m_input_start) -1;
+
+    // with compressed keys, the keys of an output segment are gathered in a buffer and then encoded
+    unique_ptr<int64_t[]> output_keys, decoded_keys;
+    size_t decoded_segment = numeric_limits<size_t>::max();
+    if(m_compressed_bytes > 0){
+        output_keys.reset(new int64_t[m_segment_capacity]);
+        decoded_keys.reset(new int64_t[m_segment_capacity]);
+    }
+
+    for(size_t i = 0; i < m_segments_per_extent; i++){
+        size_t segment_id = segment_base + i;
+        size_t segment_sz = m_output_sizes[segment_id];
+        size_t offset = get_offset(m_window_start + segment_id, segment_sz) - (m_window_start + segment_base) * m_segment_capacity; // relative to the extent
+        int64_t* keys_to = m_compressed_bytes > 0 ? output_keys.get() : buffer_keys + offset;
+        copy_elements(m_output_start[segment_id], m_output_start[segment_id +1], input_segment, keys_to, buffer_values != nullptr ? buffer_values + offset : nullptr, decoded_keys.get(), decoded_segment);
+        if(m_compressed_bytes > 0){
+            assert(segment_sz == 0 || compressed_segment_fits(keys_to[0], keys_to[segment_sz -1], segment_sz, m_compressed_bytes));
+            compressed_segment_store(reinterpret_cast<uint8_t*>(buffer_keys) + i * m_compressed_bytes, keys_to, segment_sz);
+        }
+    }
+}
+
+void ParallelSpread::release(size_t extent_id, vector<size_t>& ready){
+    if(m_pending[extent_id].fetch_sub(1, memory_order_acq_rel) == 1){
+        ready.push_back(extent_id);
+    }
+}
+
+void ParallelSpread::rewire(vector<size_t>& extents){
+    if(extents.empty()) return; // nop
+    vector<pair<void*, void*>> keys, values;
+    keys.reserve(extents.size());
+    values.reserve(extents.size());
+    for(size_t extent_id : extents){
+        size_t segment_id = m_window_start + extent_id * m_segments_per_extent;
+        keys.emplace_back(reinterpret_cast<uint8_t*>(m_keys) + segment_id * get_segment_key_bytes(), m_extents[extent_id].m_buffer_keys);
+        if(m_values != nullptr) values.emplace_back(m_values + segment_id * m_segment_capacity, m_extents[extent_id].m_buffer_values);
+    }
+    extents.clear();
+
+    scoped_lock<mutex> lock(m_mutex);
+    m_memory_keys->swap_and_release(keys);
+    if(m_values != nullptr) m_memory_values->swap_and_release(values);
+}
+
+void ParallelSpread::prepare(){
+    if(m_prepared) return;
+
+    // prefix sums of the input and the output segments
+    m_input_start.resize(m_input_length +1);
+    m_input_start[0] = 0;
+    for(size_t i = 0; i < m_input_length; i++){
+        m_input_start[i +1] = m_input_start[i] + m_segment_sizes[m_window_start + i];
+    }
+    m_output_start.resize(m_output_length +1);
+    m_output_start[0] = 0;
+    for(size_t i = 0; i < m_output_length; i++){
+        m_output_start[i +1] = m_output_start[i] + m_output_sizes[i];
+    }
+    if(m_output_start[m_output_length] != m_input_start[m_input_length] + m_insert){
+        throw invalid_argument("[ParallelSpread] The cardinality of the output segments does not match the number of elements in the window");
+    }
+
+    // rank of the element to insert, in the sorted sequence of all elements
+    m_insert_rank = numeric_limits<size_t>::max();
+    if(m_insert){
+        size_t segment_id = m_insert_input_segment;
+        size_t segment_sz = m_segment_sizes[segment_id];
+        size_t position = m_compressed_bytes > 0 ?
+                compressed_segment_upper_bound(get_compressed_segment(segment_id), segment_sz, m_insert_key) :
+                segment_upper_bound(m_keys + get_offset(segment_id, segment_sz), segment_sz, m_insert_key);
+        m_insert_rank = m_input_start[segment_id - m_window_start] + position;
+    }
+
+    m_prepared = true;
+}
+
+bool ParallelSpread::fits(){
+    if(m_compressed_bytes == 0) return true;
+    prepare();
+
+    for(size_t i = 0; i < m_output_length; i++){
+        size_t segment_sz = m_output_sizes[i];
+        if(segment_sz <= 1) continue;
+        int64_t min = get_key_by_rank(m_output_start[i]);
+        int64_t max = get_key_by_rank(m_output_start[i +1] -1);
+        if(!compressed_segment_fits(min, max, segment_sz, m_compressed_bytes)) return false;
+    }
+
+    return true;
+}
+
+void ParallelSpread::execute(size_t num_threads, StaticIndex* index){
+    // 1) ranks of the input and the output segments, and of the element to insert
+    prepare();
+    const size_t num_extents = get_num_output_extents();
+    const size_t num_workers = max<size_t>(1, min(num_threads, num_extents));
+    COUT_DEBUG("window: " << m_window_start << ", input length: " << m_input_length << ", output length: " << m_output_length << ", cardinality: " << m_output_start[m_output_length] << ", workers: " << num_workers);
+
+    // 3) an output extent can be rewired once it has been spread and all the spreads reading its input have been performed
+    m_extents.reset(new Extent2Rewire[num_extents]);
+    m_pending.reset(new atomic<size_t>[num_extents]);
+    for(size_t i = 0; i < num_extents; i++){ m_pending[i] = 1; }
+    for(size_t i = 0; i < num_extents; i++){
+        size_t first, last;
+        if(!get_input_extents(i, &first, &last)) continue;
+        for(size_t j = first; j <= last && j < num_extents; j++){ m_pending[j]++; }
+    }
+
+    // 4) spread the extents. Each worker receives a range of consecutive output extents
+    run_workers(num_workers, [&](size_t worker_id){
+        size_t extent_start = num_extents * worker_id / num_workers;
+        size_t extent_end = num_extents * (worker_id +1) / num_workers;
+        vector<size_t> ready; // extents ready to be rewired
+        for(size_t i = extent_start; i < extent_end; i++){
+            spread_extent(i);
+
+            release(i, ready);
+            size_t first, last;
+            if(get_input_extents(i, &first, &last)){
+                for(size_t j = first; j <= last && j < num_extents; j++){ release(j, ready); }
+            }
+
+            if(ready.size() >= m_rewiring_batch_sz){ rewire(ready); }
+        }
+        rewire(ready);
+    });
+    m_extents.reset();
+    m_pending.reset();
+
+    // 5) update the segment sizes and the separator keys in the index. This is done by a single thread, as the learned
+    // layout of the static index may refit its model while the keys are being updated
+    for(size_t i = 0; i < m_output_length; i++){
+        size_t segment_id = m_window_start + i;
+        m_segment_sizes[segment_id] = m_output_sizes[i];
+        if(index != nullptr && m_output_sizes[i] > 0){ index->set_separator_key(segment_id, get_key(segment_id, m_output_sizes[i], 0)); }
+    }
+
+    // 6) locate the inserted element in the output segments
+    if(m_insert){
+        size_t i = upper_bound(begin(m_output_start), end(m_output_start), m_insert_rank) - begin(m_output_start) -1;
+        assert(i < m_output_length && m_output_start[i] <= m_insert_rank && m_insert_rank < m_output_start[i +1]);
+        size_t position = m_insert_rank - m_output_start[i];
+        m_insert_output_segment = m_window_start + i;
+        m_insert_predecessor = (position > 0) ? get_key(m_insert_output_segment, m_output_sizes[i], position -1) : numeric_limits<int64_t>::min();
+        m_insert_successor = (position +1 < m_output_sizes[i]) ? get_key(m_insert_output_segment, m_output_sizes[i], position +1) : numeric_limits<int64_t>::max();
+        m_insert = false;
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Observers                                                               *
+ *                                                                           *
+ *****************************************************************************/
+int64_t ParallelSpread::get_insert_segment() const noexcept {
+    return m_insert_output_segment;
+}
+
+int64_t ParallelSpread::get_insert_predecessor() const noexcept {
+    return m_insert_predecessor;
+}
+
+int64_t ParallelSpread::get_insert_successor() const noexcept {
+    return m_insert_successor;
+}
+
+} // namespace pma
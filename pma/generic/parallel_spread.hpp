@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERIC_PARALLEL_SPREAD_HPP_
+#define GENERIC_PARALLEL_SPREAD_HPP_
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BufferedRewiredMemory; // forward decl.
+
+namespace pma {
+
+class StaticIndex; // forward decl.
+
+/**
+ * Multi-threaded spread of a large window of a PMA backed by rewired memory, with the segment layout shared by the PMAs
+ * based on a static index: the elements of even segments are stored at the end of the segment, the elements of odd
+ * segments at the start.
+ *
+ * As in the sequential SpreadWithRewiring, each output extent is written into a spare buffer of the rewired memory, which
+ * is then swapped in place of the extent. The workers are assigned ranges of consecutive output extents. A worker fills the
+ * segments of an extent by copying the elements straight from the input segments, and the buffer is swapped in as soon as
+ * no worker still needs to read the input elements of that extent. Thus each element is copied once, and only the extents
+ * whose input is still being read, usually a few extents at the boundaries between the workers, are held in the buffers.
+ *
+ * The input and the output window start at the same segment, aligned to an extent, but they can have a different length,
+ * to spread the elements while resizing the PMA. The output window must be a multiple of the extent. The caller is in
+ * charge of allocating the storage for the output window beforehand and of updating the total cardinality of the PMA
+ * afterwards.
+ *
+ * The keys can also be stored compressed, each segment in a fixed amount of space with the layout of compressed_segment.hpp,
+ * while the values keep the clustered layout. In this case the keys of each output segment are decoded from the input
+ * segments and encoded straight into the buffer of its extent. The caller should check with #fits that the compressed keys
+ * of the output segments fit their space, before executing the spread.
+ */
+class ParallelSpread {
+    int64_t* const m_keys; // the keys of the PMA, from the segment 0
+    int64_t* const m_values; // the values of the PMA, from the segment 0, or nullptr if the PMA only stores the keys
+    uint16_t* const m_segment_sizes; // the cardinality of each segment of the PMA, from the segment 0
+    const size_t m_segment_capacity; // the max number of elements in a segment
+    const size_t m_compressed_bytes; // the space of the compressed keys of a segment, in bytes, or 0 if the keys are not compressed
+    BufferedRewiredMemory* const m_memory_keys; // the rewired memory of the keys
+    BufferedRewiredMemory* const m_memory_values; // the rewired memory of the values, or nullptr if the PMA only stores the keys
+    const size_t m_segments_per_extent; // the number of segments in an extent
+    const size_t m_window_start; // the first segment of the window
+    const size_t m_input_length; // the number of segments in the window, before the spread
+    const size_t m_output_length; // the number of segments in the window, after the spread
+    std::vector<uint16_t> m_output_sizes; // the cardinality of each output segment
+
+    // whether to insert a new element during the spread
+    bool m_insert = false;
+    int64_t m_insert_key = 0;
+    int64_t m_insert_value = 0;
+    size_t m_insert_input_segment = 0; // the segment (absolute) where the element would have been inserted
+    int64_t m_insert_output_segment = -1; // the output segment (absolute) where the element has been placed
+    int64_t m_insert_predecessor = 0; // the element preceding the new element in its output segment, or int64_t::min
+    int64_t m_insert_successor = 0; // the element following the new element in its output segment, or int64_t::max
+
+    // state of the execution
+    bool m_prepared = false; // whether the ranks of the input and the output segments have been computed
+    std::vector<size_t> m_input_start; // the rank of the first element of each input segment, plus the total cardinality
+    std::vector<size_t> m_output_start; // the rank of the first element of each output segment, plus the total cardinality
+    size_t m_insert_rank = 0; // the rank of the new element in the output, or size_t::max if there is no element to insert
+    struct Extent2Rewire { int64_t* m_buffer_keys; int64_t* m_buffer_values; };
+    std::unique_ptr<Extent2Rewire[]> m_extents; // the buffers where each output extent has been written
+    std::unique_ptr<std::atomic<size_t>[]> m_pending; // for each output extent, the spreads still to perform before it can be rewired
+    std::mutex m_mutex; // to acquire & swap the buffers of the rewired memory
+    constexpr static size_t m_rewiring_batch_sz = 16; // the number of ready extents a worker accumulates before rewiring them
+
+    /**
+     * Retrieve the address of the first element in the given (absolute) segment
+     */
+    size_t get_offset(size_t segment_id, size_t cardinality) const;
+
+    /**
+     * Retrieve the space taken by the keys of a segment, in bytes
+     */
+    size_t get_segment_key_bytes() const;
+
+    /**
+     * Retrieve the compressed keys of the given (absolute) segment
+     */
+    const uint8_t* get_compressed_segment(size_t segment_id) const;
+
+    /**
+     * Retrieve the key at the given position of the (absolute) segment, with `cardinality' elements
+     */
+    int64_t get_key(size_t segment_id, size_t cardinality, size_t position) const;
+
+    /**
+     * Retrieve the key with the given rank in the output, including the new element
+     */
+    int64_t get_key_by_rank(size_t rank) const;
+
+    /**
+     * Compute the rank of the first element of each input and output segment, and the rank of the new element
+     */
+    void prepare();
+
+    /**
+     * Retrieve the number of output extents
+     */
+    size_t get_num_output_extents() const;
+
+    /**
+     * Retrieve the range [first, last] of the input extents, relative to the window, holding the elements of the given
+     * output extent. Return false if the output extent is empty.
+     */
+    bool get_input_extents(size_t extent_id, size_t* out_first, size_t* out_last) const;
+
+    /**
+     * Copy the elements with rank in [rank_start, rank_end) into the given destination, including the new element
+     * @param input_segment the input segment, relative to the window, holding the element of rank `rank_start', updated
+     *        to the segment holding the last element copied
+     * @param decoded_keys with compressed keys, a buffer with the decoded keys of the input segment `decoded_segment', updated
+     *        with the keys of the segments read
+     */
+    void copy_elements(size_t rank_start, size_t rank_end, size_t& input_segment, int64_t* keys_to, int64_t* values_to, int64_t* decoded_keys, size_t& decoded_segment) const;
+
+    /**
+     * Write the segments of the given output extent, relative to the window, into a buffer of the rewired memory
+     */
+    void spread_extent(size_t extent_id);
+
+    /**
+     * Record that one of the spreads the given output extent depends on has been performed. If it was the last one,
+     * the extent is appended to `ready'
+     */
+    void release(size_t extent_id, std::vector<size_t>& ready);
+
+    /**
+     * Swap the buffers of the given output extents in place of the extents, and release the buffers
+     */
+    void rewire(std::vector<size_t>& extents);
+
+public:
+    /**
+     * Init the spread
+     * @param keys the keys of the PMA, starting from the segment 0
+     * @param values the values of the PMA, starting from the segment 0, or nullptr to move only the keys
+     * @param segment_sizes the cardinality of each segment in the PMA, starting from the segment 0
+     * @param segment_capacity the max number of elements in each segment
+     * @param memory_keys the rewired memory backing the keys
+     * @param memory_values the rewired memory backing the values, or nullptr to move only the keys
+     * @param window_start the first segment of the window to spread
+     * @param input_length the number of segments in the window before the spread
+     * @param output_length the number of segments in the window after the spread
+     * @param compressed_bytes the space of the compressed keys of a segment, in bytes, or 0 if the keys are not compressed
+     */
+    ParallelSpread(int64_t* keys, int64_t* values, uint16_t* segment_sizes, size_t segment_capacity, BufferedRewiredMemory* memory_keys, BufferedRewiredMemory* memory_values,
+            size_t window_start, size_t input_length, size_t output_length, size_t compressed_bytes = 0);
+
+    /**
+     * Set the cardinality of the given output segment, relative to the start of the window
+     */
+    void set_output_size(size_t segment_id, size_t cardinality);
+
+    /**
+     * Spread `cardinality' elements evenly among the output segments
+     */
+    void set_output_size_uniform(size_t cardinality);
+
+    /**
+     * Insert a new element during the spread
+     * @param segment_id the (absolute) segment where the element would have been inserted, before the spread
+     */
+    void set_element_to_insert(int64_t key, int64_t value, size_t segment_id);
+
+    /**
+     * Check whether the compressed keys of each output segment fit its space. It is always true if the keys are not compressed.
+     */
+    bool fits();
+
+    /**
+     * Perform the spread, with up to `num_threads' workers, including the caller
+     * @param index if not null, the index where to update the separator keys of the output segments
+     */
+    void execute(size_t num_threads, StaticIndex* index);
+
+    /**
+     * Retrieve the segment where the new element has been inserted, or -1 if no element has been inserted
+     */
+    int64_t get_insert_segment() const noexcept;
+
+    /**
+     * Retrieve the element preceding the new element in its segment, or int64_t::min if it is the first element
+     */
+    int64_t get_insert_predecessor() const noexcept;
+
+    /**
+     * Retrieve the element following the new element in its segment, or int64_t::max if it is the last element
+     */
+    int64_t get_insert_successor() const noexcept;
+
+    /**
+     * Check whether a window can be spread in parallel: it must be aligned to the extents of the rewired memory
+     */
+    static bool is_aligned(BufferedRewiredMemory* memory_keys, size_t segment_capacity, size_t window_start, size_t output_length, size_t compressed_bytes = 0) noexcept;
+
+    /**
+     * Retrieve the number of workers that are worth employing to spread `cardinality' elements, up to `num_threads'.
+     * If it returns 1, the caller should rather use its sequential spread.
+     */
+    static size_t get_num_workers(size_t cardinality, size_t num_threads) noexcept;
+};
+
+} // namespace pma
+
+#endif /* GENERIC_PARALLEL_SPREAD_HPP_ */
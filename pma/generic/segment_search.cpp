@@ -0,0 +1,314 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "segment_search.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace pma {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Kernels                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+
+using search_fn_t = size_t (*)(const int64_t*, size_t, int64_t) noexcept;
+using sum_fn_t = void (*)(const int64_t*, const int64_t*, size_t, int64_t*, int64_t*) noexcept;
+
+// Once the binary search narrowed the run to this number of keys, switch to a linear (vectorised) count
+constexpr size_t LINEAR_THRESHOLD_SCALAR = 8;
+constexpr size_t LINEAR_THRESHOLD_SIMD = 32;
+
+// Scalar kernels for the linear part of the search
+size_t count_less_scalar(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    size_t count = 0;
+    for(size_t i = 0; i < num_keys; i++){ count += (keys[i] < key); }
+    return count;
+}
+
+size_t count_less_equal_scalar(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    size_t count = 0;
+    for(size_t i = 0; i < num_keys; i++){ count += (keys[i] <= key); }
+    return count;
+}
+
+void sum_scalar(const int64_t* __restrict keys, const int64_t* __restrict values, size_t num_elements, int64_t* sum_keys, int64_t* sum_values) noexcept {
+    int64_t k0 = 0, k1 = 0, v0 = 0, v1 = 0;
+    size_t i = 0;
+    for( ; i + 2 <= num_elements; i += 2){
+        k0 += keys[i]; k1 += keys[i +1];
+        v0 += values[i]; v1 += values[i +1];
+    }
+    if(i < num_elements){ k0 += keys[i]; v0 += values[i]; }
+    *sum_keys += k0 + k1;
+    *sum_values += v0 + v1;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+size_t count_less_avx2(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m256i vkey = _mm256_set1_epi64x(key);
+    size_t count = 0;
+    size_t i = 0;
+    for( ; i + 4 <= num_keys; i += 4){
+        __m256i vkeys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i cmp = _mm256_cmpgt_epi64(vkey, vkeys); // key > keys[i]
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(cmp)));
+    }
+    for( ; i < num_keys; i++){ count += (keys[i] < key); }
+    return count;
+}
+
+__attribute__((target("avx2")))
+size_t count_less_equal_avx2(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m256i vkey = _mm256_set1_epi64x(key);
+    size_t count = 0;
+    size_t i = 0;
+    for( ; i + 4 <= num_keys; i += 4){
+        __m256i vkeys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i cmp = _mm256_cmpgt_epi64(vkeys, vkey); // keys[i] > key
+        count += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(cmp)));
+    }
+    for( ; i < num_keys; i++){ count += (keys[i] <= key); }
+    return count;
+}
+
+__attribute__((target("avx512f")))
+size_t count_less_avx512(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m512i vkey = _mm512_set1_epi64(key);
+    size_t count = 0;
+    size_t i = 0;
+    for( ; i + 8 <= num_keys; i += 8){
+        __m512i vkeys = _mm512_loadu_si512(keys + i);
+        count += __builtin_popcount(_mm512_cmplt_epi64_mask(vkeys, vkey));
+    }
+    if(i < num_keys){ // remainder, masked load
+        __mmask8 mask = (1u << (num_keys - i)) -1;
+        __m512i vkeys = _mm512_maskz_loadu_epi64(mask, keys + i);
+        count += __builtin_popcount(_mm512_mask_cmplt_epi64_mask(mask, vkeys, vkey));
+    }
+    return count;
+}
+
+__attribute__((target("avx512f")))
+size_t count_less_equal_avx512(const int64_t* __restrict keys, size_t num_keys, int64_t key) noexcept {
+    const __m512i vkey = _mm512_set1_epi64(key);
+    size_t count = 0;
+    size_t i = 0;
+    for( ; i + 8 <= num_keys; i += 8){
+        __m512i vkeys = _mm512_loadu_si512(keys + i);
+        count += __builtin_popcount(_mm512_cmple_epi64_mask(vkeys, vkey));
+    }
+    if(i < num_keys){ // remainder, masked load
+        __mmask8 mask = (1u << (num_keys - i)) -1;
+        __m512i vkeys = _mm512_maskz_loadu_epi64(mask, keys + i);
+        count += __builtin_popcount(_mm512_mask_cmple_epi64_mask(mask, vkeys, vkey));
+    }
+    return count;
+}
+
+__attribute__((target("avx2")))
+int64_t horizontal_sum_avx2(__m256i v) noexcept {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+}
+
+__attribute__((target("avx2")))
+void sum_avx2(const int64_t* __restrict keys, const int64_t* __restrict values, size_t num_elements, int64_t* sum_keys, int64_t* sum_values) noexcept {
+    __m256i k0 = _mm256_setzero_si256(), k1 = _mm256_setzero_si256();
+    __m256i v0 = _mm256_setzero_si256(), v1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for( ; i + 8 <= num_elements; i += 8){ // two vectors per iteration, to hide the latency of the adds
+        k0 = _mm256_add_epi64(k0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+        k1 = _mm256_add_epi64(k1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i + 4)));
+        v0 = _mm256_add_epi64(v0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+        v1 = _mm256_add_epi64(v1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 4)));
+    }
+    if(i + 4 <= num_elements){
+        k0 = _mm256_add_epi64(k0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+        v0 = _mm256_add_epi64(v0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+        i += 4;
+    }
+    int64_t sk = horizontal_sum_avx2(_mm256_add_epi64(k0, k1));
+    int64_t sv = horizontal_sum_avx2(_mm256_add_epi64(v0, v1));
+    for( ; i < num_elements; i++){ sk += keys[i]; sv += values[i]; }
+    *sum_keys += sk;
+    *sum_values += sv;
+}
+
+__attribute__((target("avx512f")))
+void sum_avx512(const int64_t* __restrict keys, const int64_t* __restrict values, size_t num_elements, int64_t* sum_keys, int64_t* sum_values) noexcept {
+    __m512i k0 = _mm512_setzero_si512(), k1 = _mm512_setzero_si512();
+    __m512i v0 = _mm512_setzero_si512(), v1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for( ; i + 16 <= num_elements; i += 16){ // two vectors per iteration, to hide the latency of the adds
+        k0 = _mm512_add_epi64(k0, _mm512_loadu_si512(keys + i));
+        k1 = _mm512_add_epi64(k1, _mm512_loadu_si512(keys + i + 8));
+        v0 = _mm512_add_epi64(v0, _mm512_loadu_si512(values + i));
+        v1 = _mm512_add_epi64(v1, _mm512_loadu_si512(values + i + 8));
+    }
+    while(i < num_elements){ // remainder, masked loads
+        size_t n = std::min<size_t>(8, num_elements - i);
+        __mmask8 mask = (n == 8) ? 0xFF : (1u << n) -1;
+        k0 = _mm512_add_epi64(k0, _mm512_maskz_loadu_epi64(mask, keys + i));
+        v0 = _mm512_add_epi64(v0, _mm512_maskz_loadu_epi64(mask, values + i));
+        i += n;
+    }
+    *sum_keys += _mm512_reduce_add_epi64(_mm512_add_epi64(k0, k1));
+    *sum_values += _mm512_reduce_add_epi64(_mm512_add_epi64(v0, v1));
+}
+#endif
+
+/**
+ * Branchless binary search until the candidate run is not longer than `threshold', then
+ * count the qualifying keys in the remaining run with the given linear kernel.
+ * Invariant: all keys before `base' qualify, all keys after base + num_keys do not.
+ */
+template<bool upper_bound, size_t (*count_fn)(const int64_t* __restrict, size_t, int64_t) noexcept, size_t threshold>
+size_t bound(const int64_t* keys, size_t num_keys, int64_t key) noexcept {
+    const int64_t* base = keys;
+    while(num_keys > threshold){
+        size_t half = num_keys / 2;
+        bool qualifies = upper_bound ? (base[half] <= key) : (base[half] < key);
+        base = qualifies ? base + half : base; // cmov
+        num_keys -= half;
+    }
+    return (base - keys) + count_fn(base, num_keys, key);
+}
+
+// The kernel in use. Constant-initialised to the scalar kernel, then resolved once according to the features of the CPU
+// during the static initialisation, before any search can run concurrently
+search_fn_t g_lower_bound = bound</* upper bound ? */ false, count_less_scalar, LINEAR_THRESHOLD_SCALAR>;
+search_fn_t g_upper_bound = bound</* upper bound ? */ true, count_less_equal_scalar, LINEAR_THRESHOLD_SCALAR>;
+sum_fn_t g_sum = sum_scalar;
+SegmentSearchKernel g_kernel = SegmentSearchKernel::SCALAR;
+
+void set_kernel(SegmentSearchKernel kernel) noexcept {
+    switch(kernel){
+#if defined(__x86_64__)
+    case SegmentSearchKernel::AVX512:
+        g_lower_bound = bound</* upper bound ? */ false, count_less_avx512, LINEAR_THRESHOLD_SIMD>;
+        g_upper_bound = bound</* upper bound ? */ true, count_less_equal_avx512, LINEAR_THRESHOLD_SIMD>;
+        g_sum = sum_avx512;
+        break;
+    case SegmentSearchKernel::AVX2:
+        g_lower_bound = bound</* upper bound ? */ false, count_less_avx2, LINEAR_THRESHOLD_SIMD>;
+        g_upper_bound = bound</* upper bound ? */ true, count_less_equal_avx2, LINEAR_THRESHOLD_SIMD>;
+        g_sum = sum_avx2;
+        break;
+#endif
+    default:
+        kernel = SegmentSearchKernel::SCALAR;
+        g_lower_bound = bound</* upper bound ? */ false, count_less_scalar, LINEAR_THRESHOLD_SCALAR>;
+        g_upper_bound = bound</* upper bound ? */ true, count_less_equal_scalar, LINEAR_THRESHOLD_SCALAR>;
+        g_sum = sum_scalar;
+    }
+    g_kernel = kernel;
+}
+
+SegmentSearchKernel detect_kernel() noexcept {
+    if(segment_search_is_supported(SegmentSearchKernel::AVX512)){
+        return SegmentSearchKernel::AVX512;
+    } else if(segment_search_is_supported(SegmentSearchKernel::AVX2)){
+        return SegmentSearchKernel::AVX2;
+    } else {
+        return SegmentSearchKernel::SCALAR;
+    }
+}
+
+[[maybe_unused]] const bool g_kernel_resolved = (set_kernel(detect_kernel()), true);
+
+} // anonymous namespace
+
+/*****************************************************************************
+ *                                                                           *
+ *   Search                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+size_t segment_lower_bound(const int64_t* keys, size_t num_keys, int64_t key) noexcept {
+    return g_lower_bound(keys, num_keys, key);
+}
+
+size_t segment_upper_bound(const int64_t* keys, size_t num_keys, int64_t key) noexcept {
+    return g_upper_bound(keys, num_keys, key);
+}
+
+int64_t segment_find(const int64_t* keys, size_t num_keys, int64_t key) noexcept {
+    size_t position = g_lower_bound(keys, num_keys, key);
+    return (position < num_keys && keys[position] == key) ? static_cast<int64_t>(position) : -1;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Sum                                                                     *
+ *                                                                           *
+ *****************************************************************************/
+void segment_sum(const int64_t* keys, const int64_t* values, size_t num_elements, int64_t* sum_keys, int64_t* sum_values) noexcept {
+    g_sum(keys, values, num_elements, sum_keys, sum_values);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Kernel selection                                                        *
+ *                                                                           *
+ *****************************************************************************/
+bool segment_search_is_supported(SegmentSearchKernel kernel) noexcept {
+    switch(kernel){
+    case SegmentSearchKernel::SCALAR:
+        return true;
+#if defined(__x86_64__)
+    case SegmentSearchKernel::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case SegmentSearchKernel::AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+SegmentSearchKernel segment_search_kernel() noexcept {
+    return g_kernel;
+}
+
+void segment_search_kernel(SegmentSearchKernel kernel) {
+    if(!segment_search_is_supported(kernel)){ throw std::invalid_argument("Segment search kernel not supported by the current CPU"); }
+    set_kernel(kernel);
+}
+
+std::ostream& operator<<(std::ostream& out, SegmentSearchKernel kernel){
+    switch(kernel){
+    case SegmentSearchKernel::SCALAR: out << "scalar"; break;
+    case SegmentSearchKernel::AVX2: out << "avx2"; break;
+    case SegmentSearchKernel::AVX512: out << "avx512"; break;
+    default: out << "unknown";
+    }
+    return out;
+}
+
+} // namespace pma
@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERIC_SEGMENT_SEARCH_HPP_
+#define GENERIC_SEGMENT_SEARCH_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <ostream>
+
+namespace pma {
+
+/**
+ * Search & aggregation kernels for the sorted run of keys stored inside a PMA segment. The lookup first
+ * narrows the run with a branchless binary search, then it counts the qualifying keys in the remaining
+ * block with a vectorised comparison. The aggregation sums a run of keys and values with unrolled
+ * vector accumulators.
+ *
+ * The instruction set is selected at runtime, on the first invocation, according to the features
+ * of the current CPU: AVX-512 if available, otherwise AVX2, otherwise a scalar fallback.
+ */
+enum class SegmentSearchKernel {
+    SCALAR, AVX2, AVX512
+};
+
+/**
+ * Retrieve the number of keys in the sorted array keys[0, num_keys) strictly less than `key'.
+ */
+size_t segment_lower_bound(const int64_t* keys, size_t num_keys, int64_t key) noexcept;
+
+/**
+ * Retrieve the number of keys in the sorted array keys[0, num_keys) less or equal than `key'.
+ */
+size_t segment_upper_bound(const int64_t* keys, size_t num_keys, int64_t key) noexcept;
+
+/**
+ * Retrieve the position of the first occurrence of `key' in the sorted array keys[0, num_keys), or -1 if not present.
+ */
+int64_t segment_find(const int64_t* keys, size_t num_keys, int64_t key) noexcept;
+
+/**
+ * Add the sum of keys[0, num_elements) to `sum_keys' and the sum of values[0, num_elements) to `sum_values'
+ */
+void segment_sum(const int64_t* keys, const int64_t* values, size_t num_elements, int64_t* sum_keys, int64_t* sum_values) noexcept;
+
+/**
+ * Retrieve the kernel currently in use
+ */
+SegmentSearchKernel segment_search_kernel() noexcept;
+
+/**
+ * Force the kernel to use. It raises an std::invalid_argument if the current CPU does not support it.
+ * Only meant for testing & benchmarking purposes, it must not be invoked while other threads are searching.
+ */
+void segment_search_kernel(SegmentSearchKernel kernel);
+
+/**
+ * Check whether the current CPU supports the given kernel
+ */
+bool segment_search_is_supported(SegmentSearchKernel kernel) noexcept;
+
+std::ostream& operator<<(std::ostream& out, SegmentSearchKernel kernel);
+
+} // namespace pma
+
+#endif /* GENERIC_SEGMENT_SEARCH_HPP_ */
@@ -0,0 +1,239 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio> // rename
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "static_index.hpp"
+
+using namespace std;
+
+namespace pma {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Debug                                                                   *
+ *                                                                           *
+ *****************************************************************************/
+//#define DEBUG
+#define COUT_DEBUG_FORCE(msg) std::cout << "[Snapshot::" << __FUNCTION__ << "] " << msg << std::endl
+#if defined(DEBUG)
+    #define COUT_DEBUG(msg) COUT_DEBUG_FORCE(msg)
+#else
+    #define COUT_DEBUG(msg)
+#endif
+
+#define RAISE(msg) RAISE_EXCEPTION(SnapshotError, msg)
+
+/*****************************************************************************
+ *                                                                           *
+ *   On-disk format                                                          *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'P', 'M', 'A', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint64_t SNAPSHOT_BYTE_ORDER = 0x0102030405060708ull; // to detect snapshots saved on a machine with a different endianness
+constexpr uint64_t SNAPSHOT_ALIGNMENT = 4096; // alignment of the sections, in bytes
+constexpr uint64_t SNAPSHOT_CHUNK_SIZE = 1ull << 30; // max amount of bytes transferred by a single read/write
+
+struct Header {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_algorithm;
+    uint64_t m_byte_order;
+    uint64_t m_segment_capacity;
+    uint64_t m_number_segments;
+    uint64_t m_cardinality;
+    uint64_t m_offset_keys;
+    uint64_t m_offset_values;
+    uint64_t m_offset_sizes;
+    uint64_t m_offset_separators;
+    uint64_t m_file_size;
+};
+
+uint64_t align(uint64_t offset){
+    return (offset + SNAPSHOT_ALIGNMENT -1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+void write_fully(int fd, const string& path, const void* buffer, uint64_t length, uint64_t offset){
+    const char* ptr = reinterpret_cast<const char*>(buffer);
+    while(length > 0){
+        ssize_t rc = pwrite(fd, ptr, min(length, SNAPSHOT_CHUNK_SIZE), offset);
+        if(rc < 0){
+            if(errno == EINTR) continue;
+            RAISE("Cannot write the snapshot `" << path << "', pwrite error: " << strerror(errno) << " (" << errno << ")");
+        }
+        ptr += rc; offset += rc; length -= rc;
+    }
+}
+
+} // anonymous namespace
+
+/*****************************************************************************
+ *                                                                           *
+ *   Save                                                                    *
+ *                                                                           *
+ *****************************************************************************/
+void Snapshot::save(const string& path, Algorithm algorithm, uint64_t segment_capacity, uint64_t num_segments, uint64_t cardinality,
+        const int64_t* keys, const int64_t* values, const uint16_t* segment_sizes, const StaticIndex& index) {
+    COUT_DEBUG("path: " << path << ", segments: " << num_segments << ", cardinality: " << cardinality);
+    if(num_segments == 0) RAISE("The number of segments is zero");
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, SNAPSHOT_MAGIC, sizeof(header.m_magic));
+    header.m_version = SNAPSHOT_VERSION;
+    header.m_algorithm = static_cast<uint32_t>(algorithm);
+    header.m_byte_order = SNAPSHOT_BYTE_ORDER;
+    header.m_segment_capacity = segment_capacity;
+    header.m_number_segments = num_segments;
+    header.m_cardinality = cardinality;
+    const uint64_t elts_bytes = num_segments * segment_capacity * sizeof(int64_t);
+    header.m_offset_keys = align(sizeof(Header));
+    header.m_offset_values = align(header.m_offset_keys + elts_bytes);
+    header.m_offset_sizes = align(header.m_offset_values + elts_bytes);
+    header.m_offset_separators = align(header.m_offset_sizes + num_segments * sizeof(uint16_t));
+    header.m_file_size = header.m_offset_separators + num_segments * sizeof(int64_t);
+
+    // the separator keys, one for each segment
+    unique_ptr<int64_t[]> separators { new int64_t[num_segments] };
+    for(uint64_t i = 0; i < num_segments; i++){ separators[i] = index.get_separator_key(i); }
+
+    // write the snapshot in a temporary file first
+    string path_tmp = path + ".tmp";
+    int fd = ::open(path_tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){ RAISE("Cannot create the file `" << path_tmp << "', open error: " << strerror(errno) << " (" << errno << ")"); }
+    auto fn_close = [&](int*){ if(fd >= 0){ close(fd); unlink(path_tmp.c_str()); } };
+    unique_ptr<int, decltype(fn_close)> protect_from_errors { &fd, fn_close };
+
+    write_fully(fd, path_tmp, keys, elts_bytes, header.m_offset_keys);
+    write_fully(fd, path_tmp, values, elts_bytes, header.m_offset_values);
+    write_fully(fd, path_tmp, segment_sizes, num_segments * sizeof(uint16_t), header.m_offset_sizes);
+    write_fully(fd, path_tmp, separators.get(), num_segments * sizeof(int64_t), header.m_offset_separators);
+    write_fully(fd, path_tmp, &header, sizeof(header), 0); // the header is the last bit to be written
+
+    if(fsync(fd) != 0){ RAISE("Cannot write the snapshot `" << path_tmp << "', fsync error: " << strerror(errno) << " (" << errno << ")"); }
+    if(close(fd) != 0){ fd = -1; unlink(path_tmp.c_str()); RAISE("Cannot write the snapshot `" << path_tmp << "', close error: " << strerror(errno) << " (" << errno << ")"); }
+    fd = -1;
+    if(rename(path_tmp.c_str(), path.c_str()) != 0){
+        unlink(path_tmp.c_str());
+        RAISE("Cannot rename the snapshot `" << path_tmp << "' into `" << path << "', rename error: " << strerror(errno) << " (" << errno << ")");
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Restore                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+Snapshot::Snapshot(const string& path, Algorithm algorithm) : m_path(path), m_handle(-1) {
+    m_handle = ::open(path.c_str(), O_RDONLY);
+    if(m_handle < 0){ RAISE("Cannot open the snapshot `" << path << "', open error: " << strerror(errno) << " (" << errno << ")"); }
+    auto fn_close = [this](Snapshot*){ close(m_handle); m_handle = -1; };
+    unique_ptr<Snapshot, decltype(fn_close)> protect_from_errors { this, fn_close };
+
+    // validate the header
+    struct stat file_stats;
+    if(fstat(m_handle, &file_stats) != 0){ RAISE("Cannot open the snapshot `" << path << "', fstat error: " << strerror(errno) << " (" << errno << ")"); }
+    if(static_cast<uint64_t>(file_stats.st_size) < sizeof(Header)){ RAISE("The file `" << path << "' is not a snapshot: too small"); }
+    Header header;
+    read(&header, sizeof(header), 0);
+    if(memcmp(header.m_magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0){ RAISE("The file `" << path << "' is not a snapshot: invalid magic string"); }
+    if(header.m_version != SNAPSHOT_VERSION){ RAISE("Snapshot `" << path << "', format version not supported: " << header.m_version << ", expected: " << SNAPSHOT_VERSION); }
+    if(header.m_byte_order != SNAPSHOT_BYTE_ORDER){ RAISE("Snapshot `" << path << "', saved by a machine with a different byte order"); }
+    if(header.m_algorithm != static_cast<uint32_t>(algorithm)){ RAISE("Snapshot `" << path << "', saved by a different data structure, id: " << header.m_algorithm << ", expected: " << static_cast<uint32_t>(algorithm)); }
+    if(header.m_file_size != static_cast<uint64_t>(file_stats.st_size)){ RAISE("Snapshot `" << path << "', truncated file, size: " << file_stats.st_size << " bytes, expected: " << header.m_file_size << " bytes"); }
+    if(header.m_number_segments == 0 || header.m_cardinality > header.m_number_segments * header.m_segment_capacity){ RAISE("Snapshot `" << path << "', corrupted header"); }
+
+    m_segment_capacity = header.m_segment_capacity;
+    m_number_segments = header.m_number_segments;
+    m_cardinality = header.m_cardinality;
+    m_offset_keys = header.m_offset_keys;
+    m_offset_values = header.m_offset_values;
+    m_offset_sizes = header.m_offset_sizes;
+    m_offset_separators = header.m_offset_separators;
+
+    protect_from_errors.release();
+}
+
+Snapshot::~Snapshot(){
+    if(m_handle >= 0){
+        int rc = close(m_handle);
+        if(rc != 0){ cerr << "[Snapshot::dtor] Cannot close the snapshot `" << m_path << "': " << strerror(errno) << " (" << errno << ")" << endl; }
+        m_handle = -1;
+    }
+}
+
+void Snapshot::read(void* buffer, uint64_t length, uint64_t offset) const {
+    char* ptr = reinterpret_cast<char*>(buffer);
+    while(length > 0){
+        ssize_t rc = pread(m_handle, ptr, min(length, SNAPSHOT_CHUNK_SIZE), offset);
+        if(rc < 0){
+            if(errno == EINTR) continue;
+            RAISE("Cannot read the snapshot `" << m_path << "', pread error: " << strerror(errno) << " (" << errno << ")");
+        } else if (rc == 0){
+            RAISE("Cannot read the snapshot `" << m_path << "', unexpected end of file");
+        }
+        ptr += rc; offset += rc; length -= rc;
+    }
+}
+
+void Snapshot::load(int64_t* keys, int64_t* values, uint16_t* segment_sizes) const {
+    COUT_DEBUG("path: " << m_path << ", segments: " << m_number_segments << ", cardinality: " << m_cardinality);
+    const uint64_t elts_bytes = m_number_segments * m_segment_capacity * sizeof(int64_t);
+    read(keys, elts_bytes, m_offset_keys);
+    if(values != nullptr) read(values, elts_bytes, m_offset_values);
+    read(segment_sizes, m_number_segments * sizeof(uint16_t), m_offset_sizes);
+}
+
+void Snapshot::load(StaticIndex& index) const {
+    // read the separators before altering the index
+    unique_ptr<int64_t[]> separators { new int64_t[m_number_segments] };
+    read(separators.get(), m_number_segments * sizeof(int64_t), m_offset_separators);
+    index.rebuild(m_number_segments);
+    for(uint64_t i = 0; i < m_number_segments; i++){ index.set_separator_key(i, separators[i]); }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Observers                                                               *
+ *                                                                           *
+ *****************************************************************************/
+uint64_t Snapshot::get_segment_capacity() const noexcept {
+    return m_segment_capacity;
+}
+
+uint64_t Snapshot::get_number_segments() const noexcept {
+    return m_number_segments;
+}
+
+uint64_t Snapshot::get_cardinality() const noexcept {
+    return m_cardinality;
+}
+
+} // namespace pma
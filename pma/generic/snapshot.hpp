@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERIC_SNAPSHOT_HPP_
+#define GENERIC_SNAPSHOT_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+
+#include "errorhandling.hpp"
+
+namespace pma {
+
+class StaticIndex; // forward decl.
+
+DEFINE_EXCEPTION(SnapshotError);
+
+/**
+ * Persist the content of a PMA based on a static index into a file, and restore it afterwards without
+ * reinserting the elements.
+ *
+ * On-disk format (version 1), in the native byte order of the machine:
+ * - a header, with the magic string, the format version, the data structure that saved the snapshot,
+ *   the segment capacity, the number of segments, the cardinality and the offsets of the sections;
+ * - the sections of the keys, the values, the cardinalities of the segments and the separator keys of the
+ *   static index, one for each segment. Each section is aligned to 4 KB.
+ *
+ * The keys and the values are written in the logical order of the segments, as seen through the virtual
+ * addresses of the rewired memory. Therefore the translation maps are not stored: a restored PMA starts
+ * with the identity mapping between its virtual and physical extents.
+ */
+class Snapshot {
+public:
+    /**
+     * The data structures that can save a snapshot. A snapshot can only be restored by the same data structure.
+     */
+    enum class Algorithm : uint32_t {
+        APMA_INT3 = 1,
+        BTREE_PMACC7 = 2,
+    };
+
+private:
+    const std::string m_path; // the file of the snapshot
+    int m_handle; // file descriptor
+    uint64_t m_segment_capacity; // the max number of elements in a segment
+    uint64_t m_number_segments; // the number of segments
+    uint64_t m_cardinality; // the number of elements
+    uint64_t m_offset_keys; // offset of the section with the keys, in bytes
+    uint64_t m_offset_values; // offset of the section with the values, in bytes
+    uint64_t m_offset_sizes; // offset of the section with the segment cardinalities, in bytes
+    uint64_t m_offset_separators; // offset of the section with the separator keys, in bytes
+
+    // Read `length' bytes from the given offset of the file
+    void read(void* buffer, uint64_t length, uint64_t offset) const;
+
+public:
+    /**
+     * Open the given snapshot for reading. It raises a SnapshotError if the file is not a valid snapshot or
+     * if it was not saved by the expected data structure.
+     */
+    Snapshot(const std::string& path, Algorithm algorithm);
+
+    /**
+     * Close the snapshot
+     */
+    ~Snapshot();
+
+    /**
+     * Save the content of a PMA into the given file, replacing the file if it already exists. The snapshot is
+     * first written into a temporary file, and then renamed into `path', so that a crash never leaves a
+     * partial snapshot behind.
+     */
+    static void save(const std::string& path, Algorithm algorithm, uint64_t segment_capacity, uint64_t num_segments, uint64_t cardinality,
+            const int64_t* keys, const int64_t* values, const uint16_t* segment_sizes, const StaticIndex& index);
+
+    /**
+     * Retrieve the max number of elements in a segment
+     */
+    uint64_t get_segment_capacity() const noexcept;
+
+    /**
+     * Retrieve the number of segments
+     */
+    uint64_t get_number_segments() const noexcept;
+
+    /**
+     * Retrieve the number of elements stored
+     */
+    uint64_t get_cardinality() const noexcept;
+
+    /**
+     * Load the keys, the values and the cardinalities of the segments. The arrays must have room for #get_number_segments() segments.
+     * The values can be a nullptr, for the PMAs storing only the keys, to skip their section.
+     */
+    void load(int64_t* keys, int64_t* values, uint16_t* segment_sizes) const;
+
+    /**
+     * Rebuild the given index for #get_number_segments() segments and load its separator keys
+     */
+    void load(StaticIndex& index) const;
+};
+
+} // namespace pma
+
+#endif /* GENERIC_SNAPSHOT_HPP_ */
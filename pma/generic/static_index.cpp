@@ -16,6 +16,7 @@
  */
 
 #include "static_index.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
@@ -23,6 +24,10 @@
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+
+#include "miscellaneous.hpp"
+#include "segment_search.hpp"
 
 using namespace std;
 
@@ -48,14 +53,44 @@ namespace pma {
  *                                                                           *
  *****************************************************************************/
 
-StaticIndex::StaticIndex(uint64_t node_size, uint64_t num_segments) :
-        m_node_size(node_size), m_height(0), m_capacity(0), m_keys(nullptr), m_key_minimum(numeric_limits<int64_t>::max()) {
+StaticIndex::StaticIndex(uint64_t node_size, uint64_t num_segments, Layout layout) :
+        m_node_size(node_size), m_height(0), m_capacity(0), m_keys(nullptr), m_key_minimum(numeric_limits<int64_t>::max()), m_layout(layout) {
     if(node_size > (uint64_t) numeric_limits<uint16_t>::max()){ throw std::invalid_argument("Invalid node size: too big"); }
     rebuild(num_segments);
 }
 
 StaticIndex::~StaticIndex(){
     free(m_keys); m_keys = nullptr;
+    free(m_eytzinger_rank2pos); m_eytzinger_rank2pos = nullptr;
+    free(m_eytzinger_pos2rank); m_eytzinger_pos2rank = nullptr;
+}
+
+StaticIndex::Layout StaticIndex::layout() const noexcept {
+    return m_layout;
+}
+
+void StaticIndex::set_layout(Layout layout){
+    if(layout == m_layout) return; // nop
+
+    // save the current separator keys
+    vector<int64_t> separator_keys;
+    separator_keys.reserve(m_capacity);
+    for(int64_t i = 0; i < m_capacity; i++){ separator_keys.push_back(get_separator_key(i)); }
+
+    // release the current layout
+    free(m_keys); m_keys = nullptr;
+    free(m_eytzinger_rank2pos); m_eytzinger_rank2pos = nullptr;
+    free(m_eytzinger_pos2rank); m_eytzinger_pos2rank = nullptr;
+    vector<int64_t>().swap(m_learned_keys);
+    vector<LearnedSegment>().swap(m_learned_model);
+    vector<bool>().swap(m_learned_set);
+    m_height = 0;
+    m_capacity = 0;
+
+    // rebuild the index with the new layout
+    m_layout = layout;
+    rebuild(separator_keys.size());
+    for(size_t i = 0; i < separator_keys.size(); i++){ set_separator_key(i, separator_keys[i]); }
 }
 
 int64_t StaticIndex::node_size() const noexcept {
@@ -65,6 +100,8 @@ int64_t StaticIndex::node_size() const noexcept {
 
 void StaticIndex::rebuild(uint64_t N){
     if(N == 0) throw std::invalid_argument("Invalid number of keys: 0");
+    if(m_layout == Layout::EYTZINGER){ rebuild_eytzinger(N); return; }
+    if(m_layout == Layout::LEARNED){ rebuild_learned(N); return; }
     int height = ceil( log2(N) / log2(node_size()) );
     if(height > m_rightmost_sz){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
     uint64_t tree_sz = pow(node_size(), height) -1; // don't store the minimum, segment 0
@@ -109,7 +146,313 @@ int StaticIndex::height() const noexcept {
 
 
 size_t StaticIndex::memory_footprint() const {
-    return (pow(node_size(), height()) -1) * sizeof(int64_t);
+    if(m_layout == Layout::EYTZINGER){
+        return m_capacity * (sizeof(m_keys[0]) + sizeof(m_eytzinger_rank2pos[0]) + sizeof(m_eytzinger_pos2rank[0]));
+    } else if(m_layout == Layout::LEARNED){
+        return m_capacity * sizeof(m_keys[0]) + m_learned_keys.size() * sizeof(m_learned_keys[0]) + m_learned_model.size() * sizeof(m_learned_model[0]) + m_learned_set.size() / 8;
+    } else {
+        return (pow(node_size(), height()) -1) * sizeof(int64_t);
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Eytzinger layout                                                        *
+ *                                                                           *
+ *****************************************************************************/
+// In the Eytzinger layout, the separator keys of the segments [1, N) are stored in the breadth first order of a
+// complete binary search tree. The slot 0 is not used, the root is at the slot 1 and the children of the slot k
+// are at the slots 2k and 2k+1. The array m_keys is aligned to the cache line, so that the 8 descendants, three
+// levels below the slot k, i.e. the slots [8k, 8k+8), share the same cache line.
+
+// Assign the ranks [rank, ...) to the slots in the subtree rooted at `slot', return the next rank to assign
+static uint64_t eytzinger_assign(uint32_t* rank2pos, uint32_t* pos2rank, uint64_t num_keys, uint64_t slot, uint64_t rank){
+    if(slot <= num_keys){
+        rank = eytzinger_assign(rank2pos, pos2rank, num_keys, 2 * slot, rank);
+        rank2pos[rank] = slot; pos2rank[slot] = rank;
+        rank = eytzinger_assign(rank2pos, pos2rank, num_keys, 2 * slot + 1, rank +1);
+    }
+    return rank;
+}
+
+void StaticIndex::rebuild_eytzinger(uint64_t N){
+    if(N > (uint64_t) numeric_limits<uint32_t>::max()){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
+
+    if(N != static_cast<uint64_t>(m_capacity)){
+        free(m_keys); m_keys = nullptr;
+        free(m_eytzinger_rank2pos); m_eytzinger_rank2pos = nullptr;
+        free(m_eytzinger_pos2rank); m_eytzinger_pos2rank = nullptr;
+
+        int rc = posix_memalign((void**) &m_keys, /* alignment */ 64,  /* size */ N * sizeof(m_keys[0]));
+        if(rc != 0) { throw std::bad_alloc(); }
+        m_eytzinger_rank2pos = (uint32_t*) malloc(N * sizeof(m_eytzinger_rank2pos[0]));
+        m_eytzinger_pos2rank = (uint32_t*) malloc(N * sizeof(m_eytzinger_pos2rank[0]));
+        if(m_eytzinger_rank2pos == nullptr || m_eytzinger_pos2rank == nullptr){ throw std::bad_alloc(); }
+    }
+    m_capacity = N;
+    m_height = ceil(log2(N)); // N -1 keys, plus the minimum
+    m_eytzinger_rank2pos[0] = m_eytzinger_pos2rank[0] = 0; // unused
+
+    // assign the segments [1, N) to the slots of the tree, with an in-order visit
+    eytzinger_assign(m_eytzinger_rank2pos, m_eytzinger_pos2rank, /* num keys */ N -1, /* slot */ 1, /* rank */ 1);
+
+    COUT_DEBUG("[eytzinger] capacity: " << m_capacity << ", height: " << m_height);
+}
+
+template<bool include_equal>
+uint64_t StaticIndex::find_eytzinger(int64_t key) const noexcept {
+    const int64_t* __restrict keys = m_keys;
+    const uint64_t num_keys = m_capacity -1;
+
+    uint64_t k = 1;
+    while(k <= num_keys){
+        PREFETCH(keys + 8 * k); // three levels below
+        k = 2 * k + (include_equal ? (keys[k] <= key) : (keys[k] < key));
+    }
+    // remove the trailing right turns, plus the last left turn, to retrieve the first slot greater than key
+    k >>= __builtin_ffsll(~k);
+
+    return (k == 0) ? num_keys : m_eytzinger_pos2rank[k] -1;
+}
+
+void StaticIndex::dump_eytzinger(std::ostream& out, bool* integrity_check) const {
+    out << "[Eytzinger] keys: ";
+    int64_t previous = m_key_minimum;
+    for(int64_t i = 1; i < m_capacity; i++){
+        int64_t key = get_separator_key(i);
+        if(i > 1) out << ", ";
+        out << i << " => " << key << " [slot: " << m_eytzinger_rank2pos[i] << "]";
+        if(key < previous){
+            out << " (ERROR: sorted order not respected: " << previous << " > " << key << ")";
+            if(integrity_check) *integrity_check = false;
+        }
+        previous = key;
+    }
+    out << "\n";
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Learned layout                                                          *
+ *                                                                           *
+ *****************************************************************************/
+// In the learned layout, the separator keys of the segments [1, N) are stored in a sorted array, at the slots [1, N)
+// of m_keys. A piecewise linear model predicts the position (rank) of a key in the array, with a max error of
+// epsilon positions. The pieces are fitted with a greedy shrinking cone: a piece is anchored to its first
+// separator key and it is extended until no slope is able to predict all of its keys within the error bound.
+// To locate the segment for a key, the piece is found with a search on the first key of each piece, then the
+// window of 2 * epsilon positions around the prediction is searched. If the key is outside the window, the
+// search gallops towards the key, so that the result is always exact, even when the model is stale.
+//
+// After a rebuild, the model is fitted once all separator keys have been set, or as soon as a separator key is set
+// for the second time: the spreads do not set the keys of the empty segments, hence a key set twice implies the
+// rebuild has been completed. The keys never set take the value of the next key set, so that the array is
+// sorted and a lookup is never routed to an empty segment. Afterwards, when a separator key is updated and its
+// position exceeds the error bound of its piece, only that piece is refitted, possibly splitting it in several
+// pieces. When the number of pieces doubles w.r.t. the last fit of the whole model, the whole model is fitted again.
+
+void StaticIndex::rebuild_learned(uint64_t N){
+    if(N != static_cast<uint64_t>(m_capacity)){
+        free(m_keys); m_keys = nullptr;
+        int rc = posix_memalign((void**) &m_keys, /* alignment */ 64,  /* size */ N * sizeof(m_keys[0]));
+        if(rc != 0) { throw std::bad_alloc(); }
+    }
+    m_capacity = N;
+    m_height = (N > 1) ? 1 : 0; // the search over the window of the prediction
+    m_keys[0] = m_key_minimum; // unused
+    fill(m_keys +1, m_keys + N, numeric_limits<int64_t>::max()); // not set yet
+
+    // wait for the new separator keys to fit the model
+    m_learned_keys.clear();
+    m_learned_model.clear();
+    m_learned_set.assign(N -1, false);
+    m_learned_pending = N -1;
+    m_learned_num_pieces_fit = 0;
+
+    COUT_DEBUG("[learned] capacity: " << m_capacity << ", epsilon: " << learned_epsilon());
+}
+
+uint64_t StaticIndex::learned_epsilon() const noexcept {
+    return max<uint64_t>(1, (node_size() -1) / 2);
+}
+
+// Difference between two keys, without overflowing
+static double learned_distance(int64_t key, int64_t anchor){
+    if(key >= anchor)
+        return static_cast<double>(static_cast<uint64_t>(key) - static_cast<uint64_t>(anchor));
+    else
+        return - static_cast<double>(static_cast<uint64_t>(anchor) - static_cast<uint64_t>(key));
+}
+
+void StaticIndex::fit_learned(uint64_t rank_start, uint64_t rank_end, vector<int64_t>& out_keys, vector<LearnedSegment>& out_model) const {
+    const int64_t* __restrict separators = m_keys +1;
+    const double epsilon = learned_epsilon();
+
+    uint64_t i = rank_start;
+    while(i < rank_end){
+        // start a new piece at the rank i
+        const int64_t anchor = separators[i];
+        const uint64_t piece_end = min(rank_end, i + m_learned_max_piece_sz);
+        double slope_min = 0;
+        double slope_max = numeric_limits<double>::infinity();
+
+        uint64_t j = i +1;
+        while(j < piece_end){
+            int64_t key = separators[j];
+            if(key < anchor) break; // sorted order not respected, start a new piece
+            if(key > anchor){ // skip the duplicates of the anchor, they cannot be predicted by any slope
+                double dx = learned_distance(key, anchor);
+                double dy = j - i;
+                double lo = (dy - epsilon) / dx;
+                double hi = (dy + epsilon) / dx;
+                if(lo > slope_max || hi < slope_min) break; // the cone is empty
+                slope_min = max(slope_min, lo);
+                slope_max = min(slope_max, hi);
+            }
+            j++;
+        }
+
+        double slope = (slope_max == numeric_limits<double>::infinity()) ? 0. : (slope_min + slope_max) / 2;
+        out_keys.push_back(anchor);
+        out_model.push_back(LearnedSegment{ anchor, i, slope });
+        COUT_DEBUG("piece ranks: [" << i << ", " << j << "), anchor: " << anchor << ", slope: " << slope);
+
+        i = j;
+    }
+}
+
+void StaticIndex::fit_learned(){
+    if(!m_learned_set.empty()){ // first fit after a rebuild, the keys not set take the value of the next key set
+        int64_t next = numeric_limits<int64_t>::max();
+        for(uint64_t rank = m_capacity -1; rank > 0; rank--){
+            if(m_learned_set[rank -1]){ next = m_keys[rank]; } else { m_keys[rank] = next; }
+        }
+        vector<bool>().swap(m_learned_set);
+    }
+
+    m_learned_keys.clear();
+    m_learned_model.clear();
+    m_learned_pending = 0;
+    fit_learned(0, m_capacity -1, m_learned_keys, m_learned_model);
+    m_learned_num_pieces_fit = m_learned_model.size();
+}
+
+void StaticIndex::update_learned(uint64_t rank, int64_t key){
+    if(!m_learned_set.empty()){ // the model has not been fitted yet after the last rebuild
+        if(m_learned_set[rank]){ // set twice, the spread that followed the rebuild is complete
+            fit_learned();
+        } else {
+            m_learned_set[rank] = true;
+            if(--m_learned_pending == 0){ fit_learned(); }
+        }
+        return;
+    }
+
+    // locate the piece covering the rank
+    auto it = upper_bound(begin(m_learned_model), end(m_learned_model), rank, [](uint64_t rank, const LearnedSegment& piece){ return rank < piece.m_rank; });
+    assert(it != begin(m_learned_model));
+    uint64_t j = (it - begin(m_learned_model)) -1;
+    const LearnedSegment& piece = m_learned_model[j];
+    if(piece.m_rank == rank){ m_learned_keys[j] = key; }
+
+    // check the error bound
+    double position = piece.m_rank + piece.m_slope * learned_distance(key, piece.m_anchor);
+    if(abs(position - static_cast<double>(rank)) <= learned_epsilon()) return;
+
+    // refit the piece
+    uint64_t rank_start = piece.m_rank;
+    uint64_t rank_end = (j +1 < m_learned_model.size()) ? m_learned_model[j +1].m_rank : m_capacity -1;
+    vector<int64_t> keys;
+    vector<LearnedSegment> model;
+    fit_learned(rank_start, rank_end, keys, model);
+    COUT_DEBUG("rank: " << rank << ", key: " << key << ", refit piece: " << j << ", ranks: [" << rank_start << ", " << rank_end << "), new pieces: " << model.size());
+    m_learned_keys[j] = keys[0];
+    m_learned_model[j] = model[0];
+    m_learned_keys.insert(begin(m_learned_keys) + j +1, begin(keys) +1, end(keys));
+    m_learned_model.insert(begin(m_learned_model) + j +1, begin(model) +1, end(model));
+
+    // bound the fragmentation of the model
+    if(m_learned_model.size() > 2 * m_learned_num_pieces_fit + 8){ fit_learned(); }
+}
+
+uint64_t StaticIndex::predict_learned(int64_t key) const noexcept {
+    const uint64_t num_separators = m_capacity -1;
+    const uint64_t num_pieces = m_learned_model.size();
+    if(num_pieces == 0) return num_separators / 2; // the model has not been fitted yet, gallop from the middle
+
+    // locate the piece
+    uint64_t j = segment_upper_bound(m_learned_keys.data() +1, num_pieces -1, key);
+    const LearnedSegment& piece = m_learned_model[j];
+    uint64_t rank_end = (j +1 < num_pieces) ? m_learned_model[j +1].m_rank : num_separators;
+
+    // predict the position in the range covered by the piece
+    double position = piece.m_rank + piece.m_slope * learned_distance(key, piece.m_anchor);
+    if(position <= piece.m_rank)
+        return piece.m_rank;
+    else if(position >= rank_end)
+        return rank_end;
+    else
+        return position;
+}
+
+template<bool include_equal>
+uint64_t StaticIndex::find_learned(int64_t key, uint64_t position) const noexcept {
+    const int64_t* __restrict separators = m_keys +1;
+    const uint64_t num_separators = m_capacity -1;
+    auto precedes = [key](int64_t separator){ return include_equal ? (separator <= key) : (separator < key); };
+
+    // the window around the predicted position. The result is the number of separators preceding the key,
+    // which is at most one position after the separator predicted
+    uint64_t step = learned_epsilon() +1;
+    uint64_t lo = (position > step) ? position - step : 0;
+    uint64_t hi = min(num_separators, position + step);
+
+    // the key is outside the window, gallop towards it
+    while(lo > 0 && !precedes(separators[lo -1])){
+        hi = lo -1;
+        step *= 2;
+        lo = (hi > step) ? hi - step : 0;
+    }
+    while(hi < num_separators && precedes(separators[hi])){
+        lo = hi +1;
+        step *= 2;
+        hi = min(num_separators, lo + step);
+    }
+
+    COUT_DEBUG("key: " << key << ", position: " << position << ", window: [" << lo << ", " << hi << "]");
+    if(include_equal)
+        return lo + segment_upper_bound(separators + lo, hi - lo, key);
+    else
+        return lo + segment_lower_bound(separators + lo, hi - lo, key);
+}
+
+void StaticIndex::dump_learned(std::ostream& out, bool* integrity_check) const {
+    out << "[Learned] epsilon: " << learned_epsilon() << ", pieces: " << m_learned_model.size() << ", pieces at the last fit: " << m_learned_num_pieces_fit;
+    if(m_learned_model.empty()) out << ", model not fitted yet, keys to set: " << m_learned_pending;
+    out << "\n";
+    for(size_t j = 0; j < m_learned_model.size(); j++){
+        const LearnedSegment& piece = m_learned_model[j];
+        out << "  piece " << j << ": first rank: " << piece.m_rank << ", first key: " << m_learned_keys[j] << ", anchor: " << piece.m_anchor << ", slope: " << piece.m_slope;
+        if(m_learned_keys[j] != m_keys[piece.m_rank +1]){
+            out << " (ERROR: the first key does not match the separator key: " << m_keys[piece.m_rank +1] << ")";
+            if(integrity_check) *integrity_check = false;
+        }
+        out << "\n";
+    }
+
+    out << "  keys: ";
+    int64_t previous = m_key_minimum;
+    for(int64_t i = 1; i < m_capacity; i++){
+        int64_t key = get_separator_key(i);
+        if(i > 1) out << ", ";
+        out << i << " => " << key;
+        if(key < previous){
+            out << " (ERROR: sorted order not respected: " << previous << " > " << key << ")";
+            if(integrity_check) *integrity_check = false;
+        }
+        previous = key;
+    }
+    out << "\n";
 }
 
 /*****************************************************************************
@@ -160,6 +503,13 @@ int64_t* StaticIndex::get_slot(uint64_t segment_id) const {
 void StaticIndex::set_separator_key(uint64_t segment_id, int64_t key){
     if(segment_id == 0) {
         m_key_minimum = key;
+    } else if(m_layout == Layout::EYTZINGER){
+        assert(segment_id < static_cast<uint64_t>(m_capacity) && "Invalid slot");
+        m_keys[m_eytzinger_rank2pos[segment_id]] = key;
+    } else if(m_layout == Layout::LEARNED){
+        assert(segment_id < static_cast<uint64_t>(m_capacity) && "Invalid slot");
+        m_keys[segment_id] = key;
+        update_learned(segment_id -1, key);
     } else {
         get_slot(segment_id)[0] = key;
     }
@@ -170,6 +520,10 @@ void StaticIndex::set_separator_key(uint64_t segment_id, int64_t key){
 int64_t StaticIndex::get_separator_key(uint64_t segment_id) const {
     if(segment_id == 0)
         return m_key_minimum;
+    else if(m_layout == Layout::EYTZINGER)
+        return m_keys[m_eytzinger_rank2pos[segment_id]];
+    else if(m_layout == Layout::LEARNED)
+        return m_keys[segment_id];
     else
         return get_slot(segment_id)[0];
 }
@@ -182,6 +536,8 @@ int64_t StaticIndex::get_separator_key(uint64_t segment_id) const {
 uint64_t StaticIndex::find(int64_t key) const noexcept {
     COUT_DEBUG("key: " << key);
     if(key <= m_key_minimum) return 0; // easy!
+    if(m_layout == Layout::EYTZINGER) return find_eytzinger</* include equal ? */ true>(key);
+    if(m_layout == Layout::LEARNED) return find_learned</* include equal ? */ true>(key, predict_learned(key));
 
     int64_t* __restrict base = m_keys;
     int64_t offset = 0;
@@ -191,8 +547,7 @@ uint64_t StaticIndex::find(int64_t key) const noexcept {
 
     while(height > 0){
         uint64_t root_sz = (rightmost) ? m_rightmost[height -1].m_root_sz : node_size() -1; // full
-        uint64_t subtree_id = 0;
-        while(subtree_id < root_sz && base[subtree_id] <= key) subtree_id++;
+        uint64_t subtree_id = segment_upper_bound(base, root_sz, key);
 
         base += (node_size() -1) + subtree_id * (subtree_sz -1);
         offset += subtree_id * subtree_sz;
@@ -217,6 +572,8 @@ uint64_t StaticIndex::find(int64_t key) const noexcept {
 
 uint64_t StaticIndex::find_first(int64_t key) const noexcept {
     if(key < m_key_minimum) return 0; // easy!
+    if(m_layout == Layout::EYTZINGER) return find_eytzinger</* include equal ? */ false>(key);
+    if(m_layout == Layout::LEARNED) return find_learned</* include equal ? */ false>(key, predict_learned(key));
 
     int64_t* __restrict base = m_keys;
     int64_t offset = 0;
@@ -226,8 +583,7 @@ uint64_t StaticIndex::find_first(int64_t key) const noexcept {
 
     while(height > 0){
         uint64_t root_sz = (rightmost) ? m_rightmost[height -1].m_root_sz : node_size() -1; // full
-        uint64_t subtree_id = 0;
-        while(subtree_id < root_sz && base[subtree_id] < key) subtree_id++;
+        uint64_t subtree_id = segment_lower_bound(base, root_sz, key);
 
         base += (node_size() -1) + subtree_id * (subtree_sz -1);
         offset += subtree_id * subtree_sz;
@@ -248,6 +604,8 @@ uint64_t StaticIndex::find_first(int64_t key) const noexcept {
 
 uint64_t StaticIndex::find_last(int64_t key) const noexcept {
     if(key < m_key_minimum) return 0; // easy!
+    if(m_layout == Layout::EYTZINGER) return find_eytzinger</* include equal ? */ true>(key);
+    if(m_layout == Layout::LEARNED) return find_learned</* include equal ? */ true>(key, predict_learned(key));
 
     int64_t* __restrict base = m_keys;
     int64_t offset = 0;
@@ -257,8 +615,7 @@ uint64_t StaticIndex::find_last(int64_t key) const noexcept {
 
     while(height > 0){
         uint64_t root_sz = (rightmost) ? m_rightmost[height -1].m_root_sz : node_size() -1; // full
-        uint64_t subtree_id = root_sz;
-        while(subtree_id > 0 && key < base[subtree_id -1]) subtree_id--;
+        uint64_t subtree_id = segment_upper_bound(base, root_sz, key);
 
         base += (node_size() -1) + subtree_id * (subtree_sz -1);
         offset += subtree_id * subtree_sz;
@@ -277,6 +634,127 @@ uint64_t StaticIndex::find_last(int64_t key) const noexcept {
     return offset;
 }
 
+void StaticIndex::find_batch(const int64_t* __restrict keys, uint64_t* __restrict out_segments, size_t num_keys) const noexcept {
+    for(size_t i = 0; i < num_keys; i += m_find_batch_group_sz){
+        size_t group_sz = std::min<size_t>(m_find_batch_group_sz, num_keys - i);
+        if(m_layout == Layout::EYTZINGER){
+            find_batch_eytzinger(keys + i, out_segments + i, group_sz);
+        } else if(m_layout == Layout::LEARNED){
+            find_batch_learned(keys + i, out_segments + i, group_sz);
+        } else {
+            find_batch_btree(keys + i, out_segments + i, group_sz);
+        }
+    }
+}
+
+void StaticIndex::find_batch_btree(const int64_t* __restrict keys, uint64_t* __restrict out_segments, size_t group_sz) const noexcept {
+    assert(group_sz <= m_find_batch_group_sz);
+
+    // the state of the descent for each key in the group
+    struct {
+        int64_t* m_base;
+        int64_t m_offset;
+        int64_t m_subtree_sz;
+        int m_height;
+        bool m_rightmost;
+    } state[m_find_batch_group_sz];
+
+    for(size_t j = 0; j < group_sz; j++){
+        state[j].m_base = m_keys;
+        state[j].m_offset = 0;
+        state[j].m_subtree_sz = pow(node_size(), m_height -1);
+        state[j].m_height = (keys[j] <= m_key_minimum) ? 0 : m_height;
+        state[j].m_rightmost = true;
+    }
+
+    // descend the tree in lockstep, one node at the time for each key. The node fetched for one key is
+    // requested in advance, while the nodes for the remaining keys in the group are being searched
+    bool active = true;
+    while(active){
+        active = false;
+        for(size_t j = 0; j < group_sz; j++){
+            auto& s = state[j];
+            if(s.m_height <= 0) continue;
+
+            uint64_t root_sz = (s.m_rightmost) ? m_rightmost[s.m_height -1].m_root_sz : node_size() -1; // full
+            uint64_t subtree_id = segment_upper_bound(s.m_base, root_sz, keys[j]);
+
+            s.m_base += (node_size() -1) + subtree_id * (s.m_subtree_sz -1);
+            s.m_offset += subtree_id * s.m_subtree_sz;
+
+            // similar to #get_slot
+            s.m_rightmost = s.m_rightmost && (subtree_id >= m_rightmost[s.m_height -1].m_root_sz);
+            if(s.m_rightmost){
+                s.m_height = m_rightmost[s.m_height -1].m_right_height;
+                s.m_subtree_sz = pow(node_size(), s.m_height -1);
+            } else {
+                s.m_height --;
+                s.m_subtree_sz /= node_size();
+            }
+
+            if(s.m_height > 0){
+                for(int64_t k = 0; k < node_size() -1; k += CACHELINE / sizeof(int64_t)){ PREFETCH(s.m_base + k); }
+                active = true;
+            }
+        }
+    }
+
+    for(size_t j = 0; j < group_sz; j++){ out_segments[j] = state[j].m_offset; }
+}
+
+void StaticIndex::find_batch_eytzinger(const int64_t* __restrict keys, uint64_t* __restrict out_segments, size_t group_sz) const noexcept {
+    assert(group_sz <= m_find_batch_group_sz);
+    const int64_t* __restrict tree = m_keys;
+    const uint64_t num_separators = m_capacity -1;
+
+    uint64_t slots[m_find_batch_group_sz];
+    for(size_t j = 0; j < group_sz; j++){ slots[j] = (keys[j] <= m_key_minimum) ? 0 : 1; }
+
+    // descend the tree in lockstep, one level at the time for each key
+    bool active = true;
+    while(active){
+        active = false;
+        for(size_t j = 0; j < group_sz; j++){
+            uint64_t k = slots[j];
+            if(k == 0 || k > num_separators) continue;
+            k = 2 * k + (tree[k] <= keys[j]);
+            PREFETCH(tree + k);
+            slots[j] = k;
+            active = true;
+        }
+    }
+
+    for(size_t j = 0; j < group_sz; j++){
+        uint64_t k = slots[j];
+        if(k == 0){ // key <= minimum
+            out_segments[j] = 0;
+        } else {
+            k >>= __builtin_ffsll(~k);
+            out_segments[j] = (k == 0) ? num_separators : m_eytzinger_pos2rank[k] -1;
+        }
+    }
+}
+
+void StaticIndex::find_batch_learned(const int64_t* __restrict keys, uint64_t* __restrict out_segments, size_t group_sz) const noexcept {
+    assert(group_sz <= m_find_batch_group_sz);
+    const int64_t* __restrict separators = m_keys +1;
+    const uint64_t num_separators = m_capacity -1;
+    const uint64_t window_sz = learned_epsilon() +1;
+
+    // predict the positions of all keys in the group and request their windows in advance
+    uint64_t positions[m_find_batch_group_sz];
+    for(size_t j = 0; j < group_sz; j++){
+        positions[j] = predict_learned(keys[j]);
+        uint64_t lo = (positions[j] > window_sz) ? positions[j] - window_sz : 0;
+        uint64_t hi = min(num_separators, positions[j] + window_sz);
+        for(uint64_t k = lo; k < hi; k += CACHELINE / sizeof(int64_t)){ PREFETCH(separators + k); }
+    }
+
+    for(size_t j = 0; j < group_sz; j++){
+        out_segments[j] = (keys[j] <= m_key_minimum) ? 0 : find_learned</* include equal ? */ true>(keys[j], positions[j]);
+    }
+}
+
 int64_t StaticIndex::minimum() const noexcept {
     return m_key_minimum;
 }
@@ -357,10 +835,14 @@ void StaticIndex::dump_subtree(std::ostream& out, int64_t* root, int height, boo
 }
 
 void StaticIndex::dump(std::ostream& out, bool* integrity_check) const {
-    out << "[Index] block size: " << node_size() << ", height: " << height() <<
+    out << "[Index] layout: " << m_layout << ", block size: " << node_size() << ", height: " << height() <<
             ", capacity (number of entries indexed): " << m_capacity << ", minimum: " << minimum() << "\n";
 
-    if(m_capacity > 1)
+    if(m_capacity > 1 && m_layout == Layout::EYTZINGER)
+        dump_eytzinger(out, integrity_check);
+    else if(m_capacity > 1 && m_layout == Layout::LEARNED)
+        dump_learned(out, integrity_check);
+    else if(m_capacity > 1)
         dump_subtree(out, m_keys, height(), true, m_key_minimum, numeric_limits<int64_t>::max(), integrity_check);
 }
 
@@ -373,6 +855,16 @@ std::ostream& operator<<(std::ostream& out, const StaticIndex& index){
     return out;
 }
 
+std::ostream& operator<<(std::ostream& out, StaticIndex::Layout layout){
+    switch(layout){
+    case StaticIndex::Layout::BTREE: out << "btree"; break;
+    case StaticIndex::Layout::EYTZINGER: out << "eytzinger"; break;
+    case StaticIndex::Layout::LEARNED: out << "learned"; break;
+    default: out << "unknown";
+    }
+    return out;
+}
+
 } // namespace pma
 
 
@@ -19,7 +19,9 @@
 #define GENERIC_STATIC_INDEX_HPP_
 
 #include <cinttypes>
+#include <cstddef>
 #include <ostream>
+#include <vector>
 
 namespace pma {
 
@@ -29,14 +31,45 @@ namespace pma {
  *
  * The node size B is determined on initialisation. A node size B actually requires B -1 slots
  * in terms of space, so it is recommended to set B to a power of 2 + 1 (e.g. 65) to fully
- * exploit aligned accesses to the cache.
+ * exploit aligned accesses to the cache. In the learned layout, B -1 is the size of the window
+ * searched around the position predicted by the model, that is, the model is fitted with a max
+ * error of (B -1) / 2 positions.
  */
 class StaticIndex {
+public:
+    /**
+     * How the separator keys are laid out in memory
+     * - BTREE: static B-tree, the keys are grouped in nodes of size B, each node is searched with the SIMD segment kernels
+     * - EYTZINGER: breadth first order of a complete binary search tree, the grandchildren of the current node are prefetched during the descent
+     * - LEARNED: sorted array of keys, with a piecewise linear model predicting the position of a key within an error bound
+     */
+    enum class Layout : uint8_t { BTREE, EYTZINGER, LEARNED };
+
+private:
     const uint16_t m_node_size; // number of keys per node
     int16_t m_height; // the height of this tree
-    int32_t m_capacity; // the number of segments/keys in the tree
+    int64_t m_capacity; // the number of segments/keys in the tree
     int64_t* m_keys; // the container of the keys
     int64_t m_key_minimum; // the minimum stored in the tree
+    Layout m_layout; // the layout of the separator keys in m_keys
+    uint32_t* m_eytzinger_rank2pos = nullptr; // Eytzinger layout only, map a segment id to its slot in m_keys
+    uint32_t* m_eytzinger_pos2rank = nullptr; // Eytzinger layout only, map a slot in m_keys to its segment id
+
+    /**
+     * A piece of the linear model in the learned layout. It predicts the position of the separator keys in the
+     * ranks [m_rank, next piece's m_rank) as m_rank + m_slope * (key - m_anchor)
+     */
+    struct LearnedSegment {
+        int64_t m_anchor; // the key the piece was fitted on, at the position m_rank
+        uint64_t m_rank; // the position of the first separator key covered by this piece
+        double m_slope; // the slope of the piece
+    };
+    std::vector<int64_t> m_learned_keys; // Learned layout only, the first separator key covered by each piece, to locate the piece for a given key
+    std::vector<LearnedSegment> m_learned_model; // Learned layout only, the pieces of the model
+    std::vector<bool> m_learned_set; // Learned layout only, the ranks whose separator key has been set since the last rebuild, empty once the model is fitted
+    uint64_t m_learned_pending = 0; // Learned layout only, number of distinct ranks to set before the model is fitted for the first time after a rebuild
+    uint64_t m_learned_num_pieces_fit = 0; // Learned layout only, number of pieces after the last fit of the whole model
+    constexpr static uint64_t m_learned_max_piece_sz = 4096; // Learned layout only, max number of separator keys covered by a single piece
 
     /**
      * Keep track of the cardinality and the height of the rightmost subtrees
@@ -55,11 +88,56 @@ protected:
     // Dump the content of the given subtree
     void dump_subtree(std::ostream& out, int64_t* root, int height, bool rightmost, int64_t fence_min, int64_t fence_max, bool* integrity_check) const;
 
+    // Rebuild the Eytzinger layout to contain `num_segments'
+    void rebuild_eytzinger(uint64_t num_segments);
+
+    // Descend the Eytzinger layout, return the number of separator keys (excl. the minimum) that precede `key'
+    template<bool include_equal> uint64_t find_eytzinger(int64_t key) const noexcept;
+
+    // Dump the keys in the Eytzinger layout
+    void dump_eytzinger(std::ostream& out, bool* integrity_check) const;
+
+    // Rebuild the learned layout to contain `num_segments'
+    void rebuild_learned(uint64_t num_segments);
+
+    // The max error of the positions predicted by the model in the learned layout
+    uint64_t learned_epsilon() const noexcept;
+
+    // Fit the pieces for the separator keys in the ranks [rank_start, rank_end) and append them to the given model
+    void fit_learned(uint64_t rank_start, uint64_t rank_end, std::vector<int64_t>& out_keys, std::vector<LearnedSegment>& out_model) const;
+
+    // Fit the whole model of the learned layout
+    void fit_learned();
+
+    // Check the error of the model for the separator key at the given rank, refit its piece if the error bound is violated
+    void update_learned(uint64_t rank, int64_t key);
+
+    // Predict the position of the given key in the learned layout
+    uint64_t predict_learned(int64_t key) const noexcept;
+
+    // Search the given key around the predicted position, return the number of separator keys (excl. the minimum) that precede `key'
+    template<bool include_equal> uint64_t find_learned(int64_t key, uint64_t position) const noexcept;
+
+    // Dump the keys and the model of the learned layout
+    void dump_learned(std::ostream& out, bool* integrity_check) const;
+
+    // Number of keys looked up together by #find_batch
+    constexpr static size_t m_find_batch_group_sz = 16;
+
+    // Resolve a group of at most m_find_batch_group_sz keys in the B-Tree layout
+    void find_batch_btree(const int64_t* keys, uint64_t* out_segments, size_t group_sz) const noexcept;
+
+    // Resolve a group of at most m_find_batch_group_sz keys in the Eytzinger layout
+    void find_batch_eytzinger(const int64_t* keys, uint64_t* out_segments, size_t group_sz) const noexcept;
+
+    // Resolve a group of at most m_find_batch_group_sz keys in the learned layout
+    void find_batch_learned(const int64_t* keys, uint64_t* out_segments, size_t group_sz) const noexcept;
+
 public:
     /**
      * Initialise the AB-Tree with the given node size and capacity
      */
-    StaticIndex(uint64_t node_size, uint64_t num_segments = 1);
+    StaticIndex(uint64_t node_size, uint64_t num_segments = 1, Layout layout = Layout::BTREE);
 
     /**
      * Destructor
@@ -72,13 +150,25 @@ public:
     void rebuild(uint64_t num_segments);
 
     /**
-     * Set the separator key associated to the given segment
+     * Change the layout of the separator keys. The keys currently indexed are preserved.
+     */
+    void set_layout(Layout layout);
+
+    /**
+     * Retrieve the current layout of the separator keys
+     */
+    Layout layout() const noexcept;
+
+    /**
+     * Set the separator key associated to the given segment. In the B-tree and the Eytzinger layouts, the separator keys
+     * of distinct segments can be set concurrently. In the learned layout, the calls need to be serialised, as the
+     * model may be refitted when the key exceeds the error bound of its piece.
      */
     void set_separator_key(uint64_t segment_id, int64_t key);
 
     /**
-     * Get the separator key associated to the given segment.
-     * Used only for the debugging purposes.
+     * Get the separator key associated to the given segment. After a rebuild, the separator keys not set yet are
+     * undefined, except in the learned layout where they are the maximum int64_t until the model is fitted.
      */
     int64_t get_separator_key(uint64_t segment_id) const;
 
@@ -98,6 +188,13 @@ public:
      */
     uint64_t find_last(int64_t key) const noexcept;
 
+    /**
+     * Resolve the segment ids for the given sequence of keys, with the same semantic of #find.
+     * The keys are looked up in groups, descending the index for all keys of the group in
+     * lockstep and prefetching the next node of each key while the others are being searched.
+     */
+    void find_batch(const int64_t* keys, uint64_t* out_segments, size_t num_keys) const noexcept;
+
     /**
      * Retrieve the minimum stored in the tree
      */
@@ -126,6 +223,7 @@ public:
 };
 
 std::ostream& operator<<(std::ostream& out, const StaticIndex& index);
+std::ostream& operator<<(std::ostream& out, StaticIndex::Layout layout);
 
 } // namespace pma
 
@@ -30,6 +30,12 @@ Interface::~Interface() { }
 void Interface::build(){ };
 
 
+void Interface::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    for(size_t i = 0; i < num_keys; i++){
+        out_values[i] = find(keys[i]);
+    }
+}
+
 int64_t Interface::remove(int64_t key){
     RAISE_EXCEPTION(Exception, "Method ::remove(int64_t key) not supported!");
 }
@@ -38,14 +44,68 @@ size_t Interface::memory_footprint() const{
     return 0;
 }
 
+// Pass the elements in [min, max] fetched by the iterator to the visitor, a block at the time
+static void scan_iterator(Iterator* iterator, int64_t min, int64_t max, Interface::ScanVisitor& visitor){
+    const int64_t* keys = nullptr;
+    const int64_t* values = nullptr;
+    bool proceed = true;
+
+    while(proceed){
+        size_t length = iterator->next_block(&keys, &values);
+        if(length == 0) break;
+
+        // skip the elements < min
+        size_t start = 0;
+        while(start < length && keys[start] < min) start++;
+
+        // stop at the first element > max
+        size_t end = start;
+        while(end < length && keys[end] <= max) end++;
+        proceed = (end == length);
+
+        if(end > start){ proceed = visitor.visit(keys + start, values + start, end - start) && proceed; }
+    }
+}
+
+void Interface::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    if(min > max) return;
+    scan_iterator(iterator().get(), min, max, visitor);
+}
+
+Interface::ScanVisitor::~ScanVisitor() { }
+
 InterfaceRQ::~InterfaceRQ(){ }
 
 std::unique_ptr<Iterator> InterfaceRQ::iterator() const {
     return find(numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max());
 }
 
+void InterfaceRQ::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    if(min > max) return;
+    scan_iterator(find(min, max).get(), min, max, visitor);
+}
+
 Iterator::~Iterator(){ }
 
+size_t Iterator::next_block(const int64_t** out_keys, const int64_t** out_values){
+    constexpr size_t block_sz = 64;
+    if(!m_block_buffer){ m_block_buffer.reset(new int64_t[block_sz *2]); }
+    int64_t* keys = m_block_buffer.get();
+    int64_t* values = keys + block_sz;
+
+    size_t length = 0;
+    while(length < block_sz && hasNext()){
+        auto element = next();
+        keys[length] = element.first;
+        values[length] = element.second;
+        length++;
+    }
+
+    *out_keys = keys;
+    *out_values = values;
+    return length;
+}
+
 std::ostream& operator<<(std::ostream& out, const Interface::SumResult& sum){
     out << "{SUM, first_key: " << sum.m_first_key << ", last_key: " << sum.m_last_key << ", "
             "num_elements: " << sum.m_num_elements << ", sum_keys: " << sum.m_sum_keys << ", "
@@ -19,6 +19,7 @@
 #define PMA_INTERFACE_HPP_
 
 #include <cinttypes>
+#include <cstddef>
 #include <memory>
 #include <ostream>
 #include <utility>
@@ -34,8 +35,10 @@ struct Iterator;
  * an implementation should provide are:
  * - insert(key, value): insert a new element in the data structure
  * - find(key) -> value: retrieve the value of the given key
+ * - [optional] find_batch(keys, values, N): retrieve the values of N keys at once
  * - [optional] remove(key) -> value: remove an element from the data structure, return its value
  * - sum(min, max) -> SumResult: emulate a range query in the interval [min, max], aggregate and sum all qualifying elements
+ * - [optional] scan(min, max, visitor): visit the qualifying elements in the interval [min, max], in runs of contiguous elements
  */
 class Interface {
 public:
@@ -51,6 +54,20 @@ public:
         int64_t m_sum_values =0; // the aggregate sum of all values in the interval [min, max]
     };
 
+    /**
+     * Visitor for the method #scan. The container invokes #visit for each run of elements in the interval [min, max],
+     * in sorted order. The keys and the values of a run are stored in two contiguous arrays, which are only valid
+     * for the duration of the call.
+     */
+    struct ScanVisitor {
+        virtual ~ScanVisitor();
+
+        /**
+         * Process the next `length' elements of the scan. Return false to stop the scan.
+         */
+        virtual bool visit(const int64_t* keys, const int64_t* values, std::size_t length) = 0;
+    };
+
     /**
      * Virtual destructor
      */
@@ -75,6 +92,13 @@ public:
      */
     virtual int64_t find(int64_t key) const = 0;
 
+    /**
+     * Lookup the `num_keys' elements in the array `keys' and store their values, or -1 if not present,
+     * in the array `out_values'. By default it invokes #find for each key, one at the time. Some
+     * implementations override this method to overlap the cache misses of the lookups in the batch.
+     */
+    virtual void find_batch(const int64_t* keys, int64_t* out_values, std::size_t num_keys) const;
+
     /**
      * Remove the element with the given `key' from the PMA. Supported only by few implementations.
      * Returns the value associated to the given `key', or -1 if not found.
@@ -87,6 +111,13 @@ public:
      */
     virtual SumResult sum(int64_t min, int64_t max) const = 0;
 
+    /**
+     * Visit all elements in the range [min, max]. By default the elements are fetched in blocks with an #iterator,
+     * see Iterator::next_block, and passed to the visitor. Some implementations override this method to pass their internal runs of
+     * elements (segments, leaves) directly to the visitor, at the same cost of #sum.
+     */
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const;
+
     /**
      * Scan all elements in the container
      */
@@ -132,8 +163,31 @@ public:
      * Scan all elements in the container
      */
     virtual std::unique_ptr<Iterator> iterator() const;
+
+    /**
+     * Visit all elements in the range [min, max], fetching them with the method #find(min, max)
+     */
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
 };
 
+/**
+ * Visit all elements of `instance' in the range [min, max], invoking `callback(keys, values, length)' for each run of
+ * contiguous elements. The callback returns true to continue the scan, false to stop it.
+ */
+template<typename Callback>
+void scan(const Interface& instance, int64_t min, int64_t max, Callback callback){
+    struct CallbackVisitor : public Interface::ScanVisitor {
+        Callback& m_callback;
+        CallbackVisitor(Callback& callback) : m_callback(callback) { }
+        bool visit(const int64_t* keys, const int64_t* values, std::size_t length) override {
+            return m_callback(keys, values, length);
+        }
+    };
+
+    CallbackVisitor visitor { callback };
+    instance.scan(min, max, visitor);
+}
+
 
 std::ostream& operator<<(std::ostream& out, const Interface::SumResult& sum);
 
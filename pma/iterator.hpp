@@ -19,6 +19,7 @@
 #define PMA_ITERATOR_HPP_
 
 #include <cinttypes>
+#include <cstddef>
 #include <memory>
 #include <utility>
 
@@ -33,6 +34,18 @@ struct Iterator {
     virtual ~Iterator();
     virtual bool hasNext() const = 0;
     virtual std::pair<int64_t, int64_t> next() = 0;
+
+    /**
+     * Fetch the next block of elements, in sorted order. It sets `out_keys' and `out_values' to the keys and the values of
+     * the block and returns its length, or 0 if there are no more elements. The two arrays are only valid until the next
+     * invocation of the iterator. By default, the elements are fetched one at the time with #next and copied into a buffer
+     * owned by the iterator. Some implementations rather return the runs of contiguous elements of their storage, without
+     * any copy. The methods #next and #next_block can be interleaved.
+     */
+    virtual std::size_t next_block(const int64_t** out_keys, const int64_t** out_values);
+
+private:
+    std::unique_ptr<int64_t[]> m_block_buffer; // keys & values copied by the default implementation of #next_block
 };
 
 
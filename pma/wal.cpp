@@ -0,0 +1,593 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "wal.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio> // rename
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "iterator.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+namespace pma {
+
+/*****************************************************************************
+ *                                                                           *
+ *   Debug                                                                   *
+ *                                                                           *
+ *****************************************************************************/
+//#define DEBUG
+#define COUT_DEBUG_FORCE(msg) std::cout << "[WriteAheadLog::" << __FUNCTION__ << "] " << msg << std::endl
+#if defined(DEBUG)
+    #define COUT_DEBUG(msg) COUT_DEBUG_FORCE(msg)
+#else
+    #define COUT_DEBUG(msg)
+#endif
+
+#define RAISE(msg) RAISE_EXCEPTION(WriteAheadLogError, msg)
+#define RAISE_ERRNO(msg) RAISE(msg << ": " << strerror(errno) << " (" << errno << ")")
+
+/*****************************************************************************
+ *                                                                           *
+ *   Records                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+namespace {
+
+constexpr uint32_t RECORD_INSERT = 1;
+constexpr uint32_t RECORD_REMOVE = 2;
+constexpr uint64_t REPLAY_BATCH = 4096; // number of records read at the time by the replay
+
+template<typename Record>
+uint32_t checksum(const Record& record){
+    uint64_t hash = record.m_lsn * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ static_cast<uint64_t>(record.m_key)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ static_cast<uint64_t>(record.m_value)) * 0x94D049BB133111EBull;
+    hash = (hash ^ record.m_type) * 0x9E3779B97F4A7C15ull;
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+template<typename Record>
+bool is_valid(const Record& record){
+    return (record.m_type == RECORD_INSERT || record.m_type == RECORD_REMOVE) && record.m_checksum == checksum(record);
+}
+
+// List the sequence numbers in the names of the files in the directory matching the given scanf format, in sorted order
+vector<uint64_t> list_files(const string& directory, const char* format){
+    vector<uint64_t> result;
+    DIR* dir = opendir(directory.c_str());
+    if(dir == nullptr) RAISE_ERRNO("Cannot open the directory `" << directory << "'");
+    while(struct dirent* entry = readdir(dir)){
+        uint64_t sequence = 0; int length = 0;
+        if(sscanf(entry->d_name, format, &sequence, &length) == 1 && entry->d_name[length] == '\0'){
+            result.push_back(sequence);
+        }
+    }
+    closedir(dir);
+    sort(begin(result), end(result));
+    return result;
+}
+
+void sync_file(const string& path){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) RAISE_ERRNO("Cannot open the file `" << path << "'");
+    int rc = fsync(fd);
+    close(fd);
+    if(rc != 0) RAISE_ERRNO("Cannot sync the file `" << path << "'");
+}
+
+void sync_directory(const string& directory){
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0) RAISE_ERRNO("Cannot open the directory `" << directory << "'");
+    int rc = fsync(fd);
+    close(fd);
+    if(rc != 0) RAISE_ERRNO("Cannot sync the directory `" << directory << "'");
+}
+
+} // anonymous namespace
+
+/*****************************************************************************
+ *                                                                           *
+ *   Initialisation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+WriteAheadLog::WriteAheadLog(unique_ptr<Interface> impl, const string& directory, chrono::microseconds fsync_interval, uint64_t segment_size, bool replay) :
+        m_impl(move(impl)), m_directory(directory), m_fsync_interval(fsync_interval),
+        m_segment_size(segment_size / sizeof(Record) * sizeof(Record)), m_buffer_capacity(1ull << 16) {
+    if(m_impl.get() == nullptr) throw invalid_argument("[WriteAheadLog] The implementation to wrap is null");
+    if(m_fsync_interval.count() < 0) throw invalid_argument("[WriteAheadLog] Negative fsync interval");
+    if(m_segment_size < 4096) throw invalid_argument("[WriteAheadLog] The segment size must be at least 4 KB");
+    if(mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST) RAISE_ERRNO("Cannot create the directory `" << m_directory << "'");
+
+    auto segments = list_segments();
+    if(replay){
+        m_lsn_durable = this->replay();
+        m_lsn_next = m_lsn_durable +1;
+        m_segment_id = segments.empty() ? 1 : segments.back() +1; // the old segments are still required until the next checkpoint
+    } else {
+        remove_segments(numeric_limits<uint64_t>::max());
+        remove_snapshots(numeric_limits<uint64_t>::max());
+        m_segment_id = 1;
+    }
+    m_segment_fd = create_segment(m_segment_id);
+    m_segment_offset = 0;
+    m_buffer.reserve(m_buffer_capacity);
+
+    writer_start();
+}
+
+WriteAheadLog::~WriteAheadLog(){
+    try {
+        writer_stop();
+    } catch(exception& e){
+        cerr << "[WriteAheadLog::dtor] " << e.what() << endl;
+    }
+    close_segments();
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Segments                                                                *
+ *                                                                           *
+ *****************************************************************************/
+string WriteAheadLog::get_segment_path(uint64_t segment_id) const {
+    char name[32];
+    snprintf(name, sizeof(name), "wal_%012" PRIu64 ".log", segment_id);
+    return m_directory + "/" + name;
+}
+
+string WriteAheadLog::get_snapshot_path(const string& directory, uint64_t lsn) {
+    char name[40];
+    snprintf(name, sizeof(name), "snapshot_%012" PRIu64 ".bin", lsn);
+    return directory + "/" + name;
+}
+
+vector<uint64_t> WriteAheadLog::list_segments() const {
+    return list_files(m_directory, "wal_%" SCNu64 ".log%n");
+}
+
+vector<uint64_t> WriteAheadLog::list_snapshots(const string& directory) {
+    return list_files(directory, "snapshot_%" SCNu64 ".bin%n");
+}
+
+int WriteAheadLog::create_segment(uint64_t segment_id){
+    COUT_DEBUG("segment_id: " << segment_id);
+    string path = get_segment_path(segment_id);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) RAISE_ERRNO("Cannot create the segment `" << path << "'");
+
+    // allocate all blocks in advance, so that the appends do not need to extend the file
+    int rc = posix_fallocate(fd, 0, m_segment_size);
+    if(rc != 0){
+        close(fd);
+        unlink(path.c_str());
+        errno = rc;
+        RAISE_ERRNO("Cannot pre-allocate the segment `" << path << "'");
+    }
+    if(fsync(fd) != 0){ int error = errno; close(fd); errno = error; RAISE_ERRNO("Cannot sync the segment `" << path << "'"); }
+    sync_directory(m_directory);
+
+    unique_lock<mutex> lock(m_mutex);
+    m_statistics.m_num_segments++;
+    return fd;
+}
+
+void WriteAheadLog::switch_segment(){
+    if(fdatasync(m_segment_fd) != 0) RAISE_ERRNO("Cannot sync the segment `" << get_segment_path(m_segment_id) << "'");
+    close(m_segment_fd);
+    m_segment_id++;
+    if(m_segment_next_fd >= 0){
+        m_segment_fd = m_segment_next_fd;
+        m_segment_next_fd = -1;
+    } else {
+        m_segment_fd = -1;
+        m_segment_fd = create_segment(m_segment_id);
+    }
+    m_segment_offset = 0;
+}
+
+void WriteAheadLog::close_segments(){
+    if(m_segment_fd >= 0){ close(m_segment_fd); m_segment_fd = -1; }
+    if(m_segment_next_fd >= 0){ close(m_segment_next_fd); m_segment_next_fd = -1; }
+}
+
+void WriteAheadLog::remove_segments(uint64_t segment_id){
+    for(auto id : list_segments()){
+        if(id >= segment_id) break;
+        string path = get_segment_path(id);
+        COUT_DEBUG("remove: " << path);
+        if(unlink(path.c_str()) != 0) RAISE_ERRNO("Cannot remove the segment `" << path << "'");
+    }
+    sync_directory(m_directory);
+}
+
+void WriteAheadLog::remove_snapshots(uint64_t lsn){
+    for(auto id : list_snapshots(m_directory)){
+        if(id >= lsn) break;
+        string path = get_snapshot_path(m_directory, id);
+        COUT_DEBUG("remove: " << path);
+        if(unlink(path.c_str()) != 0) RAISE_ERRNO("Cannot remove the snapshot `" << path << "'");
+    }
+    sync_directory(m_directory);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Log writer                                                              *
+ *                                                                           *
+ *****************************************************************************/
+void WriteAheadLog::write_records(const Record* records, size_t num_records){
+    while(num_records > 0){
+        if(m_segment_offset == m_segment_size){ switch_segment(); }
+
+        size_t length = min<size_t>(num_records * sizeof(Record), m_segment_size - m_segment_offset);
+        const char* buffer = reinterpret_cast<const char*>(records);
+        size_t written = 0;
+        while(written < length){
+            ssize_t rc = pwrite(m_segment_fd, buffer + written, length - written, m_segment_offset + written);
+            if(rc < 0){
+                if(errno == EINTR) continue;
+                RAISE_ERRNO("Cannot write the segment `" << get_segment_path(m_segment_id) << "'");
+            }
+            written += rc;
+        }
+
+        m_segment_offset += length;
+        records += length / sizeof(Record);
+        num_records -= length / sizeof(Record);
+    }
+
+    if(fdatasync(m_segment_fd) != 0) RAISE_ERRNO("Cannot sync the segment `" << get_segment_path(m_segment_id) << "'");
+}
+
+void WriteAheadLog::writer_main(){
+    COUT_DEBUG("start");
+    vector<Record> batch;
+    batch.reserve(m_buffer_capacity);
+
+    unique_lock<mutex> lock(m_mutex);
+    while(true){
+        auto predicate = [this](){ return m_terminate || m_buffer.size() >= m_buffer_capacity || m_lsn_requested > m_lsn_durable; };
+        if(m_fsync_interval.count() == 0){
+            m_condvar_writer.wait(lock, predicate);
+        } else {
+            m_condvar_writer.wait_for(lock, m_fsync_interval, predicate);
+        }
+
+        if(!m_buffer.empty()){ // group commit
+            batch.clear();
+            swap(batch, m_buffer);
+            uint64_t lsn = batch.back().m_lsn;
+            m_condvar_clients.notify_all(); // updates stalled on a full buffer
+            lock.unlock();
+
+            Timer timer(true);
+            try {
+                write_records(batch.data(), batch.size());
+            } catch(...){
+                lock.lock();
+                m_writer_error = current_exception();
+                m_condvar_clients.notify_all();
+                return;
+            }
+            timer.stop();
+
+            lock.lock();
+            m_lsn_durable = lsn;
+            m_statistics.m_num_bytes += batch.size() * sizeof(Record);
+            m_statistics.m_num_group_commits++;
+            m_statistics.m_time_flush_usecs += timer.microseconds<uint64_t>();
+            m_condvar_clients.notify_all();
+        } else if(m_terminate){
+            break;
+        }
+
+        // pre-allocate the next segment outside the critical path of the updates
+        if(m_segment_next_fd < 0 && m_buffer.empty() && !m_terminate){
+            lock.unlock();
+            try {
+                m_segment_next_fd = create_segment(m_segment_id +1);
+            } catch(...){
+                lock.lock();
+                m_writer_error = current_exception();
+                m_condvar_clients.notify_all();
+                return;
+            }
+            lock.lock();
+        }
+    }
+    COUT_DEBUG("terminate");
+}
+
+void WriteAheadLog::writer_start(){
+    unique_lock<mutex> lock(m_mutex);
+    m_terminate = false;
+    m_writer = thread(&WriteAheadLog::writer_main, this);
+}
+
+void WriteAheadLog::writer_stop(){
+    if(!m_writer.joinable()) return;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_terminate = true;
+        m_condvar_writer.notify_all();
+    }
+    m_writer.join();
+
+    unique_lock<mutex> lock(m_mutex);
+    if(m_writer_error) rethrow_exception(m_writer_error);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Updates                                                                 *
+ *                                                                           *
+ *****************************************************************************/
+uint64_t WriteAheadLog::append(uint32_t type, int64_t key, int64_t value){
+    unique_lock<mutex> lock(m_mutex);
+    if(m_writer_error) rethrow_exception(m_writer_error);
+
+    if(m_buffer.size() >= 2 * m_buffer_capacity){ // the log writer cannot keep up, wait for it to catch up
+        m_statistics.m_num_stalls++;
+        m_condvar_writer.notify_one();
+        m_condvar_clients.wait(lock, [this](){ return m_buffer.size() < 2 * m_buffer_capacity || m_writer_error; });
+        if(m_writer_error) rethrow_exception(m_writer_error);
+    }
+
+    Record record;
+    record.m_lsn = m_lsn_next++;
+    record.m_key = key;
+    record.m_value = value;
+    record.m_type = type;
+    record.m_checksum = checksum(record);
+    m_buffer.push_back(record);
+    m_statistics.m_num_records++;
+
+    if(m_buffer.size() == m_buffer_capacity){ m_condvar_writer.notify_one(); }
+
+    return record.m_lsn;
+}
+
+void WriteAheadLog::wait_durable(uint64_t lsn){
+    unique_lock<mutex> lock(m_mutex);
+    if(m_lsn_durable >= lsn) return;
+    if(m_writer_error) rethrow_exception(m_writer_error);
+    m_lsn_requested = max(m_lsn_requested, lsn);
+    m_condvar_writer.notify_one();
+    m_condvar_clients.wait(lock, [this, lsn](){ return m_lsn_durable >= lsn || m_writer_error; });
+    if(m_lsn_durable < lsn) rethrow_exception(m_writer_error);
+}
+
+void WriteAheadLog::insert(int64_t key, int64_t value){
+    uint64_t lsn = append(RECORD_INSERT, key, value);
+    m_impl->insert(key, value);
+    if(m_fsync_interval.count() == 0) wait_durable(lsn);
+}
+
+int64_t WriteAheadLog::remove(int64_t key){
+    uint64_t lsn = append(RECORD_REMOVE, key, 0);
+    int64_t value = m_impl->remove(key);
+    if(m_fsync_interval.count() == 0) wait_durable(lsn);
+    return value;
+}
+
+void WriteAheadLog::load(pair<int64_t, int64_t>* array, size_t array_sz){
+    if(array_sz == 0) return;
+    uint64_t lsn = 0;
+    for(size_t i = 0; i < array_sz; i++){ lsn = append(RECORD_INSERT, array[i].first, array[i].second); }
+
+    if(auto bulk_loading = dynamic_cast<BulkLoading*>(m_impl.get()); bulk_loading != nullptr){
+        bulk_loading->set_load_threads(get_load_threads());
+        bulk_loading->load(array, array_sz);
+    } else {
+        for(size_t i = 0; i < array_sz; i++){ m_impl->insert(array[i].first, array[i].second); }
+    }
+
+    if(m_fsync_interval.count() == 0) wait_durable(lsn);
+}
+
+void WriteAheadLog::flush(){
+    uint64_t lsn = 0;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        lsn = m_lsn_next -1;
+    }
+    wait_durable(lsn);
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Checkpoints                                                             *
+ *                                                                           *
+ *****************************************************************************/
+uint64_t WriteAheadLog::read_checkpoint() const {
+    auto snapshots = list_snapshots(m_directory);
+    return snapshots.empty() ? 0 : snapshots.back();
+}
+
+string WriteAheadLog::get_checkpoint_snapshot(const string& directory){
+    struct stat info;
+    if(stat(directory.c_str(), &info) != 0 && errno == ENOENT) return ""; // the log does not exist yet
+    auto snapshots = list_snapshots(directory);
+    if(snapshots.empty()) return "";
+    return get_snapshot_path(directory, snapshots.back());
+}
+
+void WriteAheadLog::checkpoint(const function<void(Interface&, const string&)>& save_snapshot){
+    flush();
+    writer_stop(); // the segments can only be altered by the log writer
+    uint64_t lsn = m_lsn_next -1;
+    string path = get_snapshot_path(m_directory, lsn);
+    string path_tmp = path + ".tmp";
+    COUT_DEBUG("lsn: " << lsn << ", snapshot: " << path);
+
+    try {
+        save_snapshot(*m_impl, path_tmp);
+        sync_file(path_tmp);
+    } catch(...){
+        unlink(path_tmp.c_str());
+        writer_start();
+        throw;
+    }
+
+    // the snapshot and the LSN it includes become visible together. If the process crashes before the rename, the
+    // previous snapshot and the whole log are still present, otherwise the replay skips the updates up to `lsn'
+    if(rename(path_tmp.c_str(), path.c_str()) != 0){
+        int error = errno;
+        unlink(path_tmp.c_str());
+        writer_start();
+        errno = error;
+        RAISE_ERRNO("Cannot rename the snapshot `" << path_tmp << "' into `" << path << "'");
+    }
+    sync_directory(m_directory);
+
+    switch_segment(); // start a new segment, all older segments are covered by the checkpoint
+    remove_segments(m_segment_id);
+    remove_snapshots(lsn);
+    writer_start();
+}
+
+uint64_t WriteAheadLog::replay(){
+    const uint64_t lsn_checkpoint = read_checkpoint();
+    uint64_t lsn_last = lsn_checkpoint; // the last record replayed
+    uint64_t lsn_expected = 0; // the LSN of the next record, 0 if not known yet
+    m_replayed_updates = 0;
+    unique_ptr<Record[]> records { new Record[REPLAY_BATCH] };
+
+    for(auto segment_id : list_segments()){
+        string path = get_segment_path(segment_id);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) RAISE_ERRNO("Cannot open the segment `" << path << "'");
+        unique_ptr<int, void(*)(int*)> close_fd { &fd, [](int* fd){ close(*fd); } };
+
+        bool end_of_segment = false;
+        uint64_t offset = 0;
+        while(!end_of_segment){
+            ssize_t rc = pread(fd, records.get(), REPLAY_BATCH * sizeof(Record), offset);
+            if(rc < 0){
+                if(errno == EINTR) continue;
+                RAISE_ERRNO("Cannot read the segment `" << path << "'");
+            }
+            size_t num_records = rc / sizeof(Record);
+            if(num_records == 0) break;
+            offset += num_records * sizeof(Record);
+
+            for(size_t i = 0; i < num_records && !end_of_segment; i++){
+                const Record& record = records[i];
+                if(!is_valid(record)){ // either the pre-allocated space or a torn write
+                    end_of_segment = true;
+                } else if(lsn_expected == 0 && record.m_lsn > lsn_checkpoint +1){
+                    RAISE("The log in `" << m_directory << "' is incomplete: the first record available has LSN " << record.m_lsn << ", but the checkpoint is at LSN " << lsn_checkpoint);
+                } else if(lsn_expected != 0 && record.m_lsn != lsn_expected){ // this segment does not continue the previous one
+                    COUT_DEBUG("gap in the log, segment: " << path << ", lsn: " << record.m_lsn << ", expected: " << lsn_expected);
+                    return lsn_last;
+                } else {
+                    lsn_expected = record.m_lsn +1;
+                    if(record.m_lsn > lsn_checkpoint){
+                        if(record.m_type == RECORD_INSERT){
+                            m_impl->insert(record.m_key, record.m_value);
+                        } else {
+                            m_impl->remove(record.m_key);
+                        }
+                        m_replayed_updates++;
+                        lsn_last = record.m_lsn;
+                    }
+                }
+            }
+        }
+    }
+
+    COUT_DEBUG("replayed updates: " << m_replayed_updates << ", last lsn: " << lsn_last);
+    return lsn_last;
+}
+
+uint64_t WriteAheadLog::get_replayed_updates() const noexcept {
+    return m_replayed_updates;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Delegation                                                              *
+ *                                                                           *
+ *****************************************************************************/
+void WriteAheadLog::build(){
+    m_impl->build();
+}
+
+int64_t WriteAheadLog::find(int64_t key) const {
+    return m_impl->find(key);
+}
+
+void WriteAheadLog::find_batch(const int64_t* keys, int64_t* out_values, size_t num_keys) const {
+    m_impl->find_batch(keys, out_values, num_keys);
+}
+
+Interface::SumResult WriteAheadLog::sum(int64_t min, int64_t max) const {
+    return m_impl->sum(min, max);
+}
+
+void WriteAheadLog::scan(int64_t min, int64_t max, ScanVisitor& visitor) const {
+    m_impl->scan(min, max, visitor);
+}
+
+unique_ptr<Iterator> WriteAheadLog::iterator() const {
+    return m_impl->iterator();
+}
+
+size_t WriteAheadLog::size() const {
+    return m_impl->size();
+}
+
+size_t WriteAheadLog::memory_footprint() const {
+    return m_impl->memory_footprint();
+}
+
+void WriteAheadLog::dump() const {
+    m_impl->dump();
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Observers                                                               *
+ *                                                                           *
+ *****************************************************************************/
+Interface* WriteAheadLog::get_implementation() const noexcept {
+    return m_impl.get();
+}
+
+WriteAheadLog::Statistics WriteAheadLog::get_statistics() const {
+    unique_lock<mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+ostream& operator<<(ostream& out, const WriteAheadLog::Statistics& stats){
+    out << "records: " << stats.m_num_records << ", bytes written: " << stats.m_num_bytes << ", group commits: " << stats.m_num_group_commits <<
+            ", segments: " << stats.m_num_segments << ", stalls: " << stats.m_num_stalls << ", log writer time: " << stats.m_time_flush_usecs << " us";
+    return out;
+}
+
+} // namespace pma
@@ -0,0 +1,248 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PMA_WAL_HPP_
+#define PMA_WAL_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cinttypes>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bulk_loading.hpp"
+#include "errorhandling.hpp"
+#include "interface.hpp"
+
+namespace pma {
+
+DEFINE_EXCEPTION(WriteAheadLogError);
+
+/**
+ * Make the updates of any implementation of the Interface durable. The operations #insert and #remove are first
+ * appended to an in-memory buffer and then applied to the wrapped implementation. A dedicated log writer
+ * thread periodically (every `fsync_interval') writes the buffered records into the log on disk and flushes it with
+ * a single fdatasync, grouping all operations that occurred in the interval (group commit). Hence the updates are
+ * durable with a delay of at most `fsync_interval', unless the interval is zero, in which case each update waits
+ * for its record to reach the disk before returning.
+ *
+ * The log is a sequence of files (segments) of a fixed size inside a directory, named wal_<sequence>.log. The
+ * writer always pre-allocates the next segment in advance, so that switching segments does not need to
+ * allocate new blocks in the file system. Each record has a fixed size and carries its log sequence number
+ * (LSN) and a checksum, the log ends at the first record that is not valid.
+ *
+ * On startup, the wrapped implementation can be restored from the latest snapshot and the log then replayed on top
+ * of it (#replay). The method #checkpoint saves a new snapshot and discards the segments it includes. The snapshots
+ * are stored in the same directory, named snapshot_<lsn>.bin after the LSN of the last update they include. A
+ * snapshot is written under a temporary name and then renamed, hence the snapshot and its LSN become visible together.
+ *
+ * The batches loaded with #load are logged as a sequence of insertions and forwarded to the wrapped implementation,
+ * as a bulk load if the implementation supports it.
+ */
+class WriteAheadLog : public Interface, public BulkLoading {
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+public:
+    /**
+     * Statistics on the activity of the log
+     */
+    struct Statistics {
+        uint64_t m_num_records = 0; // total number of records appended
+        uint64_t m_num_bytes = 0; // total number of bytes written to the log
+        uint64_t m_num_group_commits = 0; // number of flushes to disk (fdatasync)
+        uint64_t m_num_segments = 0; // number of segments created
+        uint64_t m_num_stalls = 0; // number of times an update waited for the log writer, as the buffer was full
+        uint64_t m_time_flush_usecs = 0; // total time spent by the log writer to write and sync the records, in microsecs
+    };
+
+private:
+    struct Record { // the format of a record on disk
+        uint64_t m_lsn; // log sequence number
+        int64_t m_key; // the key of the element inserted or removed
+        int64_t m_value; // the value of the element inserted, unused for the removals
+        uint32_t m_type; // either insert or remove, zero for the unwritten space of a segment
+        uint32_t m_checksum; // detect torn writes
+    };
+
+    std::unique_ptr<Interface> m_impl; // the wrapped implementation
+    const std::string m_directory; // where to store the segments of the log
+    const std::chrono::microseconds m_fsync_interval; // the max delay between an update and its record being durable
+    const uint64_t m_segment_size; // the capacity of a segment, in bytes
+    const uint64_t m_buffer_capacity; // the number of records that wakes up the log writer before the end of the interval
+
+    mutable std::mutex m_mutex; // protect the fields below
+    std::condition_variable m_condvar_writer; // to wake up the log writer
+    std::condition_variable m_condvar_clients; // to wake up the updates waiting for the log writer
+    std::vector<Record> m_buffer; // records appended but not written yet
+    uint64_t m_lsn_next = 1; // the LSN to assign to the next record
+    uint64_t m_lsn_durable = 0; // all records up to this LSN have been written and synced to disk
+    uint64_t m_lsn_requested = 0; // an update is waiting for the records up to this LSN to be durable
+    bool m_terminate = false; // request the log writer to stop
+    std::exception_ptr m_writer_error; // the last error raised by the log writer
+    Statistics m_statistics; // the counters updated by the log writer
+    uint64_t m_replayed_updates = 0; // number of updates applied by the last replay
+
+    // Segments, only accessed by the log writer or when the log writer is stopped
+    uint64_t m_segment_id = 0; // the sequence number of the current segment
+    int m_segment_fd = -1; // the file descriptor of the current segment
+    uint64_t m_segment_offset = 0; // the offset, in bytes, where to write the next record in the current segment
+    int m_segment_next_fd = -1; // the pre-allocated next segment, if any
+
+    std::thread m_writer; // the log writer thread
+
+    // The path of the segment with the given sequence number
+    std::string get_segment_path(uint64_t segment_id) const;
+
+    // The path of the snapshot including the updates up to the given LSN
+    static std::string get_snapshot_path(const std::string& directory, uint64_t lsn);
+
+    // List the sequence numbers of the segments in the directory, in sorted order
+    std::vector<uint64_t> list_segments() const;
+
+    // List the LSNs of the snapshots in the given directory, in sorted order
+    static std::vector<uint64_t> list_snapshots(const std::string& directory);
+
+    // Create & pre-allocate the segment with the given sequence number
+    int create_segment(uint64_t segment_id);
+
+    // Move to the segment m_segment_id +1, either the one already pre-allocated or a new one
+    void switch_segment();
+
+    // Close the current & the pre-allocated segment
+    void close_segments();
+
+    // Write the given records into the log and sync them to disk
+    void write_records(const Record* records, size_t num_records);
+
+    // Main loop of the log writer
+    void writer_main();
+
+    // Start/stop the log writer
+    void writer_start();
+    void writer_stop();
+
+    // Append a new record to the buffer, return its LSN
+    uint64_t append(uint32_t type, int64_t key, int64_t value);
+
+    // Wait for the given LSN to be durable, rethrow the errors from the log writer
+    void wait_durable(uint64_t lsn);
+
+    // Read the LSN of the last checkpoint, or 0 if there is none
+    uint64_t read_checkpoint() const;
+
+    // Apply the log in the directory to the wrapped implementation, return the LSN of the last record applied
+    uint64_t replay();
+
+    // Remove all segments with a sequence number lower than `segment_id'
+    void remove_segments(uint64_t segment_id);
+
+    // Remove all snapshots with an LSN lower than `lsn'
+    void remove_snapshots(uint64_t lsn);
+
+public:
+    /**
+     * Wrap the given implementation. The segments are stored in `directory', which is created if it does not exist.
+     * If `replay' is set, the log already present in the directory is first applied to the implementation, otherwise
+     * any existing log and snapshot in the directory are discarded.
+     * @param impl the implementation to wrap, either empty or restored from the snapshot of the last checkpoint,
+     *        as given by #get_checkpoint_snapshot
+     * @param directory where to store the log
+     * @param fsync_interval the max delay between an update and its record being synced to disk. If zero, each update
+     *        is synced before returning.
+     * @param segment_size the size of each segment of the log, in bytes
+     * @param replay whether to replay the log already present in the directory
+     */
+    WriteAheadLog(std::unique_ptr<Interface> impl, const std::string& directory, std::chrono::microseconds fsync_interval,
+            uint64_t segment_size = (64ull << 20), bool replay = true);
+
+    /**
+     * Flush the log and stop the log writer
+     */
+    virtual ~WriteAheadLog();
+
+    /**
+     * Insert the given <key, value> in the container
+     */
+    virtual void insert(int64_t key, int64_t value) override;
+
+    /**
+     * Remove the element with the given `key', return its value or -1 if not found
+     */
+    virtual int64_t remove(int64_t key) override;
+
+    /**
+     * Log the given elements as insertions and load them in the wrapped implementation
+     */
+    virtual void load(std::pair<int64_t, int64_t>* array, size_t array_sz) override;
+
+    /**
+     * Wait for all updates performed so far to be durable
+     */
+    void flush();
+
+    /**
+     * Save a new snapshot of the wrapped implementation and discard the segments of the log whose updates are included
+     * in the snapshot. The function `save_snapshot' must write the snapshot into the given path. The updates cannot be
+     * executed concurrently to the checkpoint.
+     */
+    void checkpoint(const std::function<void(Interface&, const std::string& path)>& save_snapshot);
+
+    /**
+     * Retrieve the path of the snapshot of the last checkpoint in the given directory, or an empty string if there is
+     * none. The snapshot must be restored in the implementation to wrap before replaying the log.
+     */
+    static std::string get_checkpoint_snapshot(const std::string& directory);
+
+    /**
+     * Retrieve the number of updates applied by the last replay
+     */
+    uint64_t get_replayed_updates() const noexcept;
+
+    /**
+     * Retrieve the statistics on the activity of the log
+     */
+    Statistics get_statistics() const;
+
+    /**
+     * Retrieve the wrapped implementation
+     */
+    Interface* get_implementation() const noexcept;
+
+    // Delegated to the wrapped implementation
+    virtual void build() override;
+    virtual int64_t find(int64_t key) const override;
+    virtual void find_batch(const int64_t* keys, int64_t* out_values, std::size_t num_keys) const override;
+    virtual SumResult sum(int64_t min, int64_t max) const override;
+    virtual void scan(int64_t min, int64_t max, ScanVisitor& visitor) const override;
+    virtual std::unique_ptr<Iterator> iterator() const override;
+    virtual std::size_t size() const override;
+    virtual std::size_t memory_footprint() const override;
+    virtual void dump() const override;
+};
+
+std::ostream& operator<<(std::ostream& out, const WriteAheadLog::Statistics& stats);
+
+} // namespace pma
+
+#endif /* PMA_WAL_HPP_ */
@@ -17,15 +17,23 @@
 
 #include "rewired_memory.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h> // fallocate
 #include <iostream>
+#include <linux/falloc.h>
 #include <linux/memfd.h>
+#if defined(HAVE_LIBNUMA)
+#include <numa.h>
+#include <numaif.h> // mbind
+#endif
 #include <string>
 #include <sys/mman.h> // mmap
 #include <unistd.h>
 #include "configuration.hpp"
+#include "cpu_topology.hpp"
 #include "errorhandling.hpp"
 #include "miscellaneous.hpp"
 
@@ -53,19 +61,53 @@ using namespace std;
  *****************************************************************************/
 static int g_internal_id = 0;
 
+// The NUMA nodes available in the platform, empty if NUMA is not supported
+static const vector<int>& numa_nodes(){
+    static vector<int> nodes = []{
+        vector<int> result;
+#if defined(HAVE_LIBNUMA)
+        if(numa_available() != -1){ cpu_topology().get_nodes(result); }
+#endif
+        sort(begin(result), end(result));
+        return result;
+    }();
+    return nodes;
+}
+
+static RewiredMemory::NumaPolicy parse_numa_policy(const string& policy){
+    if(policy == "none"){
+        return RewiredMemory::NumaPolicy::NONE;
+#if !defined(HAVE_LIBNUMA)
+    } else if(policy == "interleaved" || policy == "local" || policy == "partitioned"){
+        RAISE("Invalid NUMA policy: `" << policy << "', the program has been compiled without libnuma support");
+#else
+    } else if(policy == "interleaved"){
+        return RewiredMemory::NumaPolicy::INTERLEAVED;
+    } else if(policy == "local"){
+        return RewiredMemory::NumaPolicy::LOCAL;
+    } else if(policy == "partitioned"){
+        return RewiredMemory::NumaPolicy::PARTITIONED;
+#endif
+    } else {
+        RAISE("Invalid NUMA policy: `" << policy << "'");
+    }
+}
+
 RewiredMemory::RewiredMemory(size_t pages_per_extent, size_t num_extents, size_t max_memory) :
         m_page_size(get_memory_page_size()), m_num_pages_per_extent(pages_per_extent), m_start_address(nullptr),
-        m_handle_physical_memory(-1), m_max_memory(max_memory){
+        m_handle_physical_memory(-1), m_max_memory(max_memory), m_numa_policy(parse_numa_policy(configuration::rewired_memory_numa_policy())),
+        m_numa_nodes(numa_nodes()), m_numa_partition_extents(0), m_transparent_huge_pages(configuration::use_transparent_huge_pages()),
+        m_prefault(configuration::use_prefaulting()), m_prefault_cancel(false) {
     // validate the user parameters
     if(pages_per_extent <= 0){ throw invalid_argument("[RewiredMemory::ctor] pages_per_extent <= 0"); }
     if(num_extents <= 0){ throw invalid_argument("[RewiredMemory::ctor] num_extents <= 0"); }
+    if(max_memory <= 0){ throw invalid_argument("[RewiredMemory::ctor] max_memory <= 0"); }
     int rc = 0;
 
-    // check whether we are allowed to allocate the amount of memory requested
+    // reserve enough virtual memory for the amount of memory requested
     size_t size_physical_memory = get_extent_size() * num_extents;
-    if(size_physical_memory > get_max_memory()){
-        RAISE("Cannot allocate " << (size_physical_memory) << " bytes. The maximum amount of reserved virtual memory specified for this instance is: " << get_max_memory() << " bytes.");
-    }
+    while(m_max_memory < size_physical_memory){ m_max_memory *= 2; }
+    m_max_memory = ((m_max_memory + m_page_size -1) / m_page_size) * m_page_size; // multiple of the page size
 
     // create the handle to the physical memory
     string id = "rewired_memory_";
@@ -88,6 +130,7 @@ RewiredMemory::RewiredMemory(size_t pages_per_extent, size_t num_extents, size_t
         /* offset, in terms of multiples of the page size */ 0);
     if(mmap_ret == MAP_FAILED){ RAISE("Cannot allocate the virtual memory: " << get_max_memory() << " bytes. mmap error: " << strerror(errno) << "(" << errno << ")"); }
     m_start_address = mmap_ret;
+    advise_huge_pages(m_start_address, get_max_memory());
     /**
      * In case the user attempts to access mapped memory not backed by the physical memory (as m_allocated_extents < m_reserved_extents)
      * the kernel will throw a SIGBUS interruption
@@ -98,10 +141,15 @@ RewiredMemory::RewiredMemory(size_t pages_per_extent, size_t num_extents, size_t
     for(size_t i = 0; i < num_extents; i++){
         m_translation_map.push_back(i);
     }
+
+    apply_numa_policy(0, num_extents);
+    prefault_start();
 }
 
 
 RewiredMemory::~RewiredMemory(){
+    prefault_stop();
+
     // release the managed virtual memory
     if(m_start_address != nullptr){
         int rc = munmap(m_start_address, get_max_memory());
@@ -153,44 +201,89 @@ void RewiredMemory::swap(void* addr1, void* addr2){
     size_t ppage2 = m_translation_map[trmap_off2];
     COUT_DEBUG("vpage1: " << addr1 << ", ppage1: " << ppage1 << ", vpage2: " << addr2 << ", ppage2: " << ppage2);
 
-    void* mmap_ret = nullptr;
+    // set ppage2 to vpage1 and ppage1 to vpage2
+    remap(vpage1, ppage2, 1);
+    remap(vpage2, ppage1, 1);
 
-    // set ppage2 to vpage1
-    mmap_ret = mmap(
-            /* destination (virtual address) */ vpage1, get_extent_size(),
-            PROT_READ | PROT_WRITE,
-            MAP_SHARED | MAP_FIXED,
-            /* source (physical location) */ m_handle_physical_memory, ppage2 * get_extent_size()
-    );
-    if(mmap_ret == MAP_FAILED){
-        cerr << "[RewiredMemory::swap] first rewiring failed, start_address: " << (void*) get_start_address() << ", extent size: " << get_extent_size() << ", allocated space: " << get_allocated_memory_size() << " bytes" << endl;
-        RAISE("first rewiring failed: " << (void*) vpage1 << ", " << strerror(errno) << " (" << errno << ")");
+    m_translation_map[trmap_off1] = ppage2;
+    m_translation_map[trmap_off2] = ppage1;
+
+    // migrate the physical extents swapped across two partitions
+    if(m_numa_policy == NumaPolicy::PARTITIONED && get_numa_node(trmap_off1) != get_numa_node(trmap_off2)){
+        apply_numa_policy(trmap_off1, 1);
+        apply_numa_policy(trmap_off2, 1);
     }
-    // set ppage 1 to vpage2
-    mmap_ret = mmap(
-            /* destination (virtual address) */ vpage2, get_extent_size(),
+}
+
+void RewiredMemory::swap(const std::vector<std::pair<void*, void*>>& extents){
+    COUT_DEBUG("num pairs: " << extents.size());
+    char* start_address = (char*) get_start_address();
+
+    // the new physical extent for each virtual extent involved, as pairs <virtual extent, physical extent>
+    vector<pair<size_t, size_t>> mappings;
+    mappings.reserve(extents.size() * 2);
+    for(auto& e : extents){
+        validate_address(e.first);
+        validate_address(e.second);
+        if(e.first == e.second){ RAISE("The arguments addr1 and addr2 are the same: " << e.first); }
+        size_t trmap_off1 = ((char*) e.first - start_address) / get_extent_size();
+        size_t trmap_off2 = ((char*) e.second - start_address) / get_extent_size();
+        mappings.emplace_back(trmap_off1, m_translation_map[trmap_off2]);
+        mappings.emplace_back(trmap_off2, m_translation_map[trmap_off1]);
+    }
+    sort(begin(mappings), end(mappings));
+    for(size_t i = 1; i < mappings.size(); i++){
+        if(mappings[i].first == mappings[i-1].first){ RAISE("The extent " << (void*) (start_address + mappings[i].first * get_extent_size()) << " appears more than once"); }
+    }
+
+    // coalesce the runs of consecutive extents, both in virtual and physical memory
+    size_t i = 0;
+    while(i < mappings.size()){
+        size_t j = i +1;
+        while(j < mappings.size() && mappings[j].first == mappings[j-1].first +1 && mappings[j].second == mappings[j-1].second +1) j++;
+        COUT_DEBUG("remap virtual extents [" << mappings[i].first << ", " << mappings[j-1].first << "] to physical [" << mappings[i].second << ", " << mappings[j-1].second << "]");
+        remap(start_address + mappings[i].first * get_extent_size(), mappings[i].second, j - i);
+        i = j;
+    }
+
+    // update the translation map
+    for(auto& m : mappings){ m_translation_map[m.first] = m.second; }
+
+    // migrate the physical extents swapped across two partitions
+    if(m_numa_policy == NumaPolicy::PARTITIONED){
+        for(auto& e : extents){
+            size_t trmap_off1 = ((char*) e.first - start_address) / get_extent_size();
+            size_t trmap_off2 = ((char*) e.second - start_address) / get_extent_size();
+            if(get_numa_node(trmap_off1) != get_numa_node(trmap_off2)){
+                apply_numa_policy(trmap_off1, 1);
+                apply_numa_policy(trmap_off2, 1);
+            }
+        }
+    }
+}
+
+void RewiredMemory::remap(char* address, size_t physical_extent, size_t num_extents){
+    void* mmap_ret = mmap(
+            /* destination (virtual address) */ address, num_extents * get_extent_size(),
             PROT_READ | PROT_WRITE,
             MAP_SHARED | MAP_FIXED,
-            /* source (physical location) */ m_handle_physical_memory, ppage1 * get_extent_size()
+            /* source (physical location) */ m_handle_physical_memory, physical_extent * get_extent_size()
     );
     if(mmap_ret == MAP_FAILED){
-        cerr << "[RewiredMemory::swap] second rewiring failed, start_address: " << (void*) get_start_address() <<", extent size: " << get_extent_size() << ", allocated space: " << get_allocated_memory_size() << " bytes" << endl;
-        RAISE("second rewiring failed: " << (void*) vpage2 << ", " << strerror(errno) << " (" << errno << ")");
+        cerr << "[RewiredMemory::remap] rewiring failed, start_address: " << (void*) get_start_address() << ", extent size: " << get_extent_size() << ", allocated space: " << get_allocated_memory_size() << " bytes" << endl;
+        RAISE("rewiring failed: " << (void*) address << ", num extents: " << num_extents << ", " << strerror(errno) << " (" << errno << ")");
     }
-
-    m_translation_map[trmap_off1] = ppage2;
-    m_translation_map[trmap_off2] = ppage1;
+    advise_huge_pages(address, num_extents * get_extent_size()); // the new mapping does not inherit the advice
 }
 
-
 void RewiredMemory::extend(size_t num_extents){
     if(num_extents == 0) return;
     size_t memory_in_bytes = get_allocated_memory_size() +  num_extents * get_extent_size();
-    if(memory_in_bytes > get_max_memory()){
-       RAISE("Already reached the limit for the maximum size that can be allocated: " << get_max_memory() << " bytes. "
-               "Allocated size: " << get_allocated_memory_size() << " bytes, requested size: " << memory_in_bytes);
+    if(memory_in_bytes > get_max_memory()){ // grow the reservation geometrically
+       reserve(max(memory_in_bytes, get_max_memory() * 2));
     }
 
+    prefault_stop();
     int rc = ftruncate(m_handle_physical_memory, memory_in_bytes);
     if(rc != 0){ RAISE("Cannot allocate the physical memory: " << memory_in_bytes << " bytes. ftruncate error: " << strerror(errno) << "(" << errno << ")"); }
 
@@ -199,6 +292,244 @@ void RewiredMemory::extend(size_t num_extents){
     for(size_t i = 0; i < num_extents; i++){
         m_translation_map.push_back(start_fd +i);
     }
+
+    if(m_numa_policy == NumaPolicy::PARTITIONED && m_numa_partition_extents == 0){ // the boundaries of the partitions have moved
+        apply_numa_policy(0, get_allocated_extents());
+    } else {
+        apply_numa_policy(start_fd, num_extents);
+    }
+
+    if(m_prefault){
+#if defined(MADV_POPULATE_WRITE)
+        // populate the page tables of the new extents, their physical memory has likely been allocated ahead by the background thread
+        madvise((char*) get_start_address() + start_fd * get_extent_size(), num_extents * get_extent_size(), MADV_POPULATE_WRITE); // best effort
+#endif
+        prefault_start();
+    }
+}
+
+void RewiredMemory::shrink(size_t num_extents){
+    if(num_extents == 0) return;
+    if(num_extents >= get_allocated_extents()){ RAISE("Cannot release " << num_extents << " extents, allocated extents: " << get_allocated_extents()); }
+    const size_t extent_size = get_extent_size();
+    const size_t num_extents_before = get_allocated_extents();
+    const size_t num_extents_after = num_extents_before - num_extents;
+    char* start_address = (char*) get_start_address();
+    COUT_DEBUG("extents: " << num_extents_before << " -> " << num_extents_after);
+
+    // the virtual extents being released whose physical extents are retained
+    vector<size_t> free_extents;
+    for(size_t i = num_extents_after; i < num_extents_before; i++){
+        if(m_translation_map[i] < num_extents_after){ free_extents.push_back(i); }
+    }
+
+    // compact the physical memory, move the retained virtual extents mapped beyond the new size into the free physical extents
+    size_t j = 0;
+    for(size_t i = 0; i < num_extents_after; i++){
+        if(m_translation_map[i] < num_extents_after) continue;
+        assert(j < free_extents.size() && "The number of free physical extents must match the number of extents to move");
+        size_t source = free_extents[j++];
+        memcpy(start_address + source * extent_size, start_address + i * extent_size, extent_size);
+        remap(start_address + i * extent_size, m_translation_map[source], 1);
+        m_translation_map[i] = m_translation_map[source];
+    }
+
+    // restore the identity mapping for the released virtual extents, as expected by #extend
+    remap(start_address + num_extents_after * extent_size, num_extents_after, num_extents);
+    m_translation_map.resize(num_extents_after);
+
+    // release the physical memory, including the memory allocated ahead by the background thread
+    prefault_stop();
+    int rc = ftruncate(m_handle_physical_memory, num_extents_after * extent_size);
+    if(rc != 0){ RAISE("Cannot release the physical memory. ftruncate error: " << strerror(errno) << "(" << errno << ")"); }
+
+    if(m_numa_policy == NumaPolicy::PARTITIONED){ // the compaction and the boundaries of the partitions may have moved the extents
+        apply_numa_policy(0, get_allocated_extents());
+    }
+
+    if(m_prefault){ // allocate ahead the memory for the next extension, relative to the new size
+        prefault_start();
+    }
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Reservation                                                             *
+ *                                                                           *
+ *****************************************************************************/
+void RewiredMemory::reserve(size_t max_memory){
+    max_memory = ((max_memory + m_page_size -1) / m_page_size) * m_page_size; // multiple of the page size
+    if(max_memory <= get_max_memory()) return;
+    COUT_DEBUG("current reservation: " << get_max_memory() << " bytes, new reservation: " << max_memory << " bytes");
+
+    // first attempt, extend the current region in place
+    char* hint = (char*) get_start_address() + get_max_memory();
+    int flags = MAP_SHARED;
+#if defined(MAP_FIXED_NOREPLACE)
+    flags |= MAP_FIXED_NOREPLACE; // do not clobber the existing mappings
+#endif
+    // the new virtual extents are mapped to the physical extents with the same offset, as #extend assumes
+    void* mmap_ret = mmap(hint, max_memory - get_max_memory(), PROT_READ | PROT_WRITE, flags, m_handle_physical_memory, get_max_memory());
+    if(mmap_ret == hint){
+        COUT_DEBUG("extended in place");
+        advise_huge_pages(hint, max_memory - get_max_memory());
+        m_max_memory = max_memory;
+    } else {
+        if(mmap_ret != MAP_FAILED){ munmap(mmap_ret, max_memory - get_max_memory()); } // the kernel ignored the hint
+        relocate(max_memory);
+    }
+}
+
+void RewiredMemory::relocate(size_t max_memory){
+    assert(max_memory >= get_allocated_memory_size());
+
+    // reserve the new region, initially with the identity mapping between virtual and physical extents
+    void* mmap_ret = mmap(NULL, max_memory, PROT_READ | PROT_WRITE, MAP_SHARED, m_handle_physical_memory, 0);
+    if(mmap_ret == MAP_FAILED){ RAISE("Cannot reserve the virtual memory: " << max_memory << " bytes. mmap error: " << strerror(errno) << "(" << errno << ")"); }
+    char* new_start_address = (char*) mmap_ret;
+    advise_huge_pages(new_start_address, max_memory);
+    COUT_DEBUG("relocate from " << get_start_address() << " to " << (void*) new_start_address << ", reservation: " << max_memory << " bytes");
+
+    // replay the rewirings, coalescing the runs of consecutive extents
+    try {
+        size_t i = 0, num_extents = m_translation_map.size();
+        while(i < num_extents){
+            if(m_translation_map[i] == i){ i++; continue; }
+            size_t j = i +1;
+            while(j < num_extents && m_translation_map[j] != j && m_translation_map[j] == m_translation_map[j-1] +1) j++;
+            remap(new_start_address + i * get_extent_size(), m_translation_map[i], j - i);
+            i = j;
+        }
+    } catch(...){
+        munmap(new_start_address, max_memory);
+        throw;
+    }
+
+    // release the old region
+    int rc = munmap(m_start_address, get_max_memory());
+    if(rc < 0){
+        cerr << "[RewiredMemory::relocate] Error in releasing the virtual memory, munmap error: " << strerror(errno) << " (" << errno << ")" << endl;
+    }
+    m_start_address = new_start_address;
+    m_max_memory = max_memory;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Huge pages & prefaulting                                                *
+ *                                                                           *
+ *****************************************************************************/
+void RewiredMemory::advise_huge_pages(void* address, size_t length){
+    if(!m_transparent_huge_pages) return;
+    int rc = madvise(address, length, MADV_HUGEPAGE);
+    if(rc != 0){ RAISE("Cannot request transparent huge pages, madvise error: " << strerror(errno) << " (" << errno << ")"); }
+}
+
+void RewiredMemory::set_prefault(bool value){
+    m_prefault = value;
+    if(m_prefault){
+        prefault_start();
+    } else {
+        prefault_stop();
+    }
+}
+
+void RewiredMemory::prefault_start(){
+    if(!m_prefault) return;
+    prefault_stop();
+
+    const size_t offset = get_allocated_memory_size();
+    const size_t length = offset; // the next extension will likely double the allocated memory
+    const size_t chunk_size = max<size_t>(get_extent_size(), 1ull << 21); // check for cancellation every 2 MB at least
+    const int fd = m_handle_physical_memory;
+    m_prefault_cancel = false;
+    m_prefault_thread = thread([this, fd, offset, length, chunk_size](){
+        for(size_t i = 0; i < length && !m_prefault_cancel.load(memory_order_relaxed); i += chunk_size){
+            // allocate the physical memory without altering the size of the file, the extents are still not accessible
+            int rc = fallocate(fd, FALLOC_FL_KEEP_SIZE, offset + i, min(chunk_size, length - i));
+            if(rc != 0){ COUT_DEBUG("fallocate error: " << strerror(errno) << " (" << errno << ")"); break; } // best effort
+        }
+    });
+}
+
+void RewiredMemory::prefault_stop(){
+    if(!m_prefault_thread.joinable()) return;
+    m_prefault_cancel = true;
+    m_prefault_thread.join();
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   NUMA placement                                                          *
+ *                                                                           *
+ *****************************************************************************/
+void RewiredMemory::set_numa_policy(NumaPolicy policy){
+#if !defined(HAVE_LIBNUMA)
+    if(policy != NumaPolicy::NONE){ RAISE("Invalid NUMA policy, the program has been compiled without libnuma support"); }
+#endif
+    m_numa_policy = policy;
+    apply_numa_policy(0, get_allocated_extents());
+}
+
+auto RewiredMemory::get_numa_policy() const noexcept -> NumaPolicy {
+    return m_numa_policy;
+}
+
+void RewiredMemory::set_numa_partition(size_t num_extents){
+    if(num_extents == m_numa_partition_extents) return;
+    m_numa_partition_extents = num_extents;
+    if(m_numa_policy == NumaPolicy::PARTITIONED){ apply_numa_policy(0, get_allocated_extents()); }
+}
+
+int RewiredMemory::get_numa_node(size_t extent_id) const {
+    size_t num_extents = m_numa_partition_extents > 0 ? min(m_numa_partition_extents, get_allocated_extents()) : get_allocated_extents();
+    if(extent_id >= num_extents || m_numa_nodes.empty()) return -1;
+    return m_numa_nodes[extent_id * m_numa_nodes.size() / num_extents];
+}
+
+void RewiredMemory::apply_numa_policy(size_t extent_start, size_t num_extents){
+    if(m_numa_policy == NumaPolicy::NONE || m_numa_nodes.size() <= 1 || num_extents == 0) return; // nop
+#if defined(HAVE_LIBNUMA)
+    assert(extent_start + num_extents <= get_allocated_extents() && "Invalid range of extents");
+
+    // the mask of the nodes
+    constexpr size_t bits_per_word = sizeof(unsigned long) * 8;
+    vector<unsigned long> nodemask(m_numa_nodes.back() / bits_per_word +1, 0);
+    auto do_mbind = [&](size_t first_extent, size_t last_extent /* excl */, int mode){
+        char* address = (char*) get_start_address() + first_extent * get_extent_size();
+        size_t length = (last_extent - first_extent) * get_extent_size();
+        COUT_DEBUG("extents: [" << first_extent << ", " << last_extent << "), mode: " << mode);
+        long rc = mbind(address, length, mode, mode == MPOL_PREFERRED ? nullptr : nodemask.data(), nodemask.size() * bits_per_word +1, MPOL_MF_MOVE);
+        if(rc != 0){ RAISE("Cannot set the NUMA policy for the extents [" << first_extent << ", " << last_extent << "). mbind error: " << strerror(errno) << " (" << errno << ")"); }
+    };
+
+    switch(m_numa_policy){
+    case NumaPolicy::INTERLEAVED:
+        for(int node : m_numa_nodes){ nodemask[node / bits_per_word] |= (1ul << (node % bits_per_word)); }
+        do_mbind(extent_start, extent_start + num_extents, MPOL_INTERLEAVE);
+        break;
+    case NumaPolicy::LOCAL:
+        do_mbind(extent_start, extent_start + num_extents, MPOL_PREFERRED); // an empty mask means the local node
+        break;
+    case NumaPolicy::PARTITIONED: {
+        // bind each run of consecutive extents in the same partition to its node, skip the extents not partitioned
+        size_t i = extent_start, extent_end = extent_start + num_extents;
+        while(i < extent_end){
+            int node = get_numa_node(i);
+            size_t j = i +1;
+            while(j < extent_end && get_numa_node(j) == node) j++;
+            if(node >= 0){
+                fill(begin(nodemask), end(nodemask), 0);
+                nodemask[node / bits_per_word] = (1ul << (node % bits_per_word));
+                do_mbind(i, j, MPOL_BIND);
+            }
+            i = j;
+        }
+    } break;
+    default:
+        assert(0 && "Invalid policy");
+    }
+#endif
 }
 
 /*****************************************************************************
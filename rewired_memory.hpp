@@ -17,8 +17,11 @@
 #ifndef REWIRED_MEMORY_HPP_
 #define REWIRED_MEMORY_HPP_
 
+#include <atomic>
 #include <cinttypes>
 #include <cstddef>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "errorhandling.hpp"
@@ -29,14 +32,42 @@ DEFINE_EXCEPTION(RewiredMemoryException);
  * It represents a single large section of memory mapped memory. The memory is split in extents, multiple
  * of a virtual page. Extents within the mapped memory can be rewired, exchanging the mapping
  * between their virtual addresses and the underlying physical memory.
+ *
+ * The virtual memory is reserved upfront, up to `max_memory' bytes. When the allocated memory exceeds
+ * the reservation, the reservation is grown on demand, extending the current region in place if the
+ * adjacent virtual addresses are free, or remapping the whole region elsewhere otherwise. In the
+ * latter case the start address changes: the users need to reload it with #get_start_address after
+ * each invocation of #extend or #reserve.
  */
 class RewiredMemory{
+public:
+    /**
+     * Placement of the physical extents among the NUMA nodes. The policy is attached to the physical memory, so
+     * that the interleaved and the local placement are preserved by the rewirings. With the partitioned placement,
+     * the virtual extents are rather split into contiguous ranges, one for each node, and the physical extents
+     * swapped across two ranges are migrated to the node of their new virtual extent.
+     */
+    enum class NumaPolicy {
+        NONE, // the default policy of the process
+        INTERLEAVED, // the pages are interleaved among all nodes
+        LOCAL, // the pages are allocated on the node of the thread first touching them
+        PARTITIONED, // contiguous ranges of virtual extents are bound to each node, i.e. key ranges in a PMA
+    };
+
+private:
     const size_t m_page_size; // virtual memory page size, for the underlying architecture
     const size_t m_num_pages_per_extent; // number of pages that compose an extent
     void* m_start_address; // the start address in virtual memory of the reserved region
     int m_handle_physical_memory; // the handle to the allocated physical memory, as file descriptor
-    std::vector<uint32_t> m_translation_map; // an array, given an offset in virtual memory, returns the offset
-    const size_t m_max_memory; // the maximum amount of virtual memory reserved for the memory mapping, in bytes
+    std::vector<uint64_t> m_translation_map; // an array, given an offset in virtual memory, returns the offset
+    size_t m_max_memory; // the amount of virtual memory reserved for the memory mapping, in bytes
+    NumaPolicy m_numa_policy; // placement of the physical memory among the NUMA nodes
+    std::vector<int> m_numa_nodes; // the NUMA nodes available, empty if the platform does not support NUMA
+    size_t m_numa_partition_extents; // with the partitioned placement, the number of virtual extents partitioned, 0 = all allocated extents
+    bool m_transparent_huge_pages; // whether to request transparent huge pages for the mapped regions
+    bool m_prefault; // whether to allocate in background the physical memory for the next extension
+    std::thread m_prefault_thread; // the background thread allocating the physical memory
+    std::atomic<bool> m_prefault_cancel; // flag to stop the background thread
 
     /**
      * Raise an exception if the given address is not valid:
@@ -44,12 +75,49 @@ class RewiredMemory{
      * - it is not part of the memory space handled by this instance
      */
     void validate_address(void* address);
+
+    /**
+     * Map the physical extents [physical_extent, physical_extent + num_extents) to the virtual extents starting at `address'
+     */
+    void remap(char* address, size_t physical_extent, size_t num_extents);
+
+    /**
+     * Reserve a new region of virtual memory of `max_memory' bytes and move there the current mapping
+     */
+    void relocate(size_t max_memory);
+
+    /**
+     * Request transparent huge pages for the given virtual range, if enabled
+     */
+    void advise_huge_pages(void* address, size_t length);
+
+    /**
+     * Start a background thread allocating the physical memory beyond the allocated extents, in view of the next
+     * extension. The thread allocates as much memory as currently allocated, the next extension will likely double it.
+     */
+    void prefault_start();
+
+    /**
+     * Stop the background thread, if running. The physical memory already allocated by the thread is retained.
+     */
+    void prefault_stop();
+
+    /**
+     * Apply the NUMA policy to the virtual extents [extent_start, extent_start + num_extents)
+     */
+    void apply_numa_policy(size_t extent_start, size_t num_extents);
+
+    /**
+     * With the partitioned placement, retrieve the node where the given virtual extent is bound, or -1 if it is not bound
+     */
+    int get_numa_node(size_t extent_id) const;
+
 public:
     /**
      * Allocate a single segment of mapped memory
      * @param pages_per_extent it defines the size of a single extents, in terms of virtual pages
      * @param the amount of extents to allocate
-     * @param max_memory the maximum amount of virtual memory that can be reserved by this instance, in bytes
+     * @param max_memory the amount of virtual memory initially reserved by this instance, in bytes. It is grown on demand.
      */
     RewiredMemory(size_t pages_per_extent, size_t num_extents, size_t max_memory = (1ull << 35) /* 2^35 = 32 GB */);
 
@@ -64,15 +132,60 @@ public:
     void* get_start_address() const noexcept;
 
     /**
-     * Extent the amount of allocated memory
+     * Extent the amount of allocated memory. The start address may change.
      */
     void extend(size_t num_extents);
 
+    /**
+     * Ensure that at least `max_memory' bytes of virtual memory are reserved, without allocating
+     * additional physical memory. The start address may change.
+     */
+    void reserve(size_t max_memory);
+
+    /**
+     * Release the last `num_extents' virtual extents and return their physical memory to the OS. The physical
+     * memory is compacted first, copying the content of the retained extents mapped beyond the new size
+     * of the physical memory into the physical extents being released. The start address does not change.
+     */
+    void shrink(size_t num_extents);
+
+    /**
+     * Allocate in a background thread the physical memory for the next extension, and populate the page tables
+     * of the new extents as soon as they are acquired by #extend. The physical memory allocated ahead is not
+     * accounted by #get_allocated_memory_size. By default, it is given by the configuration parameter `prefault'.
+     */
+    void set_prefault(bool value);
+
+    /**
+     * Set the placement of the physical memory among the NUMA nodes. The pages already allocated are migrated
+     * to comply with the new policy. By default, it is given by the configuration parameter `rewired_numa'.
+     * Without libnuma support, only the policy NONE is accepted.
+     */
+    void set_numa_policy(NumaPolicy policy);
+
+    /**
+     * Retrieve the current placement of the physical memory among the NUMA nodes
+     */
+    NumaPolicy get_numa_policy() const noexcept;
+
+    /**
+     * With the partitioned placement, restrict the partitioning to the first `num_extents' virtual extents, e.g.
+     * to exclude the extents used as buffers. If 0, all allocated extents are partitioned.
+     */
+    void set_numa_partition(size_t num_extents);
+
     /**
      * Rewires the memory of addr1 and addr2, swapping their physical addresses
      */
     void swap(void* addr1, void* addr2);
 
+    /**
+     * Rewire all the given pairs of extents at once, swapping the physical addresses of each pair. The
+     * virtual extents that end up mapped to consecutive physical extents are coalesced and remapped with
+     * a single system call. The same extent cannot appear more than once in the list.
+     */
+    void swap(const std::vector<std::pair<void*, void*>>& extents);
+
     /**
      * The size of a single extent, in bytes
      */
@@ -89,7 +202,7 @@ public:
     size_t get_allocated_extents() const noexcept;
 
     /**
-     * Retrieve the maximum amount of memory that can be allocated, in bytes
+     * Retrieve the amount of virtual memory currently reserved, in bytes
      */
     size_t get_max_memory() const noexcept;
 };
@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "slab_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring> // strerror
+#include <iostream>
+#include <new> // std::bad_alloc
+#include <stdexcept>
+#include <sys/mman.h> // mmap
+
+#include "configuration.hpp"
+#include "errorhandling.hpp"
+
+using namespace std;
+
+DEFINE_EXCEPTION(SlabAllocatorError);
+#define RAISE(msg) RAISE_EXCEPTION(SlabAllocatorError, msg)
+
+/*****************************************************************************
+ *                                                                           *
+ *   DEBUG                                                                   *
+ *                                                                           *
+ *****************************************************************************/
+//#define DEBUG
+#define COUT_DEBUG_FORCE(msg) std::cout << "[SlabAllocator::" << __FUNCTION__ << "] " << msg << std::endl
+#if defined(DEBUG)
+    #define COUT_DEBUG(msg) COUT_DEBUG_FORCE(msg)
+#else
+    #define COUT_DEBUG(msg)
+#endif
+
+/*****************************************************************************
+ *                                                                           *
+ *   Initialisation                                                          *
+ *                                                                           *
+ *****************************************************************************/
+static constexpr size_t CACHE_LINE = 64;
+static constexpr size_t MIN_CHUNK_SIZE = 2ull << 20; // 2 MB, the size of a huge page
+static constexpr size_t MIN_OBJECTS_PER_CHUNK = 8;
+
+static size_t round_up(size_t value, size_t alignment){
+    return ((value + alignment -1) / alignment) * alignment;
+}
+
+static size_t compute_chunk_size(size_t header_size, size_t object_size){
+    size_t chunk_size = MIN_CHUNK_SIZE;
+    while(chunk_size < header_size + object_size * MIN_OBJECTS_PER_CHUNK) chunk_size *= 2;
+    return chunk_size;
+}
+
+SlabAllocator::SlabAllocator(size_t object_size) :
+        m_object_size(round_up(std::max<size_t>(object_size, sizeof(void*)), CACHE_LINE)),
+        m_chunk_size(compute_chunk_size(round_up(sizeof(Chunk), CACHE_LINE), m_object_size)),
+        m_header_size(round_up(sizeof(Chunk), CACHE_LINE)),
+        m_objects_per_chunk((m_chunk_size - m_header_size) / m_object_size) {
+    if(object_size == 0) throw std::invalid_argument("The size of the objects must be greater than 0");
+    COUT_DEBUG("object size: " << m_object_size << ", chunk size: " << m_chunk_size << ", objects per chunk: " << m_objects_per_chunk);
+}
+
+SlabAllocator::~SlabAllocator(){
+    for(auto chunk : m_chunks){ release_chunk(chunk); }
+    m_chunks.clear();
+    m_available.clear();
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Chunks                                                                  *
+ *                                                                           *
+ *****************************************************************************/
+SlabAllocator::Chunk* SlabAllocator::create_chunk(){
+    // huge pages are naturally aligned to their size, otherwise over-allocate and trim the excess
+    char* address = reinterpret_cast<char*>(MAP_FAILED);
+    if(configuration::use_huge_pages()){
+        address = (char*) mmap(nullptr, m_chunk_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        // fall back to the regular pages if no huge pages are available
+    }
+    if(address == MAP_FAILED){
+        address = (char*) mmap(nullptr, m_chunk_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if(address == MAP_FAILED){ RAISE("Cannot allocate a chunk of " << m_chunk_size << " bytes. mmap error: " << strerror(errno) << " (" << errno << ")"); }
+
+    char* start = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(address), m_chunk_size));
+    char* end = start + m_chunk_size;
+    if(start > address){ munmap(address, start - address); }
+    if(address + m_chunk_size * 2 > end){ munmap(end, (address + m_chunk_size * 2) - end); }
+
+    if(configuration::use_transparent_huge_pages()){ madvise(start, m_chunk_size, MADV_HUGEPAGE); } // best effort
+
+    Chunk* chunk = reinterpret_cast<Chunk*>(start);
+    chunk->m_free_list = nullptr;
+    chunk->m_num_used = 0;
+    chunk->m_bump = 0;
+    chunk->m_available = true;
+    m_chunks.push_back(chunk);
+    m_available.push_back(chunk);
+
+    COUT_DEBUG("chunk: " << (void*) chunk << ", total chunks: " << m_chunks.size());
+    return chunk;
+}
+
+void SlabAllocator::release_chunk(Chunk* chunk) noexcept {
+    int rc = munmap(chunk, m_chunk_size);
+    if(rc != 0){
+        std::cerr << "[SlabAllocator::release_chunk] Cannot release the chunk " << (void*) chunk << ", munmap error: " << strerror(errno) << " (" << errno << ")" << std::endl;
+    }
+}
+
+SlabAllocator::Chunk* SlabAllocator::get_chunk(const void* ptr) const noexcept {
+    return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(ptr) & ~(static_cast<uintptr_t>(m_chunk_size) -1));
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   Allocate & deallocate                                                   *
+ *                                                                           *
+ *****************************************************************************/
+void* SlabAllocator::allocate_from(Chunk* chunk) noexcept {
+    assert(chunk->m_num_used < m_objects_per_chunk && "The chunk is full");
+    void* ptr { nullptr };
+    if(chunk->m_free_list != nullptr){
+        ptr = chunk->m_free_list;
+        chunk->m_free_list = *reinterpret_cast<void**>(ptr);
+    } else {
+        assert(chunk->m_bump < m_objects_per_chunk);
+        ptr = reinterpret_cast<char*>(chunk) + m_header_size + chunk->m_bump * m_object_size;
+        chunk->m_bump++;
+    }
+    chunk->m_num_used++;
+    m_num_allocated++;
+    return ptr;
+}
+
+void* SlabAllocator::allocate(const void* hint){
+    // try the chunk of the hint first
+    if(hint != nullptr){
+        Chunk* chunk = get_chunk(hint);
+        if(chunk->m_num_used < m_objects_per_chunk) return allocate_from(chunk);
+    }
+
+    // remove the chunks that have been filled in the meanwhile
+    while(!m_available.empty() && m_available.back()->m_num_used == m_objects_per_chunk){
+        m_available.back()->m_available = false;
+        m_available.pop_back();
+    }
+
+    Chunk* chunk = m_available.empty() ? create_chunk() : m_available.back();
+    return allocate_from(chunk);
+}
+
+void SlabAllocator::deallocate(void* ptr) noexcept {
+    if(ptr == nullptr) return;
+    Chunk* chunk = get_chunk(ptr);
+    assert(chunk->m_num_used > 0 && "Double free?");
+    *reinterpret_cast<void**>(ptr) = chunk->m_free_list;
+    chunk->m_free_list = ptr;
+    chunk->m_num_used--;
+    m_num_allocated--;
+
+    if(chunk->m_num_used == 0 && m_chunks.size() > 1){ // release the chunk
+        m_chunks.erase(std::find(begin(m_chunks), end(m_chunks), chunk));
+        if(chunk->m_available){ m_available.erase(std::find(begin(m_available), end(m_available), chunk)); }
+        release_chunk(chunk);
+    } else if (!chunk->m_available){
+        chunk->m_available = true;
+        m_available.push_back(chunk);
+    }
+}
+
+void SlabAllocator::swap(SlabAllocator& other){
+    if(m_object_size != other.m_object_size) throw std::invalid_argument("The two allocators serve objects of different sizes");
+    assert(m_chunk_size == other.m_chunk_size);
+    std::swap(m_chunks, other.m_chunks);
+    std::swap(m_available, other.m_available);
+    std::swap(m_num_allocated, other.m_num_allocated);
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SLAB_ALLOCATOR_HPP_
+#define SLAB_ALLOCATOR_HPP_
+
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Allocator for objects of a fixed size, such as the nodes of a B-Tree. The objects are carved out of large chunks
+ * of memory, 2 MB or more, optionally backed by huge pages, rather than being scattered among the heap.
+ *
+ * Each chunk is aligned to its size and keeps its own list of free slots. An allocation can be given a hint, the
+ * address of a related object, e.g. the sibling of a new node, and it is served from the same chunk of the hint if
+ * it still has space. A chunk that becomes empty is released to the OS, as long as it is not the last one.
+ */
+class SlabAllocator {
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    // The header at the start of each chunk
+    struct Chunk {
+        void* m_free_list; // linked list of the slots released
+        uint64_t m_num_used; // number of slots currently in use
+        uint64_t m_bump; // the slots after this index have never been allocated
+        bool m_available; // whether the chunk is part of the list m_available
+    };
+
+    const size_t m_object_size; // the size of each object, a multiple of the cache line
+    const size_t m_chunk_size; // the size of each chunk, a power of 2
+    const size_t m_header_size; // the space reserved to the header at the start of each chunk
+    const size_t m_objects_per_chunk; // the number of objects that can be stored in a chunk
+    std::vector<Chunk*> m_chunks; // all chunks allocated
+    std::vector<Chunk*> m_available; // chunks with some free slots
+    uint64_t m_num_allocated = 0; // number of objects currently allocated
+
+    // Retrieve the chunk that contains the given address
+    Chunk* get_chunk(const void* ptr) const noexcept;
+
+    // Take a slot from the given chunk. The chunk must have some free space.
+    void* allocate_from(Chunk* chunk) noexcept;
+
+    // Acquire a new chunk from the OS
+    Chunk* create_chunk();
+
+    // Release the given chunk to the OS
+    void release_chunk(Chunk* chunk) noexcept;
+
+public:
+    /**
+     * Create a new allocator for objects of the given size, in bytes
+     */
+    SlabAllocator(size_t object_size);
+
+    /**
+     * Destructor. It releases all chunks, including the objects still allocated.
+     */
+    ~SlabAllocator();
+
+    /**
+     * Allocate a new object, aligned to the cache line. If a hint is given, the object is placed in the same
+     * chunk of the hint, if possible.
+     */
+    void* allocate(const void* hint = nullptr);
+
+    /**
+     * Release an object previously allocated by this instance
+     */
+    void deallocate(void* ptr) noexcept;
+
+    /**
+     * Exchange the chunks of this allocator with those of `other'. Both allocators must serve objects of the same size.
+     */
+    void swap(SlabAllocator& other);
+
+    // The size of each object, in bytes
+    size_t object_size() const noexcept { return m_object_size; }
+
+    // The number of objects currently allocated
+    uint64_t num_allocated() const noexcept { return m_num_allocated; }
+
+    // The number of chunks currently allocated
+    size_t num_chunks() const noexcept { return m_chunks.size(); }
+
+    // The amount of memory acquired from the OS, in bytes
+    size_t memory_footprint() const noexcept { return m_chunks.size() * m_chunk_size; }
+};
+
+#endif /* SLAB_ALLOCATOR_HPP_ */
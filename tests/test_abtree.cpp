@@ -7,9 +7,12 @@
  *      Author: dleo@cwi.nl
  */
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <random>
 #include <utility>
+#include <vector>
 
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
@@ -59,6 +62,19 @@ TEST_CASE("Sanity"){
 
 }
 
+TEST_CASE("find_batch"){
+    ABTree tree(4);
+    for(int64_t i = 1; i <= 1000; i++){ tree.insert(i * 2, i * 20); } // only even keys
+
+    vector<int64_t> keys;
+    for(int64_t i = 0; i <= 2010; i++){ keys.push_back(i); }
+    vector<int64_t> values(keys.size());
+    tree.find_batch(keys.data(), values.data(), keys.size());
+    for(size_t i = 0; i < keys.size(); i++){
+        REQUIRE(values[i] == tree.find(keys[i]));
+    }
+}
+
 TEST_CASE("B+ Tree v1 - Inserting sorted elements"){
     typedef std::pair<int64_t, int64_t> element_t;
 
@@ -231,3 +247,173 @@ TEST_CASE("Delete_Sequential"){
 
     REQUIRE(b.size() == 0);
 }
+
+TEST_CASE("scan"){
+    ABTree implementation{16};
+
+    // even keys only, in random order
+    constexpr int64_t sz = 4096;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+
+    for(int64_t min = -1; min <= 2 * sz + 2; min += 37){
+        for(int64_t max = min -1; max <= 2 * sz + 2; max += 101){
+            int64_t expected_key = std::max<int64_t>(2, min + (min % 2 != 0)); // first even key >= min
+            pma::scan(implementation, min, max, [&](const int64_t* keys, const int64_t* values, size_t length){
+                REQUIRE(length > 0);
+                for(size_t i = 0; i < length; i++){
+                    REQUIRE(keys[i] == expected_key);
+                    REQUIRE(values[i] == expected_key * 10);
+                    expected_key += 2;
+                }
+                return true;
+            });
+            REQUIRE(expected_key == std::max<int64_t>(std::max<int64_t>(2, min + (min % 2 != 0)), std::min<int64_t>(2 * sz, max - (max % 2 != 0)) + 2));
+        }
+    }
+
+    // stop after the first run
+    size_t num_runs = 0;
+    pma::scan(implementation, 0, 2 * sz, [&](const int64_t*, const int64_t*, size_t){
+        num_runs++;
+        return false;
+    });
+    REQUIRE(num_runs == 1);
+}
+
+TEST_CASE("next_block"){
+    ABTree implementation{16};
+
+    // even keys only, in random order
+    constexpr int64_t sz = 4096;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+
+    for(int64_t min = -1; min <= 2 * sz + 2; min += 37){
+        for(int64_t max = min -1; max <= 2 * sz + 2; max += 101){
+            int64_t expected_key = std::max<int64_t>(2, min + (min % 2 != 0)); // first even key >= min
+            auto it = implementation.find(min, max);
+            const int64_t* block_keys = nullptr;
+            const int64_t* block_values = nullptr;
+            bool use_next = false; // interleave the single elements and the blocks
+            while(true){
+                if(use_next){
+                    if(!it->hasNext()) break;
+                    auto element = it->next();
+                    REQUIRE(element.first == expected_key);
+                    REQUIRE(element.second == expected_key * 10);
+                    expected_key += 2;
+                } else {
+                    size_t length = it->next_block(&block_keys, &block_values);
+                    if(length == 0) break;
+                    for(size_t i = 0; i < length; i++){
+                        REQUIRE(block_keys[i] == expected_key);
+                        REQUIRE(block_values[i] == expected_key * 10);
+                        expected_key += 2;
+                    }
+                }
+                use_next = !use_next;
+            }
+            REQUIRE(!it->hasNext());
+            REQUIRE(expected_key == std::max<int64_t>(std::max<int64_t>(2, min + (min % 2 != 0)), std::min<int64_t>(2 * sz, max - (max % 2 != 0)) + 2));
+        }
+    }
+}
+
+TEST_CASE("slab_allocator"){
+    ABTree implementation{64};
+    implementation.set_slab_allocator(true);
+
+    // random inserts & removals
+    constexpr int64_t sz = 200000;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+    for(int64_t i = 0; i < sz / 2; i++){ REQUIRE(implementation.remove(keys[i]) == keys[i] * 10); }
+    REQUIRE(implementation.size() == sz / 2);
+
+    // count the leaves that are not placed after their predecessor in memory
+    auto count_descents = [&](size_t* out_num_leaves){
+        auto it = implementation.find(0, sz);
+        const int64_t* block_keys = nullptr; const int64_t* block_values = nullptr;
+        const int64_t* previous = nullptr;
+        size_t num_descents = 0, num_leaves = 0;
+        int64_t expected_size = 0;
+        while(it->next_block(&block_keys, &block_values) > 0){
+            if(previous != nullptr && block_keys < previous) num_descents++;
+            previous = block_keys;
+            num_leaves++;
+        }
+        for(auto it = implementation.iterator(); it->hasNext(); it->next()){ expected_size++; }
+        REQUIRE(expected_size == sz / 2);
+        if(out_num_leaves != nullptr) *out_num_leaves = num_leaves;
+        return num_descents;
+    };
+    size_t num_leaves = 0;
+    REQUIRE(count_descents(&num_leaves) > 0);
+
+    // after the defragmentation, the leaves are sorted in memory, except at the boundaries of the chunks
+    implementation.defragment();
+    REQUIRE(count_descents(nullptr) <= num_leaves / 100);
+    for(int64_t i = 0; i < sz; i++){
+        REQUIRE(implementation.find(keys[i]) == (i < sz / 2 ? -1 : keys[i] * 10));
+    }
+
+    // the tree is still updatable
+    for(int64_t i = 0; i < sz / 2; i++){ implementation.insert(keys[i], keys[i] * 10); }
+    for(int64_t key = 1; key <= sz; key++){ REQUIRE(implementation.find(key) == key * 10); }
+
+    REQUIRE_THROWS(implementation.set_slab_allocator(false));
+
+    // the random permutation moves the leaves into the memory of the internal nodes, it cannot be combined with the slab allocators
+    ABTree permuted{64};
+    permuted.set_common_memsize_nodes(true);
+    REQUIRE_THROWS(permuted.set_slab_allocator(true));
+    ABTree slab{64};
+    slab.set_slab_allocator(true);
+    REQUIRE_THROWS(slab.set_common_memsize_nodes(true));
+}
+
+TEST_CASE("parallel_load"){
+    constexpr int64_t sz = 1000000;
+    vector<pair<int64_t, int64_t>> elements;
+    for(int64_t i = 1; i <= sz; i++){ elements.emplace_back(i * 2, i * 20); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(elements), end(elements), random_generator);
+
+    for(size_t num_threads : {1, 4}){
+        ABTree implementation{64};
+        implementation.set_load_threads(num_threads);
+        implementation.load(elements.data(), elements.size());
+        REQUIRE(implementation.size() == sz);
+        implementation.validate();
+
+        for(int64_t i = 1; i <= sz; i++){
+            REQUIRE(implementation.find(i * 2) == i * 20);
+            REQUIRE(implementation.find(i * 2 +1) == -1);
+        }
+        auto it = implementation.iterator();
+        int64_t expected_key = 2;
+        while(it->hasNext()){
+            REQUIRE(it->next().first == expected_key);
+            expected_key += 2;
+        }
+        REQUIRE(expected_key == 2 * sz + 2);
+
+        // the tree is still updatable
+        for(int64_t i = 1; i <= 1000; i++){ implementation.insert(i * 2 +1, i); }
+        for(int64_t i = 1; i <= 1000; i++){ REQUIRE(implementation.remove(i * 2) == i * 20); }
+        implementation.validate();
+    }
+
+    ABTree implementation{64};
+    REQUIRE_THROWS(implementation.set_load_threads(0));
+}
@@ -10,8 +10,15 @@
 
 #include "distribution/random_permutation.hpp"
 #include "pma/driver.hpp"
+#include "pma/generic/snapshot.hpp"
 #include "pma/adaptive/int3/packed_memory_array.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <thread>
 #include <vector>
 
 using namespace pma;
@@ -41,6 +48,16 @@ void check(const vector<int64_t>& entries, size_t block_size = 32){
     REQUIRE(!tree.empty());
     REQUIRE(tree.size() == entries.size());
 
+    { // batched lookups, including keys not present
+        vector<int64_t> batch_keys;
+        for(size_t i = 0; i < entries.size(); i++){ batch_keys.push_back(entries[i]); batch_keys.push_back(-entries[i]); }
+        vector<int64_t> batch_values(batch_keys.size());
+        tree.find_batch(batch_keys.data(), batch_values.data(), batch_keys.size());
+        for(size_t i = 0; i < batch_keys.size(); i++){
+            REQUIRE(batch_values[i] == tree.find(batch_keys[i]));
+        }
+    }
+
 //    tree.dump();
 
     // remove
@@ -1759,3 +1776,287 @@ TEST_CASE("unibig"){
     }
 }
 
+TEST_CASE("spread_threads"){
+    pma::initialise();
+    PackedMemoryArray pma { /* segment size */ 32, /* pages per extent */ 1};
+    pma.set_spread_threads(4);
+
+    // large enough for the rebalances to spread the windows with multiple threads
+    constexpr size_t sz = 1ull << 19;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+
+    for(auto key : keys){ pma.insert(key, key * 10); }
+    REQUIRE(pma.size() == sz);
+    for(int64_t key = 1; key <= sz; key++){
+        REQUIRE(pma.find(key) == key * 10);
+    }
+
+    // remove 3/4 of the elements, to shrink the array
+    for(size_t i = 0; i < sz * 3 / 4; i++){ REQUIRE(pma.remove(keys[i]) == keys[i] * 10); }
+    REQUIRE(pma.size() == sz / 4);
+    sort(begin(keys) + sz * 3 / 4, end(keys));
+    auto it = pma.iterator();
+    for(size_t i = sz * 3 / 4; i < sz; i++){
+        REQUIRE(it->hasNext());
+        auto p = it->next();
+        REQUIRE(p.first == keys[i]);
+        REQUIRE(p.second == keys[i] * 10);
+    }
+    REQUIRE(!it->hasNext());
+}
+
+TEST_CASE("concurrent_readers"){
+    pma::initialise();
+    PackedMemoryArray pma { /* segment size */ 32, /* pages per extent */ 1};
+    pma.set_concurrent_readers(true);
+    REQUIRE(pma.has_concurrent_readers());
+    REQUIRE_THROWS(pma.set_index_layout(StaticIndex::Layout::LEARNED));
+    {
+        PackedMemoryArray learned { /* segment size */ 32, /* pages per extent */ 1};
+        learned.set_index_layout(StaticIndex::Layout::LEARNED);
+        REQUIRE_THROWS(learned.set_concurrent_readers(true));
+        REQUIRE(!learned.has_concurrent_readers());
+    }
+
+    // the even keys are always present, the writer inserts & removes the odd keys
+    constexpr int64_t sz = 1ull << 16;
+    for(int64_t key = 2; key <= 2 * sz; key += 2){ pma.insert(key, key * 10); }
+
+    atomic<bool> writer_done { false };
+    atomic<uint64_t> num_errors { 0 };
+    auto reader = [&](uint64_t seed){
+        mt19937_64 random_generator{ seed };
+        while(!writer_done){
+            int64_t key = 1 + random_generator() % (2 * sz);
+            int64_t value = pma.find(key);
+            if((key % 2 == 0 && value != key * 10) || (key % 2 == 1 && value != -1 && value != key * 10)){ num_errors++; }
+
+            int64_t max = std::min<int64_t>(key + 1000, 2 * sz);
+            auto sum = pma.sum(key, max);
+            uint64_t num_evens = max / 2 - (key -1) / 2;
+            if(sum.m_num_elements < num_evens || sum.m_num_elements > static_cast<uint64_t>(max - key + 1) || sum.m_sum_values != sum.m_sum_keys * 10){ num_errors++; }
+        }
+    };
+    vector<thread> readers;
+    for(uint64_t i = 0; i < 4; i++){ readers.emplace_back(reader, i); }
+
+    // writer
+    vector<int64_t> keys;
+    for(int64_t key = 1; key < 2 * sz; key += 2){ keys.push_back(key); }
+    mt19937_64 random_generator{ 42 };
+    for(int round = 0; round < 2; round++){
+        shuffle(begin(keys), end(keys), random_generator);
+        for(auto key : keys){ pma.insert(key, key * 10); }
+        shuffle(begin(keys), end(keys), random_generator);
+        for(auto key : keys){ pma.remove(key); }
+    }
+    writer_done = true;
+    for(auto& t : readers) t.join();
+
+    REQUIRE(num_errors == 0);
+    REQUIRE(pma.size() == sz);
+    auto sum = pma.sum(0, 2 * sz);
+    REQUIRE(sum.m_num_elements == sz);
+    REQUIRE(sum.m_first_key == 2);
+    REQUIRE(sum.m_last_key == 2 * sz);
+    REQUIRE(sum.m_sum_keys == sz * (sz +1));
+}
+
+TEST_CASE("scan"){
+    pma::initialise();
+    PackedMemoryArray implementation { /* segment size */ 32, /* pages per extent */ 1};
+
+    // even keys only, in random order
+    constexpr int64_t sz = 4096;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+
+    for(int64_t min = -1; min <= 2 * sz + 2; min += 37){
+        for(int64_t max = min -1; max <= 2 * sz + 2; max += 101){
+            int64_t expected_key = std::max<int64_t>(2, min + (min % 2 != 0)); // first even key >= min
+            pma::scan(implementation, min, max, [&](const int64_t* keys, const int64_t* values, size_t length){
+                REQUIRE(length > 0);
+                for(size_t i = 0; i < length; i++){
+                    REQUIRE(keys[i] == expected_key);
+                    REQUIRE(values[i] == expected_key * 10);
+                    expected_key += 2;
+                }
+                return true;
+            });
+            REQUIRE(expected_key == std::max<int64_t>(std::max<int64_t>(2, min + (min % 2 != 0)), std::min<int64_t>(2 * sz, max - (max % 2 != 0)) + 2));
+        }
+    }
+
+    // stop after the first run
+    size_t num_runs = 0;
+    pma::scan(implementation, 0, 2 * sz, [&](const int64_t*, const int64_t*, size_t){
+        num_runs++;
+        return false;
+    });
+    REQUIRE(num_runs == 1);
+}
+
+TEST_CASE("next_block"){
+    pma::initialise();
+    PackedMemoryArray implementation { /* segment size */ 32, /* pages per extent */ 1};
+
+    // even keys only, in random order
+    constexpr int64_t sz = 4096;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+
+    for(int64_t min = -1; min <= 2 * sz + 2; min += 37){
+        for(int64_t max = min -1; max <= 2 * sz + 2; max += 101){
+            int64_t expected_key = std::max<int64_t>(2, min + (min % 2 != 0)); // first even key >= min
+            auto it = implementation.find(min, max);
+            const int64_t* block_keys = nullptr;
+            const int64_t* block_values = nullptr;
+            bool use_next = false; // interleave the single elements and the blocks
+            while(true){
+                if(use_next){
+                    if(!it->hasNext()) break;
+                    auto element = it->next();
+                    REQUIRE(element.first == expected_key);
+                    REQUIRE(element.second == expected_key * 10);
+                    expected_key += 2;
+                } else {
+                    size_t length = it->next_block(&block_keys, &block_values);
+                    if(length == 0) break;
+                    for(size_t i = 0; i < length; i++){
+                        REQUIRE(block_keys[i] == expected_key);
+                        REQUIRE(block_values[i] == expected_key * 10);
+                        expected_key += 2;
+                    }
+                }
+                use_next = !use_next;
+            }
+            REQUIRE(!it->hasNext());
+            REQUIRE(expected_key == std::max<int64_t>(std::max<int64_t>(2, min + (min % 2 != 0)), std::min<int64_t>(2 * sz, max - (max % 2 != 0)) + 2));
+        }
+    }
+}
+
+TEST_CASE("snapshot"){
+    pma::initialise();
+    PackedMemoryArray pma1 { /* segment size */ 32, /* pages per extent */ 1};
+    constexpr size_t sz = 1ull << 16;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ pma1.insert(key, key * 10); }
+    for(size_t i = 0; i < sz / 2; i++){ pma1.remove(keys[i]); } // leave some gaps
+    string path = "/tmp/pma_snapshot_" + to_string(getpid()) + ".bin";
+    pma1.save(path);
+
+    // restore the snapshot in a different instance
+    PackedMemoryArray pma2 { /* segment size */ 32, /* pages per extent */ 1};
+    pma2.insert(1, 1); // the content of the PMA is replaced
+    pma2.open(path);
+    REQUIRE(pma2.size() == pma1.size());
+    auto it1 = pma1.iterator();
+    auto it2 = pma2.iterator();
+    while(it1->hasNext()){
+        REQUIRE(it2->hasNext());
+        REQUIRE(it2->next() == it1->next());
+    }
+    REQUIRE(!it2->hasNext());
+    for(size_t i = 0; i < sz; i++){
+        REQUIRE(pma2.find(keys[i]) == (i < sz / 2 ? -1 : keys[i] * 10));
+        REQUIRE(pma2.find(keys[i] +1) == -1);
+    }
+    REQUIRE(pma2.sum(0, sz * 4).m_sum_values == pma1.sum(0, sz * 4).m_sum_values);
+
+    // the restored instance can be altered as usual, including resizes
+    for(size_t i = 0; i < sz; i++){ pma2.insert(keys[i] +1, keys[i]); }
+    for(size_t i = 0; i < sz / 2; i++){ REQUIRE(pma2.remove(keys[i] +1) == keys[i]); }
+    REQUIRE(pma2.size() == sz);
+    for(size_t i = sz / 2; i < sz; i++){
+        REQUIRE(pma2.find(keys[i]) == keys[i] * 10);
+        REQUIRE(pma2.find(keys[i] +1) == keys[i]);
+    }
+
+    unlink(path.c_str());
+    REQUIRE_THROWS(pma2.open(path)); // the file does not exist anymore
+}
+
+TEST_CASE("key_only"){
+    pma::initialise();
+    PackedMemoryArray pma { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ true };
+    PackedMemoryArray pma_kv { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1 };
+    pma.set_spread_threads(4);
+
+    // the values are ignored, the value of each element is its key
+    constexpr size_t sz = 1ull << 18;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(size_t i = 0; i < sz / 2; i++){ pma.insert(keys[i], keys[i] * 10); pma_kv.insert(keys[i], keys[i] * 10); }
+    vector<pair<int64_t, int64_t>> batch;
+    for(size_t i = sz / 2; i < sz; i++){ batch.emplace_back(keys[i], keys[i] * 10); pma_kv.insert(keys[i], keys[i] * 10); }
+    sort(begin(batch), end(batch));
+    pma.load(batch.data(), batch.size());
+    REQUIRE(pma.size() == sz);
+    for(auto key : keys){ REQUIRE(pma.find(key) == key); REQUIRE(pma.find(key +1) == -1); }
+    auto it = pma.iterator();
+    int64_t expected_key = 2;
+    while(it->hasNext()){
+        auto p = it->next();
+        REQUIRE(p.first == expected_key);
+        REQUIRE(p.second == expected_key);
+        expected_key += 2;
+    }
+    REQUIRE(expected_key == 2 * sz + 2);
+    auto sum = pma.sum(0, sz);
+    REQUIRE(sum.m_num_elements == sz / 2);
+    REQUIRE(sum.m_sum_values == sum.m_sum_keys);
+    REQUIRE(pma.memory_footprint() < pma_kv.memory_footprint());
+
+    // snapshot
+    string path = "/tmp/pma_snapshot_" + to_string(getpid()) + ".bin";
+    pma.save(path);
+    PackedMemoryArray pma2 { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ true };
+    pma2.open(path);
+    unlink(path.c_str());
+    REQUIRE(pma2.size() == sz);
+    for(auto key : keys){ REQUIRE(pma2.find(key) == key); }
+
+    // remove the elements, to shrink the array
+    for(size_t i = 0; i < sz; i++){ REQUIRE(pma.remove(keys[i]) == keys[i]); }
+    REQUIRE(pma.empty());
+}
+
+TEST_CASE("spread_threads_key_only"){
+    pma::initialise();
+    PackedMemoryArray pma { /* index block size */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ true};
+    pma.set_spread_threads(4);
+
+    constexpr size_t sz = 1ull << 19;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+
+    for(auto key : keys){ pma.insert(key, key); }
+    for(size_t i = 0; i < sz / 2; i++){ REQUIRE(pma.remove(keys[i]) == keys[i]); }
+    REQUIRE(pma.size() == sz / 2);
+    sort(begin(keys) + sz / 2, end(keys));
+    auto it = pma.iterator();
+    for(size_t i = sz / 2; i < sz; i++){
+        REQUIRE(it->hasNext());
+        auto p = it->next();
+        REQUIRE(p.first == keys[i]);
+        REQUIRE(p.second == keys[i]);
+    }
+    REQUIRE(!it->hasNext());
+}
@@ -3,8 +3,11 @@
  */
 
 #include <cmath>
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <utility>
+#include <vector>
 
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
@@ -1848,3 +1851,30 @@ TEST_CASE("uniform"){
 
     autocheck(keys, 64);
 }
+
+TEST_CASE("load"){
+    constexpr int64_t sz = 500000;
+    vector<pair<int64_t, int64_t>> elements;
+    for(int64_t i = 1; i <= sz; i++){ elements.emplace_back(i * 2, i * 20); }
+    mt19937_64 random_generator{ 42 };
+
+    for(size_t num_threads : {1, 4}){
+        shuffle(begin(elements), end(elements), random_generator);
+        ART tree{64};
+        tree.set_load_threads(num_threads);
+        tree.load(elements.data(), elements.size());
+        REQUIRE(tree.size() == sz);
+        for(int64_t i = 1; i <= sz; i++){
+            REQUIRE(tree.find(i * 2) == i * 20);
+            REQUIRE(tree.find(i * 2 +1) == -1);
+        }
+        REQUIRE(tree.sum(0, 2 * sz).m_num_elements == sz);
+
+        // a second batch is inserted one by one
+        vector<pair<int64_t, int64_t>> batch;
+        for(int64_t i = 1; i <= 1000; i++){ batch.emplace_back(i * 2 +1, i); }
+        tree.load(batch.data(), batch.size());
+        REQUIRE(tree.size() == sz + 1000);
+        for(int64_t i = 1; i <= 1000; i++){ REQUIRE(tree.find(i * 2 +1) == i); }
+    }
+}
@@ -7,7 +7,9 @@
 
 
 
+#include <algorithm>
 #include <climits>
+#include <random>
 
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
@@ -2259,6 +2261,18 @@ TEST_CASE("rew_uniform"){
     rewiring_check(keys, false, 64);
 }
 
+TEST_CASE("rew_uniform_large"){ // an element greater than all keys of its run of segments must be inserted before the next run
+    const size_t cardinality = 1ull << 15;
+    vector<int64_t> keys;
+    keys.reserve(cardinality);
+    for(size_t i = 1; i <= cardinality; i++){
+        keys.push_back(i);
+    }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    rewiring_check(keys);
+}
+
 TEST_CASE("sum"){
     pma::initialise();
     using Implementation = APMA_BH07_v2;
@@ -0,0 +1,331 @@
+/*
+ * test_btreepmacc10.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include "pma/driver.hpp"
+#include "pma/iterator.hpp"
+#include "pma/btree/10/adapter.hpp"
+#include "pma/btree/10/packed_memory_array.hpp"
+#include "pma/btree/10/varlen_pma.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace pma;
+using namespace pma::v10;
+using namespace std;
+
+// Random inserts & removals through the common interface
+static void check_interface(Interface& pma, int64_t key_max, size_t num_updates){
+    map<int64_t, int64_t> model;
+    mt19937_64 random_generator { 42 };
+    auto random_key = [&](){ return static_cast<int64_t>(random_generator() % key_max); };
+
+    for(size_t i = 0; i < num_updates; i++){
+        int64_t key;
+        do { key = random_key(); } while(model.count(key) > 0);
+        pma.insert(key, key * 10);
+        model[key] = key * 10;
+    }
+    REQUIRE(pma.size() == model.size());
+    for(auto& e : model){ REQUIRE(pma.find(e.first) == e.second); }
+    REQUIRE(pma.find(-1) == -1);
+
+    // iterator
+    auto it = pma.iterator();
+    for(auto& e : model){
+        REQUIRE(it->hasNext());
+        REQUIRE(it->next() == make_pair(e.first, e.second));
+    }
+    REQUIRE(!it->hasNext());
+
+    // range sums
+    for(size_t i = 0; i < 100; i++){
+        int64_t min = random_key(), max = random_key();
+        if(min > max) swap(min, max);
+        Interface::SumResult expected;
+        for(auto it = model.lower_bound(min); it != model.end() && it->first <= max; it++){
+            if(expected.m_num_elements == 0) expected.m_first_key = it->first;
+            expected.m_last_key = it->first;
+            expected.m_num_elements++;
+            expected.m_sum_keys += it->first;
+            expected.m_sum_values += it->second;
+        }
+        auto result = pma.sum(min, max);
+        REQUIRE(result.m_num_elements == expected.m_num_elements);
+        if(expected.m_num_elements > 0){
+            REQUIRE(result.m_first_key == expected.m_first_key);
+            REQUIRE(result.m_last_key == expected.m_last_key);
+            REQUIRE(result.m_sum_keys == expected.m_sum_keys);
+            REQUIRE(result.m_sum_values == expected.m_sum_values);
+        }
+    }
+    REQUIRE(pma.sum(numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max()).m_num_elements == model.size());
+
+    // remove everything
+    while(!model.empty()){
+        auto it = model.lower_bound(random_key());
+        if(it == model.end()) it = model.begin();
+        REQUIRE(pma.remove(it->first) == it->second);
+        REQUIRE(pma.find(it->first) == -1);
+        model.erase(it);
+    }
+    REQUIRE(pma.size() == 0);
+}
+
+template<typename K>
+static void check_adapter(size_t segment_size, int64_t key_max, size_t num_updates){
+    initialise();
+    PackedMemoryArray10<K> pma { segment_size };
+    check_interface(pma, key_max, num_updates);
+}
+
+TEST_CASE("adapter_u32"){
+    check_adapter<uint32_t>(32, numeric_limits<uint32_t>::max(), 50000);
+
+    PackedMemoryArray10<uint32_t> pma;
+    REQUIRE_THROWS(pma.insert(-1, 0));
+    REQUIRE_THROWS(pma.insert(static_cast<int64_t>(numeric_limits<uint32_t>::max()) +1, 0));
+    REQUIRE(pma.find(-1) == -1);
+}
+
+TEST_CASE("adapter_u64"){
+    check_adapter<uint64_t>(64, numeric_limits<int64_t>::max(), 50000);
+}
+
+TEST_CASE("adapter_i64"){
+    check_adapter<int64_t>(16, 1000000, 50000);
+}
+
+TEST_CASE("adapter_composite"){
+    check_adapter<CompositeKey32>(32, numeric_limits<int64_t>::max(), 50000);
+
+    // the negative keys are mapped to the negative tenants
+    PackedMemoryArray10<CompositeKey32> pma;
+    for(int64_t key : vector<int64_t>{ -1, numeric_limits<int64_t>::min(), -(1ll << 32), 1ll << 32, 0 }){ pma.insert(key, key + 1); }
+    auto it = pma.iterator();
+    for(int64_t key : vector<int64_t>{ numeric_limits<int64_t>::min(), -(1ll << 32), -1, 0, 1ll << 32 }){
+        REQUIRE(it->hasNext());
+        REQUIRE(it->next() == make_pair(key, key + 1));
+    }
+    REQUIRE(!it->hasNext());
+    REQUIRE(pma.sum(-(1ll << 32), 0).m_num_elements == 3);
+}
+
+TEST_CASE("adapter_varlen"){
+    initialise();
+    VarlenPackedMemoryArray10 pma { /* segment size */ 32, /* payload size */ 48, /* pages per extent */ 1 };
+    check_interface(pma, 1000000, 20000);
+    REQUIRE_THROWS((VarlenPackedMemoryArray10{ 32, /* payload size */ 4 }));
+}
+
+TEST_CASE("index_layouts"){
+    initialise();
+    for(auto layout : { StaticIndex::Layout::BTREE, StaticIndex::Layout::EYTZINGER, StaticIndex::Layout::LEARNED }){
+        PackedMemoryArray<uint64_t, uint64_t> pma { 32, /* index B */ 8 };
+        pma.set_index_layout(layout);
+        mt19937_64 random_generator { 42 };
+        vector<uint64_t> keys;
+        for(size_t i = 0; i < 20000; i++){ keys.push_back(random_generator()); } // including the keys >= 2^63
+        for(auto key : keys){ pma.insert(key, key / 2); }
+        uint64_t value;
+        for(auto key : keys){
+            REQUIRE(pma.find(key, &value));
+            REQUIRE(value == key / 2);
+        }
+
+        // the scan visits the elements in sorted order, in runs spanning up to two clustered segments
+        sort(begin(keys), end(keys));
+        size_t position = 0, max_run = 0;
+        pma.scan(0, numeric_limits<uint64_t>::max(), [&](const uint64_t* run_keys, const uint64_t*, size_t length){
+            for(size_t i = 0; i < length; i++){ REQUIRE(run_keys[i] == keys[position++]); }
+            max_run = std::max(max_run, length);
+            return true;
+        });
+        REQUIRE(position == keys.size());
+        REQUIRE(max_run > pma.get_segment_capacity());
+        REQUIRE(max_run <= 2 * pma.get_segment_capacity());
+
+        for(auto key : keys){ REQUIRE(pma.remove(key)); }
+        REQUIRE(pma.empty());
+    }
+}
+
+TEST_CASE("footprint"){
+    initialise();
+    PackedMemoryArray10<uint32_t> pma32;
+    PackedMemoryArray10<int64_t> pma64;
+    for(int64_t i = 0; i < 100000; i++){ pma32.insert(i, i); pma64.insert(i, i); }
+    REQUIRE(pma32.memory_footprint() < pma64.memory_footprint());
+}
+
+TEST_CASE("composite_keys"){
+    initialise();
+    using Key = CompositeKey<uint32_t, uint64_t>; // <tenant, timestamp>
+    struct Payload { uint64_t m_id; double m_amount; };
+    PackedMemoryArray<Key, Payload> pma { 32 };
+
+    constexpr uint32_t num_tenants = 16;
+    constexpr uint64_t num_timestamps = 4000;
+    vector<Key> keys;
+    for(uint32_t tenant = 0; tenant < num_tenants; tenant++){
+        for(uint64_t ts = 0; ts < num_timestamps; ts++){ keys.push_back(Key{tenant, ts * 2}); }
+    }
+    mt19937_64 random_generator { 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto& key : keys){ pma.insert(key, Payload{ key.m_high * num_timestamps * 2 + key.m_low, key.m_low * 0.5 }); }
+    REQUIRE(pma.size() == keys.size());
+
+    Payload payload;
+    for(auto& key : keys){
+        REQUIRE(pma.find(key, &payload));
+        REQUIRE(payload.m_id == key.m_high * num_timestamps * 2 + key.m_low);
+        REQUIRE(pma.find(Key{key.m_high, key.m_low +1}) == false);
+    }
+
+    // all the events of a tenant in an interval of time
+    size_t count = 0;
+    uint64_t expected_ts = 100;
+    pma.scan(Key{7, 100}, Key{7, 1001}, [&](const Key* keys, const Payload* payloads, size_t length){
+        for(size_t i = 0; i < length; i++){
+            REQUIRE(keys[i].m_high == 7);
+            REQUIRE(keys[i].m_low == expected_ts);
+            REQUIRE(payloads[i].m_amount == expected_ts * 0.5);
+            expected_ts += 2;
+            count++;
+        }
+        return true;
+    });
+    REQUIRE(count == 451);
+
+    // remove a tenant
+    for(uint64_t ts = 0; ts < num_timestamps; ts++){
+        REQUIRE(pma.remove(Key{3, ts * 2}, &payload));
+        REQUIRE(payload.m_amount == ts);
+    }
+    REQUIRE(pma.size() == (num_tenants -1) * num_timestamps);
+    count = 0;
+    pma.scan(Key{3, 0}, Key{3, numeric_limits<uint64_t>::max()}, [&](const Key*, const Payload*, size_t length){ count += length; return true; });
+    REQUIRE(count == 0);
+    REQUIRE(pma.find(Key{4, 0}));
+}
+
+TEST_CASE("duplicates"){
+    initialise();
+    PackedMemoryArray<uint32_t, uint32_t> pma { 16 };
+    for(uint32_t i = 0; i < 1000; i++){ pma.insert(i % 10, i); }
+    REQUIRE(pma.size() == 1000);
+    size_t count = 0;
+    pma.scan(3, 4, [&](const uint32_t* keys, const uint32_t*, size_t length){
+        for(size_t i = 0; i < length; i++){ REQUIRE((keys[i] == 3 || keys[i] == 4)); }
+        count += length;
+        return true;
+    });
+    REQUIRE(count == 200);
+    for(uint32_t i = 0; i < 1000; i++){ REQUIRE(pma.remove(i % 10)); }
+    REQUIRE(pma.empty());
+    REQUIRE(!pma.remove(0));
+}
+
+TEST_CASE("varlen_payloads"){
+    initialise();
+    VarlenPackedMemoryArray<uint64_t> pma { 32, /* pages per extent */ 1 };
+    map<uint64_t, string> model;
+    mt19937_64 random_generator { 42 };
+    auto random_payload = [&](uint64_t key){ return string(random_generator() % 200, static_cast<char>('a' + key % 26)); };
+
+    for(size_t i = 0; i < 20000; i++){
+        uint64_t key = random_generator() % 1000000;
+        if(model.count(key) > 0) continue;
+        string payload = random_payload(key);
+        pma.insert(key, payload.data(), payload.size());
+        model[key] = payload;
+    }
+    REQUIRE(pma.size() == model.size());
+
+    string_view view;
+    for(auto& e : model){
+        REQUIRE(pma.find(e.first, &view));
+        REQUIRE(view == e.second);
+    }
+    REQUIRE(!pma.find(1000000));
+
+    // scan
+    auto it_model = model.lower_bound(1000);
+    pma.scan(1000, 500000, [&](uint64_t key, string_view payload){
+        REQUIRE(it_model != model.end());
+        REQUIRE(key == it_model->first);
+        REQUIRE(payload == it_model->second);
+        it_model++;
+        return true;
+    });
+    REQUIRE((it_model == model.end() || it_model->first > 500000));
+
+    // remove half of the elements, the garbage is bounded by the compactions
+    size_t i = 0;
+    for(auto it = model.begin(); it != model.end(); i++){
+        if(i % 2 == 0){
+            REQUIRE(pma.remove(it->first));
+            it = model.erase(it);
+        } else {
+            it++;
+        }
+    }
+    REQUIRE(pma.size() == model.size());
+    uint64_t live = 0;
+    for(auto& e : model){ live += e.second.size(); }
+    REQUIRE(pma.heap().live() == live);
+    REQUIRE(pma.heap().garbage() <= std::max(live, pma.heap().memory_footprint() / 4));
+
+    // after a compaction, the payloads are stored in key order
+    pma.compact();
+    REQUIRE(pma.heap().used() == live);
+    const char* previous = nullptr;
+    pma.scan(0, numeric_limits<uint64_t>::max(), [&](uint64_t, string_view payload){
+        if(previous != nullptr){ REQUIRE(previous <= payload.data()); }
+        previous = payload.data() + payload.size();
+        return true;
+    });
+    for(auto& e : model){
+        REQUIRE(pma.find(e.first, &view));
+        REQUIRE(view == e.second);
+    }
+
+    for(auto& e : model){ REQUIRE(pma.remove(e.first)); }
+    REQUIRE(pma.empty());
+    REQUIRE(pma.heap().live() == 0);
+    REQUIRE(!pma.remove(0));
+
+    string too_long(ValueHeap::MAX_LENGTH +1, 'x');
+    REQUIRE_THROWS(pma.insert(0, too_long.data(), too_long.size()));
+}
+
+TEST_CASE("varlen_sequential"){ // the payloads are appended in key order, the rebalances do not need to relocate them
+    initialise();
+    VarlenPackedMemoryArray<uint64_t> pma { 32, /* pages per extent */ 1 };
+    string payload(100, 'p');
+    uint64_t live = 0;
+    for(uint64_t key = 0; key < 50000; key++){
+        pma.insert(key, payload.data(), key % payload.size());
+        live += key % payload.size();
+    }
+    REQUIRE(pma.heap().live() == live);
+    REQUIRE(pma.heap().garbage() == 0);
+
+    string_view view;
+    for(uint64_t key = 0; key < 50000; key += 7){
+        REQUIRE(pma.find(key, &view));
+        REQUIRE(view.size() == key % payload.size());
+    }
+}
@@ -10,8 +10,14 @@
 #include "third-party/catch/catch.hpp"
 
 #include "pma/driver.hpp"
+#include "pma/generic/snapshot.hpp"
 #include "pma/btree/btreepmacc7.hpp"
 
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
 #include <vector>
 
 using namespace pma;
@@ -2150,3 +2156,402 @@ TEST_CASE("bulk_loading_sequential"){
 }
 
 
+
+TEST_CASE("spread_threads"){
+    initialise();
+    BTreePMACC7 tree {32, 1};
+    tree.set_spread_threads(4);
+
+    // sequential insertions, to trigger the rebalance of large windows, spread with multiple threads
+    constexpr size_t sz = 1ull << 18;
+    for(size_t key = 1; key <= sz; key++){ tree.insert(key, key * 10); }
+    REQUIRE(tree.size() == sz);
+    for(int64_t key = 1; key <= sz; key++){
+        REQUIRE(tree.find(key) == key * 10);
+    }
+    auto it = tree.iterator();
+    int64_t expected_key = 1;
+    while(it->hasNext()){
+        auto p = it->next();
+        REQUIRE(p.first == expected_key);
+        REQUIRE(p.second == expected_key * 10);
+        expected_key++;
+    }
+    REQUIRE(expected_key == sz +1);
+}
+
+TEST_CASE("load_threads"){
+    initialise();
+    constexpr int64_t sz = 1ull << 20;
+    vector<pair<int64_t, int64_t>> elements;
+    for(int64_t key = 1; key <= sz; key++){ elements.emplace_back(key, key * 10); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(elements), end(elements), random_generator);
+
+    BTreePMACC7 tree {32, 1};
+    tree.set_load_threads(4);
+    tree.load(elements.data(), elements.size()); // sorted & copied into the segments with multiple threads
+    REQUIRE(tree.size() == sz);
+    for(int64_t key = 1; key <= sz; key++){
+        REQUIRE(tree.find(key) == key * 10);
+    }
+
+    // the separator keys are set after the workers completed, as the learned layout of the index is not thread safe
+    {
+        BTreePMACC7 learned {32, 1};
+        learned.set_index_layout(StaticIndex::Layout::LEARNED);
+        learned.set_load_threads(4);
+        learned.load(elements.data(), elements.size());
+        REQUIRE(learned.size() == sz);
+        for(int64_t key = 1; key <= sz; key++){
+            REQUIRE(learned.find(key) == key * 10);
+        }
+    }
+    auto it = tree.iterator();
+    int64_t expected_key = 1;
+    while(it->hasNext()){
+        REQUIRE(it->next().first == expected_key);
+        expected_key++;
+    }
+    REQUIRE(expected_key == sz +1);
+
+    // sort_elements leaves an already sorted array untouched
+    vector<pair<int64_t, int64_t>> sorted;
+    for(int64_t key = 1; key <= sz; key++){ sorted.emplace_back(key, sz - key); }
+    sort_elements(sorted.data(), sorted.size(), 4);
+    for(int64_t key = 1; key <= sz; key++){ REQUIRE(sorted[key -1].second == sz - key); }
+    REQUIRE_THROWS(tree.set_load_threads(0));
+}
+
+TEST_CASE("scan"){
+    initialise();
+    BTreePMACC7 implementation {32, 1};
+
+    // even keys only, in random order
+    constexpr int64_t sz = 4096;
+    vector<int64_t> keys;
+    for(int64_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ implementation.insert(key, key * 10); }
+
+    for(int64_t min = -1; min <= 2 * sz + 2; min += 37){
+        for(int64_t max = min -1; max <= 2 * sz + 2; max += 101){
+            int64_t expected_key = std::max<int64_t>(2, min + (min % 2 != 0)); // first even key >= min
+            pma::scan(implementation, min, max, [&](const int64_t* keys, const int64_t* values, size_t length){
+                REQUIRE(length > 0);
+                for(size_t i = 0; i < length; i++){
+                    REQUIRE(keys[i] == expected_key);
+                    REQUIRE(values[i] == expected_key * 10);
+                    expected_key += 2;
+                }
+                return true;
+            });
+            REQUIRE(expected_key == std::max<int64_t>(std::max<int64_t>(2, min + (min % 2 != 0)), std::min<int64_t>(2 * sz, max - (max % 2 != 0)) + 2));
+        }
+    }
+
+    // stop after the first run
+    size_t num_runs = 0;
+    pma::scan(implementation, 0, 2 * sz, [&](const int64_t*, const int64_t*, size_t){
+        num_runs++;
+        return false;
+    });
+    REQUIRE(num_runs == 1);
+}
+
+TEST_CASE("snapshot"){
+    initialise();
+    BTreePMACC7 pma1 {32, 1};
+    constexpr size_t sz = 1ull << 16;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(auto key : keys){ pma1.insert(key, key * 10); }
+    for(size_t i = 0; i < sz / 2; i++){ pma1.remove(keys[i]); } // leave some gaps
+    string path = "/tmp/pma_snapshot_" + to_string(getpid()) + ".bin";
+    pma1.save(path);
+
+    // restore the snapshot in a different instance
+    BTreePMACC7 pma2 {32, 1};
+    pma2.insert(1, 1); // the content of the PMA is replaced
+    pma2.open(path);
+    REQUIRE(pma2.size() == pma1.size());
+    auto it1 = pma1.iterator();
+    auto it2 = pma2.iterator();
+    while(it1->hasNext()){
+        REQUIRE(it2->hasNext());
+        REQUIRE(it2->next() == it1->next());
+    }
+    REQUIRE(!it2->hasNext());
+    for(size_t i = 0; i < sz; i++){
+        REQUIRE(pma2.find(keys[i]) == (i < sz / 2 ? -1 : keys[i] * 10));
+        REQUIRE(pma2.find(keys[i] +1) == -1);
+    }
+    REQUIRE(pma2.sum(0, sz * 4).m_sum_values == pma1.sum(0, sz * 4).m_sum_values);
+
+    // the restored instance can be altered as usual, including resizes
+    for(size_t i = 0; i < sz; i++){ pma2.insert(keys[i] +1, keys[i]); }
+    for(size_t i = 0; i < sz / 2; i++){ REQUIRE(pma2.remove(keys[i] +1) == keys[i]); }
+    REQUIRE(pma2.size() == sz);
+    for(size_t i = sz / 2; i < sz; i++){
+        REQUIRE(pma2.find(keys[i]) == keys[i] * 10);
+        REQUIRE(pma2.find(keys[i] +1) == keys[i]);
+    }
+
+    unlink(path.c_str());
+    REQUIRE_THROWS(pma2.open(path)); // the file does not exist anymore
+}
+
+TEST_CASE("key_only"){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ true };
+    BTreePMACC7 pma_kv { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1 };
+    pma.set_spread_threads(4);
+
+    // the values are ignored, the value of each element is its key
+    constexpr size_t sz = 1ull << 18;
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i * 2); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+    for(size_t i = 0; i < sz / 2; i++){ pma.insert(keys[i], keys[i] * 10); pma_kv.insert(keys[i], keys[i] * 10); }
+    vector<pair<int64_t, int64_t>> batch;
+    for(size_t i = sz / 2; i < sz; i++){ batch.emplace_back(keys[i], keys[i] * 10); pma_kv.insert(keys[i], keys[i] * 10); }
+    sort(begin(batch), end(batch));
+    pma.load(batch.data(), batch.size());
+    REQUIRE(pma.size() == sz);
+    for(auto key : keys){ REQUIRE(pma.find(key) == key); REQUIRE(pma.find(key +1) == -1); }
+    auto it = pma.iterator();
+    int64_t expected_key = 2;
+    while(it->hasNext()){
+        auto p = it->next();
+        REQUIRE(p.first == expected_key);
+        REQUIRE(p.second == expected_key);
+        expected_key += 2;
+    }
+    REQUIRE(expected_key == 2 * sz + 2);
+    auto sum = pma.sum(0, sz);
+    REQUIRE(sum.m_num_elements == sz / 2);
+    REQUIRE(sum.m_sum_values == sum.m_sum_keys);
+    REQUIRE(pma.memory_footprint() < pma_kv.memory_footprint());
+
+    // snapshot
+    string path = "/tmp/pma_snapshot_" + to_string(getpid()) + ".bin";
+    pma.save(path);
+    BTreePMACC7 pma2 { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ true };
+    pma2.open(path);
+    unlink(path.c_str());
+    REQUIRE(pma2.size() == sz);
+    for(auto key : keys){ REQUIRE(pma2.find(key) == key); }
+
+    // remove the elements, to shrink the array
+    for(size_t i = 0; i < sz; i++){ REQUIRE(pma.remove(keys[i]) == keys[i]); }
+    REQUIRE(pma.empty());
+}
+
+// Check the content of the PMA with compressed keys is the same of the model
+static void validate_compressed(const BTreePMACC7& pma, const map<int64_t, int64_t>& model){
+    REQUIRE(pma.size() == model.size());
+    auto it = pma.iterator();
+    for(auto& e : model){
+        REQUIRE(it->hasNext());
+        auto p = it->next();
+        REQUIRE(p.first == e.first);
+        REQUIRE(p.second == e.second);
+    }
+    REQUIRE(!it->hasNext());
+
+    // blocks
+    it = pma.iterator();
+    auto it_model = model.begin();
+    const int64_t* keys; const int64_t* values;
+    size_t length;
+    while((length = it->next_block(&keys, &values)) > 0){
+        for(size_t i = 0; i < length; i++){
+            REQUIRE(it_model != model.end());
+            REQUIRE(keys[i] == it_model->first);
+            REQUIRE(values[i] == it_model->second);
+            it_model++;
+        }
+    }
+    REQUIRE(it_model == model.end());
+}
+
+// Check the result of a range sum and a range iterator against the model
+static void validate_compressed_sum(const BTreePMACC7& pma, const map<int64_t, int64_t>& model, int64_t min, int64_t max){
+    Interface::SumResult expected;
+    for(auto it = model.lower_bound(min); it != model.end() && it->first <= max; it++){
+        if(expected.m_num_elements == 0) expected.m_first_key = it->first;
+        expected.m_last_key = it->first;
+        expected.m_num_elements++;
+        expected.m_sum_keys += it->first;
+        expected.m_sum_values += it->second;
+    }
+
+    auto result = pma.sum(min, max);
+    REQUIRE(result.m_num_elements == expected.m_num_elements);
+    if(expected.m_num_elements > 0){
+        REQUIRE(result.m_first_key == expected.m_first_key);
+        REQUIRE(result.m_last_key == expected.m_last_key);
+        REQUIRE(result.m_sum_keys == expected.m_sum_keys);
+        REQUIRE(result.m_sum_values == expected.m_sum_values);
+    }
+
+    auto it = pma.find(min, max);
+    for(auto it_model = model.lower_bound(min); it_model != model.end() && it_model->first <= max; it_model++){
+        REQUIRE(it->hasNext());
+        REQUIRE(it->next().first == it_model->first);
+    }
+    REQUIRE(!it->hasNext());
+}
+
+// Random inserts & removals with compressed keys, drawn in [0, 2^key_bits)
+static void check_compressed(size_t segment_size, size_t bits_per_key, int key_bits, size_t num_updates, size_t num_threads = 1){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, segment_size, /* pages per extent */ 1, /* key only */ false, bits_per_key };
+    pma.set_spread_threads(num_threads);
+    map<int64_t, int64_t> model;
+    mt19937_64 random_generator { 42 };
+    auto random_key = [&](){ return static_cast<int64_t>(key_bits == 64 ? random_generator() : random_generator() % (1ull << key_bits)); };
+
+    // inserts
+    for(size_t i = 0; i < num_updates; i++){
+        int64_t key;
+        do { key = random_key(); } while(model.count(key) > 0);
+        pma.insert(key, key * 10);
+        model[key] = key * 10;
+    }
+    validate_compressed(pma, model);
+    for(auto& e : model){ REQUIRE(pma.find(e.first) == e.second); }
+
+    // range sums
+    for(size_t i = 0; i < 100; i++){
+        int64_t min = random_key(), max = random_key();
+        if(min > max) swap(min, max);
+        validate_compressed_sum(pma, model, min, max);
+    }
+    validate_compressed_sum(pma, model, numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max());
+
+    // mixed updates
+    for(size_t i = 0; i < num_updates; i++){
+        if(random_generator() % 2 == 0){
+            int64_t key;
+            do { key = random_key(); } while(model.count(key) > 0);
+            pma.insert(key, key * 10);
+            model[key] = key * 10;
+        } else {
+            auto it = model.lower_bound(random_key());
+            if(it == model.end()) it = model.begin();
+            REQUIRE(pma.remove(it->first) == it->second);
+            model.erase(it);
+        }
+    }
+    validate_compressed(pma, model);
+
+    // remove everything
+    REQUIRE(pma.remove(-1) == -1);
+    while(!model.empty()){
+        auto it = model.lower_bound(random_key());
+        if(it == model.end()) it = model.begin();
+        REQUIRE(pma.remove(it->first) == it->second);
+        REQUIRE(pma.find(it->first) == -1);
+        model.erase(it);
+    }
+    REQUIRE(pma.empty());
+    validate_compressed(pma, model);
+}
+
+TEST_CASE("compressed_sequential"){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 16 };
+    BTreePMACC7 pma_uncompressed { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1 };
+    map<int64_t, int64_t> model;
+    for(int64_t i = 1; i <= 100000; i++){
+        pma.insert(i, i + 100);
+        pma_uncompressed.insert(i, i + 100);
+        model[i] = i + 100;
+    }
+    validate_compressed(pma, model);
+    validate_compressed_sum(pma, model, 100, 60000);
+    REQUIRE(pma.memory_footprint() < pma_uncompressed.memory_footprint());
+
+    for(int64_t i = 100000; i >= 1; i--){
+        REQUIRE(pma.remove(i) == i + 100);
+    }
+    REQUIRE(pma.empty());
+}
+
+TEST_CASE("compressed_dense"){ // the offsets fit in the space reserved
+    check_compressed(/* segment size */ 64, /* bits per key */ 16, /* key bits */ 20, 50000);
+}
+
+TEST_CASE("compressed_sparse"){ // the keys are spread in the whole domain, the segments are never full
+    check_compressed(/* segment size */ 64, /* bits per key */ 16, /* key bits */ 64, 20000);
+}
+
+TEST_CASE("compressed_small_segments"){
+    check_compressed(/* segment size */ 64, /* bits per key */ 8, /* key bits */ 48, 20000);
+}
+
+TEST_CASE("compressed_spread_threads"){ // large windows are spread by multiple workers, in the rewired memory
+    check_compressed(/* segment size */ 32, /* bits per key */ 32, /* key bits */ 40, 400000, /* threads */ 4);
+}
+
+TEST_CASE("compressed_key_only"){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 64, /* pages per extent */ 1, /* key only */ true, /* bits per key */ 16 };
+    map<int64_t, int64_t> model;
+    mt19937_64 random_generator { 7 };
+    for(size_t i = 0; i < 50000; i++){
+        int64_t key = random_generator() % (1ull << 24);
+        if(model.count(key) > 0) continue;
+        pma.insert(key, key * 10); // the value is ignored
+        model[key] = key;
+    }
+    validate_compressed(pma, model);
+    for(auto& e : model){ REQUIRE(pma.find(e.first) == e.first); }
+    validate_compressed_sum(pma, model, 1000, 1ull << 23);
+    for(auto& e : model){ REQUIRE(pma.remove(e.first) == e.first); }
+    REQUIRE(pma.empty());
+}
+
+TEST_CASE("compressed_load"){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 64, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 16 };
+    map<int64_t, int64_t> model;
+    mt19937_64 random_generator { 11 };
+    for(size_t batch_sz : {1, 10, 1000, 30000, 5, 100000}){
+        vector<pair<int64_t, int64_t>> batch;
+        for(size_t i = 0; i < batch_sz; i++){
+            int64_t key = random_generator() % (1ull << 30);
+            if(model.count(key) > 0) continue;
+            batch.emplace_back(key, key + 1);
+            model[key] = key + 1;
+        }
+        sort(begin(batch), end(batch));
+        pma.load(batch.data(), batch.size());
+        validate_compressed(pma, model);
+    }
+    for(auto& e : model){ REQUIRE(pma.find(e.first) == e.second); }
+}
+
+TEST_CASE("compressed_duplicates"){
+    initialise();
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 16 };
+    for(int64_t i = 0; i < 1000; i++){ pma.insert(i % 10, i); }
+    REQUIRE(pma.size() == 1000);
+    auto sum = pma.sum(3, 4);
+    REQUIRE(sum.m_num_elements == 200);
+    REQUIRE(sum.m_sum_keys == 100 * 3 + 100 * 4);
+}
+
+TEST_CASE("compressed_invalid"){
+    initialise();
+    REQUIRE_THROWS_AS((BTreePMACC7{ /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 12 }), std::invalid_argument);
+    REQUIRE_THROWS_AS((BTreePMACC7{ /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 8 }), std::invalid_argument); // too small
+    BTreePMACC7 pma { /* B */ 64, /* segment size */ 32, /* pages per extent */ 1, /* key only */ false, /* bits per key */ 16 };
+    pma.insert(1, 2);
+    REQUIRE_THROWS_AS(pma.save("/tmp/pma_snapshot_compressed.bin"), SnapshotError);
+}
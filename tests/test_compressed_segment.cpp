@@ -0,0 +1,86 @@
+/*
+ * test_compressed_segment.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <limits>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include "pma/generic/compressed_segment.hpp"
+#include "pma/generic/segment_search.hpp"
+
+using namespace pma;
+using namespace std;
+
+static void validate(SegmentSearchKernel kernel){
+    if(!segment_search_is_supported(kernel)) return; // skip
+    segment_search_kernel(kernel);
+    REQUIRE(segment_search_kernel() == kernel);
+
+    mt19937_64 random_generator{ 42 };
+    for(int width = 0; width <= 64; width++){
+        for(size_t num_keys : {1, 2, 3, 4, 5, 7, 8, 9, 31, 32, 33, 64, 100, 511}){
+            // sorted keys, the first is the minimum and the last is the maximum for the given width
+            const uint64_t mask = width == 64 ? numeric_limits<uint64_t>::max() : (static_cast<uint64_t>(1) << width) -1;
+            const int64_t base = width == 64 ? numeric_limits<int64_t>::min() : -static_cast<int64_t>(mask / 2);
+            vector<int64_t> keys;
+            keys.push_back(base);
+            for(size_t i = 2; i < num_keys; i++){ keys.push_back(static_cast<int64_t>(static_cast<uint64_t>(base) + (random_generator() & mask))); }
+            if(num_keys > 1) keys.push_back(static_cast<int64_t>(static_cast<uint64_t>(base) + mask));
+            sort(begin(keys), end(keys));
+            REQUIRE(compressed_segment_width(keys.front(), keys.back()) == (num_keys > 1 ? width : 0));
+            const int encoded_width = compressed_segment_width(keys.front(), keys.back());
+
+            // encode, guard the bytes after the encoded run
+            const size_t num_bytes = compressed_segment_bytes(num_keys, encoded_width);
+            vector<uint8_t> encoded(num_bytes + COMPRESSED_SEGMENT_PADDING, 0xAB);
+            compressed_segment_encode(keys.data(), num_keys, base, encoded_width, encoded.data());
+            for(size_t i = num_bytes; i < encoded.size(); i++){ REQUIRE(encoded[i] == 0xAB); }
+
+            // random access
+            for(size_t i = 0; i < num_keys; i++){ REQUIRE(compressed_segment_get(encoded.data(), i, base, encoded_width) == keys[i]); }
+
+            // decode, also the prefixes of the run
+            for(size_t length : {num_keys, num_keys / 2, num_keys -1}){
+                vector<int64_t> decoded(length +1, 0);
+                decoded[length] = -1; // guard
+                compressed_segment_decode(encoded.data(), length, base, encoded_width, decoded.data());
+                for(size_t i = 0; i < length; i++){ REQUIRE(decoded[i] == keys[i]); }
+                REQUIRE(decoded[length] == -1);
+            }
+
+            // search
+            vector<int64_t> probes = keys;
+            for(auto key : keys){
+                if(key > numeric_limits<int64_t>::min()) probes.push_back(key -1);
+                if(key < numeric_limits<int64_t>::max()) probes.push_back(key +1);
+            }
+            for(auto key : probes){
+                size_t expected_lb = lower_bound(begin(keys), end(keys), key) - begin(keys);
+                size_t expected_ub = upper_bound(begin(keys), end(keys), key) - begin(keys);
+                REQUIRE(compressed_segment_lower_bound(encoded.data(), num_keys, base, encoded_width, key) == expected_lb);
+                REQUIRE(compressed_segment_upper_bound(encoded.data(), num_keys, base, encoded_width, key) == expected_ub);
+            }
+        }
+    }
+}
+
+TEST_CASE("scalar"){
+    validate(SegmentSearchKernel::SCALAR);
+}
+
+TEST_CASE("avx2"){
+    validate(SegmentSearchKernel::AVX2);
+}
+
+TEST_CASE("avx512"){
+    validate(SegmentSearchKernel::AVX512);
+}
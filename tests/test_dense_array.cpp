@@ -6,8 +6,11 @@
  */
 
 #include <iostream>
+#include <map>
 #include <memory>
+#include <random>
 #include <utility>
+#include <vector>
 
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
@@ -413,3 +416,122 @@ TEST_CASE("sum"){
     }
 }
 
+
+// Check the content of the dense array, including the delta, against the model
+static void validate(const DenseArray& array, const multimap<int64_t, int64_t>& model, int64_t min, int64_t max){
+    vector<pair<int64_t, int64_t>> expected;
+    for(auto it = model.lower_bound(min); it != model.end() && it->first <= max; it++){ expected.push_back(*it); }
+
+    // iterator, element by element
+    auto it = array.find(min, max);
+    for(auto& e : expected){
+        REQUIRE(it->hasNext());
+        REQUIRE(it->next().first == e.first);
+    }
+    REQUIRE(!it->hasNext());
+
+    // iterator, by blocks
+    it = array.find(min, max);
+    size_t count = 0;
+    const int64_t* keys; const int64_t* values;
+    while(size_t length = it->next_block(&keys, &values)){
+        for(size_t i = 0; i < length; i++){
+            REQUIRE(count < expected.size());
+            REQUIRE(keys[i] == expected[count].first);
+            count++;
+        }
+    }
+    REQUIRE(count == expected.size());
+
+    // scan
+    count = 0;
+    pma::scan(array, min, max, [&](const int64_t* keys, const int64_t* values, size_t length){
+        for(size_t i = 0; i < length; i++){
+            REQUIRE(keys[i] == expected[count].first);
+            REQUIRE(values[i] / 10 == keys[i]);
+            count++;
+        }
+        return true;
+    });
+    REQUIRE(count == expected.size());
+
+    // sum
+    auto sum = array.sum(min, max);
+    REQUIRE(sum.m_num_elements == expected.size());
+    if(!expected.empty()){
+        REQUIRE(sum.m_first_key == expected.front().first);
+        REQUIRE(sum.m_last_key == expected.back().first);
+        int64_t sum_keys = 0;
+        for(auto& e : expected) sum_keys += e.first;
+        REQUIRE(sum.m_sum_keys == sum_keys);
+        REQUIRE(sum.m_sum_values == sum_keys * 10);
+    }
+}
+
+TEST_CASE("delta"){ // the elements in the delta are visible before they are merged
+    DenseArray array{8};
+    multimap<int64_t, int64_t> model;
+    mt19937_64 random_generator{ 42 };
+    size_t delta_size = 0;
+
+    for(int round = 0; round < 4; round++){
+        for(int i = 0; i < 1000; i++){
+            int64_t key = random_generator() % 5000;
+            array.insert(key, key * 10);
+            model.emplace(key, key * 10);
+            delta_size++;
+        }
+        REQUIRE(array.size() == model.size());
+        REQUIRE(array.delta_size() == delta_size);
+
+        for(int64_t key = 0; key < 5000; key += 7){
+            REQUIRE(array.find(key) == (model.count(key) > 0 ? key * 10 : -1));
+        }
+        vector<int64_t> lookups { 0, 1, 2, 100, 4999, 5000 };
+        vector<int64_t> results(lookups.size());
+        array.find_batch(lookups.data(), results.data(), lookups.size());
+        for(size_t i = 0; i < lookups.size(); i++){ REQUIRE(results[i] == (model.count(lookups[i]) > 0 ? lookups[i] * 10 : -1)); }
+
+        validate(array, model, 0, 5000);
+        validate(array, model, 1000, 1200);
+        validate(array, model, 2000, 1999);
+
+        // merge the elements in the delta only on the even rounds
+        if(round % 2 == 0){
+            array.build();
+            delta_size = 0;
+            REQUIRE(array.delta_size() == 0);
+            REQUIRE(array.size() == model.size());
+            validate(array, model, 0, 5000);
+            validate(array, model, 1500, 3000);
+        }
+    }
+}
+
+TEST_CASE("parallel_merge"){
+    DenseArray array{64};
+    array.set_build_threads(4);
+    multimap<int64_t, int64_t> model;
+    mt19937_64 random_generator{ 7 };
+
+    for(int round = 0; round < 3; round++){
+        for(int i = 0; i < 200000; i++){
+            int64_t key = random_generator() % 1000000;
+            array.insert(key, key * 10);
+            model.emplace(key, key * 10);
+        }
+        array.build();
+        REQUIRE(array.size() == model.size());
+        REQUIRE(array.delta_size() == 0);
+
+        auto it = array.iterator();
+        for(auto& e : model){
+            REQUIRE(it->hasNext());
+            REQUIRE(it->next().first == e.first);
+        }
+        REQUIRE(!it->hasNext());
+    }
+    validate(array, model, 12345, 678901);
+
+    REQUIRE_THROWS(array.set_build_threads(0));
+}
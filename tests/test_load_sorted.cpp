@@ -0,0 +1,102 @@
+/*
+ * test_load_sorted.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "pma/driver.hpp"
+#include "pma/adaptive/bh07_v2/packed_memory_array.hpp"
+#include "pma/adaptive/int2/packed_memory_array.hpp"
+#include "pma/adaptive/int3/packed_memory_array.hpp"
+
+using namespace pma;
+using namespace std;
+
+/**
+ * Load a random permutation of the keys in [1, sz], in batches of the given sizes followed by a batch with the remaining
+ * keys, and validate the content of the PMA. In the key-only mode, the value of each element is its own key.
+ */
+template<typename PMA>
+static void check_load_sorted(PMA& tree, size_t sz, bool key_only = false, const vector<size_t>& batch_sizes = {1, 5, 31, 1000, 4000, 25000}){
+    auto value_of = [key_only](int64_t key){ return key_only ? key : key * 100; };
+    vector<int64_t> keys;
+    for(size_t i = 1; i <= sz; i++){ keys.push_back(i); }
+    mt19937_64 random_generator{ 42 };
+    shuffle(begin(keys), end(keys), random_generator);
+
+    size_t start = 0;
+    auto load = [&](size_t batch_sz){
+        vector<pair<int64_t, int64_t>> batch;
+        for(size_t i = start; i < start + batch_sz; i++){ batch.emplace_back(keys[i], value_of(keys[i])); }
+        tree.load(batch.data(), batch.size());
+        start += batch_sz;
+        REQUIRE(tree.size() == start);
+    };
+    for(size_t batch_sz : batch_sizes){ load(std::min(batch_sz, sz - start)); }
+    load(sz - start); // remaining keys, one batch
+
+    // validate that all elements have been inserted
+    REQUIRE(tree.size() == sz);
+    for(int64_t key = 1; key <= (int64_t) sz; key++){
+        REQUIRE(tree.find(key) == value_of(key));
+    }
+    auto it = tree.iterator();
+    int64_t expected_key = 1;
+    while(it->hasNext()){
+        auto p = it->next();
+        REQUIRE(p.first == expected_key);
+        REQUIRE(p.second == value_of(expected_key));
+        expected_key++;
+    }
+    REQUIRE(expected_key == (int64_t) sz +1);
+}
+
+TEST_CASE("apma_int2"){
+    initialise();
+    adaptive::int2::PackedMemoryArray tree{ /* segment size */ 32, /* pages per extent */ 2};
+    check_load_sorted(tree, 1ull << 16);
+}
+
+TEST_CASE("apma_int3"){
+    initialise();
+    adaptive::int3::PackedMemoryArray tree{ /* segment size */ 32, /* pages per extent */ 2};
+    check_load_sorted(tree, 1ull << 16);
+}
+
+TEST_CASE("apma_int3_key_only"){
+    initialise();
+    adaptive::int3::PackedMemoryArray tree{ /* index block size */ 64, /* segment size */ 32, /* pages per extent */ 2, /* key only */ true};
+    check_load_sorted(tree, 1ull << 16, /* key only */ true);
+}
+
+TEST_CASE("apma_int3_concurrent_readers"){
+    initialise();
+    adaptive::int3::PackedMemoryArray tree{ /* segment size */ 32, /* pages per extent */ 2};
+    tree.set_concurrent_readers(true);
+    check_load_sorted(tree, 1ull << 16);
+}
+
+TEST_CASE("large_batches"){ // batches much larger than the content of the PMA, requiring several resizes
+    initialise();
+    adaptive::int2::PackedMemoryArray tree2{ /* segment size */ 32, /* pages per extent */ 1};
+    check_load_sorted(tree2, 1ull << 16, false, {5000});
+    adaptive::int3::PackedMemoryArray tree3{ /* segment size */ 32, /* pages per extent */ 1};
+    check_load_sorted(tree3, 1ull << 16, false, {5000});
+    adaptive::bh07_v2::APMA_BH07_v2 tree_bh07{/* index block size */ 8, /* segment size */ 32, /* extent size */ 8};
+    check_load_sorted(tree_bh07, 1ull << 16, false, {5000});
+}
+
+TEST_CASE("bh07_v2"){
+    initialise();
+    adaptive::bh07_v2::APMA_BH07_v2 tree{/* index block size */ 8, /* segment size */ 32, /* extent size */ 8};
+    check_load_sorted(tree, 1ull << 16);
+}
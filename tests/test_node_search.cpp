@@ -0,0 +1,56 @@
+/*
+ * test_node_search.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include "pma/generic/node_search.hpp"
+
+using namespace pma;
+using namespace std;
+
+// Compare the kernels for a node of the given capacity against std::lower_bound & std::upper_bound
+template<size_t capacity, typename K>
+static void validate(){
+    mt19937_64 random_generator{ 42 };
+    const size_t max_keys = capacity > 0 ? capacity : 1024;
+    for(size_t num_keys = 0; num_keys <= max_keys; num_keys += (num_keys < 70 ? 1 : 97)){
+        // sorted keys, with duplicates, followed by garbage up to the capacity of the node
+        vector<K> keys;
+        for(size_t i = 0; i < num_keys; i++){ keys.push_back( static_cast<K>((random_generator() % (num_keys +1)) * 10) ); }
+        sort(begin(keys), end(keys));
+        for(size_t i = num_keys; i < max_keys; i++){ keys.push_back( static_cast<K>(random_generator() % 100) ); }
+
+        for(int64_t key = (is_signed<K>::value ? -10 : 0); key <= static_cast<int64_t>(num_keys +1) * 10; key += 5){
+            K k = static_cast<K>(key);
+            size_t expected_lb = lower_bound(begin(keys), begin(keys) + num_keys, k) - begin(keys);
+            size_t expected_ub = upper_bound(begin(keys), begin(keys) + num_keys, k) - begin(keys);
+            REQUIRE(node_lower_bound<capacity>(keys.data(), num_keys, k) == expected_lb);
+            REQUIRE(node_upper_bound<capacity>(keys.data(), num_keys, k) == expected_ub);
+        }
+    }
+}
+
+TEST_CASE("unrolled"){
+    validate<4, int64_t>();
+    validate<8, int64_t>();
+    validate<16, int64_t>();
+    validate<64, int64_t>();
+    validate<10, int64_t>(); // not a multiple of the vector length
+    validate<16, uint32_t>();
+}
+
+TEST_CASE("generic"){
+    validate<0, int64_t>(); // unknown capacity
+    validate<128, int64_t>(); // over NODE_SEARCH_UNROLL_MAX
+    validate<0, uint64_t>();
+}
@@ -1,3 +1,9 @@
+#include <cstring>
+#if defined(HAVE_LIBNUMA)
+#include <numaif.h>
+#endif
+#include <sys/mman.h>
+
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
 
@@ -122,3 +128,215 @@ TEST_CASE("acquire_buffer"){
 
     REQUIRE(rmem.get_used_buffers() == 0); // all employed buffers should have been released
 }
+
+TEST_CASE("swap_batch"){
+    // Allocate 16 extents, where each extent is 2 times the page size
+    constexpr size_t extent_const = 2;
+    constexpr size_t num_extents = 16;
+    BufferedRewiredMemory rmem { extent_const, num_extents };
+    const size_t extent_sz = rmem.get_extent_size() / sizeof(uint64_t);
+
+    uint64_t* array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = 0; i < num_extents * extent_sz; i++){ array[i] = i; }
+
+    // rewire the extents [4, 12) in descending order, acquiring the buffers from the highest one
+    vector<pair<void*, void*>> extents;
+    for(int64_t i = 11; i >= 4; i--){
+        uint64_t* buffer = (uint64_t*) rmem.acquire_buffer(/* highest first */ true);
+        for(size_t j = 0; j < extent_sz; j++){ buffer[j] = 1000000 + i * extent_sz + j; }
+        // mix the order of the arguments, user space & buffer space
+        if(i % 2 == 0){
+            extents.emplace_back(array + i * extent_sz, buffer);
+        } else {
+            extents.emplace_back(buffer, array + i * extent_sz);
+        }
+    }
+    REQUIRE(rmem.get_used_buffers() == 8);
+    rmem.swap_and_release(extents);
+    REQUIRE(rmem.get_used_buffers() == 0);
+
+    // validate the content of the memory space
+    for(size_t i = 0; i < num_extents * extent_sz; i++){
+        size_t extent_id = i / extent_sz;
+        if(extent_id >= 4 && extent_id < 12){
+            REQUIRE(array[i] == 1000000 + i);
+        } else {
+            REQUIRE(array[i] == i);
+        }
+    }
+
+    // rewire again, one extent at the time, on top of the batch
+    for(size_t i = 4; i < 12; i++){
+        uint64_t* buffer = (uint64_t*) rmem.acquire_buffer();
+        for(size_t j = 0; j < extent_sz; j++){ buffer[j] = i * extent_sz + j; }
+        rmem.swap_and_release(array + i * extent_sz, buffer);
+    }
+    for(size_t i = 0; i < num_extents * extent_sz; i++){
+        REQUIRE(array[i] == i);
+    }
+
+    // the same extent cannot be rewired twice in the same batch
+    uint64_t* buffer1 = (uint64_t*) rmem.acquire_buffer();
+    uint64_t* buffer2 = (uint64_t*) rmem.acquire_buffer();
+    REQUIRE_THROWS(rmem.swap_and_release(vector<pair<void*, void*>>{ {array, buffer1}, {array, buffer2} }));
+}
+
+TEST_CASE("grow_reservation"){
+    // Reserve the virtual memory for 4 extents only
+    constexpr size_t extent_const = 2;
+    const size_t extent_bytes = extent_const * get_memory_page_size();
+    RewiredMemory rmem { extent_const, 4, 4 * extent_bytes };
+    REQUIRE(rmem.get_max_memory() == 4 * extent_bytes);
+    const size_t extent_sz = extent_bytes / sizeof(uint64_t);
+
+    uint64_t* array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = 0; i < 4 * extent_sz; i++){ array[i] = i; }
+    rmem.swap(array, array + 3 * extent_sz); // extents: [3, 1, 2, 0]
+
+    // occupy the virtual memory just after the reservation, to force the relocation of the region
+    void* guard = mmap((char*) array + rmem.get_max_memory(), get_memory_page_size(), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    // extend beyond the initial reservation
+    rmem.extend(6);
+    REQUIRE(rmem.get_allocated_extents() == 10);
+    REQUIRE(rmem.get_max_memory() >= 10 * extent_bytes);
+    array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = 4 * extent_sz; i < 10 * extent_sz; i++){ array[i] = i; }
+
+    // the previous rewiring must have been preserved
+    for(size_t i = 0; i < 10 * extent_sz; i++){
+        size_t extent_id = i / extent_sz;
+        size_t expected_extent = extent_id == 0 ? 3 : extent_id == 3 ? 0 : extent_id;
+        REQUIRE(array[i] == expected_extent * extent_sz + i % extent_sz);
+    }
+
+    // rewire again after the growth
+    rmem.swap(array, array + 8 * extent_sz); // extents: [8, 1, 2, 0, 4, 5, 6, 7, 3, 9]
+    REQUIRE(array[0] == 8 * extent_sz);
+    REQUIRE(array[8 * extent_sz] == 3 * extent_sz);
+    REQUIRE(array[3 * extent_sz] == 0);
+
+    if(guard != MAP_FAILED){ munmap(guard, get_memory_page_size()); }
+}
+
+TEST_CASE("reclaim"){
+    constexpr size_t extent_const = 2;
+    const size_t extent_sz = extent_const * get_memory_page_size() / sizeof(uint64_t);
+
+    // release the tail of a rewired region
+    RewiredMemory rmem { extent_const, 8 };
+    uint64_t* array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = 0; i < 8 * extent_sz; i++){ array[i] = i; }
+    rmem.swap(array + extent_sz, array + 6 * extent_sz); // extents: [0, 6, 2, 3, 4, 5, 1, 7]
+    rmem.swap(array + 2 * extent_sz, array + 7 * extent_sz); // extents: [0, 6, 7, 3, 4, 5, 1, 2]
+    rmem.shrink(3);
+    REQUIRE(rmem.get_allocated_extents() == 5);
+    REQUIRE(array == rmem.get_start_address());
+    for(size_t i = 0; i < 5 * extent_sz; i++){
+        size_t extent_id = i / extent_sz;
+        size_t expected_extent = extent_id == 1 ? 6 : extent_id == 2 ? 7 : extent_id;
+        REQUIRE(array[i] == expected_extent * extent_sz + i % extent_sz);
+    }
+
+    // the released extents can be acquired again
+    rmem.extend(3);
+    for(size_t i = 5 * extent_sz; i < 8 * extent_sz; i++){ array[i] = i; }
+    rmem.swap(array, array + 7 * extent_sz);
+    REQUIRE(array[0] == 7 * extent_sz);
+    REQUIRE(array[7 * extent_sz] == 0);
+    REQUIRE(array[extent_sz] == 6 * extent_sz);
+
+    // the buffered memory retains at most 4 free buffers with a reclaim ratio of 0
+    BufferedRewiredMemory bmem { extent_const, 16 };
+    bmem.set_reclaim_ratio(0);
+    array = (uint64_t*) bmem.get_start_address();
+    for(size_t i = 0; i < 16 * extent_sz; i++){ array[i] = i; }
+    void* buffer = bmem.acquire_buffer();
+    memcpy(buffer, array + 2 * extent_sz, extent_sz * sizeof(uint64_t));
+    bmem.swap_and_release(array + 2 * extent_sz, buffer);
+    bmem.shrink(10);
+    REQUIRE(bmem.get_total_buffers() == 4);
+    REQUIRE(bmem.get_allocated_extents() == 10);
+    for(size_t i = 0; i < 6 * extent_sz; i++){ REQUIRE(array[i] == i); }
+
+    // extend again, beyond the retained buffers
+    bmem.extend(8);
+    REQUIRE(bmem.get_used_buffers() == 0);
+    array = (uint64_t*) bmem.get_start_address();
+    for(size_t i = 6 * extent_sz; i < 14 * extent_sz; i++){ array[i] = i; }
+    for(size_t i = 0; i < 14 * extent_sz; i++){ REQUIRE(array[i] == i); }
+}
+
+TEST_CASE("numa_policy"){
+    constexpr size_t extent_const = 2;
+#if !defined(HAVE_LIBNUMA)
+    // without libnuma, only the policy `none' is accepted
+    RewiredMemory rmem { extent_const, 8 };
+    REQUIRE_THROWS(rmem.set_numa_policy(RewiredMemory::NumaPolicy::INTERLEAVED));
+    rmem.set_numa_policy(RewiredMemory::NumaPolicy::NONE);
+    REQUIRE(rmem.get_numa_policy() == RewiredMemory::NumaPolicy::NONE);
+#else
+    const size_t extent_sz = extent_const * get_memory_page_size() / sizeof(uint64_t);
+    const int num_nodes = get_numa_max_node() +1;
+
+    for(auto policy : { RewiredMemory::NumaPolicy::INTERLEAVED, RewiredMemory::NumaPolicy::LOCAL, RewiredMemory::NumaPolicy::PARTITIONED }){
+        RewiredMemory rmem { extent_const, 8 };
+        rmem.set_numa_policy(policy);
+        REQUIRE(rmem.get_numa_policy() == policy);
+        uint64_t* array = (uint64_t*) rmem.get_start_address();
+        for(size_t i = 0; i < 8 * extent_sz; i++){ array[i] = i; }
+
+        // rewire the first and the last extent, then grow the memory
+        rmem.swap(array, array + 7 * extent_sz);
+        rmem.extend(8);
+        array = (uint64_t*) rmem.get_start_address();
+        for(size_t i = 8 * extent_sz; i < 16 * extent_sz; i++){ array[i] = i; }
+        for(size_t i = 0; i < 16 * extent_sz; i++){
+            size_t extent_id = i / extent_sz;
+            size_t expected_extent = extent_id == 0 ? 7 : extent_id == 7 ? 0 : extent_id;
+            REQUIRE(array[i] == expected_extent * extent_sz + i % extent_sz);
+        }
+
+        // with the partitioned placement, each virtual extent resides in the node of its range
+        if(policy == RewiredMemory::NumaPolicy::PARTITIONED && num_nodes > 1){
+            for(size_t extent_id = 0; extent_id < 16; extent_id++){
+                int node = -1;
+                REQUIRE(get_mempolicy(&node, nullptr, 0, array + extent_id * extent_sz, MPOL_F_NODE | MPOL_F_ADDR) == 0);
+                REQUIRE(node == static_cast<int>(extent_id * num_nodes / 16));
+            }
+        }
+    }
+#endif
+}
+
+TEST_CASE("prefault"){
+    constexpr size_t extent_const = 2;
+    const size_t extent_sz = extent_const * get_memory_page_size() / sizeof(uint64_t);
+
+    RewiredMemory rmem { extent_const, 4 };
+    rmem.set_prefault(true);
+    uint64_t* array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = 0; i < 4 * extent_sz; i++){ array[i] = i; }
+
+    // each extension doubles the memory, as expected by the background thread
+    size_t num_extents = 4;
+    for(size_t round = 0; round < 4; round++){
+        rmem.extend(num_extents);
+        array = (uint64_t*) rmem.get_start_address();
+        for(size_t i = num_extents * extent_sz; i < 2 * num_extents * extent_sz; i++){
+            REQUIRE(array[i] == 0); // the memory allocated ahead must be zeroed
+            array[i] = i;
+        }
+        num_extents *= 2;
+    }
+    rmem.swap(array, array + (num_extents -1) * extent_sz);
+    rmem.shrink(num_extents / 2);
+    REQUIRE(rmem.get_allocated_extents() == num_extents / 2);
+    REQUIRE(array[0] == (num_extents -1) * extent_sz);
+    for(size_t i = extent_sz; i < num_extents / 2 * extent_sz; i++){ REQUIRE(array[i] == i); }
+
+    // the memory released by the shrink must be zeroed when acquired again
+    rmem.extend(1);
+    array = (uint64_t*) rmem.get_start_address();
+    for(size_t i = num_extents / 2 * extent_sz; i < (num_extents / 2 +1) * extent_sz; i++){ REQUIRE(array[i] == 0); }
+}
@@ -0,0 +1,67 @@
+/*
+ * test_segment_search.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include "pma/generic/segment_search.hpp"
+
+using namespace pma;
+using namespace std;
+
+static void validate(SegmentSearchKernel kernel){
+    if(!segment_search_is_supported(kernel)) return; // skip
+    segment_search_kernel(kernel);
+    REQUIRE(segment_search_kernel() == kernel);
+
+    mt19937_64 random_generator{ 42 };
+    for(size_t num_keys : {0, 1, 2, 3, 7, 8, 9, 31, 32, 33, 64, 100, 511, 1024}){
+        // sorted keys, with duplicates
+        vector<int64_t> keys;
+        for(size_t i = 0; i < num_keys; i++){ keys.push_back( (random_generator() % (num_keys +1)) * 10 ); }
+        sort(begin(keys), end(keys));
+
+        for(int64_t key = -10; key <= static_cast<int64_t>(num_keys +1) * 10; key += 5){
+            size_t expected_lb = lower_bound(begin(keys), end(keys), key) - begin(keys);
+            size_t expected_ub = upper_bound(begin(keys), end(keys), key) - begin(keys);
+            int64_t expected_pos = (expected_lb < num_keys && keys[expected_lb] == key) ? expected_lb : -1;
+
+            REQUIRE(segment_lower_bound(keys.data(), num_keys, key) == expected_lb);
+            REQUIRE(segment_upper_bound(keys.data(), num_keys, key) == expected_ub);
+            REQUIRE(segment_find(keys.data(), num_keys, key) == expected_pos);
+        }
+
+        // aggregate sums, for the suffixes of the run
+        vector<int64_t> values;
+        for(size_t i = 0; i < num_keys; i++){ values.push_back( static_cast<int64_t>(random_generator() % 1000000) - 500000 ); }
+        for(size_t start = 0; start <= num_keys; start += 1 + start / 4){
+            int64_t expected_keys = 0, expected_values = 0;
+            for(size_t i = start; i < num_keys; i++){ expected_keys += keys[i]; expected_values += values[i]; }
+            int64_t sum_keys = 1, sum_values = -1; // the kernel adds to the existing totals
+            segment_sum(keys.data() + start, values.data() + start, num_keys - start, &sum_keys, &sum_values);
+            REQUIRE(sum_keys == expected_keys + 1);
+            REQUIRE(sum_values == expected_values - 1);
+        }
+    }
+}
+
+TEST_CASE("scalar"){
+    validate(SegmentSearchKernel::SCALAR);
+}
+
+TEST_CASE("avx2"){
+    validate(SegmentSearchKernel::AVX2);
+}
+
+TEST_CASE("avx512"){
+    validate(SegmentSearchKernel::AVX512);
+}
@@ -0,0 +1,65 @@
+/*
+ * test_slab_allocator.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "slab_allocator.hpp"
+
+using namespace std;
+
+TEST_CASE("sanity"){
+    SlabAllocator allocator { 100 };
+    REQUIRE(allocator.object_size() == 128); // rounded to the cache line
+    REQUIRE(allocator.num_chunks() == 0);
+
+    vector<char*> objects;
+    for(size_t i = 0; i < 100000; i++){
+        char* object = reinterpret_cast<char*>(allocator.allocate(objects.empty() ? nullptr : objects.back()));
+        REQUIRE(reinterpret_cast<uintptr_t>(object) % 64 == 0);
+        memset(object, static_cast<int>(i % 256), 100);
+        objects.push_back(object);
+    }
+    REQUIRE(allocator.num_allocated() == objects.size());
+    REQUIRE(allocator.num_chunks() > 1);
+    REQUIRE(allocator.memory_footprint() >= objects.size() * allocator.object_size());
+    for(size_t i = 0; i < objects.size(); i++){
+        REQUIRE(objects[i][0] == static_cast<char>(i % 256));
+        REQUIRE(objects[i][99] == static_cast<char>(i % 256));
+    }
+
+    // release the objects in random order, the slots are reused
+    mt19937_64 random_generator { 42 };
+    shuffle(begin(objects), end(objects), random_generator);
+    for(size_t i = 0; i < objects.size() / 2; i++){ allocator.deallocate(objects[i]); }
+    objects.erase(begin(objects), begin(objects) + objects.size() / 2);
+    size_t num_chunks = allocator.num_chunks();
+    for(size_t i = 0; i < 1000; i++){ objects.push_back(reinterpret_cast<char*>(allocator.allocate())); }
+    REQUIRE(allocator.num_chunks() == num_chunks);
+
+    // the empty chunks are released, but the last one
+    for(auto object : objects){ allocator.deallocate(object); }
+    REQUIRE(allocator.num_allocated() == 0);
+    REQUIRE(allocator.num_chunks() == 1);
+}
+
+TEST_CASE("hint"){
+    SlabAllocator allocator { 1000 };
+    void* first = allocator.allocate();
+    void* second = allocator.allocate(first);
+    // same chunk
+    REQUIRE(abs(reinterpret_cast<char*>(second) - reinterpret_cast<char*>(first)) < static_cast<ptrdiff_t>(allocator.memory_footprint()));
+    allocator.deallocate(first);
+    allocator.deallocate(second);
+
+    REQUIRE_THROWS(SlabAllocator{0});
+}
@@ -5,9 +5,14 @@
  *      Author: dleo@cwi.nl
  */
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <random>
+#include <sstream>
 #include <utility>
+#include <vector>
 
 #define CATCH_CONFIG_MAIN
 #include "third-party/catch/catch.hpp"
@@ -143,3 +148,191 @@ TEST_CASE("height6"){
         REQUIRE(index.find((i+1) * 10 +1) == i);
     }
 }
+
+TEST_CASE("eytzinger"){
+    for(size_t num_keys : {1, 2, 3, 7, 8, 64, 366, 4000}){
+        StaticIndex btree(/* node size */ 5, num_keys, StaticIndex::Layout::BTREE);
+        StaticIndex eytzinger(/* node size */ 5, num_keys, StaticIndex::Layout::EYTZINGER);
+        REQUIRE(eytzinger.layout() == StaticIndex::Layout::EYTZINGER);
+        for(int i = 0; i < num_keys; i++){
+            int64_t key = (i / 3 +1) * 10; // with duplicates
+            btree.set_separator_key(i, key);
+            eytzinger.set_separator_key(i, key);
+        }
+        for(int i = 0; i < num_keys; i++){
+            REQUIRE(eytzinger.get_separator_key(i) == btree.get_separator_key(i));
+        }
+
+        int64_t max_key = (num_keys / 3 +2) * 10;
+        for(int64_t key = 0; key <= max_key; key += 5){
+            REQUIRE(eytzinger.find(key) == btree.find(key));
+            REQUIRE(eytzinger.find_first(key) == btree.find_first(key));
+            REQUIRE(eytzinger.find_last(key) == btree.find_last(key));
+        }
+
+        // switch the layout, the separator keys must be preserved
+        btree.set_layout(StaticIndex::Layout::EYTZINGER);
+        eytzinger.set_layout(StaticIndex::Layout::BTREE);
+        REQUIRE(btree.layout() == StaticIndex::Layout::EYTZINGER);
+        REQUIRE(eytzinger.layout() == StaticIndex::Layout::BTREE);
+        for(int64_t key = 0; key <= max_key; key += 5){
+            REQUIRE(eytzinger.find(key) == btree.find(key));
+            REQUIRE(eytzinger.find_first(key) == btree.find_first(key));
+            REQUIRE(eytzinger.find_last(key) == btree.find_last(key));
+        }
+    }
+}
+
+TEST_CASE("find_batch"){
+    for(auto layout : {StaticIndex::Layout::BTREE, StaticIndex::Layout::EYTZINGER, StaticIndex::Layout::LEARNED}){
+        for(size_t num_keys : {1, 3, 7, 64, 366, 4000}){
+            StaticIndex index(/* node size */ 5, num_keys, layout);
+            for(int i = 0; i < num_keys; i++){ index.set_separator_key(i, (i+1) * 10); }
+
+            vector<int64_t> keys;
+            for(int64_t key = 0; key <= static_cast<int64_t>(num_keys +1) * 10; key += 5){ keys.push_back(key); }
+            vector<uint64_t> segments(keys.size());
+            index.find_batch(keys.data(), segments.data(), keys.size());
+            for(size_t i = 0; i < keys.size(); i++){
+                REQUIRE(segments[i] == index.find(keys[i]));
+            }
+        }
+    }
+}
+
+// Check the segments returned by the index against a binary search on the separator keys
+static void check_learned(const StaticIndex& index, const vector<int64_t>& separators, int64_t key){
+    uint64_t expected_first = (key < separators[0]) ? 0 : lower_bound(begin(separators) +1, end(separators), key) - begin(separators) -1;
+    uint64_t expected_last = (key < separators[0]) ? 0 : upper_bound(begin(separators) +1, end(separators), key) - begin(separators) -1;
+    REQUIRE(index.find_first(key) == expected_first);
+    REQUIRE(index.find_last(key) == expected_last);
+    REQUIRE(index.find(key) == ((key <= separators[0]) ? 0 : expected_last));
+}
+
+TEST_CASE("learned"){
+    mt19937_64 random_generator { 42 };
+    for(size_t num_keys : {1, 2, 3, 7, 64, 366, 4000, 20000}){
+        // near-sequential keys, with duplicates
+        vector<int64_t> separators;
+        for(size_t i = 0; i < num_keys; i++){ separators.push_back((i / 3 +1) * 10 + random_generator() % 5); }
+        sort(begin(separators), end(separators));
+
+        StaticIndex btree(/* node size */ 5, num_keys, StaticIndex::Layout::BTREE);
+        StaticIndex learned(/* node size */ 5, num_keys, StaticIndex::Layout::LEARNED);
+        REQUIRE(learned.layout() == StaticIndex::Layout::LEARNED);
+        for(size_t i = 0; i < num_keys; i++){
+            btree.set_separator_key(i, separators[i]);
+            learned.set_separator_key(i, separators[i]);
+        }
+        for(size_t i = 0; i < num_keys; i++){
+            REQUIRE(learned.get_separator_key(i) == btree.get_separator_key(i));
+        }
+        bool integrity_check = true;
+        stringstream ss;
+        learned.dump(ss, &integrity_check);
+        REQUIRE(integrity_check);
+
+        int64_t max_key = separators.back() + 10;
+        for(int64_t key = 0; key <= max_key; key++){
+            REQUIRE(learned.find(key) == btree.find(key));
+            REQUIRE(learned.find_first(key) == btree.find_first(key));
+            REQUIRE(learned.find_last(key) == btree.find_last(key));
+        }
+
+        // switch the layout, the separator keys must be preserved
+        btree.set_layout(StaticIndex::Layout::LEARNED);
+        learned.set_layout(StaticIndex::Layout::EYTZINGER);
+        for(int64_t key = 0; key <= max_key; key += 3){
+            REQUIRE(learned.find(key) == btree.find(key));
+            REQUIRE(learned.find_first(key) == btree.find_first(key));
+            REQUIRE(learned.find_last(key) == btree.find_last(key));
+        }
+    }
+}
+
+TEST_CASE("learned_updates"){
+    constexpr size_t num_keys = 8000;
+    mt19937_64 random_generator { 42 };
+    StaticIndex index(/* node size */ 9, num_keys, StaticIndex::Layout::LEARNED);
+    vector<int64_t> separators;
+    for(size_t i = 0; i < num_keys; i++){
+        separators.push_back(i * 100);
+        index.set_separator_key(i, separators[i]);
+    }
+
+    // redistribute the keys in a window of segments, as a rebalance would do, the model must follow the new keys
+    for(size_t round = 0; round < 200; round++){
+        size_t window_length = 2 + random_generator() % 500;
+        size_t window_start = random_generator() % (num_keys - window_length +1);
+        int64_t key_min = (window_start == 0) ? separators[0] : separators[window_start -1];
+        int64_t key_max = (window_start + window_length == num_keys) ? separators.back() + 100000 : separators[window_start + window_length];
+        vector<int64_t> keys;
+        for(size_t i = 0; i < window_length; i++){ keys.push_back(key_min + random_generator() % (key_max - key_min +1)); }
+        sort(begin(keys), end(keys));
+        for(size_t i = 0; i < window_length; i++){
+            separators[window_start + i] = keys[i];
+            index.set_separator_key(window_start + i, keys[i]);
+        }
+
+        for(size_t i = 0; i < 200; i++){
+            check_learned(index, separators, separators[random_generator() % num_keys] + (int64_t) (random_generator() % 3) -1);
+        }
+    }
+
+    bool integrity_check = true;
+    stringstream ss;
+    index.dump(ss, &integrity_check);
+    REQUIRE(integrity_check);
+    for(size_t i = 0; i < num_keys; i++){
+        REQUIRE(index.get_separator_key(i) == separators[i]);
+        check_learned(index, separators, separators[i]);
+    }
+
+    // a new minimum
+    separators[0] = numeric_limits<int64_t>::min();
+    index.set_separator_key(0, separators[0]);
+    check_learned(index, separators, numeric_limits<int64_t>::min());
+    check_learned(index, separators, -1);
+    check_learned(index, separators, numeric_limits<int64_t>::max());
+}
+
+TEST_CASE("learned_rebuild"){
+    constexpr size_t num_keys = 1000;
+    auto is_fitted = [](const StaticIndex& index){
+        bool integrity_check = true;
+        stringstream ss;
+        index.dump(ss, &integrity_check);
+        bool fitted = ss.str().find("model not fitted yet") == string::npos;
+        if(fitted){ REQUIRE(integrity_check); }
+        return fitted;
+    };
+
+    // the spreads do not set the separator keys of the empty segments, the model is fitted once a key is set again
+    StaticIndex index(/* node size */ 9, num_keys, StaticIndex::Layout::LEARNED);
+    vector<int64_t> separators;
+    for(size_t i = 0; i < num_keys; i++){
+        separators.push_back(i * 10);
+        if(i % 100 != 99){ index.set_separator_key(i, separators[i]); }
+    }
+    REQUIRE(!is_fitted(index));
+    index.set_separator_key(500, separators[500]);
+    REQUIRE(is_fitted(index));
+    for(size_t i = 0; i < num_keys; i++){
+        if(i % 100 == 99){ // an empty segment takes the separator key of the next segment, it is never the result of a lookup
+            REQUIRE(index.get_separator_key(i) == ((i +1 < num_keys) ? separators[i +1] : numeric_limits<int64_t>::max()));
+            REQUIRE(index.find(separators[i]) == i -1);
+        } else {
+            REQUIRE(index.find(separators[i]) == i);
+        }
+    }
+
+    // the same key set more than once only counts once
+    index.rebuild(num_keys);
+    for(size_t i = 0; i < num_keys -1; i++){ index.set_separator_key(1, separators[1]); }
+    REQUIRE(is_fitted(index));
+    for(size_t i = 0; i < num_keys; i++){ index.set_separator_key(i, separators[i]); }
+    for(size_t i = 0; i < num_keys; i++){
+        REQUIRE(index.get_separator_key(i) == separators[i]);
+        check_learned(index, separators, separators[i]);
+    }
+}
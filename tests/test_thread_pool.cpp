@@ -0,0 +1,70 @@
+/*
+ * test_thread_pool.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using namespace std;
+
+TEST_CASE("sanity"){
+    ThreadPool pool;
+    REQUIRE(pool.num_threads() == 0);
+
+    for(size_t num_workers : {1, 2, 4, 3, 8}){
+        vector<int> executed(num_workers, 0);
+        pool.run(num_workers, [&](size_t worker_id){ executed[worker_id]++; });
+        for(size_t i = 0; i < num_workers; i++){ REQUIRE(executed[i] == 1); }
+    }
+    REQUIRE(pool.num_threads() == 7); // the threads are reused, the caller is the worker 0
+}
+
+TEST_CASE("exceptions"){
+    ThreadPool pool;
+    REQUIRE_THROWS(pool.run(4, [](size_t worker_id){ if(worker_id == 2) throw std::runtime_error("worker 2"); }));
+    REQUIRE_THROWS(pool.run(4, [](size_t worker_id){ if(worker_id == 0) throw std::runtime_error("caller"); }));
+
+    // the pool is still usable
+    atomic<size_t> count { 0 };
+    pool.run(4, [&](size_t){ count++; });
+    REQUIRE(count == 4);
+}
+
+TEST_CASE("nested"){
+    // a job started from a worker, or while the pool is busy, is executed by temporary threads
+    atomic<size_t> count { 0 };
+    run_workers(4, [&](size_t){
+        run_workers(4, [&](size_t){ count++; });
+    });
+    REQUIRE(count == 16);
+
+    vector<thread> threads;
+    for(size_t i = 0; i < 4; i++){
+        threads.emplace_back([&](){
+            for(size_t j = 0; j < 100; j++){ run_workers(3, [&](size_t){ count++; }); }
+        });
+    }
+    for(auto& t : threads) t.join();
+    REQUIRE(count == 16 + 4 * 100 * 3);
+}
+
+TEST_CASE("nested_exceptions"){
+    // the temporary threads of a nested job also propagate the first exception to the caller
+    atomic<size_t> count { 0 };
+    for(size_t thrower : {0, 2}){
+        REQUIRE_THROWS(run_workers(4, [&](size_t){
+            run_workers(4, [&](size_t worker_id){ if(worker_id == thrower) throw std::runtime_error("nested worker"); count++; });
+        }));
+    }
+    REQUIRE(count == 2 * 4 * 3);
+}
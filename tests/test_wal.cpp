@@ -0,0 +1,284 @@
+/*
+ * test_wal.cpp
+ *
+ *  Created on: 18 Oct 2018
+ *      Author: Dean De Leo
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "third-party/catch/catch.hpp"
+
+#include "pma/driver.hpp"
+#include "pma/iterator.hpp"
+#include "pma/wal.hpp"
+#include "pma/adaptive/int3/packed_memory_array.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace pma;
+using namespace std;
+namespace fs = std::filesystem;
+
+using PackedMemoryArray = pma::adaptive::int3::PackedMemoryArray;
+
+static string make_directory(const string& name){
+    string path = "/tmp/pma_wal_" + name + "_" + to_string(getpid());
+    fs::remove_all(path);
+    return path;
+}
+
+static unique_ptr<Interface> make_pma(){
+    return unique_ptr<Interface>{ new PackedMemoryArray{ /* segment size */ 32, /* pages per extent */ 1 } };
+}
+
+static void save_snapshot(Interface& instance, const string& path){
+    dynamic_cast<PackedMemoryArray&>(instance).save(path);
+}
+
+// An instance restored from the snapshot of the last checkpoint in the directory, if any
+static unique_ptr<Interface> restore_pma(const string& directory){
+    unique_ptr<Interface> instance = make_pma();
+    string path = WriteAheadLog::get_checkpoint_snapshot(directory);
+    if(!path.empty()) dynamic_cast<PackedMemoryArray*>(instance.get())->open(path);
+    return instance;
+}
+
+// Check the content of the given implementation is the same of the model
+static void validate(const Interface& instance, const map<int64_t, int64_t>& model){
+    REQUIRE(instance.size() == model.size());
+    auto it = instance.iterator();
+    for(auto& e : model){
+        REQUIRE(it->hasNext());
+        auto p = it->next();
+        REQUIRE(p.first == e.first);
+        REQUIRE(p.second == e.second);
+    }
+    REQUIRE(!it->hasNext());
+}
+
+// Perform `num_updates' random inserts & removals on both the instance and the model
+static void run_updates(Interface& instance, map<int64_t, int64_t>& model, size_t num_updates, uint64_t seed){
+    mt19937_64 random_generator{ seed };
+    for(size_t i = 0; i < num_updates; i++){
+        if(model.empty() || random_generator() % 3 != 0){
+            int64_t key;
+            do { key = random_generator() % (1ull << 40); } while (model.count(key) > 0);
+            instance.insert(key, key * 10);
+            model[key] = key * 10;
+        } else {
+            auto it = model.lower_bound(random_generator() % (1ull << 40));
+            if(it == model.end()) it = model.begin();
+            REQUIRE(instance.remove(it->first) == it->second);
+            model.erase(it);
+        }
+    }
+}
+
+TEST_CASE("replay"){
+    pma::initialise();
+    string directory = make_directory("replay");
+    map<int64_t, int64_t> model;
+
+    { // first run
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), /* segment size */ (1ull << 16), /* replay ? */ false };
+        run_updates(wal, model, 20000, 42);
+        validate(wal, model);
+    } // the log is flushed by the destructor
+
+    { // replay the log on top of an empty instance
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 20000);
+        validate(wal, model);
+        run_updates(wal, model, 5000, 43);
+        wal.flush();
+    }
+
+    { // replay again, the log continues in the new segments
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 25000);
+        validate(wal, model);
+        REQUIRE(wal.get_statistics().m_num_records == 0);
+    }
+
+    { // discard the log
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ false };
+        REQUIRE(wal.size() == 0);
+    }
+    {
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 0);
+        REQUIRE(wal.size() == 0);
+    }
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("sync"){
+    pma::initialise();
+    string directory = make_directory("sync");
+    map<int64_t, int64_t> model;
+
+    { // each update is durable before returning
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(0), (1ull << 16), /* replay ? */ false };
+        run_updates(wal, model, 200, 42);
+        auto stats = wal.get_statistics();
+        REQUIRE(stats.m_num_records == 200);
+        REQUIRE(stats.m_num_group_commits == 200);
+        REQUIRE(stats.m_num_bytes == stats.m_num_records * 32);
+    }
+
+    {
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(0), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 200);
+        validate(wal, model);
+    }
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("checkpoint"){
+    pma::initialise();
+    string directory = make_directory("checkpoint");
+    map<int64_t, int64_t> model;
+
+    {
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ false };
+        REQUIRE(WriteAheadLog::get_checkpoint_snapshot(directory) == "");
+        run_updates(wal, model, 20000, 42);
+        wal.checkpoint(save_snapshot);
+        run_updates(wal, model, 3000, 43);
+    }
+
+    { // restore the snapshot & replay only the updates after the checkpoint
+        WriteAheadLog wal { restore_pma(directory), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 3000);
+        validate(wal, model);
+
+        // a second checkpoint replaces the first snapshot
+        string path_snapshot = WriteAheadLog::get_checkpoint_snapshot(directory);
+        run_updates(wal, model, 1000, 44);
+        wal.checkpoint(save_snapshot);
+        REQUIRE(WriteAheadLog::get_checkpoint_snapshot(directory) != path_snapshot);
+        REQUIRE(!fs::exists(path_snapshot));
+    }
+
+    {
+        WriteAheadLog wal { restore_pma(directory), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 0);
+        validate(wal, model);
+    }
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("checkpoint_crash"){
+    pma::initialise();
+    string directory = make_directory("checkpoint_crash");
+    string directory_copy = directory + "_copy";
+    fs::remove_all(directory_copy);
+    map<int64_t, int64_t> model;
+
+    {
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ false };
+        run_updates(wal, model, 5000, 42);
+
+        // a checkpoint that fails while saving the snapshot leaves neither the snapshot nor its LSN behind
+        REQUIRE_THROWS(wal.checkpoint([](Interface& instance, const string& path){
+            save_snapshot(instance, path);
+            throw std::runtime_error("crash");
+        }));
+        REQUIRE(WriteAheadLog::get_checkpoint_snapshot(directory) == "");
+
+        run_updates(wal, model, 5000, 43);
+        wal.flush();
+        fs::copy(directory, directory_copy); // the segments before the checkpoint
+        wal.checkpoint(save_snapshot);
+        run_updates(wal, model, 2000, 44);
+    }
+
+    // emulate a crash after the snapshot has been saved, but before the segments it includes have been removed
+    for(auto& entry : fs::directory_iterator(directory_copy)){
+        fs::copy(entry.path(), fs::path(directory) / entry.path().filename(), fs::copy_options::skip_existing);
+    }
+    fs::remove_all(directory_copy);
+
+    { // the updates included in the snapshot are not replayed again
+        WriteAheadLog wal { restore_pma(directory), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 2000);
+        validate(wal, model);
+    }
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("bulk_loading"){
+    pma::initialise();
+    string directory = make_directory("bulk_loading");
+    map<int64_t, int64_t> model;
+
+    {
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ false };
+        BulkLoading* bulk_loading = &wal; // as accessed by the experiments
+        bulk_loading->set_load_threads(2);
+        mt19937_64 random_generator{ 42 };
+        for(int batch = 0; batch < 4; batch++){
+            vector<pair<int64_t, int64_t>> elements;
+            while(elements.size() < 5000){
+                int64_t key = random_generator() % (1ull << 40);
+                if(model.count(key) > 0) continue;
+                model[key] = key * 10;
+                elements.emplace_back(key, key * 10);
+            }
+            bulk_loading->load(elements.data(), elements.size());
+        }
+        validate(wal, model);
+        REQUIRE(wal.get_statistics().m_num_records == 20000);
+    }
+
+    { // the batches are replayed as single insertions
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 16), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 20000);
+        validate(wal, model);
+    }
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("torn_write"){
+    pma::initialise();
+    string directory = make_directory("torn_write");
+    map<int64_t, int64_t> model, model_last;
+
+    { // a single segment
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 20), /* replay ? */ false };
+        run_updates(wal, model, 999, 42);
+        model_last = model;
+        run_updates(wal, model_last, 1, 43);
+    }
+
+    // corrupt the last record
+    string path = directory + "/wal_000000000001.log";
+    int fd = ::open(path.c_str(), O_WRONLY);
+    REQUIRE(fd >= 0);
+    int64_t garbage = 12345;
+    REQUIRE(pwrite(fd, &garbage, sizeof(garbage), 999 * 32 + 8) == sizeof(garbage));
+    close(fd);
+
+    { // all records but the last one are replayed
+        WriteAheadLog wal { make_pma(), directory, chrono::milliseconds(5), (1ull << 20), /* replay ? */ true };
+        REQUIRE(wal.get_replayed_updates() == 999);
+        validate(wal, model);
+    }
+
+    fs::remove_all(directory);
+}
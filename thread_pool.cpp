@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "thread_pool.hpp"
+
+#include <cassert>
+
+using namespace std;
+
+// Whether the current thread belongs to a pool
+static thread_local bool g_pool_worker = false;
+
+ThreadPool::ThreadPool() { }
+
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_terminate = true;
+    }
+    m_condvar_workers.notify_all();
+    for(auto& t : m_threads) t.join();
+}
+
+ThreadPool& ThreadPool::instance(){
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::num_threads(){
+    lock_guard<mutex> lock(m_mutex);
+    return m_threads.size();
+}
+
+void ThreadPool::main_thread(){
+    g_pool_worker = true;
+    unique_lock<mutex> lock(m_mutex);
+    while(true){
+        m_condvar_workers.wait(lock, [this](){ return m_terminate || (m_job != nullptr && m_job_next_worker < m_job_num_workers); });
+        if(m_terminate) return;
+
+        size_t worker_id = m_job_next_worker++;
+        const auto* job = m_job;
+        lock.unlock();
+        exception_ptr exception;
+        try {
+            (*job)(worker_id);
+        } catch(...){
+            exception = current_exception();
+        }
+        lock.lock();
+
+        if(exception && !m_job_exception){ m_job_exception = exception; }
+        assert(m_job_pending > 0);
+        if(--m_job_pending == 0){ m_condvar_caller.notify_one(); }
+    }
+}
+
+void ThreadPool::run_detached(size_t num_workers, const std::function<void(size_t)>& fn){
+    mutex mutex_exception;
+    exception_ptr exception; // the first exception raised by the workers
+    auto worker_main = [&](size_t worker_id){
+        try {
+            fn(worker_id);
+        } catch(...){
+            lock_guard<mutex> lock(mutex_exception);
+            if(!exception){ exception = current_exception(); }
+        }
+    };
+
+    vector<thread> threads;
+    try {
+        threads.reserve(num_workers -1);
+        for(size_t worker_id = 1; worker_id < num_workers; worker_id++){
+            threads.emplace_back(worker_main, worker_id);
+        }
+    } catch(...){ // cannot spawn the threads, still wait for those already started
+        lock_guard<mutex> lock(mutex_exception);
+        if(!exception){ exception = current_exception(); }
+    }
+    if(threads.size() == num_workers -1){ worker_main(0); }
+    for(auto& t : threads) t.join();
+
+    if(exception) rethrow_exception(exception);
+}
+
+void ThreadPool::run(size_t num_workers, const std::function<void(size_t)>& fn){
+    if(num_workers <= 1){ fn(0); return; }
+
+    // the pool is already busy with another job
+    unique_lock<mutex> lock_job(m_mutex_job, try_to_lock);
+    if(g_pool_worker || !lock_job.owns_lock()){
+        run_detached(num_workers, fn);
+        return;
+    }
+
+    // publish the job
+    {
+        lock_guard<mutex> lock(m_mutex);
+        while(m_threads.size() < num_workers -1){ m_threads.emplace_back(&ThreadPool::main_thread, this); }
+        m_job = &fn;
+        m_job_num_workers = num_workers;
+        m_job_next_worker = 1;
+        m_job_pending = num_workers -1;
+        m_job_exception = nullptr;
+    }
+    m_condvar_workers.notify_all();
+
+    // the caller is the worker 0
+    exception_ptr exception;
+    try {
+        fn(0);
+    } catch(...){
+        exception = current_exception();
+    }
+
+    // wait for the other workers
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_condvar_caller.wait(lock, [this](){ return m_job_pending == 0; });
+        m_job = nullptr;
+        if(!exception) exception = m_job_exception;
+        m_job_exception = nullptr;
+    }
+
+    if(exception) rethrow_exception(exception);
+}
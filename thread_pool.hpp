@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2018 Dean De Leo, email: dleo[at]cwi.nl
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cinttypes>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A pool of worker threads, shared by the whole process, to execute the parallel phases of the data structures
+ * (spread, bulk loading, merge of the delta, ...). The threads are created on demand, when a job requires more
+ * workers than those already available, and they are kept alive until the termination of the program.
+ *
+ * A job executes fn(worker_id) for all workers in [0, num_workers): the caller acts as the worker 0 and the others
+ * are taken from the pool. Only one job at the time runs in the pool. A job started while the pool is busy, or from
+ * inside a worker of the pool, is executed by temporary threads instead.
+ */
+class ThreadPool {
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::mutex m_mutex_job; // only one job at the time
+    std::mutex m_mutex; // protect the state of the current job
+    std::condition_variable m_condvar_workers; // wake up the workers when a new job is available
+    std::condition_variable m_condvar_caller; // notify the caller when all workers completed the job
+    std::vector<std::thread> m_threads; // the threads in the pool
+    const std::function<void(size_t)>* m_job = nullptr; // the job currently executed
+    size_t m_job_num_workers = 0; // the number of workers, including the caller, for the current job
+    size_t m_job_next_worker = 0; // the next worker id to assign
+    size_t m_job_pending = 0; // the number of workers still executing the current job
+    std::exception_ptr m_job_exception; // the first exception raised by the workers of the current job
+    bool m_terminate = false; // whether to stop the threads in the pool
+
+    // The main loop of each thread in the pool
+    void main_thread();
+
+    // Execute the job with temporary threads, propagating the first exception raised by a worker
+    static void run_detached(size_t num_workers, const std::function<void(size_t)>& fn);
+
+public:
+    /**
+     * Create an empty pool
+     */
+    ThreadPool();
+
+    /**
+     * Stop and join all threads in the pool
+     */
+    ~ThreadPool();
+
+    /**
+     * Retrieve the pool shared by the whole process
+     */
+    static ThreadPool& instance();
+
+    /**
+     * Execute fn(worker_id) for all workers in [0, num_workers), the caller acts as the worker 0. It returns when
+     * all workers completed. The first exception raised by a worker is propagated to the caller.
+     */
+    void run(size_t num_workers, const std::function<void(size_t)>& fn);
+
+    /**
+     * Retrieve the number of threads currently in the pool
+     */
+    size_t num_threads();
+};
+
+/**
+ * Execute fn(worker_id) for all workers in [0, num_workers) with the threads of the shared pool, the caller acts as the worker 0
+ */
+template<typename Function>
+void run_workers(size_t num_workers, Function fn){
+    if(num_workers <= 1){
+        fn(0);
+    } else {
+        ThreadPool::instance().run(num_workers, fn);
+    }
+}
+
+#endif /* THREAD_POOL_HPP_ */